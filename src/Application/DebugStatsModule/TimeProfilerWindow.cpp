@@ -1991,16 +1991,11 @@ void TimeProfilerWindow::RefreshOgreSceneComplexityPage()
         // Get Ogre meshes from terrain EC
         else if (terrain)
         {
-            for(uint y=0; y<terrain->PatchHeight(); ++y)
+            for(uint y=0; y<terrain->ChunksHeight(); ++y)
             {
-                for(uint x=0; x<terrain->PatchWidth(); ++x)
+                for(uint x=0; x<terrain->ChunksWidth(); ++x)
                 {
-                    Ogre::SceneNode *node = terrain->GetPatch(static_cast<int>(x), static_cast<int>(y)).node;
-                    if (!node)
-                        continue;
-                    if (!node->numAttachedObjects())
-                        continue;
-                    ogreEntity = dynamic_cast<Ogre::Entity*>(node->getAttachedObject(0));
+                    ogreEntity = terrain->GetChunk(x, y).entity;
                     if (ogreEntity && ogreEntity->getMesh().get())
                     {
                         Ogre::Mesh* ogreMesh = ogreEntity->getMesh().get();
@@ -2556,9 +2551,10 @@ void TimeProfilerWindow::RefreshBulletPage()
         return;
 
     PhysicsWorldPtr physics = scene->Subsystem<PhysicsWorld>();
-    const std::set<std::pair<const btCollisionObject*, const btCollisionObject*> > &collisions = physics->PreviousFrameCollisions();
+    physics->WaitForSimulation();
+    const std::vector<std::pair<const btCollisionObject*, const btCollisionObject*> > collisions = physics->PreviousFrameCollisions();
 
-    for(std::set<std::pair<const btCollisionObject*, const btCollisionObject*> >::const_iterator iter = collisions.begin(); iter != collisions.end(); ++iter)
+    for(std::vector<std::pair<const btCollisionObject*, const btCollisionObject*> >::const_iterator iter = collisions.begin(); iter != collisions.end(); ++iter)
     {
         const btCollisionObject* objectA = iter->first;
         const btCollisionObject* objectB = iter->second;
@@ -28,6 +28,7 @@ Q_DECLARE_METATYPE(QList<QObject*>)
 Q_DECLARE_METATYPE(QList<RaycastResult*>)
 Q_DECLARE_METATYPE(Entity*)
 Q_DECLARE_METATYPE(std::string)
+Q_DECLARE_METATYPE(QVector<float>)
 Q_DECLARE_METATYPE(EntityList)
 Q_DECLARE_METATYPE(Scene::EntityMap)
 Q_DECLARE_METATYPE(Entity::ComponentMap)
@@ -486,6 +487,8 @@ void ExposeCoreTypes(QScriptEngine *engine)
     qScriptRegisterMetaType<Entity::ComponentMap>(engine, toScriptValueComponentMap, fromScriptValueComponentMap);
     qScriptRegisterMetaType<Entity::ComponentVector>(engine, toScriptValueComponentVector, fromScriptValueComponentVector);
     qScriptRegisterMetaType<std::string>(engine, toScriptValueStdString, fromScriptValueStdString);
+    // Flat number arrays of the batched queries, e.g. EC_Terrain::GetHeightsAndNormals, without boxing each number to a QVariant.
+    qScriptRegisterSequenceMetaType<QVector<float> >(engine);
 
     // Register constructors
     QScriptValue ctorAssetReference = engine->newFunction(createAssetReference);
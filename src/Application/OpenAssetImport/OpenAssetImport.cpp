@@ -17,10 +17,16 @@ Licensed under the MIT license:
 #include "AssetAPI.h"
 #include "IAssetTransfer.h"
 #include "IAsset.h"
+#include "AssetCache.h"
+#include "AssetData.h"
+#include "Profiler.h"
 
 #include <Ogre.h>
 
-#include <assimp/DefaultLogger.hpp>
+#include <QFile>
+#include <QDataStream>
+#include <QThreadPool>
+
 #include <assimp/Importer.hpp>
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
@@ -30,6 +36,83 @@ Licensed under the MIT license:
 
 int OpenAssetConverter::msBoneCount = 0;
 
+/// Version of the converted mesh cache data. Increment when the conversion output changes, so stale cache entries are not used.
+static const quint32 cConvertedMeshCacheVersion = 1;
+
+QDataStream &operator <<(QDataStream &out, const Ogre::ColourValue &c)
+{
+    return out << c.r << c.g << c.b << c.a;
+}
+
+QDataStream &operator >>(QDataStream &in, Ogre::ColourValue &c)
+{
+    return in >> c.r >> c.g >> c.b >> c.a;
+}
+
+QDataStream &operator <<(QDataStream &out, const ImportedMaterial &mat)
+{
+    return out << mat.ambient << mat.diffuse << mat.specular << mat.emissive << mat.shininess
+        << mat.hasDiffuse << mat.hasSpecular << mat.hasEmissive << mat.hasShininess << mat.twoSided << mat.hasTexture << mat.texture;
+}
+
+QDataStream &operator >>(QDataStream &in, ImportedMaterial &mat)
+{
+    return in >> mat.ambient >> mat.diffuse >> mat.specular >> mat.emissive >> mat.shininess
+        >> mat.hasDiffuse >> mat.hasSpecular >> mat.hasEmissive >> mat.hasShininess >> mat.twoSided >> mat.hasTexture >> mat.texture;
+}
+
+QDataStream &operator <<(QDataStream &out, const ImportedSubMesh &subMesh)
+{
+    return out << (qint32)subMesh.materialIndex << subMesh.vertexColors;
+}
+
+QDataStream &operator >>(QDataStream &in, ImportedSubMesh &subMesh)
+{
+    qint32 materialIndex = -1;
+    in >> materialIndex >> subMesh.vertexColors;
+    subMesh.materialIndex = materialIndex;
+    return in;
+}
+
+template<typename T>
+QDataStream &operator <<(QDataStream &out, const std::vector<T> &items)
+{
+    out << (quint32)items.size();
+    for(size_t i = 0; i < items.size(); ++i)
+        out << items[i];
+    return out;
+}
+
+template<typename T>
+QDataStream &operator >>(QDataStream &in, std::vector<T> &items)
+{
+    quint32 count = 0;
+    in >> count;
+    items.clear();
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        T item;
+        in >> item;
+        items.push_back(item);
+    }
+    return in;
+}
+
+ImportedMaterial::ImportedMaterial() :
+    ambient(1.0f, 1.0f, 1.0f, 1.0f),
+    diffuse(1.0f, 1.0f, 1.0f, 1.0f),
+    specular(1.0f, 1.0f, 1.0f, 1.0f),
+    emissive(1.0f, 1.0f, 1.0f, 1.0f),
+    shininess(0.0f),
+    hasDiffuse(false),
+    hasSpecular(false),
+    hasEmissive(false),
+    hasShininess(false),
+    twoSided(false),
+    hasTexture(false)
+{
+}
+
 OpenAssetImport::OpenAssetImport() :
     IModule("OpenAssetImport")
 {
@@ -59,10 +142,38 @@ void OpenAssetImport::OnConversionRequest(OgreMeshAsset *asset, const u8 *data,
 {
     OpenAssetConverter *converter = new OpenAssetConverter(GetFramework());
     connect(converter, SIGNAL(ConversionDone(bool)), asset, SLOT(OnAssimpConversionDone(bool)), Qt::UniqueConnection);
-    converter->Convert(data, len, asset->Name(), asset->DiskSource(), asset->ogreMesh);
+    converter->Convert(asset, data, len);
+}
+
+OpenAssetImportWorker::OpenAssetImportWorker(shared_ptr<Assimp::Importer> importer, const QByteArray &data, const QString &hint, const QString &diskSource, unsigned int flags) :
+    importer_(importer),
+    data_(data),
+    hint_(hint),
+    diskSource_(diskSource),
+    flags_(flags)
+{
+    // Make sure this worker object is deleted by QThreadPool once run() completes.
+    setAutoDelete(true);
+}
+
+void OpenAssetImportWorker::run()
+{
+    const aiScene *scene = importer_->ReadFileFromMemory(reinterpret_cast<const void*>(data_.constData()), data_.size(), flags_, hint_.toStdString().c_str());
+    if (!scene)
+    {
+        LogInfo("AssImp importer::convert: Failed to read file:" + diskSource_ + " from memory: " + importer_->GetErrorString());
+        LogInfo("AssImp importer::convert: Trying to load data from file:" + diskSource_);
+
+        // If the importer failed to read the file from memory,
+        // try to read the file again.
+        scene = importer_->ReadFile(diskSource_.toStdString(), flags_);
+    }
+
+    emit ImportCompleted(scene != 0);
 }
 
 OpenAssetConverter::OpenAssetConverter(Framework *fw) :
+    scene(0),
     assetAPI(fw->Asset()),
     meshCreated(false),
     texCount(0)
@@ -205,7 +316,7 @@ void OpenAssetConverter::SetTexture(QString &texFile)
     texMatMap.erase(texFile);
 
     if(meshCreated && PendingTextures())
-        emit ConversionDone(true);
+        Finish(true);
 }
 
 void OpenAssetConverter::OnTextureLoaded(IAssetTransfer* assetTransfer)
@@ -221,7 +332,7 @@ void OpenAssetConverter::OnTextureLoadFailed(IAssetTransfer* assetTransfer, QStr
     texMatMap.erase(texFile);
 
     if(meshCreated && PendingTextures())
-        emit ConversionDone(true); //mesh created succesfully without textures
+        Finish(true); //mesh created succesfully without textures
 }
 
 bool OpenAssetConverter::PendingTextures()
@@ -414,14 +525,26 @@ void GetBasePose(const aiScene * sc, const aiNode * nd)
     }
 }
 
-void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString &fileName, const QString &diskSource, Ogre::MeshPtr mesh)
+void OpenAssetConverter::Convert(OgreMeshAsset *asset, const u8 *data_, size_t numBytes)
 {
+    PROFILE(OpenAssetConverter_Convert);
     meshCreated = false;
-    LogInfo("AssImp importer: Converting file:" +fileName.toStdString());
-    Assimp::DefaultLogger::create("asslogger.log",Assimp::Logger::VERBOSE);
+    meshAsset = asset->shared_from_this();
+    mesh = asset->ogreMesh;
+    meshName = asset->Name();
+    meshDiskSource = asset->DiskSource();
     mAnimationSpeedModifier = 1.0f;
-    Assimp::Importer importer;
-//    bool searchFromIndex = false;
+
+    // The conversion result depends only on the source data, so identical files share one cache entry regardless of their ref.
+    if (assetAPI->Cache())
+    {
+        cacheKey = "assimp-v" + QString::number(cConvertedMeshCacheVersion) + "-" + AssetCache::ContentHash(data_, numBytes);
+        if (LoadFromCache())
+            return;
+    }
+
+    LogInfo("AssImp importer: Converting file:" + meshName.toStdString());
+    importer = MAKE_SHARED(Assimp::Importer);
 
     /// NOTICE!!!
     // Some converted mesh might show up pretty messed up, it's happening because some formats might
@@ -430,16 +553,16 @@ void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString
     // degenerate structures from bad modelling or bad import/export.  if they
     // are needed it can be turned on with IncludeLinesPoints
 
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
+    importer->SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
     /// END OF NOTICE
 
     // Limit triangles because for each mesh there's limited index memory (16bit)
     // ...which should be easy to just change to 32 bit but it didn't seem to be the case
-    importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, 21845);
+    importer->SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, 21845);
 
-    //importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_CAMERAS|aiComponent_LIGHTS|aiComponent_TEXTURES|aiComponent_ANIMATIONS);
-    //importer.SetPropertyInteger(AI_CONFIG_FAVOUR_SPEED,1);
-    //importer.SetPropertyInteger(AI_CONFIG_GLOB_MEASURE_TIME,0);
+    //importer->SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_CAMERAS|aiComponent_LIGHTS|aiComponent_TEXTURES|aiComponent_ANIMATIONS);
+    //importer->SetPropertyInteger(AI_CONFIG_FAVOUR_SPEED,1);
+    //importer->SetPropertyInteger(AI_CONFIG_GLOB_MEASURE_TIME,0);
 
     // And have it read the given file with some example postprocessing
     // Usually - if speed is not the most important aspect for you - you'll
@@ -463,25 +586,37 @@ void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString
 #endif
 
     //assimp importer looks for a loader to support the file extension specified by hint 
-    QString hint = fileName.right(fileName.length() - fileName.lastIndexOf('.')-1);
-    scene = importer.ReadFileFromMemory(reinterpret_cast<const void*>(data_), numBytes, pFlags, hint.toStdString().c_str());
+    QString hint = meshName.right(meshName.length() - meshName.lastIndexOf('.')-1);
 
-    if(!scene)
+    // Reading and post-processing the file is the heavy part of the conversion and only touches the importer,
+    // so it is done in a worker thread. The source data is copied as the caller's buffer does not outlive this call.
+    OpenAssetImportWorker *worker = new OpenAssetImportWorker(importer, QByteArray(reinterpret_cast<const char*>(data_), (int)numBytes), hint, meshDiskSource, pFlags);
+    connect(worker, SIGNAL(ImportCompleted(bool)), this, SLOT(OnImportCompleted(bool)), Qt::QueuedConnection);
+    QThreadPool::globalInstance()->start(worker);
+}
+
+void OpenAssetConverter::OnImportCompleted(bool success)
+{
+    PROFILE(OpenAssetConverter_OnImportCompleted);
+
+    // The asset may have been unloaded or reloaded while the import was running.
+    AssetPtr asset = meshAsset.lock();
+    OgreMeshAsset *ogreMeshAsset = dynamic_cast<OgreMeshAsset*>(asset.get());
+    if (!ogreMeshAsset || ogreMeshAsset->ogreMesh != mesh)
     {
-        LogInfo("AssImp importer::convert: Failed to read file:" +fileName.toStdString()+ " from memory: ");
-        LogInfo(importer.GetErrorString());
-        LogInfo("AssImp importer::convert: Trying to load data from file:" +fileName.toStdString());
-		
-        // If the importer failed to read the file from memory,
-        // try to read the file again.
-        scene = importer.ReadFile(diskSource.toStdString(), pFlags);
+        LogDebug("AssImp importer: Asset " + meshName + " was unloaded during conversion, discarding the result.");
+        importer.reset();
+        deleteLater();
+        return;
+    }
 
-        if(!scene)
-        {
-            LogError("AssImp importer::convert: conversion failed, importer unable to load data from file:" +fileName.toStdString());
-            emit ConversionDone(false);
-            return;
-        }
+    scene = (success ? importer->GetScene() : 0);
+    if(!scene)
+    {
+        LogError("AssImp importer::convert: conversion failed, importer unable to load data from file:" + meshName.toStdString());
+        importer.reset();
+        Finish(false);
+        return;
     }
 
     if (scene->HasAnimations())
@@ -519,10 +654,14 @@ void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString
     }
 #endif
 
-    LoadDataFromNode(scene, scene->mRootNode, diskSource, fileName, mesh);
+    importedMaterials.clear();
+    importedSubMeshes.clear();
+    for(unsigned int i = 0; i < scene->mNumMaterials; ++i)
+        importedMaterials.push_back(ReadMaterial(scene->mMaterials[i]));
+
+    LoadDataFromNode(scene, scene->mRootNode, meshDiskSource, meshName, mesh);
 
     Ogre::LogManager::getSingleton().logMessage("*** Finished loading ass file ***");
-    Assimp::DefaultLogger::kill();
 
 #ifdef SKELETON_ENABLED
 
@@ -547,7 +686,7 @@ void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString
         Ogre::MeshPtr mMesh = *it;
         if(mBonesByName.size())
         {
-            mMesh->setSkeletonName(fileName.toStdString() + ".skeleton");
+            mMesh->setSkeletonName(meshName.toStdString() + ".skeleton");
         }
 
         Ogre::Mesh::SubMeshIterator smIt = mMesh->getSubMeshIterator();
@@ -578,6 +717,12 @@ void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString
 
 #endif
 
+    StoreToCache();
+
+    // The Ogre mesh now holds all the data we need, release the Assimp scene.
+    scene = 0;
+    importer.reset();
+
     mMeshes.clear();
     mMaterialCode = "";
     mBonesByName.clear();
@@ -591,7 +736,115 @@ void OpenAssetConverter::Convert(const u8 *data_, size_t numBytes, const QString
     Ogre::SkeletonManager::getSingleton().removeUnreferencedResources();
 	
     if(meshCreated && PendingTextures())
-        emit ConversionDone(true);
+        Finish(true);
+}
+
+void OpenAssetConverter::Finish(bool success)
+{
+    emit ConversionDone(success);
+    deleteLater();
+}
+
+bool OpenAssetConverter::LoadFromCache()
+{
+    AssetCache *cache = assetAPI->Cache();
+    const QString meshFile = cache->FindInCache(cacheKey + ".mesh");
+    const QString infoFile = cache->FindInCache(cacheKey + ".meshinfo");
+    if (meshFile.isEmpty() || infoFile.isEmpty())
+        return false;
+
+    PROFILE(OpenAssetConverter_LoadFromCache);
+
+    QFile file(infoFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream stream(&file);
+    quint32 version = 0;
+    stream >> version;
+    if (version != cConvertedMeshCacheVersion)
+        return false;
+
+    std::vector<ImportedSubMesh> subMeshes;
+    std::vector<ImportedMaterial> materials;
+    stream >> subMeshes >> materials;
+    file.close();
+    if (stream.status() != QDataStream::Ok)
+    {
+        LogWarning("AssImp importer: Ignoring corrupted converted mesh cache file " + infoFile);
+        return false;
+    }
+    for(size_t i = 0; i < subMeshes.size(); ++i)
+        if (subMeshes[i].materialIndex < 0 || subMeshes[i].materialIndex >= (int)materials.size())
+            return false;
+
+    AssetData meshData;
+    if (!meshData.LoadFile(meshFile) || meshData.IsEmpty())
+        return false;
+
+    try
+    {
+#include "DisableMemoryLeakCheck.h"
+        Ogre::DataStreamPtr meshStream(new Ogre::MemoryDataStream(const_cast<u8*>(meshData.Data()), meshData.Size(), false, true));
+#include "EnableMemoryLeakCheck.h"
+        Ogre::MeshSerializer serializer;
+        serializer.importMesh(meshStream, mesh.getPointer());
+    }
+    catch(Ogre::Exception &e)
+    {
+        LogWarning("AssImp importer: Failed to load converted mesh for " + meshName + " from cache: " + e.what());
+        while(mesh->getNumSubMeshes() > 0)
+            mesh->destroySubMesh(0);
+        return false;
+    }
+
+    if (mesh->getNumSubMeshes() != subMeshes.size())
+    {
+        LogWarning("AssImp importer: Converted mesh cache file " + meshFile + " does not match its material information, converting again.");
+        while(mesh->getNumSubMeshes() > 0)
+            mesh->destroySubMesh(0);
+        return false;
+    }
+
+    LogDebug("AssImp importer: Loaded converted mesh for " + meshName + " from cache.");
+
+    // The cached mesh may have been converted from an identical file with another name, so recreate the materials with our name.
+    importedMaterials = materials;
+    importedSubMeshes = subMeshes;
+    for(unsigned short i = 0; i < mesh->getNumSubMeshes(); ++i)
+    {
+        Ogre::MaterialPtr matptr = GetOrCreateMaterial(subMeshes[i].materialIndex, subMeshes[i].vertexColors, meshDiskSource, meshName);
+        mesh->getSubMesh(i)->setMaterialName(matptr->getName());
+    }
+
+    meshCreated = true;
+    if(PendingTextures())
+        Finish(true);
+    return true;
+}
+
+void OpenAssetConverter::StoreToCache()
+{
+    AssetCache *cache = assetAPI->Cache();
+    if (!cache || cacheKey.isEmpty())
+        return;
+
+    PROFILE(OpenAssetConverter_StoreToCache);
+    try
+    {
+        Ogre::MeshSerializer serializer;
+        serializer.exportMesh(mesh.getPointer(), cache->GetDiskSourceByRef(cacheKey + ".mesh").toStdString());
+    }
+    catch(Ogre::Exception &e)
+    {
+        LogWarning("AssImp importer: Failed to store converted mesh for " + meshName + " to cache: " + e.what());
+        return;
+    }
+
+    // The material information is written last, so a cache entry is never found without its mesh.
+    QByteArray info;
+    QDataStream stream(&info, QIODevice::WriteOnly);
+    stream << cConvertedMeshCacheVersion << importedSubMeshes << importedMaterials;
+    cache->StoreAsset(reinterpret_cast<const u8*>(info.constData()), info.size(), cacheKey + ".meshinfo");
 }
 
 void OpenAssetConverter::ParseAnimation (const aiScene* mScene, int index, aiAnimation* anim)
@@ -884,76 +1137,81 @@ Ogre::MaterialPtr OpenAssetConverter::CreateVertexColorMaterial()
     return ogreMaterial;
 }
 
-Ogre::MaterialPtr OpenAssetConverter::CreateMaterial(Ogre::String& matName, const aiMaterial* mat, const QString &meshFileDiskSource, const QString &meshFileName)
+ImportedMaterial OpenAssetConverter::ReadMaterial(const aiMaterial *mat) const
 {
-    std::ostringstream matname;
-    Ogre::MaterialManager* ogreMaterialMgr =  Ogre::MaterialManager::getSingletonPtr();
+    ImportedMaterial imported;
     enum aiTextureType Type = aiTextureType_DIFFUSE;
     aiString path;
-//    aiTextureMapping mapping = aiTextureMapping_UV;       // the mapping (should be uv for now)
-    unsigned int uvindex = 0;                             // the texture uv index channel
-//    float blend = 1.0f;                                   // blend
-//    aiTextureOp op = aiTextureOp_Multiply;                // op
-//    aiTextureMapMode mapmode[2] =  { aiTextureMapMode_Wrap, aiTextureMapMode_Wrap };    // mapmode
-    std::ostringstream texname;
-
-    aiString szPath;
-
-    if(AI_SUCCESS == aiGetMaterialString(mat, AI_MATKEY_TEXTURE_DIFFUSE(0), &szPath))
-    {
-	    Ogre::LogManager::getSingleton().logMessage("File: " + meshFileName.toStdString() + ". Texture " + Ogre::String(szPath.data) + " for channel " + Ogre::StringConverter::toString(uvindex));
-        //LogInfo("File: " + meshFileName.toStdString() + ". Texture " + Ogre::String(szPath.data) + " for channel " + Ogre::StringConverter::toString(uvindex));
-    }
-
-    Ogre::MaterialPtr ogreMaterial = ogreMaterialMgr->create(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, true);
 
     // ambient
     aiColor4D clr(1.0f, 1.0f, 1.0f, 1.0f);
     //Ambient is usually way too low! FIX ME!
-    if (mat->GetTexture(Type, 0, &path) != AI_SUCCESS)
+    imported.hasTexture = (mat->GetTexture(Type, 0, &path) == AI_SUCCESS);
+    if (!imported.hasTexture)
         aiGetMaterialColor(mat, AI_MATKEY_COLOR_AMBIENT, &clr);
-
-    ogreMaterial->setAmbient(clr.r, clr.g, clr.b);
+    imported.ambient = Ogre::ColourValue(clr.r, clr.g, clr.b);
 
     // diffuse
     clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
-    if(AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_DIFFUSE, &clr))
-    {
-        ogreMaterial->setDiffuse(clr.r, clr.g, clr.b, clr.a);
-    }
+    imported.hasDiffuse = (AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_DIFFUSE, &clr));
+    imported.diffuse = Ogre::ColourValue(clr.r, clr.g, clr.b, clr.a);
 
     // specular
     clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
-    if(AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_SPECULAR, &clr))
-    {
-        ogreMaterial->setSpecular(clr.r, clr.g, clr.b, clr.a);
-    }
+    imported.hasSpecular = (AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_SPECULAR, &clr));
+    imported.specular = Ogre::ColourValue(clr.r, clr.g, clr.b, clr.a);
 
     // emissive
     clr = aiColor4D(1.0f, 1.0f, 1.0f, 1.0f);
-    if(AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_EMISSIVE, &clr))
-    {
-        ogreMaterial->setSelfIllumination(clr.r, clr.g, clr.b);
-    }
+    imported.hasEmissive = (AI_SUCCESS == aiGetMaterialColor(mat, AI_MATKEY_COLOR_EMISSIVE, &clr));
+    imported.emissive = Ogre::ColourValue(clr.r, clr.g, clr.b);
+
+    float fShininess = 0.0f;
+    imported.hasShininess = (AI_SUCCESS == aiGetMaterialFloat(mat, AI_MATKEY_SHININESS, &fShininess));
+    imported.shininess = fShininess;
+
+    int two_sided = 0;
+    aiGetMaterialInteger(mat, AI_MATKEY_TWOSIDED, &two_sided);
+    imported.twoSided = (two_sided != 0);
+
+    //If the assimp scene contains textures they are loaded into the Ogre resource system
+    aiString szPath;
+    if (imported.hasTexture && !scene->HasTextures() && AI_SUCCESS == aiGetMaterialString(mat, AI_MATKEY_TEXTURE_DIFFUSE(0), &szPath))
+        imported.texture = QString::fromStdString(szPath.data);
+
+    return imported;
+}
 
-    float fShininess;
-    if(AI_SUCCESS == aiGetMaterialFloat(mat, AI_MATKEY_SHININESS, &fShininess))
+Ogre::MaterialPtr OpenAssetConverter::CreateMaterial(Ogre::String& matName, const ImportedMaterial &mat, const QString &meshFileDiskSource, const QString &meshFileName)
+{
+    Ogre::MaterialManager* ogreMaterialMgr =  Ogre::MaterialManager::getSingletonPtr();
+    unsigned int uvindex = 0;                             // the texture uv index channel
+
+    if(!mat.texture.isEmpty())
     {
-        ogreMaterial->setShininess(Ogre::Real(fShininess));
+	    Ogre::LogManager::getSingleton().logMessage("File: " + meshFileName.toStdString() + ". Texture " + mat.texture.toStdString() + " for channel " + Ogre::StringConverter::toString(uvindex));
+        //LogInfo("File: " + meshFileName.toStdString() + ". Texture " + mat.texture.toStdString() + " for channel " + Ogre::StringConverter::toString(uvindex));
     }
 
-    int two_sided;
-    aiGetMaterialInteger(mat, AI_MATKEY_TWOSIDED, &two_sided);
+    Ogre::MaterialPtr ogreMaterial = ogreMaterialMgr->create(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, true);
 
-    if (two_sided != 0)
+    ogreMaterial->setAmbient(mat.ambient.r, mat.ambient.g, mat.ambient.b);
+    if(mat.hasDiffuse)
+        ogreMaterial->setDiffuse(mat.diffuse.r, mat.diffuse.g, mat.diffuse.b, mat.diffuse.a);
+    if(mat.hasSpecular)
+        ogreMaterial->setSpecular(mat.specular.r, mat.specular.g, mat.specular.b, mat.specular.a);
+    if(mat.hasEmissive)
+        ogreMaterial->setSelfIllumination(mat.emissive.r, mat.emissive.g, mat.emissive.b);
+    if(mat.hasShininess)
+        ogreMaterial->setShininess(Ogre::Real(mat.shininess));
+    if (mat.twoSided)
         ogreMaterial->setCullingMode(Ogre::CULL_NONE);
 
-    if (mat->GetTexture(Type, 0, &path) == AI_SUCCESS)
+    if (mat.hasTexture)
     {
-        //If the assimp scene contains textures they are loaded into the Ogre resource system
-        if (!scene->HasTextures())
+        if (!mat.texture.isEmpty())
         {
-            QString tex = QString::fromStdString(szPath.data);
+            QString tex = mat.texture;
             QString texPath = GetPathToTexture(meshFileName, meshFileDiskSource, tex);
             texMatMap.insert(TexMatPair(texPath, ogreMaterial));
             LoadTextureFile(texPath);
@@ -965,6 +1223,32 @@ Ogre::MaterialPtr OpenAssetConverter::CreateMaterial(Ogre::String& matName, cons
     return ogreMaterial;
 }
 
+Ogre::MaterialPtr OpenAssetConverter::GetOrCreateMaterial(int materialIndex, bool vertexColors, const QString &meshFileDiskSource, const QString &meshFileName)
+{
+    //generates material name
+    Ogre::String matName = Ogre::String(meshFileName.toStdString()+"_generatedMat" + Ogre::StringConverter::toString(materialIndex)+ ".material");
+    //checks if the material already exist, it might have been generated before to another submesh.
+    Ogre::MaterialPtr matptr = Ogre::MaterialManager::getSingleton().getByName(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+
+    if(matptr.isNull())
+    {
+        if(vertexColors)
+            matptr = CreateVertexColorMaterial();
+        else
+           matptr = CreateMaterial(matName, importedMaterials[materialIndex], meshFileDiskSource, meshFileName);
+
+        //we must create an OgreMaterialAsset through assetAPI and put the just created
+        //ogre material pointer to it
+        //GenerateTemporaryNonexistingAssetFilename() is used to prevent the "Asset Storage contains ambiguous assets in two different subdirectories!" warning 
+        QString matname = assetAPI->GenerateTemporaryNonexistingAssetFilename(QString::fromStdString(matptr->getName()));
+        AssetPtr assetPtr = assetAPI->CreateNewAsset("OgreMaterial", matname);
+        OgreMaterialAsset *mat = static_cast<OgreMaterialAsset *>(assetPtr.get());
+        mat->ogreMaterial = matptr;
+    }
+
+    return matptr;
+}
+
 bool OpenAssetConverter::CreateVertexData(const Ogre::String& name, const aiNode* pNode, const aiMesh *mesh, Ogre::SubMesh* submesh, Ogre::AxisAlignedBox& mAAB)
 {
     // if animated all submeshes must have bone weights
@@ -1216,29 +1500,11 @@ void OpenAssetConverter::LoadDataFromNode(const aiScene* mScene,  const aiNode *
             //if pAIMesh->
             Ogre::LogManager::getSingleton().logMessage("SubMesh " + Ogre::StringConverter::toString(idx) + " for mesh '" + Ogre::String(pNode->mName.data) + "'");
 
-            const aiMaterial *pAIMaterial = mScene->mMaterials[ pAIMesh->mMaterialIndex ];
-            Ogre::MaterialPtr matptr;
-
-            //generates material name
-            Ogre::String matName = Ogre::String(meshFileName.toStdString()+"_generatedMat" + Ogre::StringConverter::toString(pAIMesh->mMaterialIndex)+ ".material");
-            //checks if the material already exist, it might have been generated before to another submesh.
-            matptr = Ogre::MaterialManager::getSingleton().getByName(matName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-
-            if(matptr.isNull())
-            {
-                if(pAIMesh->HasVertexColors(0))
-                    matptr = CreateVertexColorMaterial();
-                else
-                   matptr = CreateMaterial(matName, pAIMaterial, meshFileDiskSource, meshFileName);
-
-                //we must create an OgreMaterialAsset through assetAPI and put the just created
-                //ogre material pointer to it
-                //GenerateTemporaryNonexistingAssetFilename() is used to prevent the "Asset Storage contains ambiguous assets in two different subdirectories!" warning 
-                QString matname = assetAPI->GenerateTemporaryNonexistingAssetFilename(QString::fromStdString(matptr->getName()));
-                AssetPtr assetPtr = assetAPI->CreateNewAsset("OgreMaterial", matname);
-                OgreMaterialAsset *mat = static_cast<OgreMaterialAsset *>(assetPtr.get());
-                mat->ogreMaterial = matptr;
-            }
+            ImportedSubMesh importedSubMesh;
+            importedSubMesh.materialIndex = pAIMesh->mMaterialIndex;
+            importedSubMesh.vertexColors = pAIMesh->HasVertexColors(0);
+            importedSubMeshes.push_back(importedSubMesh);
+            Ogre::MaterialPtr matptr = GetOrCreateMaterial(importedSubMesh.materialIndex, importedSubMesh.vertexColors, meshFileDiskSource, meshFileName);
 
             Ogre::SubMesh* submesh = mesh->createSubMesh(pNode->mName.data + Ogre::StringConverter::toString(idx));
             CreateVertexData(Ogre::StringConverter::toString(pNode->mName.data), pNode, pAIMesh, submesh, mAAB);
@@ -16,6 +16,7 @@ Licensed under the MIT license:
 
 #include <OgreMesh.h>
 #include <OgreMeshSerializer.h>
+#include <OgreColourValue.h>
 
 #include <assimp/vector3.h>
 #include <assimp/matrix4x4.h>
@@ -23,6 +24,8 @@ Licensed under the MIT license:
 #include <map>
 #include <QString>
 #include <QObject>
+#include <QRunnable>
+#include <QByteArray>
 
 struct aiNode;
 struct aiBone;
@@ -31,6 +34,8 @@ struct aiMaterial;
 struct aiScene;
 struct aiAnimation;
 
+namespace Assimp { class Importer; }
+
 struct boneNode
 {
     aiNode* node;
@@ -46,6 +51,34 @@ typedef std::vector<Ogre::MeshPtr> MeshVector;
 typedef std::map<QString, Ogre::MaterialPtr> TextureMaterialPointerMap;
 typedef std::pair<QString, Ogre::MaterialPtr> TexMatPair;
 
+/// Material properties read from an Assimp material.
+/** Stored to the converted mesh cache along with the Ogre mesh, so that the materials can be recreated without Assimp. */
+struct ImportedMaterial
+{
+    ImportedMaterial();
+
+    Ogre::ColourValue ambient;
+    Ogre::ColourValue diffuse;
+    Ogre::ColourValue specular;
+    Ogre::ColourValue emissive;
+    float shininess;
+    bool hasDiffuse;
+    bool hasSpecular;
+    bool hasEmissive;
+    bool hasShininess;
+    bool twoSided;
+    bool hasTexture;
+    /// Diffuse texture path as written in the source file. Empty if the material has no texture or it is embedded in the file.
+    QString texture;
+};
+
+/// Material of a generated submesh, in the order the submeshes were created.
+struct ImportedSubMesh
+{
+    int materialIndex;
+    bool vertexColors;
+};
+
 class OPENASSETIMPORT_API OpenAssetImport : public IModule
 {
     Q_OBJECT
@@ -62,6 +95,31 @@ private:
     AssetAPI *assetAPI;
 };
 
+/// Worker that runs the Assimp import and post-processing of a file in a QThreadPool thread.
+/** Only touches the given Assimp::Importer, the resulting scene is converted to Ogre resources in the main thread. */
+class OpenAssetImportWorker : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    OpenAssetImportWorker(shared_ptr<Assimp::Importer> importer, const QByteArray &data, const QString &hint, const QString &diskSource, unsigned int flags);
+
+    /// QRunnable override.
+    virtual void run();
+
+signals:
+    /// Emitted when the import has been completed. The scene can be fetched from the importer if @c success is true.
+    /** @note Connect your slot with Qt::QueuedConnection so you will receive the callback in your thread. */
+    void ImportCompleted(bool success);
+
+private:
+    shared_ptr<Assimp::Importer> importer_;
+    QByteArray data_;
+    QString hint_;
+    QString diskSource_;
+    unsigned int flags_;
+};
+
 class OpenAssetConverter : public QObject
 {
     Q_OBJECT
@@ -69,13 +127,26 @@ public:
     OpenAssetConverter(Framework *fw);
     ~OpenAssetConverter();
     /// Converts collada files to ogre meshes, also parses and generates ogre materials.
-    void Convert(const u8 *data_, size_t numBytes, const QString &fileName, const QString &diskSource, Ogre::MeshPtr mesh);
+    /** If the same source data has been converted before, the result is loaded from the asset cache.
+        Otherwise the Assimp import is run in a worker thread and the Ogre mesh is filled in the main thread once it completes.
+        The converter deletes itself after emitting ConversionDone. */
+    void Convert(OgreMeshAsset *asset, const u8 *data_, size_t numBytes);
 
 signals:
     /// This signal is emitted when the ogre mesh is created and generated materials are ready.
     void ConversionDone(bool success);
 
 private:
+    /// Emits ConversionDone and schedules this converter for deletion.
+    void Finish(bool success);
+    /// Loads a previously converted mesh and its materials from the asset cache. Returns false if not found or the cached data is invalid.
+    bool LoadFromCache();
+    /// Stores the converted mesh and its material information to the asset cache.
+    void StoreToCache();
+    /// Reads the material properties used by CreateMaterial.
+    ImportedMaterial ReadMaterial(const aiMaterial *mat) const;
+    /// Returns the generated material for the given material index, creating it if it does not exist yet.
+    Ogre::MaterialPtr GetOrCreateMaterial(int materialIndex, bool vertexColors, const QString &meshFileDiskSource, const QString &meshFileName);
     /// Sets texture unit to material.
     void SetTexture(QString &texFile);
     /// Returns if all textures are loaded.
@@ -87,7 +158,7 @@ private:
     /// Creates vertex data to submeshes.
     bool CreateVertexData(const Ogre::String& name, const aiNode* pNode, const aiMesh *mesh, Ogre::SubMesh* submesh, Ogre::AxisAlignedBox& mAAB);
     /// Generates the ogre materials.
-    Ogre::MaterialPtr CreateMaterial(Ogre::String& matName, const aiMaterial* mat, const QString &meshFileDiskSource, const QString &meshFileName);
+    Ogre::MaterialPtr CreateMaterial(Ogre::String& matName, const ImportedMaterial &mat, const QString &meshFileDiskSource, const QString &meshFileName);
     Ogre::MaterialPtr CreateVertexColorMaterial();
     Ogre::MaterialPtr CreateMaterialByScript(int index, const aiMaterial* mat);
     void GrabNodeNamesFromNode(const aiScene* mScene,  const aiNode* pNode);
@@ -101,6 +172,8 @@ private:
     bool IsNodeNeeded(const char* name);
     void ParseAnimation (const aiScene* mScene, int index, aiAnimation* anim);
 
+    /// Importer owning the scene while it is converted. Shared with the worker doing the import.
+    shared_ptr<Assimp::Importer> importer;
     const aiScene *scene;
     int mLoaderParams;
     int texCount;
@@ -123,7 +196,18 @@ private:
     NodeTransformMap mNodeDerivedTransformByName;
     MeshVector mMeshes;
 
+    /// The asset being converted and its Ogre mesh at the time the conversion started.
+    AssetWeakPtr meshAsset;
+    Ogre::MeshPtr mesh;
+    QString meshName;
+    QString meshDiskSource;
+    /// Converted mesh cache ref prefix, based on the source data hash. Empty if there is no asset cache.
+    QString cacheKey;
+    std::vector<ImportedMaterial> importedMaterials;
+    std::vector<ImportedSubMesh> importedSubMeshes;
+
 private slots:
+    void OnImportCompleted(bool success);
     void OnTextureLoaded(IAssetTransfer* assetTransfer);
     void OnTextureLoadFailed(IAssetTransfer* assetTransfer, QString reason);
 };
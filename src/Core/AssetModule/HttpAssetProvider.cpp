@@ -325,7 +325,7 @@ void HttpAssetProvider::OnHttpTransferFinished(QNetworkReply *reply)
         if (iter == transfers.end())
             return;
         HttpAssetTransferPtr transfer = iter->second;
-        transfer->rawAssetData.clear();
+        transfer->rawAssetData.Clear();
 
         // We have called abort() or close() on an ongoing transfer, for example in AbortTransfer.
         if (reply->error() == QNetworkReply::OperationCanceledError)
@@ -412,8 +412,8 @@ void HttpAssetProvider::OnHttpTransferFinished(QNetworkReply *reply)
                 else
                     cache->DeleteAsset(sourceRef);
 
-                // Write original source data to the transfer.
-                transfer->rawAssetData.insert(transfer->rawAssetData.end(), bodyData.data(), bodyData.data() + bodyData.size());
+                // Hand the original source data to the transfer. The byte array is implicitly shared, not copied.
+                transfer->rawAssetData.SetByteArray(bodyData);
             }
             else
                 error = QString("Http GET for address \"%1\" returned status code %2 that could not be processed.").arg(replyUrl).arg(httpStatusCode);
@@ -422,7 +422,7 @@ void HttpAssetProvider::OnHttpTransferFinished(QNetworkReply *reply)
             if (error.isEmpty())
             {
                 // This tells AssetAPI going forward that storing to cache has been done, otherwise it will rewrite the file.
-                transfer->SetCachingBehavior(false, transfer->CachingAllowed() ? cache->GetDiskSourceByRef(sourceRef) : "");
+                transfer->SetCachingBehavior(false, transfer->CachingAllowed() ? cache->FindInCache(sourceRef) : "");
                 completedTransfers << transfer;
             }
             else
@@ -507,7 +507,7 @@ void HttpAssetProvider::OnCacheWriteCompleted(AssetTransferPtr transfer, bool ca
         LogWarning("HttpAssetProvider: Failed to store asset to cache after completed reply: " + sourceRef);
 
     // This tells AssetAPI going forward that storing to cache has been done, otherwise it will rewrite the file.
-    transfer->SetCachingBehavior(false, cacheFileWritten ? framework->Asset()->Cache()->GetDiskSourceByRef(sourceRef) : "");
+    transfer->SetCachingBehavior(false, cacheFileWritten ? framework->Asset()->Cache()->FindInCache(sourceRef) : "");
 
     // Push to completed queue.
     completedTransfers << transfer;
@@ -607,8 +607,8 @@ void TransferCacheWriteOperation::run()
     bool succeeded = false;
 
     // Write data to the transfer.
-    if (transfer_->rawAssetData.empty())
-        transfer_->rawAssetData.insert(transfer_->rawAssetData.end(), data_.data(), data_.data() + data_.size());
+    if (transfer_->rawAssetData.IsEmpty())
+        transfer_->rawAssetData.SetByteArray(data_);
 
     // File data to disk.
     QFile file(path_);
@@ -28,9 +28,19 @@
 
 #include "MemoryLeakCheck.h"
 
+/// Maximum number of asset files being read in the I/O thread pool at a time.
+static const int cMaxOutstandingReads = 64;
+
+/// Number of threads used for reading asset files. Kept small, as more parallel reads only cause seeking on spinning disks.
+static const int cNumIOThreads = 4;
+
 LocalAssetProvider::LocalAssetProvider(Framework* framework_) :
     framework(framework_)
 {
+    // AssetTransferPtr is used in a queued signal of LocalFileReadOperation. See HttpAssetProvider.
+    qRegisterMetaType<AssetTransferPtr>("AssetTransferPtr");
+    ioThreadPool.setMaxThreadCount(cNumIOThreads);
+
     enableRequestsOutsideStorages = (framework_->HasCommandLineParameter("--acceptUnknownLocalSources") ||
         framework_->HasCommandLineParameter("--accept_unknown_local_sources"));  /**< @todo Remove support for the deprecated underscore version at some point. */
 }
@@ -106,6 +116,18 @@ bool LocalAssetProvider::AbortTransfer(IAssetTransfer *transfer)
             return true;
         }
     }
+
+    // The file of the transfer may be being read or already read. A read that completes after this is ignored.
+    QList<AssetTransferPtr> *lists[] = { &readingTransfers, &completedTransfers };
+    for(size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); ++i)
+        for(QList<AssetTransferPtr>::iterator iter = lists[i]->begin(); iter != lists[i]->end(); ++iter)
+            if (iter->get() == transfer)
+            {
+                framework->Asset()->AssetTransferAborted(transfer);
+                lists[i]->erase(iter);
+                return true;
+            }
+
     return false;
 }
 
@@ -309,75 +331,130 @@ void LocalAssetProvider::CompletePendingFileDownloads()
     if (pendingUploads.size() > 0)
         return;
 
-    const int maxLoadMSecs = 16;
-    tick_t startTime = GetCurrentClockTime();
-
-    while(pendingDownloads.size() > 0)
+    // Start reading files in the I/O thread pool, but keep the amount of outstanding reads bounded
+    // so that a scene referring to thousands of assets does not hold all of their data in memory at once.
+    while(pendingDownloads.size() > 0 && readingTransfers.size() < cMaxOutstandingReads)
     {
         PROFILE(LocalAssetProvider_ProcessPendingDownload);
 
         AssetTransferPtr transfer = pendingDownloads.back();
         pendingDownloads.pop_back();
-            
-        QString ref = transfer->source.ref;
+        StartFileRead(transfer);
+    }
 
-        QString path_filename;
-        AssetAPI::AssetRefType refType = AssetAPI::ParseAssetRef(ref.trimmed(), 0, 0, 0, 0, &path_filename);
+    if (completedTransfers.isEmpty())
+        return;
 
-        LocalAssetStoragePtr storage;
+    const int maxLoadMSecs = 16;
+    tick_t startTime = GetCurrentClockTime();
+
+    while(completedTransfers.size() > 0)
+    {
+        PROFILE(LocalAssetProvider_ProcessCompletedDownload);
+
+        AssetTransferPtr transfer = completedTransfers.front();
+        completedTransfers.pop_front();
+
+        // Signal the Asset API that this asset is now successfully downloaded.
+        framework->Asset()->AssetTransferCompleted(transfer.get());
+
+        // Throttle asset loading to at most 16 msecs/frame.
+        if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
+            break;
+    }
+}
 
-        QFileInfo file;
+void LocalAssetProvider::StartFileRead(const AssetTransferPtr &transfer)
+{
+    QString path_filename;
+    AssetAPI::AssetRefType refType = AssetAPI::ParseAssetRef(transfer->source.ref.trimmed(), 0, 0, 0, 0, &path_filename);
 
-        if (refType == AssetAPI::AssetRefLocalPath)
+    LocalFileCandidateList candidates;
+    // 'C:/path/to/asset/asset.png' or 'file://C:/path/to/asset/asset.png'.
+    if (refType == AssetAPI::AssetRefLocalPath || AssetAPI::ParseAssetRef(path_filename) == AssetAPI::AssetRefLocalPath)
+        candidates << qMakePair(path_filename, QString());
+    else // Using a local relative path, like "local://asset.ref" or "asset.ref".
+    {
+        // Same precedence as the non-recursive pass of GetPathForAsset: the storage directory first, then the files already known in its subdirectories.
+        // The existence checks are done in the worker. If neither is found, the recursive lookup is done in OnFileReadCompleted.
+        for(size_t i = 0; i < storages.size(); ++i)
         {
-            file = QFileInfo(path_filename);
+            candidates << qMakePair(GuaranteeTrailingSlash(storages[i]->directory) + path_filename, storages[i]->name);
+            QMultiHash<QString, QString>::const_iterator iter = storages[i]->cachedFiles.constFind(path_filename.toLower());
+            if (iter != storages[i]->cachedFiles.constEnd())
+                candidates << qMakePair(iter.value(), storages[i]->name);
         }
-        else // Using a local relative path, like "local://asset.ref" or "asset.ref".
+    }
+
+    readingTransfers.push_back(transfer);
+
+    // LocalFileReadOperation is a QRunnable, the thread pool deletes it once it has been run.
+    LocalFileReadOperation *operation = new LocalFileReadOperation(transfer, candidates);
+    connect(operation, SIGNAL(Completed(AssetTransferPtr, QString, QString, bool)), SLOT(OnFileReadCompleted(AssetTransferPtr, QString, QString, bool)), Qt::QueuedConnection);
+    ioThreadPool.start(operation);
+}
+
+void LocalAssetProvider::OnFileReadCompleted(AssetTransferPtr transfer, QString absoluteFilename, QString storageName, bool success)
+{
+    PROFILE(LocalAssetProvider_OnFileReadCompleted);
+
+    // If the transfer is no longer being read, it was aborted in the meanwhile.
+    if (!readingTransfers.removeOne(transfer))
+        return;
+
+    const QString ref = transfer->source.ref;
+    if (absoluteFilename.isEmpty())
+    {
+        QString path_filename;
+        AssetAPI::AssetRefType refType = AssetAPI::ParseAssetRef(ref.trimmed(), 0, 0, 0, 0, &path_filename);
+        if (refType == AssetAPI::AssetRefLocalPath || AssetAPI::ParseAssetRef(path_filename) == AssetAPI::AssetRefLocalPath)
         {
-            AssetAPI::AssetRefType urlRefType = AssetAPI::ParseAssetRef(path_filename);
-            if (urlRefType == AssetAPI::AssetRefLocalPath)
-                file = QFileInfo(path_filename); // 'file://C:/path/to/asset/asset.png'.
-            else // The ref is of form 'file://relativePath/asset.png'.
-            {
-                QString path = GetPathForAsset(path_filename, &storage);
-                if (path.isEmpty())
-                {
-                    QString reason = "Failed to find local asset with filename \"" + ref + "\"!";
-                    framework->Asset()->AssetTransferFailed(transfer.get(), reason);
-                    // Also throttle asset loading here. This is needed in the case we have a lot of failed refs.
-                    //if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
-                    //    break;
-                    continue;
-                }
-            
-                file = QFileInfo(GuaranteeTrailingSlash(path) + path_filename);
-            }
+            QString reason = "Failed to read asset data for asset \"" + ref + "\" from file \"" + path_filename + "\"";
+            framework->Asset()->AssetTransferFailed(transfer.get(), reason);
+            return;
         }
-        QString absoluteFilename = file.absoluteFilePath();
 
-        bool success = LoadFileToVector(absoluteFilename, transfer->rawAssetData);
-        if (!success)
+        // The file was not found from the storage directories or from the files known to be in their subdirectories.
+        // Do the recursive lookup here, as it may need to refresh the cached contents of a storage.
+        LocalAssetStoragePtr storage;
+        QString path = GetPathForAsset(path_filename, &storage);
+        if (path.isEmpty() || !storage)
         {
-            QString reason = "Failed to read asset data for asset \"" + ref + "\" from file \"" + absoluteFilename + "\"";
+            QString reason = "Failed to find local asset with filename \"" + ref + "\"!";
             framework->Asset()->AssetTransferFailed(transfer.get(), reason);
-            // Also throttle asset loading here. This is needed in the case we have a lot of failed refs.
-            if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
-                break;
-            continue;
+            return;
         }
-        
-        // Tell the Asset API that this asset should not be cached into the asset cache, and instead the original filename should be used
-        // as a disk source, rather than generating a cache file for it.
-        transfer->SetCachingBehavior(false, absoluteFilename);
-        transfer->storage = storage;
 
-        // Signal the Asset API that this asset is now successfully downloaded.
-        framework->Asset()->AssetTransferCompleted(transfer.get());
+        readingTransfers.push_back(transfer);
+        LocalFileReadOperation *operation = new LocalFileReadOperation(transfer, LocalFileCandidateList() << qMakePair(GuaranteeTrailingSlash(path) + path_filename, storage->name));
+        connect(operation, SIGNAL(Completed(AssetTransferPtr, QString, QString, bool)), SLOT(OnFileReadCompleted(AssetTransferPtr, QString, QString, bool)), Qt::QueuedConnection);
+        ioThreadPool.start(operation);
+        return;
+    }
 
-        // Throttle asset loading to at most 16 msecs/frame.
-        if (GetCurrentClockTime() - startTime >= GetCurrentClockFreq() * maxLoadMSecs / 1000)
-            break;
+    if (!success)
+    {
+        QString reason = "Failed to read asset data for asset \"" + ref + "\" from file \"" + absoluteFilename + "\"";
+        framework->Asset()->AssetTransferFailed(transfer.get(), reason);
+        return;
+    }
+
+    // Tell the Asset API that this asset should not be cached into the asset cache, and instead the original filename should be used
+    // as a disk source, rather than generating a cache file for it.
+    transfer->SetCachingBehavior(false, absoluteFilename);
+    LocalAssetStoragePtr storage;
+    if (!storageName.isEmpty())
+    {
+        storage = dynamic_pointer_cast<LocalAssetStorage>(GetStorageByName(storageName));
+        transfer->storage = storage;
     }
+
+    // Storages track new and removed files through their directories, watch the file itself for modifications now that it is being loaded.
+    LocalAssetStoragePtr watchingStorage = (storage ? storage : FindStorageForPath(QDir::fromNativeSeparators(absoluteFilename)));
+    if (watchingStorage)
+        watchingStorage->WatchFile(absoluteFilename);
+
+    completedTransfers.push_back(transfer);
 }
 
 AssetStoragePtr LocalAssetProvider::TryDeserializeStorageFromString(const QString &storage, bool /*fromNetwork*/)
@@ -517,229 +594,26 @@ void LocalAssetProvider::CompletePendingFileUploads()
 void LocalAssetProvider::CheckForPendingFileSystemChanges()
 {
     PROFILE(LocalAssetProvider_CheckForPendingFileSystemChanges);
-    QStringList files = changedFiles.toList();
-    while(!files.isEmpty())
+
+    // Only the files of loaded assets are watched, so a file change notification is either a modification or a deletion of such a file.
+    foreach(const QString &file, changedFiles)
     {
-        QString file = files.front();
-        files.pop_front();
-
-//        // If some watched file is changed, so is watched directory. Remove the directory from 
-//        // changedDirectories so we can ignore it later on when checking directory changes.
-//        
-//        QString dir = QFileInfo(file).dir().path();
-//        if (qFind(changedDirectories, dir) != changedDirectories.end())
-//        {
-//            LogInfo("REMOVING " + dir + "FROM changedDirectories");
-//            changedDirectories.removeOne(dir);
-//        }
-//        
         LocalAssetStoragePtr storage = FindStorageForPath(file);
         if (storage)
-        {
-            if (!storage->AutoDiscoverable())
-            {
-                LogWarning("Received file change notification for storage of which auto-discovery is false.");
-                continue;
-            }
-
-            assert(storage->changeWatcher);
-            QString assetRef = file;
-            int lastSlash = assetRef.lastIndexOf('/');
-            if (lastSlash != -1)
-                assetRef = assetRef.right(assetRef.length() - lastSlash - 1);
-            assetRef.prepend("local://");
-
-            // Note: if file was removed, it's removed automatically from tracked files of QFileSystemWatcher.
-            const QStringList watchedFiles = storage->changeWatcher->files();
-            if (qFind(watchedFiles, file) == watchedFiles.end() && !QFile::exists(file))
-            {
-                // Tracked file was not found from the list of tracked files and it doesn't exist so 
-                // it must be deleted (info about new files is retrieved by directoryChanged signal).
-                LogInfo("File " + file + " not found from watch list. So it must be deleted.");
-                storage->EmitAssetChanged(file, IAssetStorage::AssetDelete);
-            }
-            else
-            {
-                // File was tracked and found from watched files: must've been modified.
-                LogInfo("File " + file + " found from watch list so it must be modified. Asset ref: " + assetRef);
-                storage->EmitAssetChanged(file, IAssetStorage::AssetModify);
-            }
-        }
+            storage->HandleFileChanged(file);
         else
-        {
             LogError("LocalAssetProvider::CheckForPendingFileSystemChanges: Could not find storage for file " + file);
-        }
     }
 
-    QStringList dirs = changedDirectories.toList();
-    while(!dirs.isEmpty())
+    // Directory change notifications cover files and subdirectories being added, removed and renamed.
+    // Only the changed directory itself is rescanned and compared to the storage index.
+    foreach(const QString &path, changedDirectories)
     {
-        QString path = dirs.front();
-        dirs.pop_front();
         LocalAssetStoragePtr storage = FindStorageForPath(path);
         if (storage)
-        {
-            if (!storage->AutoDiscoverable())
-            {
-                LogWarning("Received directory change notification for storage of which auto-discovery is false.");
-                continue;
-            }
-
-            assert(storage->changeWatcher);
-            const QStringList watchedDirs = storage->changeWatcher->directories();
-            if (qFind(watchedDirs, path) != watchedDirs.end())
-            {
-                //LogError("CheckForPendingFileSystemChanges: " + path + " was on the watch list.");
-                // Remove path from watch list in case the directory was removed.
-                // We'll add it back anyways in case of this change was addition of new directory.
-                // Remove the path only if it's not the root directory of the storage
-                //if (!QString(path + "/").compare(QDir::fromNativeSeparators(storage->directory), Qt::CaseInsensitive) != 0)
-                //{
-                    //LogInfo("LocalAssetProvider: Directory " + path + " was on the watch list, removing it by default always.");
-                   // storage->changeWatcher->removePath(path);
-                //}
-/*
-                if (!QDir(path).exists()) // 1: Was directory deleted?
-                {
-                    LogDebug("Directory " + path + " removed.");
-                    QStringList subdirs = DirectorySearch(path, true, QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
-                    if (!subdirs.isEmpty())
-                    {
-                        LogInfo("Directory " + path + " was removed. Removing all of its subdirs too:\n" + subdirs.join("\n"));
-                        storage->changeWatcher->removePaths(subdirs);
-                    }
-                    // Add parent dir back to watch list.
-                    if (!watchedDirs.contains(path), Qt::CaseInsensitive)
-                        storage->changeWatcher->addPath(path);
-                }
-                else // 2: Was new directory added, an existing one renamed, or something else?
-*/
-                {
-                    // Was new file added?
-                    QStringList oldFiles, currentFiles;
-                    currentFiles = DirectorySearch(path, false, QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
-                    const QStringList watchedFiles = storage->changeWatcher->files();
-                    foreach(const QString &file, watchedFiles)
-                        if (GuaranteeTrailingSlash(path) == GuaranteeTrailingSlash(QFileInfo(file).dir().path()))
-                            oldFiles.append(file);
-
-                    if (currentFiles.size() > oldFiles.size())
-                    {
-                        LogDebug("NumOldFiles for " + path + " " + QString::number(oldFiles.size()) + " NumCurFiles: " + QString::number(currentFiles.size()));
-                        LogDebug("Conclusion: new file added.");
-                        foreach(const QString &file, currentFiles)
-                        {
-                            QStringList::const_iterator it = qFind(oldFiles, file);
-                            if (it == oldFiles.end())
-                            {
-                                LogInfo("New file " + file + " added to storage " + storage->ToString());
-                                storage->changeWatcher->addPath(file);
-                                storage->EmitAssetChanged(file, IAssetStorage::AssetCreate);
-                                break;
-                            }
-                    }
-                    //else if(if (currentFiles.size() > oldFiles.size())
-                    //{
-                    //}
-/*
-                    // Check out the path's subdir count. Find all old watched dirs and replace them with the new dirs.
-                    QStringList curSubdirs = DirectorySearch(path, true, QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
-                    QStringList oldSubdirs;
-                    foreach(const QString &dir, watchedDirs)
-                        if (dir.contains(path, Qt::CaseInsensitive) && dir.compare(path, Qt::CaseInsensitive) != 0)
-                            oldSubdirs << dir;
-
-                    LogWarning("CURRENT DIRS " + curSubdirs.join("\n"));
-                    LogWarning("OLD DIRS " + oldSubdirs.join("\n"));
-                    LogInfo("NumOldSubdirs for " + path + ": " + QString::number(oldSubdirs.size()) + ", NumCurDirs: " + QString::number(curSubdirs.size()));
-                    if (!oldSubdirs.isEmpty() && !curSubdirs.isEmpty() && oldSubdirs.size() == curSubdirs.size())
-                    {
-                        // Folder rename occurred. Remove all subdirs and add them back.
-                        LogError("SOME FOLDER WAS RENAMED");
-                        LogInfo("Removing\n" + oldSubdirs.join("\n"));
-
-                        storage->changeWatcher->removePaths(oldSubdirs);
-
-                        LogInfo("Adding\n" + curSubdirs.join("\n"));
-                        foreach(const QString &d, curSubdirs) // for some odd reason addPaths() fails, so have to call addPath() for individual paths instead.
-                            if (!watchedDirs.contains(d), Qt::CaseInsensitive)
-                                storage->changeWatcher->addPath(d);
-
-                        // Add parent dir back to watch list.
-                        if (!watchedDirs.contains(path), Qt::CaseInsensitive)
-                            storage->changeWatcher->addPath(path);
-                    }
-                    else if (oldSubdirs.size() != curSubdirs.size())
-                    {
-                        LogError("NEW DIRECTORY");
-                        LogInfo("New directory added to " + path);
-                        //LogInfo("Directory structure changed: number of old subdirs for " + path + " " + QString::number(oldSubdirs.size()) +
-                        //    ", number of current dirs " + QString::number(curSubdirs.size()));
-                        LogInfo("This means we got a new directory to watch.");
-                        if (!oldSubdirs.isEmpty())
-                        {
-                            LogInfo("Removing oldSubdirs:\n" + oldSubdirs.join("\n"));
-                            storage->changeWatcher->removePaths(oldSubdirs);
-                        }
-                        if (!curSubdirs.isEmpty())
-                        {
-                            LogInfo("Adding curSubdirs:\n" + curSubdirs.join("\n"));
-                            foreach(const QString &d, curSubdirs) // for some odd reason addPaths() fails, so have to call addPath() for individual paths instead.
-                                if (!watchedDirs.contains(d), Qt::CaseInsensitive)
-                                    storage->changeWatcher->addPath(d);
-                        }
-
-                        QString newDir = curSubdirs.size() == 1 ? curSubdirs.first() : "";
-                        foreach(const QString &curSubdir, curSubdirs)
-                            if (qFind(oldSubdirs, curSubdir) == oldSubdirs.end())
-                            {
-                                newDir = curSubdir;
-                                LogInfo("New dir's name is : " + newDir);
-                                if (storage->recursive)
-                                {
-                                    QStringList pathsToAdd = DirectorySearch(newDir, true, QDir::Files |QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
-                                    if (!pathsToAdd.isEmpty())
-                                    {
-                                        LogInfo("Adding paths to watch list: " + pathsToAdd.join("\n"));
-                                        LogInfo("******before " + QString::number(storage->changeWatcher->files().count()));
-                                        storage->changeWatcher->addPaths(pathsToAdd);
-                                        LogInfo("******after " + QString::number(storage->changeWatcher->files().count()));
-                                    }
-                                }
-                            }
-
-                        // Add parent dir back to watch list.
-                        if (!watchedDirs.contains(path), Qt::CaseInsensitive)
-                            storage->changeWatcher->addPath(path);
-                    }
-                    else
-                    {
-                        // We end up here after:
-                        // -removing subdir of a watched dir we get change notification for the watcher dir,
-                        // -Addition of new file to watched dir
-                        LogError("DIDN'T KNOW WHAT TO DO WITH CHANGED DIR");
-                        if (!watchedDirs.contains(path), Qt::CaseInsensitive)
-                            storage->changeWatcher->addPath(path);
-
-                        QStringList pathsToAdd = DirectorySearch(path, false, QDir::Files);
-                        if (!pathsToAdd.isEmpty())
-                        {
-                            LogInfo("Adding paths to watch list: " + pathsToAdd.join("\n"));
-                            foreach(const QString &p, pathsToAdd) // for some odd reason addPaths() fails, so have to call addPath() for individual paths instead.
-                                storage->changeWatcher->addPath(p);
-                        }
-*/
-                    }
-                }
-
-                //LogInfo("Refreshing storage \"" + storage->Name() + "\".");
-                //storage->RefreshAssetRefs();
-            }
-        }
+            storage->RescanDirectory(path);
         else
-        {
             LogError("LocalAssetProvider::CheckForPendingFileSystemChanges: Could not find storage for directory " + path);
-        }
     }
 
     changedFiles.clear();
@@ -757,3 +631,31 @@ void LocalAssetProvider::OnDirectoryChanged(const QString &path)
     LogDebug("LocalAssetProvider: Directory " + path + " changed.");
     changedDirectories << path;
 }
+
+// LocalFileReadOperation
+
+LocalFileReadOperation::LocalFileReadOperation(AssetTransferPtr transfer, const LocalFileCandidateList &candidates) :
+    transfer_(transfer),
+    candidates_(candidates)
+{
+    // Make sure this worker object is deleted by QThreadPool once run() completes.
+    setAutoDelete(true);
+}
+
+void LocalFileReadOperation::run()
+{
+    for(int i = 0; i < candidates_.size(); ++i)
+    {
+        QFileInfo file(candidates_[i].first);
+        if (!file.exists())
+            continue;
+
+        // Large files are memory-mapped instead of reading them to a separate buffer.
+        QString absoluteFilename = file.absoluteFilePath();
+        bool success = transfer_->rawAssetData.LoadFile(absoluteFilename);
+        emit Completed(transfer_, absoluteFilename, candidates_[i].second, success);
+        return;
+    }
+
+    emit Completed(transfer_, "", "", false);
+}
@@ -7,11 +7,18 @@
 #include "AssetFwd.h"
 
 #include <QSet>
+#include <QList>
+#include <QPair>
+#include <QRunnable>
+#include <QThreadPool>
 
 class LocalAssetStorage;
 
 typedef shared_ptr<LocalAssetStorage> LocalAssetStoragePtr;
 
+/// List of candidate absolute filenames for a local asset, paired with the name of the storage each candidate belongs to.
+typedef QList<QPair<QString, QString> > LocalFileCandidateList;
+
 /// Provides access to files on the local file system using the 'local://' URL specifier.
 class ASSET_MODULE_API LocalAssetProvider : public QObject, public IAssetProvider, public enable_shared_from_this<LocalAssetProvider>
 {
@@ -75,9 +82,12 @@ private:
     /// @param storage [out] Receives the local storage that contains the asset.
     QString GetPathForAsset(const QString &localFilename, LocalAssetStoragePtr *storage) const;
 
-    /// Takes all the pending file download transfers and finishes them.
+    /// Starts reading the pending file download transfers in the I/O thread pool, and hands the completed ones to the Asset API.
     void CompletePendingFileDownloads();
 
+    /// Resolves the files the given transfer may be read from and starts reading it in the I/O thread pool.
+    void StartFileRead(const AssetTransferPtr &transfer);
+
     /// Takes all the pending file upload transfers and finishes them.
     void CompletePendingFileUploads();
 
@@ -88,6 +98,9 @@ private:
     std::vector<LocalAssetStoragePtr> storages; ///< Asset directories to search, may be recursive or not
     std::vector<AssetUploadTransferPtr> pendingUploads; ///< The following asset uploads are pending to be completed by this provider.
     std::vector<AssetTransferPtr> pendingDownloads; ///< The following asset downloads are pending to be completed by this provider.
+    QList<AssetTransferPtr> readingTransfers; ///< Transfers whose files are being read in the I/O thread pool.
+    QList<AssetTransferPtr> completedTransfers; ///< Transfers whose files have been read, to be sent to AssetAPI.
+    QThreadPool ioThreadPool; ///< Threads used for resolving and reading asset files.
     QSet<QString> changedFiles; ///< Pending file changes.
     QSet<QString> changedDirectories; ///< Pending directory changes.
 
@@ -97,4 +110,27 @@ private:
 private slots:
     void OnFileChanged(const QString &path);
     void OnDirectoryChanged(const QString &path);
+    void OnFileReadCompleted(AssetTransferPtr transfer, QString absoluteFilename, QString storageName, bool success);
+};
+
+/// Threaded file read operation. Used internally to find and read local asset files without blocking the main thread.
+class ASSET_MODULE_API LocalFileReadOperation : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    /// @param candidates Files the asset may be read from, in the order of precedence. The first existing one is read.
+    LocalFileReadOperation(AssetTransferPtr transfer, const LocalFileCandidateList &candidates);
+
+    /// QRunnable override.
+    virtual void run();
+
+signals:
+    /// @param absoluteFilename The file that was read, or empty if none of the candidates existed.
+    /// @param storageName Name of the storage the file was found from.
+    void Completed(AssetTransferPtr transfer, QString absoluteFilename, QString storageName, bool success);
+
+private:
+    AssetTransferPtr transfer_;
+    LocalFileCandidateList candidates_;
 };
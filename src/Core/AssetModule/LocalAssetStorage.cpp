@@ -19,7 +19,8 @@
 
 LocalAssetStorage::LocalAssetStorage(bool writable_, bool liveUpdate_, bool autoDiscoverable_) :
     recursive(true),
-    changeWatcher(0)
+    changeWatcher(0),
+    contentsCached(false)
 {
     // Override the parameters for the base class.
     writable = writable_;
@@ -34,20 +35,30 @@ LocalAssetStorage::~LocalAssetStorage()
 
 void LocalAssetStorage::LoadAllAssetsOfType(AssetAPI *assetAPI, const QString &suffix, const QString &assetType)
 {
-    foreach(QString str, DirectorySearch(directory, recursive, QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks))
-        if ((suffix == "" || str.endsWith(suffix)) && !(str.contains(".git") || str.contains(".svn") || str.contains(".hg")))
-        {
-            int lastSlash = str.lastIndexOf('/');
-            if (lastSlash != -1)
-                str = str.right(str.length() - lastSlash - 1);
-            assetAPI->RequestAsset("local://" + str, assetType);
-        }
+    if (!contentsCached || !IsWatching())
+        CacheStorageContents();
+
+    foreach(const IndexedDirectory &dir, indexedDirectories)
+        foreach(QString str, dir.files)
+            if (suffix == "" || str.endsWith(suffix))
+            {
+                int lastSlash = str.lastIndexOf('/');
+                if (lastSlash != -1)
+                    str = str.right(str.length() - lastSlash - 1);
+                assetAPI->RequestAsset("local://" + str, assetType);
+            }
 }
 
 void LocalAssetStorage::RefreshAssetRefs()
 {
-    foreach(QString str, DirectorySearch(directory, recursive, QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks))
-        if (!(str.contains(".git") || str.contains(".svn") || str.contains(".hg")))
+    PROFILE(LocalAssetStorage_RefreshAssetRefs);
+
+    // The index is kept up to date by the directory watches. Without them, walk through the storage again.
+    if (!contentsCached || !IsWatching())
+        CacheStorageContents();
+
+    foreach(const IndexedDirectory &dir, indexedDirectories)
+        foreach(QString str, dir.files)
         {
             QString diskSource = str;
             int lastSlash = str.lastIndexOf('/');
@@ -57,7 +68,7 @@ void LocalAssetStorage::RefreshAssetRefs()
             str.prepend("local://");
             if (!assetRefs.contains(str))
             {
-                assetRefs.append(str);
+                assetRefs.insert(str);
                 emit AssetChanged(localName, diskSource, IAssetStorage::AssetCreate);
             }
         }
@@ -65,25 +76,19 @@ void LocalAssetStorage::RefreshAssetRefs()
 
 void LocalAssetStorage::CacheStorageContents()
 {
-    cachedFiles.clear();
+    PROFILE(LocalAssetStorage_CacheStorageContents);
+    tick_t startTime = GetCurrentClockTime();
 
-    foreach(QString str, DirectorySearch(directory, recursive, QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks))
-        if (!(str.contains(".git") || str.contains(".svn") || str.contains(".hg")))
-        {
-            QString diskSource = str;
-            int lastSlash = str.lastIndexOf('/');
-            if (lastSlash != -1)
-                str = str.right(str.length() - lastSlash - 1);
-            QString localName = str;
+    indexedDirectories.clear();
+    cachedFiles.clear();
+    QStringList dirs = IndexDirectory(directory, false);
+    contentsCached = true;
 
-///\todo This is an often-received error condition if the user is not aware, but also occurs naturally in built-in Ogre Media storages.
-/// Fix this check to occur somehow nicer (without additional constraints to asset load time) without a hardcoded check
-/// against the storage name.
-            if (Name() != "Ogre Media" && cachedFiles.find(localName) != cachedFiles.end())
-                LogWarning("Warning: Asset Storage \"" + Name() + "\" contains ambiguous assets \"" + cachedFiles[localName] + "\" and \"" + diskSource + "\" in two different subdirectories!");
+    if (IsWatching() && !dirs.isEmpty())
+        changeWatcher->addPaths(dirs);
 
-            cachedFiles[localName] = diskSource;
-        }
+    LogDebug("LocalAssetStorage: Indexed " + QString::number(cachedFiles.size()) + " files in " + QString::number(dirs.size()) + " directories of storage " +
+        ToString() + " in " + QString::number((GetCurrentClockTime() - startTime) * 1000.0 / GetCurrentClockFreq(), 'f', 1) + " msecs.");
 }
 
 QString LocalAssetStorage::GetFullPathForAsset(const QString &assetname, bool recursiveLookup)
@@ -92,19 +97,20 @@ QString LocalAssetStorage::GetFullPathForAsset(const QString &assetname, bool re
     if (QFile::exists(dir.absolutePath()))
         return directory;
 
-    std::map<QString, QString, QStringLessThanNoCase>::iterator iter = cachedFiles.find(assetname);
-    if (iter == cachedFiles.end())
+    // With directory watches the index is always up to date, so a file not in the index does not exist.
+    // Without them, walk through the storage again before giving up.
+    if (!cachedFiles.contains(assetname.toLower()))
     {
-        if (!recursive || !recursiveLookup)
+        if (!recursive || !recursiveLookup || (contentsCached && IsWatching()))
             return "";
         else
             CacheStorageContents();
     }
 
-    iter = cachedFiles.find(assetname);
-    if (iter != cachedFiles.end())
+    QMultiHash<QString, QString>::const_iterator iter = cachedFiles.constFind(assetname.toLower());
+    if (iter != cachedFiles.constEnd())
     {
-        QFileInfo file(iter->second);
+        QFileInfo file(iter.value());
         if (file.exists())
             return file.dir().path();
     }
@@ -143,9 +149,15 @@ void LocalAssetStorage::EmitAssetChanged(QString absoluteFilename, IAssetStorage
     if (lastSlash != -1)
         localName = absoluteFilename.right(absoluteFilename.length() - lastSlash - 1);
     QString assetRef = "local://" + localName;
-    if (assetRefs.contains(assetRef) && change == IAssetStorage::AssetCreate)
-        LogDebug("LocalAssetStorage::EmitAssetChanged: Emitting AssetCreate signal for already existing asset " + assetRef +
-            ", file " + absoluteFilename + ". Asset was probably removed and then added back.");
+    if (change == IAssetStorage::AssetCreate)
+    {
+        if (assetRefs.contains(assetRef))
+            LogDebug("LocalAssetStorage::EmitAssetChanged: Emitting AssetCreate signal for already existing asset " + assetRef +
+                ", file " + absoluteFilename + ". Asset was probably removed and then added back.");
+        assetRefs.insert(assetRef);
+    }
+    else if (change == IAssetStorage::AssetDelete && !cachedFiles.contains(localName.toLower()))
+        assetRefs.remove(assetRef);
     emit AssetChanged(localName, absoluteFilename, change);
 }
 
@@ -156,28 +168,205 @@ void LocalAssetStorage::SetupWatcher()
 
     changeWatcher = new QFileSystemWatcher();
 
-    // Add directory contents to watch list.
-    if (recursive)
+    // Only the directories are watched. Watching every file of a large recursive storage is slow and can exhaust the watches the OS allows.
+    // The directories are added to the watch list when the storage contents are indexed.
+    CacheStorageContents();
+}
+
+void LocalAssetStorage::RemoveWatcher()
+{
+    SAFE_DELETE(changeWatcher);
+    watchedFiles.clear();
+}
+
+bool LocalAssetStorage::IsWatching() const
+{
+#ifdef Q_WS_MAC
+    return false;
+#else
+    return changeWatcher != 0;
+#endif
+}
+
+void LocalAssetStorage::WatchFile(const QString &absoluteFilename)
+{
+    if (!IsWatching())
+        return;
+
+    QString file = IndexPath(absoluteFilename);
+    if (!watchedFiles.contains(file))
     {
-        // Make a visible log message - we may hang here for several seconds, since this step involves recursive iteration. Try to make the path relative before printing.
-        QString installDir = QDir::toNativeSeparators(Application::InstallationDirectory());
-        QString watchAbsPath = QDir::toNativeSeparators(QDir(directory).absolutePath());
-        QString watchDirPath = (watchAbsPath.startsWith(installDir) ? QString(".%1%2").arg(QDir::separator()).arg(watchAbsPath.mid(installDir.length())) : watchAbsPath);
-        LogInfo("LocalAssetStorage: Recursively adding all files from " + watchDirPath + " to a watch list. This may take a while...");
+        watchedFiles.insert(file);
+        changeWatcher->addPath(file);
     }
-    else
-        LogDebug("LocalAssetStorage: Adding " + directory + " recursive=" + BoolToString(recursive));
+}
 
-    QStringList paths = DirectorySearch(directory, recursive, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
-#ifndef Q_WS_MAC
-    changeWatcher->addPath(QDir::fromNativeSeparators(directory));
-    changeWatcher->addPaths(paths);
-#endif
+void LocalAssetStorage::HandleFileChanged(const QString &path)
+{
+    QString file = IndexPath(path);
+    if (QFile::exists(file))
+    {
+        if (autoDiscoverable)
+            EmitAssetChanged(file, IAssetStorage::AssetModify);
+        return;
+    }
 
-    LogDebug("Total of " + QString::number(paths.count()) + " dirs and files added to watch list.");
+    // Deleted files are removed from the watch list automatically. Handle the deletion through the directory contents.
+    watchedFiles.remove(file);
+    RescanDirectory(QFileInfo(file).absolutePath());
 }
 
-void LocalAssetStorage::RemoveWatcher()
+void LocalAssetStorage::RescanDirectory(const QString &path)
 {
-    SAFE_DELETE(changeWatcher);
+    PROFILE(LocalAssetStorage_RescanDirectory);
+
+    const QString dirPath = IndexPath(path);
+    QHash<QString, IndexedDirectory>::iterator iter = indexedDirectories.find(dirPath);
+    if (iter == indexedDirectories.end())
+        return; // Not part of this storage, or already removed along with its parent.
+
+    if (!QDir(dirPath).exists())
+    {
+        RemoveDirectoryFromIndex(dirPath, autoDiscoverable);
+        return;
+    }
+
+    QSet<QString> currentFiles, currentDirs;
+    const QDir::Filters filters = QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks | (recursive ? QDir::Dirs : QDir::Filters(0));
+    foreach(const QFileInfo &entry, QDir(dirPath).entryInfoList(filters))
+    {
+        QString entryPath = dirPath + "/" + entry.fileName();
+        if (IsIgnoredPath(entryPath))
+            continue;
+        if (entry.isDir())
+            currentDirs.insert(entryPath);
+        else
+            currentFiles.insert(entryPath);
+    }
+
+    IndexedDirectory &dir = iter.value();
+    foreach(const QString &file, dir.files - currentFiles)
+    {
+        RemoveFileFromIndex(dir, file);
+        LogInfo("File " + file + " removed from storage " + ToString());
+        if (autoDiscoverable)
+            EmitAssetChanged(file, IAssetStorage::AssetDelete);
+    }
+    foreach(const QString &file, currentFiles - dir.files)
+    {
+        AddFileToIndex(dir, file);
+        LogInfo("New file " + file + " added to storage " + ToString());
+        if (autoDiscoverable)
+            EmitAssetChanged(file, IAssetStorage::AssetCreate);
+    }
+
+    const QSet<QString> removedDirs = dir.subdirectories - currentDirs;
+    const QSet<QString> addedDirs = currentDirs - dir.subdirectories;
+    dir.subdirectories = currentDirs;
+    // Note: the reference to the directory is not used after this, as indexing may reallocate the hash.
+    foreach(const QString &subdir, removedDirs)
+        RemoveDirectoryFromIndex(subdir, autoDiscoverable);
+    QStringList newDirs;
+    foreach(const QString &subdir, addedDirs)
+        newDirs << IndexDirectory(subdir, autoDiscoverable);
+    if (IsWatching() && !newDirs.isEmpty())
+        changeWatcher->addPaths(newDirs);
+}
+
+QString LocalAssetStorage::IndexPath(const QString &path)
+{
+    return QDir::cleanPath(QFileInfo(QDir::fromNativeSeparators(path)).absoluteFilePath());
+}
+
+bool LocalAssetStorage::IsIgnoredPath(const QString &path)
+{
+    return path.contains(".git") || path.contains(".svn") || path.contains(".hg");
+}
+
+QStringList LocalAssetStorage::IndexDirectory(const QString &path, bool emitCreated)
+{
+    QStringList addedDirs;
+    QStringList dirsToIndex;
+    dirsToIndex << IndexPath(path);
+    while(!dirsToIndex.isEmpty())
+    {
+        const QString dirPath = dirsToIndex.takeLast();
+        if (indexedDirectories.contains(dirPath))
+            continue;
+
+        IndexedDirectory &dir = indexedDirectories[dirPath];
+        addedDirs << dirPath;
+        const QDir::Filters filters = QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks | (recursive ? QDir::Dirs : QDir::Filters(0));
+        foreach(const QFileInfo &entry, QDir(dirPath).entryInfoList(filters))
+        {
+            QString entryPath = dirPath + "/" + entry.fileName();
+            if (IsIgnoredPath(entryPath))
+                continue;
+            if (entry.isDir())
+            {
+                dir.subdirectories.insert(entryPath);
+                dirsToIndex << entryPath;
+            }
+            else
+            {
+                AddFileToIndex(dir, entryPath);
+                if (emitCreated && autoDiscoverable)
+                    EmitAssetChanged(entryPath, IAssetStorage::AssetCreate);
+            }
+        }
+    }
+    return addedDirs;
+}
+
+void LocalAssetStorage::RemoveDirectoryFromIndex(const QString &path, bool emitDeleted)
+{
+    QStringList dirsToRemove;
+    dirsToRemove << IndexPath(path);
+    QStringList removedDirs;
+    while(!dirsToRemove.isEmpty())
+    {
+        const QString dirPath = dirsToRemove.takeLast();
+        QHash<QString, IndexedDirectory>::iterator iter = indexedDirectories.find(dirPath);
+        if (iter == indexedDirectories.end())
+            continue;
+
+        IndexedDirectory dir = iter.value();
+        indexedDirectories.erase(iter);
+        removedDirs << dirPath;
+        foreach(const QString &file, dir.files)
+        {
+            RemoveFileFromIndex(dir, file);
+            if (emitDeleted)
+                EmitAssetChanged(file, IAssetStorage::AssetDelete);
+        }
+        foreach(const QString &subdir, dir.subdirectories)
+            dirsToRemove << subdir;
+    }
+
+    // The storage root itself stays in the index, so that it is rescanned if it is created again.
+    if (removedDirs.contains(IndexPath(directory)))
+        indexedDirectories.insert(IndexPath(directory), IndexedDirectory());
+    else if (IsWatching())
+        changeWatcher->removePaths(removedDirs);
+}
+
+void LocalAssetStorage::AddFileToIndex(IndexedDirectory &dir, const QString &file)
+{
+    dir.files.insert(file);
+    const QString localName = file.mid(file.lastIndexOf('/') + 1).toLower();
+
+///\todo This is an often-received error condition if the user is not aware, but also occurs naturally in built-in Ogre Media storages.
+/// Fix this check to occur somehow nicer (without additional constraints to asset load time) without a hardcoded check
+/// against the storage name.
+    if (Name() != "Ogre Media" && cachedFiles.contains(localName))
+        LogWarning("Warning: Asset Storage \"" + Name() + "\" contains ambiguous assets \"" + cachedFiles.value(localName) + "\" and \"" + file + "\" in two different subdirectories!");
+
+    cachedFiles.insert(localName, file);
+}
+
+void LocalAssetStorage::RemoveFileFromIndex(IndexedDirectory &dir, const QString &file)
+{
+    dir.files.remove(file);
+    cachedFiles.remove(file.mid(file.lastIndexOf('/') + 1).toLower(), file);
+    watchedFiles.remove(file);
 }
@@ -7,6 +7,8 @@
 #include "CoreStringUtils.h"
 
 #include <QMap>
+#include <QHash>
+#include <QSet>
 
 class QFileSystemWatcher;
 class AssetAPI;
@@ -31,16 +33,29 @@ public:
     bool recursive;
     
     /// Starts listening on the local directory this asset storage points to.
+    /** Indexes the storage contents and watches the directories of the storage, not the individual files. */
     void SetupWatcher();
 
     /// Stops and deallocates the directory change listener.
     void RemoveWatcher();
 
+    /// Starts watching the given file for modifications.
+    /** Only the files of which assets have been loaded need to be watched, creation and deletion of files is tracked through their directories. */
+    void WatchFile(const QString &absoluteFilename);
+
+    /// Re-reads the contents of a single directory in this storage and updates the storage index accordingly.
+    /** Emits AssetChanged for created and deleted files. New subdirectories are indexed and watched,
+        and the files of removed subdirectories are handled as deleted. */
+    void RescanDirectory(const QString &path);
+
+    /// Handles a change notification of a watched file. Emits AssetModify if the file still exists, otherwise rescans its directory.
+    void HandleFileChanged(const QString &path);
+
     /// Load all assets of specific suffix
     void LoadAllAssetsOfType(AssetAPI *assetAPI, const QString &suffix, const QString &assetType);
 
     ///\todo Evaluate if could be removed. Now both AssetAPI and LocalAssetStorage manage list of asset refs.
-    QStringList assetRefs;
+    QSet<QString> assetRefs;
 
     QFileSystemWatcher *changeWatcher;
 
@@ -66,7 +81,7 @@ public slots:
 
     /// Returns all assetrefs currently known in this asset storage. Does not load the assets
     /// @deprecated Do not call this. Rather query for assets through AssetAPI.
-    virtual QStringList GetAllAssetRefs() { return assetRefs; }
+    virtual QStringList GetAllAssetRefs() { return assetRefs.toList(); }
     
     /// Refresh asset refs. Issues a directory query and emits AssetChanged signals immediately
     virtual void RefreshAssetRefs();
@@ -90,7 +105,44 @@ public slots:
 private:
     friend class LocalAssetProvider;
 
-    /// Maps a file basename 'asset.mesh' to its full path 'c:\project\assets\asset.mesh'.
+    /// Files and subdirectories of a single directory in the storage index, as absolute paths.
+    struct IndexedDirectory
+    {
+        QSet<QString> files;
+        QSet<QString> subdirectories;
+    };
+
+    /// Returns @c path in the form used as the key of the storage index: absolute, forward slashes and no trailing slash.
+    static QString IndexPath(const QString &path);
+
+    /// Returns true if the given file or directory should not be included in the storage, f.ex. version control metadata.
+    static bool IsIgnoredPath(const QString &path);
+
+    /// Adds the given directory to the index, and also its subdirectories if this storage is recursive.
+    /** @param emitCreated If true, AssetChanged is emitted for each file found.
+        @return The directories that were added to the index. */
+    QStringList IndexDirectory(const QString &path, bool emitCreated);
+
+    /// Removes the given directory and its subdirectories from the index.
+    /** @param emitDeleted If true, AssetChanged is emitted for each removed file. */
+    void RemoveDirectoryFromIndex(const QString &path, bool emitDeleted);
+
+    void AddFileToIndex(IndexedDirectory &dir, const QString &file);
+    void RemoveFileFromIndex(IndexedDirectory &dir, const QString &file);
+
+    /// Returns true if the storage index is kept up to date by directory change notifications.
+    bool IsWatching() const;
+
+    /// Maps an indexed directory to its contents.
+    QHash<QString, IndexedDirectory> indexedDirectories;
+
+    /// Maps a lowercase file basename 'asset.mesh' to its full path 'c:/project/assets/asset.mesh'.
     /// Used to quickly lookup known assets by basename instead of having to do an expensive recursive directory search.
-    std::map<QString, QString, QStringLessThanNoCase> cachedFiles;
+    QMultiHash<QString, QString> cachedFiles;
+
+    /// Files that are being watched for modifications.
+    QSet<QString> watchedFiles;
+
+    /// True once the storage contents have been indexed.
+    bool contentsCached;
 };
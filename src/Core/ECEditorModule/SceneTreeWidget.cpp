@@ -49,8 +49,6 @@
 #include <QLabel>
 #include <QDialog>
 
-#include <kNet/DataSerializer.h>
-
 #include "MemoryLeakCheck.h"
 
 #ifdef Q_WS_MAC
@@ -1312,23 +1310,18 @@ void SceneTreeWidget::SaveSelectionDialogClosed(int result)
     else // Handle all other as binary.
     {
         SceneTreeWidgetSelection sel = SelectedItems();
-        if (!sel.IsEmpty())
+        if (!sel.IsEmpty() && !scene.expired())
         {
-            // Assume 4MB max for now
-            bytes.resize(4 * 1024 * 1024);
-            kNet::DataSerializer dest(bytes.data(), bytes.size());
-
-            dest.Add<u32>(sel.entities.size());
-
+            EntityList entities;
             foreach(EntityItem *eItem, sel.entities)
             {
                 EntityPtr entity = eItem->Entity();
                 assert(entity);
                 if (entity)
-                    entity->SerializeToBinary(dest);
+                    entities.push_back(entity);
             }
 
-            bytes.resize((int)dest.BytesFilled());
+            bytes = scene.lock()->SerializeToBinary(entities, false);
         }
     }
 
@@ -21,6 +21,10 @@
 #include "Profiler.h"
 #include "OgreRenderingModule.h"
 #include "OgreWorld.h"
+#include "FrameAPI.h"
+#include "ConfigAPI.h"
+#include "Math/MathFunc.h"
+#include "ParallelFor.h"
 
 #include <Ogre.h>
 #include <utility>
@@ -30,6 +34,89 @@
 using namespace std;
 using namespace OgreRenderer;
 
+namespace
+{
+
+/// Reads the height values of the terrain patches for TerrainGeometry.
+class PatchHeightSource : public TerrainHeightSource
+{
+public:
+    explicit PatchHeightSource(const EC_Terrain &terrain_) : terrain(terrain_) {}
+
+    uint VerticesWidth() const { return terrain.VerticesWidth(); }
+    uint VerticesHeight() const { return terrain.VerticesHeight(); }
+    float Height(uint x, uint y) const
+    {
+        // The patches that are not loaded read as zero, like in EC_Terrain::GetPoint.
+        const EC_Terrain::Patch &patch = terrain.GetPatch(x / EC_Terrain::cPatchSize, y / EC_Terrain::cPatchSize);
+        return patch.heightData.empty() ? 0.f : patch.GetHeightValue(x % EC_Terrain::cPatchSize, y % EC_Terrain::cPatchSize);
+    }
+
+private:
+    const EC_Terrain &terrain;
+};
+
+/// Sets the bounds of a terrain chunk mesh.
+void SetMeshBounds(Ogre::Mesh *mesh, const AABB &bounds)
+{
+    // The bounding sphere of an Ogre mesh is centered at the mesh origin.
+    const float3 farthest(Max(Abs(bounds.minPoint.x), Abs(bounds.maxPoint.x)), Max(Abs(bounds.minPoint.y), Abs(bounds.maxPoint.y)),
+        Max(Abs(bounds.minPoint.z), Abs(bounds.maxPoint.z)));
+    mesh->_setBounds(Ogre::AxisAlignedBox(bounds.minPoint, bounds.maxPoint));
+    mesh->_setBoundingSphereRadius(farthest.Length());
+}
+
+/// The vertices of a chunk, or of a rectangle of its vertex grid, to generate.
+struct ChunkVertexJob
+{
+    ChunkVertexJob() : chunkIndex(0), wholeChunk(false), minX(0), minY(0), maxX(0), maxY(0) {}
+
+    /// Index of the chunk in EC_Terrain::chunks.
+    uint chunkIndex;
+    /// If true, the Ogre resources of the chunk are recreated from the vertices. Otherwise the vertices are written to the existing mesh.
+    bool wholeChunk;
+    /// The rectangle of the chunk vertex grid to generate, see TerrainGeometry::GenerateChunkVertices.
+    uint minX, minY, maxX, maxY;
+    std::vector<TerrainVertex> vertices;
+    AABB bounds;
+};
+
+/// Generates the vertices of a set of chunks in parallel.
+/** The vertex generation only reads the height values of the terrain, so it is safe to do outside the main thread,
+    as long as the heights are not modified at the same time. The Ogre resources are created on the main thread afterwards. */
+class ChunkVertexBatch : public IParallelTask
+{
+public:
+    ChunkVertexBatch(const TerrainGeometry &geometry_, const TerrainHeightSource &heights_, const EC_Terrain::Chunk *chunks_,
+        float uScale_, float vScale_, std::vector<ChunkVertexJob> &jobs_) :
+        geometry(geometry_), heights(heights_), chunks(chunks_), uScale(uScale_), vScale(vScale_), jobs(jobs_)
+    {
+    }
+
+    /// Runs all the jobs. Returns once all are done.
+    void Run()
+    {
+        ParallelFor(*this, jobs.size());
+    }
+
+    void RunItem(size_t index)
+    {
+        ChunkVertexJob &job = jobs[index];
+        const EC_Terrain::Chunk &chunk = chunks[job.chunkIndex];
+        geometry.GenerateChunkVertices(heights, chunk.x, chunk.y, uScale, vScale, job.minX, job.minY, job.maxX, job.maxY, job.vertices, job.bounds);
+    }
+
+private:
+    const TerrainGeometry &geometry;
+    const TerrainHeightSource &heights;
+    const EC_Terrain::Chunk *chunks;
+    float uScale;
+    float vScale;
+    std::vector<ChunkVertexJob> &jobs;
+};
+
+}
+
 EC_Terrain::EC_Terrain(Scene* scene) :
     IComponent(scene),
     INIT_ATTRIBUTE(nodeTransformation, "Transform"),
@@ -41,7 +128,25 @@ EC_Terrain::EC_Terrain(Scene* scene) :
     INIT_ATTRIBUTE_VALUE(vScale, "Tex. V scale", 0.13f),
     patchWidth(1),
     patchHeight(1),
-    rootNode(0)
+    rootNode(0),
+    chunkPatches(1),
+    chunksWidth(0),
+    chunksHeight(0),
+    lodDistance(64.f),
+    streamingRadius(512.f),
+    streamingUpdateAcc(0.f),
+    editedMinX(0xFFFFFFFF),
+    editedMinY(0xFFFFFFFF),
+    editedMaxX(0),
+    editedMaxY(0),
+    loadEditedMinX(0xFFFFFFFF),
+    loadEditedMinY(0xFFFFFFFF),
+    loadEditedMaxX(0),
+    loadEditedMaxY(0),
+    heightMapLoading(false),
+    heightGridMin(0.f),
+    heightGridMax(0.f),
+    heightGridRangeValid(false)
 {
     connect(this, SIGNAL(ParentEntitySet()), this, SLOT(UpdateSignals()));
 
@@ -67,6 +172,11 @@ void EC_Terrain::UpdateSignals()
         connect(parent, SIGNAL(ComponentRemoved(IComponent*, AttributeChange::Type)), this, SLOT(AttachTerrainRootNode()), Qt::UniqueConnection); // The Attach function also handles detaches.
 
         world_ = ParentScene()->Subsystem<OgreWorld>();
+
+        if (!framework->IsHeadless())
+            connect(framework->Frame(), SIGNAL(Updated(float)), this, SLOT(UpdateChunkLods()), Qt::UniqueConnection);
+        connect(framework->Frame(), SIGNAL(Updated(float)), this, SLOT(UpdateStreaming(float)), Qt::UniqueConnection);
+        streamingRadius = framework->Config()->Get(ConfigAPI::FILE_FRAMEWORK, ConfigAPI::SECTION_FRAMEWORK, "terrain streaming radius", streamingRadius).toFloat();
     }
 }
 
@@ -76,6 +186,8 @@ void EC_Terrain::MakePatchFlat(uint x, uint y, float heightValue)
     patch.heightData.clear();
     patch.heightData.insert(patch.heightData.end(), cPatchSize*cPatchSize, heightValue);
     patch.patch_geometry_dirty = true;
+    heightGridRangeValid = false;
+    UpdateHeightGrid(x * cPatchSize, y * cPatchSize, (x + 1) * cPatchSize - 1, (y + 1) * cPatchSize - 1);
 }
 
 void EC_Terrain::MakeTerrainFlat(float heightValue)
@@ -97,23 +209,13 @@ void EC_Terrain::ResizeTerrain(uint newPatchWidth, uint newPatchHeight)
     if (newPatchWidth == patchWidth && newPatchHeight == patchHeight)
         return;
 
-    // If the width changes, we need to also regenerate the old right-most column to generate the new seams. (If we are shrinking, this is not necessary)
-    if (patchWidth < newPatchWidth)
-        for(uint y = 0; y < patchHeight; ++y)
-            GetPatch(patchWidth-1, y).patch_geometry_dirty = true;
-
-    // If the height changes, we need to also regenerate the old top-most row to generate the new seams. (If we are shrinking, this is not necessary)
-    if (patchHeight < newPatchHeight)
-        for(uint x = 0; x < patchWidth; ++x)
-            GetPatch(x, patchHeight-1).patch_geometry_dirty = true;
+    // The old height values are copied over, so they all need to be present.
+    StopStreaming();
+    heightGrid.reset();
+    heightGridRangeValid = false;
 
-    // First delete all the patches that will not be part of the newly-sized terrain (user shrinked the terrain in one or two dimensions)
-    for(uint y = newPatchHeight; y < patchHeight; ++y)
-        for(uint x = 0; x < patchWidth; ++x)
-            DestroyPatch(x, y);
-    for(uint x = newPatchWidth; x < patchWidth; ++x) // We hav esome overlap here with above, but it's ok since DestroyPatch is benign.
-        for(uint y = 0; y < patchHeight; ++y)
-            DestroyPatch(x, y);
+    // The chunks are padded to the terrain edges and their blend mask UVs stretch across the whole terrain, so all chunks need to be regenerated.
+    DirtyAllTerrainPatches();
 
     // Now create the new terrain patch storage and copy the old height values over.
     std::vector<Patch> newPatches(newPatchWidth * newPatchHeight);
@@ -176,6 +278,9 @@ void EC_Terrain::AttributesChanged()
     {
         QString refBody;
         std::map<QString, QString> args = ParseAssetRefArgs(heightMap.Get().ref, &refBody);
+        heightMapLoading = !refBody.trimmed().isEmpty();
+        if (!heightMapLoading)
+            heightsSetBeforeLoad.clear();
         heightMapAsset->HandleAssetRefChange(framework->Asset(), refBody);
     }
 }
@@ -192,14 +297,21 @@ void EC_Terrain::MaterialAssetLoaded(AssetPtr asset_)
 
     currentMaterial = ogreMaterial->ogreAssetName;
 
-    // Also, we need to update each geometry patch to use the new material.
-    for(uint y = 0; y < patchHeight; ++y)
-        for(uint x = 0; x < patchWidth; ++x)
-            UpdateTerrainPatchMaterial(x, y);
+    // Also, we need to update each geometry chunk to use the new material.
+    for(size_t i = 0; i < chunks.size(); ++i)
+        UpdateTerrainChunkMaterial(chunks[i]);
 }
 
 void EC_Terrain::TerrainAssetLoaded(AssetPtr asset_)
 {
+    TerrainTileAssetPtr tileData = dynamic_pointer_cast<TerrainTileAsset>(asset_);
+    if (tileData)
+    {
+        LoadFromTileAsset(tileData);
+        ReapplyHeightsSetBeforeLoad();
+        return;
+    }
+
     BinaryAssetPtr assetData = dynamic_pointer_cast<BinaryAsset>(asset_);
     TextureAssetPtr textureData = dynamic_pointer_cast<TextureAsset>(asset_);
     if ((!assetData.get() || assetData->data.size() == 0) && !textureData)
@@ -232,6 +344,25 @@ void EC_Terrain::TerrainAssetLoaded(AssetPtr asset_)
             LogError("Failed to load terrain from texture source \"" + textureData->Name() + "\"! Loading the file \"" + textureData->DiskSource() + "\" failed!");
         }
     }
+    ReapplyHeightsSetBeforeLoad();
+}
+
+void EC_Terrain::ReapplyHeightsSetBeforeLoad()
+{
+    heightMapLoading = false;
+    if (heightsSetBeforeLoad.empty())
+        return;
+
+    // The peers have already applied the edits, so they are set locally. They still differ from the height map asset.
+    std::vector<HeightsSetBeforeLoad> edits;
+    edits.swap(heightsSetBeforeLoad);
+    for(size_t i = 0; i < edits.size(); ++i)
+    {
+        const HeightsSetBeforeLoad &edit = edits[i];
+        SetHeights(edit.minX, edit.minY, edit.width, edit.height, &edit.heights[0], AttributeChange::LocalOnly);
+        AddEditedHeightsSinceLoad(edit.minX, edit.minY, edit.minX + edit.width - 1, edit.minY + edit.height - 1);
+    }
+    RegenerateDirtyTerrainPatches();
 }
 
 void EC_Terrain::DestroyPatch(uint x, uint y)
@@ -239,43 +370,55 @@ void EC_Terrain::DestroyPatch(uint x, uint y)
     if (x >= patchWidth || y >= patchHeight)
         return;
 
+    const uint chunkIndex = (y / chunkPatches) * chunksWidth + x / chunkPatches;
+    if (chunkIndex < chunks.size())
+        DestroyChunk(chunks[chunkIndex]);
+}
+
+void EC_Terrain::DestroyChunk(Chunk &chunk)
+{
     if (!GetFramework() || world_.expired()) // Already destroyed or not initialized at all.
         return;
 
     Ogre::SceneManager *sceneMgr = world_.lock()->OgreSceneManager();
-    
-    EC_Terrain::Patch &patch = GetPatch(x, y);
 
-    if (patch.node)
+    if (chunk.node)
     {
-        sceneMgr->getRootSceneNode()->removeChild(patch.node);
-        patch.node->detachAllObjects();
-        sceneMgr->destroySceneNode(patch.node);
-        patch.node = 0;
+        if (chunk.node->getParentSceneNode())
+            chunk.node->getParentSceneNode()->removeChild(chunk.node);
+        chunk.node->detachAllObjects();
+        sceneMgr->destroySceneNode(chunk.node);
+        chunk.node = 0;
     }
-    if (patch.entity)
+    if (chunk.entity)
     {
-        sceneMgr->destroyEntity(patch.entity);
-        patch.entity = 0;
+        sceneMgr->destroyEntity(chunk.entity);
+        chunk.entity = 0;
     }
+    chunk.indexListId = 0xFFFFFFFF;
+    chunk.ClearDirtyVertices();
 
     // If there exists a previously generated GPU Mesh resource, delete it before creating a new one.
-    if (patch.meshGeometryName.length() > 0)
+    if (chunk.meshGeometryName.length() > 0)
     {
         try
         {
-            Ogre::MeshManager::getSingleton().remove(patch.meshGeometryName);
+            Ogre::MeshManager::getSingleton().remove(chunk.meshGeometryName);
         }
         catch(...) {}
-        patch.meshGeometryName = "";
+        chunk.meshGeometryName = "";
     }
 }
 
 void EC_Terrain::Destroy()
 {
-    for(uint y = 0; y < patchHeight; ++y)
-        for(uint x = 0; x < patchWidth; ++x)
-            DestroyPatch(x, y);
+    for(size_t i = 0; i < chunks.size(); ++i)
+        DestroyChunk(chunks[i]);
+
+    // The index data is only referenced by the chunk meshes, so it can be released once they are gone.
+    for(std::map<u32, Ogre::IndexData*>::iterator iter = chunkIndexData.begin(); iter != chunkIndexData.end(); ++iter)
+        OGRE_DELETE iter->second;
+    chunkIndexData.clear();
 
     if (!GetFramework() || world_.expired()) // Already destroyed or not initialized at all.
         return;
@@ -294,15 +437,159 @@ float EC_Terrain::GetPoint(uint x, uint y) const
     if (y >= cPatchSize * patchHeight)
         y = cPatchSize * patchHeight - 1;
 
-    return GetPatch(x / cPatchSize, y / cPatchSize).heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)];
+    const Patch &patch = GetPatch(x / cPatchSize, y / cPatchSize);
+    if (patch.heightData.empty())
+        return 0.f;
+    return patch.heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)];
 }
 
-void EC_Terrain::SetPointHeight(uint x, uint y, float height)
+void EC_Terrain::SetPointHeight(uint x, uint y, float height, AttributeChange::Type change)
 {
     if (x >= cPatchSize * patchWidth || y >= cPatchSize * patchHeight)
         return; // Out of bounds signals are silently ignored.
 
-    GetPatch(x / cPatchSize, y / cPatchSize).heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)] = height;
+    Patch &patch = GetPatch(x / cPatchSize, y / cPatchSize);
+    if (patch.heightData.empty())
+        return; // The patch is not loaded, e.g. it is outside the streaming radius.
+    float &value = patch.heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)];
+    UpdateHeightGridRange(value, height);
+    value = height;
+    UpdateHeightGrid(x, y, x, y);
+    DirtyTerrainVertices(x, y, x, y);
+    MarkHeightsEdited(x, y, x, y, change);
+}
+
+void EC_Terrain::GetHeights(uint minX, uint minY, uint width, uint height, float *dest) const
+{
+    for(uint y = minY; y < minY + height; ++y)
+        for(uint x = minX; x < minX + width; ++x, ++dest)
+        {
+            if (x >= cPatchSize * patchWidth || y >= cPatchSize * patchHeight)
+            {
+                *dest = FLOAT_NAN;
+                continue;
+            }
+            const Patch &patch = GetPatch(x / cPatchSize, y / cPatchSize);
+            *dest = patch.heightData.empty() ? FLOAT_NAN : patch.heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)];
+        }
+}
+
+void EC_Terrain::SetHeights(uint minX, uint minY, uint width, uint height, const float *heights, AttributeChange::Type change)
+{
+    if (width == 0 || height == 0)
+        return;
+    if (heightMapLoading)
+    {
+        HeightsSetBeforeLoad edit;
+        edit.minX = minX;
+        edit.minY = minY;
+        edit.width = width;
+        edit.height = height;
+        edit.heights.assign(heights, heights + width * height);
+        heightsSetBeforeLoad.push_back(edit);
+    }
+    if (minX >= cPatchSize * patchWidth || minY >= cPatchSize * patchHeight)
+        return;
+
+    for(uint y = minY; y < minY + height; ++y)
+        for(uint x = minX; x < minX + width; ++x, ++heights)
+        {
+            if (x >= cPatchSize * patchWidth || y >= cPatchSize * patchHeight || IsNan(*heights))
+                continue;
+            Patch &patch = GetPatch(x / cPatchSize, y / cPatchSize);
+            if (!patch.heightData.empty())
+            {
+                float &value = patch.heightData[(y % cPatchSize) * cPatchSize + (x % cPatchSize)];
+                UpdateHeightGridRange(value, *heights);
+                value = *heights;
+            }
+        }
+
+    const uint maxX = min(minX + width, cPatchSize * patchWidth) - 1;
+    const uint maxY = min(minY + height, cPatchSize * patchHeight) - 1;
+    UpdateHeightGrid(minX, minY, maxX, maxY);
+    DirtyTerrainVertices(minX, minY, maxX, maxY);
+    MarkHeightsEdited(minX, minY, maxX, maxY, change);
+}
+
+void EC_Terrain::MarkHeightsEdited(uint minX, uint minY, uint maxX, uint maxY, AttributeChange::Type change)
+{
+    if (change == AttributeChange::Default)
+        change = UpdateMode();
+    if (change != AttributeChange::Replicate || !IsReplicated())
+        return;
+
+    AddEditedHeightsSinceLoad(minX, minY, maxX, maxY);
+    const bool wasEdited = editedMinX <= editedMaxX;
+    editedMinX = min(editedMinX, minX);
+    editedMinY = min(editedMinY, minY);
+    editedMaxX = max(editedMaxX, maxX);
+    editedMaxY = max(editedMaxY, maxY);
+    if (!wasEdited)
+        emit HeightsEdited();
+}
+
+bool EC_Terrain::TakeEditedHeights(uint &minX, uint &minY, uint &maxX, uint &maxY)
+{
+    // The terrain may have been resized since the edits.
+    const bool edited = editedMinX <= editedMaxX && editedMinX < cPatchSize * patchWidth && editedMinY < cPatchSize * patchHeight;
+    if (edited)
+    {
+        minX = editedMinX;
+        minY = editedMinY;
+        maxX = min(editedMaxX, cPatchSize * patchWidth - 1);
+        maxY = min(editedMaxY, cPatchSize * patchHeight - 1);
+    }
+    editedMinX = editedMinY = 0xFFFFFFFF;
+    editedMaxX = editedMaxY = 0;
+    return edited;
+}
+
+bool EC_Terrain::EditedHeightsSinceLoad(uint &minX, uint &minY, uint &maxX, uint &maxY) const
+{
+    // The terrain may have been resized since the edits.
+    if (loadEditedMinX > loadEditedMaxX || loadEditedMinX >= cPatchSize * patchWidth || loadEditedMinY >= cPatchSize * patchHeight)
+        return false;
+    minX = loadEditedMinX;
+    minY = loadEditedMinY;
+    maxX = min(loadEditedMaxX, cPatchSize * patchWidth - 1);
+    maxY = min(loadEditedMaxY, cPatchSize * patchHeight - 1);
+    return true;
+}
+
+void EC_Terrain::AddEditedHeightsSinceLoad(uint minX, uint minY, uint maxX, uint maxY)
+{
+    loadEditedMinX = min(loadEditedMinX, minX);
+    loadEditedMinY = min(loadEditedMinY, minY);
+    loadEditedMaxX = max(loadEditedMaxX, maxX);
+    loadEditedMaxY = max(loadEditedMaxY, maxY);
+}
+
+void EC_Terrain::DirtyTerrainVertices(uint minX, uint minY, uint maxX, uint maxY)
+{
+    // Only the chunks that have geometry are updated in place. The others are generated as a whole once their patches have been loaded.
+    if (chunks.empty())
+        return;
+
+    // The chunks share their edge vertices, and the normals of the vertices next to the rectangle change too.
+    const uint chunkSize = geometry.ChunkSize();
+    const uint firstChunkX = minX >= 2 ? (minX - 2) / chunkSize : 0;
+    const uint firstChunkY = minY >= 2 ? (minY - 2) / chunkSize : 0;
+    const uint lastChunkX = min((maxX + 1) / chunkSize, chunksWidth - 1);
+    const uint lastChunkY = min((maxY + 1) / chunkSize, chunksHeight - 1);
+
+    for(uint y = firstChunkY; y <= lastChunkY; ++y)
+        for(uint x = firstChunkX; x <= lastChunkX; ++x)
+        {
+            Chunk &chunk = chunks[y * chunksWidth + x];
+            uint chunkMinX, chunkMinY, chunkMaxX, chunkMaxY;
+            if (!chunk.entity || !geometry.ChunkVerticesAffectedBy(x, y, minX, minY, maxX, maxY, chunkMinX, chunkMinY, chunkMaxX, chunkMaxY))
+                continue;
+            chunk.dirtyMinX = min(chunk.dirtyMinX, chunkMinX);
+            chunk.dirtyMinY = min(chunk.dirtyMinY, chunkMinY);
+            chunk.dirtyMaxX = max(chunk.dirtyMaxX, chunkMaxX);
+            chunk.dirtyMaxY = max(chunk.dirtyMaxY, chunkMaxY);
+        }
 }
 
 float3 EC_Terrain::GetPointOnMap(const float3 &point) const 
@@ -338,6 +625,59 @@ float3 EC_Terrain::GetPointOnMapLocal(const float3 &point) const
     return float3(local.x, local.y, local.z);
 }
 
+void EC_Terrain::GetPointsOnMap(const float3 *worldPositions, size_t count, float3 *pointsOnMap, float3 *normals) const
+{
+    PROFILE(EC_Terrain_GetPointsOnMap);
+
+    const float3x4 localToWorld = LocalToWorld();
+    float3x4 worldToLocal = localToWorld;
+    worldToLocal.Inverse();
+
+    // Note: heightmap X & Y correspond to X & Z local axes, while height is local Y
+    std::vector<float> xs(count), ys(count), heights(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        const float3 local = worldToLocal.MulPos(worldPositions[i]);
+        xs[i] = local.x;
+        ys[i] = local.z;
+    }
+    if (count > 0)
+        TerrainGeometry::SampleSurface(PatchHeightSource(*this), &xs[0], &ys[0], count, &heights[0], normals);
+
+    for(size_t i = 0; i < count; ++i)
+        pointsOnMap[i] = localToWorld.MulPos(float3(xs[i], heights[i], ys[i]));
+
+    if (normals)
+    {
+        // Normals transform with the inverse transpose, so that they stay perpendicular to the surface under non-uniform scale.
+        const float3x4 normalTransform = localToWorld.InverseTransposed();
+        for(size_t i = 0; i < count; ++i)
+            normals[i] = normalTransform.MulDir(normals[i]).Normalized();
+    }
+}
+
+QVector<float> EC_Terrain::GetHeightsAndNormals(const QVector<float> &worldXZ) const
+{
+    std::vector<float3> positions(worldXZ.size() / 2);
+    for(size_t i = 0; i < positions.size(); ++i)
+        positions[i] = float3(worldXZ[(int)i*2], 0.f, worldXZ[(int)i*2+1]);
+
+    std::vector<float3> points(positions.size()), normals(positions.size());
+    if (!positions.empty())
+        GetPointsOnMap(&positions[0], positions.size(), &points[0], &normals[0]);
+
+    QVector<float> result((int)positions.size() * 4);
+    float *dest = result.data();
+    for(size_t i = 0; i < positions.size(); ++i, dest += 4)
+    {
+        dest[0] = points[i].y;
+        dest[1] = normals[i].x;
+        dest[2] = normals[i].y;
+        dest[3] = normals[i].z;
+    }
+    return result;
+}
+
 float EC_Terrain::GetDistanceToTerrain(const float3 &point) const
 {
     float3 pointOnMap = GetPointOnMap(point);
@@ -413,6 +753,115 @@ float3x4 EC_Terrain::WorldTransform() const
     return float4x4(worldTM).Float3x4Part();
 }
 
+float3x4 EC_Terrain::LocalToWorld() const
+{
+    // Compute the transform without Ogre, since servers do not have the root node.
+    float3x4 localToWorld = nodeTransformation.Get().ToFloat3x4();
+    EC_Placeable *placeable = ParentEntity() ? ParentEntity()->GetComponent<EC_Placeable>().get() : 0;
+    if (placeable)
+        localToWorld = placeable->LocalToWorld() * localToWorld;
+    return localToWorld;
+}
+
+shared_ptr<const std::vector<float> > EC_Terrain::HeightGrid() const
+{
+    if (!heightGrid)
+    {
+        heightGrid = MAKE_SHARED(std::vector<float>, VerticesWidth() * VerticesHeight());
+        if (!heightGrid->empty())
+            CopyToHeightGrid(0, 0, VerticesWidth() - 1, VerticesHeight() - 1);
+    }
+    return heightGrid;
+}
+
+void EC_Terrain::CopyToHeightGrid(uint minX, uint minY, uint maxX, uint maxY) const
+{
+    const uint verticesWidth = VerticesWidth();
+    maxX = min(maxX, verticesWidth - 1);
+    maxY = min(maxY, VerticesHeight() - 1);
+
+    // The patches of a streamed terrain that are not loaded are read from the asset, so that the grid always holds the whole terrain,
+    // e.g. for the physics of a server that streams the terrain around its clients. The patches are visited one tile at a time,
+    // so that each tile is read at most once.
+    const uint tilePatches = streamingAsset ? streamingAsset->TilePatches() : 1;
+    const uint patchValues = cPatchSize * cPatchSize;
+    std::vector<float> tile;
+    for(uint tileY = minY / cPatchSize / tilePatches; tileY <= maxY / cPatchSize / tilePatches; ++tileY)
+        for(uint tileX = minX / cPatchSize / tilePatches; tileX <= maxX / cPatchSize / tilePatches; ++tileX)
+        {
+            tile.clear();
+            for(uint y = max(minY, tileY * tilePatches * cPatchSize); y <= min(maxY, (tileY + 1) * tilePatches * cPatchSize - 1); ++y)
+                for(uint x = max(minX, tileX * tilePatches * cPatchSize); x <= min(maxX, (tileX + 1) * tilePatches * cPatchSize - 1); ++x)
+                {
+                    const Patch &patch = GetPatch(x / cPatchSize, y / cPatchSize);
+                    float height = 0.f;
+                    if (!patch.heightData.empty())
+                        height = patch.GetHeightValue(x % cPatchSize, y % cPatchSize);
+                    else if (streamingAsset && (!tile.empty() || streamingAsset->ReadTile(tileX, tileY, tile)))
+                        height = tile[((patch.y % tilePatches) * tilePatches + patch.x % tilePatches) * patchValues +
+                            (y % cPatchSize) * cPatchSize + x % cPatchSize];
+                    (*heightGrid)[y * verticesWidth + x] = height;
+                }
+        }
+}
+
+void EC_Terrain::HeightGridRange(float &minHeight, float &maxHeight) const
+{
+    if (!heightGridRangeValid)
+    {
+        heightGridMin = std::numeric_limits<float>::max();
+        heightGridMax = -std::numeric_limits<float>::max();
+        for(size_t i = 0; i < patches.size(); ++i)
+        {
+            const std::vector<float> &heights = patches[i].heightData;
+            for(size_t j = 0; j < heights.size(); ++j)
+            {
+                heightGridMin = min(heightGridMin, heights[j]);
+                heightGridMax = max(heightGridMax, heights[j]);
+            }
+        }
+        // The grid holds the asset values of the tiles that are not loaded, and the asset stores their height range.
+        for(size_t i = 0; i < loadedTiles.size(); ++i)
+            if (!loadedTiles[i])
+            {
+                float tileMin, tileMax;
+                streamingAsset->TileHeightRange(i % streamingAsset->TilesWidth(), i / streamingAsset->TilesWidth(), tileMin, tileMax);
+                heightGridMin = min(heightGridMin, tileMin);
+                heightGridMax = max(heightGridMax, tileMax);
+            }
+        heightGridRangeValid = true;
+    }
+    minHeight = heightGridMin;
+    maxHeight = heightGridMax;
+}
+
+void EC_Terrain::UpdateHeightGridRange(float oldHeight, float newHeight)
+{
+    if (!heightGridRangeValid)
+        return;
+    // If the old height was an end of the range and moved inwards, the range may have shrunk. It is scanned again when next asked for.
+    if ((oldHeight <= heightGridMin && newHeight > oldHeight) || (oldHeight >= heightGridMax && newHeight < oldHeight))
+        heightGridRangeValid = false;
+    else
+    {
+        heightGridMin = min(heightGridMin, newHeight);
+        heightGridMax = max(heightGridMax, newHeight);
+    }
+}
+
+void EC_Terrain::UpdateHeightGrid(uint minX, uint minY, uint maxX, uint maxY)
+{
+    if (!heightGrid)
+        return;
+    if (heightGrid.unique())
+        heightGrid.reset(); // No one refers to the grid any more, so release it instead of keeping it up to date.
+    else
+    {
+        emit HeightGridAboutToChange();
+        CopyToHeightGrid(minX, minY, maxX, maxY);
+    }
+}
+
 void EC_Terrain::GetTriangleNormals(float x, float y, float3 &n1, float3 &n2, float3 &n3, float &u, float &v) const
 {
     x = max(0.f, min((float)VerticesWidth()-1.f, x));
@@ -517,23 +966,7 @@ float3 EC_Terrain::GetInterpolatedNormal(float x, float y) const
 
 float3 EC_Terrain::CalculateNormal(uint x, uint y, uint xinside, uint yinside) const
 {
-    uint px = x * cPatchSize + xinside;
-    uint py = y * cPatchSize + yinside;
-
-    uint xNext = Clamp(px+1, 0U, patchWidth * cPatchSize - 1);
-    uint yNext = Clamp(py+1, 0U, patchHeight * cPatchSize - 1);
-    uint xPrev = Clamp(px-1, 0U, patchWidth * cPatchSize - 1);
-    uint yPrev = Clamp(py-1, 0U, patchHeight * cPatchSize - 1);
-
-    float x_slope = GetPoint(xPrev, py) - GetPoint(xNext, py);
-    if ((px <= 0) || (px >= patchWidth * cPatchSize))
-        x_slope *= 2;
-    float y_slope = GetPoint(px, yPrev) - GetPoint(px, yNext);
-    if ((py <= 0) || (py >= patchHeight * cPatchSize))
-        y_slope *= 2;
-
-    // Note: heightmap X & Y correspond to X & Z world axes, while height is world Y
-    return float3(x_slope, 2.0, y_slope).Normalized();
+    return TerrainGeometry::CalculateNormal(PatchHeightSource(*this), x * cPatchSize + xinside, y * cPatchSize + yinside);
 }
 
 bool EC_Terrain::SaveToFile(QString filename)
@@ -558,13 +991,9 @@ bool EC_Terrain::SaveToFile(QString filename)
 
     assert(sizeof(float) == 4);
 
-    for(u32 i = 0; i < xPatches*yPatches; ++i)
-    {
-        if (patches[i].heightData.size() < cPatchSize*cPatchSize)
-            patches[i].heightData.resize(cPatchSize*cPatchSize);
-
-        fwrite(&patches[i].heightData[0], sizeof(float), cPatchSize*cPatchSize, handle); ///< \todo Check read error.
-    }
+    std::vector<float> heights;
+    ReadAllPatchHeights(heights);
+    fwrite(&heights[0], sizeof(float), heights.size(), handle); ///< \todo Check read error.
     fflush(handle);
     if (ferror(handle))
     LogError("Write error in SaveToFile");
@@ -573,6 +1002,44 @@ bool EC_Terrain::SaveToFile(QString filename)
     return true;
 }
 
+bool EC_Terrain::SaveToTileFile(QString filename)
+{
+    if (patchWidth * patchHeight != (int)patches.size())
+    {
+        LogError("The EC_Terrain is in inconsistent state. Cannot save.");
+        return false;
+    }
+
+    std::vector<float> heights;
+    ReadAllPatchHeights(heights);
+    return TerrainTileAsset::SaveTiles(filename, patchWidth, patchHeight, TerrainTileAsset::cDefaultTilePatches, &heights[0]);
+}
+
+bool EC_Terrain::ConvertNtfToTileFile(QString ntfFilename, QString destFilename, uint tilePatches)
+{
+    return TerrainTileAsset::ConvertFromNtf(ntfFilename, destFilename, tilePatches > 0 ? tilePatches : TerrainTileAsset::cDefaultTilePatches);
+}
+
+void EC_Terrain::ReadAllPatchHeights(std::vector<float> &dest)
+{
+    const uint patchValues = cPatchSize * cPatchSize;
+    dest.assign(patches.size() * patchValues, 0.f);
+    std::vector<float> tile;
+    for(size_t i = 0; i < patches.size(); ++i)
+    {
+        const Patch &patch = patches[i];
+        if (patch.heightData.size() == patchValues)
+            memcpy(&dest[i * patchValues], &patch.heightData[0], patchValues * sizeof(float));
+        else if (streamingAsset)
+        {
+            // The patch is not loaded, so read it from the asset. The tiles store their patches in row-major order.
+            const uint tilePatches = streamingAsset->TilePatches();
+            if (streamingAsset->ReadTile(patch.x / tilePatches, patch.y / tilePatches, tile))
+                memcpy(&dest[i * patchValues], &tile[((patch.y % tilePatches) * tilePatches + patch.x % tilePatches) * patchValues], patchValues * sizeof(float));
+        }
+    }
+}
+
 u32 ReadU32(const char *dataPtr, size_t numBytes, int &offset)
 {
     if (offset + 4 > (int)numBytes)
@@ -634,6 +1101,12 @@ bool EC_Terrain::LoadFromDataInMemory(const char *data, size_t numBytes)
     // The terrain asset loaded ok. We are good to set that terrain as the active terrain.
     Destroy();
 
+    streamingAsset.reset();
+    loadedTiles.clear();
+    heightGrid.reset();
+    heightGridRangeValid = false;
+    loadEditedMinX = loadEditedMinY = 0xFFFFFFFF;
+    loadEditedMaxX = loadEditedMaxY = 0;
     patches = newPatches;
     patchWidth = xPatches;
     patchHeight = yPatches;
@@ -717,6 +1190,9 @@ bool EC_Terrain::LoadFromImageFile(QString filename, float offset, float scale)
         return false;
     }
 
+    // The image replaces the whole height map, so all patches need to be present.
+    StopStreaming();
+
     // Note: In the following, we round down, so if the image size is not a multiple of cPatchSize (== 16),
     // we will not use the whole image contents.
     xPatches.Set((uint)image.getWidth() / cPatchSize, AttributeChange::Disconnected);
@@ -728,7 +1204,7 @@ bool EC_Terrain::LoadFromImageFile(QString filename, float offset, float scale)
         {
             Ogre::ColourValue c = image.getColourAt(x, y, 0);
             float height = offset + scale * (c.r + c.g + c.b) / 3.f; // Treat the image as a grayscale heightmap field with the color in range [0,1].
-            SetPointHeight(x, y, height);
+            SetPointHeight(x, y, height, AttributeChange::LocalOnly);
         }
 
     xPatches.Changed(AttributeChange::LocalOnly);
@@ -1003,6 +1479,8 @@ void EC_Terrain::GenerateFromOgreMesh(QString ogreMeshResourceName, const Ogre::
     xVertices = ((xVertices + cPatchSize-1) / cPatchSize) * cPatchSize;
     yVertices = ((yVertices + cPatchSize-1) / cPatchSize) * cPatchSize;
 
+    StopStreaming();
+
     xPatches.Set(xVertices/cPatchSize, AttributeChange::Disconnected);
     yPatches.Set(yVertices/cPatchSize, AttributeChange::Disconnected);
     ResizeTerrain(xVertices/cPatchSize, yVertices/cPatchSize);
@@ -1022,7 +1500,7 @@ void EC_Terrain::GenerateFromOgreMesh(QString ogreMeshResourceName, const Ogre::
             if (height < 1e8f)
             {
                 height = raycastHeight - height;
-                SetPointHeight(x, y, height);
+                SetPointHeight(x, y, height, AttributeChange::LocalOnly);
                 minHeight = min(minHeight, height);
                 maxHeight = max(maxHeight, height);
             }
@@ -1031,7 +1509,7 @@ void EC_Terrain::GenerateFromOgreMesh(QString ogreMeshResourceName, const Ogre::
     for(int y = 0; y < yVertices; ++y)
         for(int x = 0; x < xVertices; ++x)
             if (GetPoint(x, y) >= 1e8f)
-                SetPointHeight(x, y, minHeight);
+                SetPointHeight(x, y, minHeight, AttributeChange::LocalOnly);
 
     // Adjust offset so that we always have the lowest point of the terrain at height 0.
     RemapHeightValues(0.f, maxHeight - minHeight);
@@ -1050,7 +1528,7 @@ void EC_Terrain::AffineTransform(float scale, float offset)
 {
     for(uint y = 0; y < yPatches.Get() * cPatchSize; ++y)
         for(uint x = 0; x < xPatches.Get() * cPatchSize; ++x)
-            SetPointHeight(x, y, GetPoint(x, y) * scale + offset);
+            SetPointHeight(x, y, GetPoint(x, y) * scale + offset, AttributeChange::LocalOnly);
 }
 
 void EC_Terrain::RemapHeightValues(float minHeight, float maxHeight)
@@ -1101,16 +1579,14 @@ void EC_Terrain::SetTerrainMaterialTexture(uint index, const QString &textureNam
 //        LogWarning("Ogre material " + std::string(terrainMaterialName) + " not found!");
 }
 
-void EC_Terrain::UpdateTerrainPatchMaterial(uint patchX, uint patchY)
+void EC_Terrain::UpdateTerrainChunkMaterial(Chunk &chunk)
 {
-    Patch &patch = GetPatch(patchX, patchY);
-
-    if (!patch.entity)
+    if (!chunk.entity)
         return;
 
-    for(uint i = 0; i < patch.entity->getNumSubEntities(); ++i)
+    for(uint i = 0; i < chunk.entity->getNumSubEntities(); ++i)
     {
-        Ogre::SubEntity *sub = patch.entity->getSubEntity(i);
+        Ogre::SubEntity *sub = chunk.entity->getSubEntity(i);
         if (sub)
             sub->setMaterialName(currentMaterial.toStdString().c_str());
     }
@@ -1160,11 +1636,9 @@ void EC_Terrain::AttachTerrainRootNode()
     }
 }
 
-void EC_Terrain::GenerateTerrainGeometryForOnePatch(uint patchX, uint patchY)
+void EC_Terrain::CreateChunkMesh(Chunk &chunk, const std::vector<TerrainVertex> &vertices, const AABB &bounds)
 {
-    PROFILE(EC_Terrain_GenerateTerrainGeometryForOnePatch);
-
-    EC_Terrain::Patch &patch = GetPatch(patchX, patchY);
+    PROFILE(EC_Terrain_CreateChunkMesh);
 
     if (!ViewEnabled())
         return;
@@ -1173,153 +1647,420 @@ void EC_Terrain::GenerateTerrainGeometryForOnePatch(uint patchX, uint patchY)
     OgreWorldPtr world = world_.lock();
     Ogre::SceneManager *sceneMgr = world->OgreSceneManager();
 
-    Ogre::SceneNode *node = patch.node;
-    bool firstTimeFill = (node == 0);
-    UNREFERENCED_PARAM(firstTimeFill);
+    Ogre::SceneNode *node = chunk.node;
     if (!node)
     {
-        CreateOgreTerrainPatchNode(node, patch.x, patch.y);
-        patch.node = node;
+        CreateOgreTerrainChunkNode(node, chunk.x, chunk.y);
+        chunk.node = node;
     }
-    assert(node);
+    if (!node)
+        return;
 
     Ogre::MaterialPtr terrainMaterial = Ogre::MaterialManager::getSingleton().getByName(currentMaterial.toStdString().c_str());
     if (!terrainMaterial.get()) // If we could not find the material we were supposed to use, just use the default system terrain material.
         terrainMaterial = OgreRenderer::GetOrCreateLitTexturedMaterial("Rex/TerrainPCF");
 
-    Ogre::ManualObject *manual = sceneMgr->createManualObject(world->GetUniqueObjectName("EC_Terrain_manual"));
-    manual->setCastShadows(false);
+    // Explicitly destroy all attached MovableObjects previously bound to this terrain node, and the previously generated GPU Mesh resource.
+    Ogre::SceneNode::ObjectIterator iter = node->getAttachedObjectIterator();
+    while(iter.hasMoreElements())
+    {
+        Ogre::MovableObject *obj = iter.getNext();
+        sceneMgr->destroyMovableObject(obj);
+    }
+    node->detachAllObjects();
+    chunk.entity = 0;
+    chunk.indexListId = 0xFFFFFFFF;
+    if (chunk.meshGeometryName.length() > 0)
+    {
+        try
+        {
+            Ogre::MeshManager::getSingleton().remove(chunk.meshGeometryName);
+        }
+        catch(...) {}
+    }
+
+    // All LOD levels share the full resolution vertex data: position, normal and the two UV sets, see TerrainVertex.
+    chunk.meshGeometryName = world->GetUniqueObjectName("EC_Terrain_chunkmesh");
+    Ogre::MeshPtr terrainMesh = Ogre::MeshManager::getSingleton().createManual(chunk.meshGeometryName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+    terrainMesh->sharedVertexData = OGRE_NEW Ogre::VertexData();
+    Ogre::VertexDeclaration *decl = terrainMesh->sharedVertexData->vertexDeclaration;
+    size_t offset = 0;
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION).getSize();
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_NORMAL).getSize();
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0).getSize();
+    offset += decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 1).getSize();
+    assert(offset == sizeof(TerrainVertex));
+
+    Ogre::HardwareVertexBufferSharedPtr vertexBuffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+        sizeof(TerrainVertex), vertices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+    vertexBuffer->writeData(0, vertexBuffer->getSizeInBytes(), &vertices[0], true);
+    terrainMesh->sharedVertexData->vertexBufferBinding->setBinding(0, vertexBuffer);
+    terrainMesh->sharedVertexData->vertexStart = 0;
+    terrainMesh->sharedVertexData->vertexCount = vertices.size();
+
+    Ogre::SubMesh *subMesh = terrainMesh->createSubMesh();
+    subMesh->useSharedVertices = true;
+    subMesh->operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+    subMesh->setMaterialName(terrainMaterial->getName());
+
+    chunk.bounds = bounds;
+    SetMeshBounds(terrainMesh.get(), bounds);
+    terrainMesh->load();
+
+    chunk.entity = sceneMgr->createEntity(world->GetUniqueObjectName("EC_Terrain_chunkentity"), chunk.meshGeometryName);
+    chunk.entity->setUserAny(Ogre::Any(static_cast<IComponent *>(this)));
+    chunk.entity->setCastShadows(false);
+    // Set UserAny also on subentities
+    for(uint i = 0; i < chunk.entity->getNumSubEntities(); ++i)
+        chunk.entity->getSubEntity(i)->setUserAny(chunk.entity->getUserAny());
 
-    manual->clear();
-    manual->estimateVertexCount((cPatchSize+1)*(cPatchSize+1));
-    manual->estimateIndexCount((cPatchSize+1)*(cPatchSize+1)*3*2);
-    manual->begin(terrainMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+    // Draw the chunk at its previous level until the levels are updated.
+    const uint edgeLods[TerrainGeometry::NumChunkEdges] = { chunk.lod, chunk.lod, chunk.lod, chunk.lod };
+    SetChunkIndices(chunk, edgeLods);
 
-    const float vertexSpacingX = 1.f;
-    const float vertexSpacingY = 1.f;
-    const float patchSpacingX = cPatchSize * vertexSpacingX;
-    const float patchSpacingY = cPatchSize * vertexSpacingY;
-    const Ogre::Vector3 patchOrigin(patch.x * patchSpacingX, 0.f, patch.y * patchSpacingY);
-// Opensim:    const Ogre::Vector3 patchOrigin(patch.x * patchSpacingX, patch.y * patchSpacingY, 0.f);
+    // Now attach the new built terrain mesh.
+    node->attachObject(chunk.entity);
+}
 
-    int curIndex = 0;
+void EC_Terrain::UpdateChunkVertices(Chunk &chunk, uint minX, uint minY, uint maxX, uint maxY, const std::vector<TerrainVertex> &vertices, const AABB &bounds)
+{
+    if (!chunk.entity)
+        return;
 
-    const int cPatchVertexWidth = cPatchSize; // The number of vertices in the patch in horizontal direction. We use the fixed value of cPatchSize==16.
-    const int cPatchVertexHeight = cPatchSize; // The number of vertices in the patch in vertical  direction. We use the fixed value of cPatchSize==16.
-    // If we assume each patch is 16x16 vertices, then all the internal patches will get a 17x17 grid, since we need to connect seams.
-    // But, the outermost patch row and column at the terrain edge will not have this, since they do not need to connect to a next patch.
-    // This is the vertex stride for the terrain.
-    const int stride = (patch.x + 1 >= patchWidth) ? cPatchVertexWidth : (cPatchVertexWidth+1);
+    Ogre::Mesh *mesh = chunk.entity->getMesh().get();
+    Ogre::HardwareVertexBufferSharedPtr vertexBuffer = mesh->sharedVertexData->vertexBufferBinding->getBuffer(0);
+    const uint stride = geometry.ChunkSize() + 1;
+    const uint rowLength = maxX - minX + 1;
+    if (rowLength == stride) // Whole rows are contiguous in the vertex buffer.
+        vertexBuffer->writeData(minY * stride * sizeof(TerrainVertex), vertices.size() * sizeof(TerrainVertex), &vertices[0]);
+    else
+        for(uint y = minY; y <= maxY; ++y)
+            vertexBuffer->writeData((y * stride + minX) * sizeof(TerrainVertex), rowLength * sizeof(TerrainVertex), &vertices[(y - minY) * rowLength]);
 
-    const float uScale = this->uScale.Get();
-    const float vScale = this->vScale.Get();
+    // The bounds only grow on edits. Slightly loose bounds are cheaper than reading back the rest of the chunk.
+    if (!chunk.bounds.Contains(bounds))
+    {
+        chunk.bounds.Enclose(bounds);
+        SetMeshBounds(mesh, chunk.bounds);
+        if (chunk.node)
+            chunk.node->needUpdate();
+    }
+}
 
-    for(int y = 0; y <= cPatchVertexHeight; ++y)
-        for(int x = 0; x <= cPatchVertexWidth; ++x)
+bool EC_Terrain::ChunkNeedsRegeneration(uint chunkX, uint chunkY) const
+{
+    // The vertices of a chunk are generated from its own patches, the next row and column of patches (seams),
+    // and the previous row and column of patches (normals).
+    const uint firstX = chunkX * chunkPatches > 0 ? chunkX * chunkPatches - 1 : 0;
+    const uint firstY = chunkY * chunkPatches > 0 ? chunkY * chunkPatches - 1 : 0;
+    const uint lastX = min((chunkX + 1) * chunkPatches, patchWidth - 1);
+    const uint lastY = min((chunkY + 1) * chunkPatches, patchHeight - 1);
+
+    bool dirty = false;
+    for(uint y = firstY; y <= lastY; ++y)
+        for(uint x = firstX; x <= lastX; ++x)
         {
-            if ((patch.x + 1 >= patchWidth && x == cPatchVertexWidth) ||
-                (patch.y + 1 >= patchHeight && y == cPatchVertexHeight))
-                continue; // We are at the single corner-most vertex of the whole terrain. That is to be skipped.
-
-            // These coordinates are directly generated to our Ogre coordinate system, i.e. are cycled from OpenSim XYZ -> our YZX.
-            // see OpenSimToOgreCoordinateAxes.
-            Ogre::Vector3 pos;
-            pos.x = vertexSpacingX * x;
-            pos.z = vertexSpacingY * y;
-// Opensim:             pos.x = vertexSpacingX * x;
-// Opensim              pos.y = vertexSpacingY * y;
-
-            EC_Terrain::Patch *thisPatch;
-            int X = x;
-            int Y = y;
-            if (x < cPatchVertexWidth && y < cPatchVertexHeight)
-            {
-                thisPatch = &patch;
+            const Patch &patch = GetPatch(x, y);
+            if (patch.heightData.size() == 0)
+                return false;
+            if (patch.patch_geometry_dirty)
+                dirty = true;
+        }
 
-                if ((patch.x + 1 < patchWidth || x+1 < cPatchVertexWidth) &&
-                    (patch.y + 1 < patchHeight || y+1 < cPatchVertexHeight))
-                {
-                    // Note: winding needs to be flipped when terrain X axis goes along world X axis and terrain Y axis along world Z
-                    manual->index(curIndex+stride);
-                    manual->index(curIndex+1);
-                    manual->index(curIndex);
-
-                    manual->index(curIndex+stride);
-                    manual->index(curIndex+stride+1);
-                    manual->index(curIndex+1);
-                }
-            }
-            else if (x == cPatchVertexWidth && y == cPatchVertexHeight)
-            {
-                thisPatch = &GetPatch(patch.x + 1, patch.y + 1);
-                X = 0;
-                Y = 0;
-            }
-            else if (x == cPatchVertexWidth)
-            {
-                thisPatch = &GetPatch(patch.x + 1, patch.y);
-                X = 0;
-            }
-            else // (y == patchHeight)
+    return dirty;
+}
+
+void EC_Terrain::UpdateChunkLayout()
+{
+    uint newChunkPatches = 1;
+    while(newChunkPatches < cMaxChunkPatches && newChunkPatches < max(patchWidth, patchHeight))
+        newChunkPatches *= 2;
+    const uint newChunksWidth = (patchWidth + newChunkPatches - 1) / newChunkPatches;
+    const uint newChunksHeight = (patchHeight + newChunkPatches - 1) / newChunkPatches;
+
+    if (newChunkPatches != chunkPatches || newChunksWidth != chunksWidth || newChunksHeight != chunksHeight)
+    {
+        Destroy();
+
+        chunkPatches = newChunkPatches;
+        chunksWidth = newChunksWidth;
+        chunksHeight = newChunksHeight;
+        chunks.clear();
+        chunks.resize(chunksWidth * chunksHeight);
+        for(uint y = 0; y < chunksHeight; ++y)
+            for(uint x = 0; x < chunksWidth; ++x)
             {
-                thisPatch = &GetPatch(patch.x, patch.y + 1);
-                Y = 0;
+                chunks[y * chunksWidth + x].x = x;
+                chunks[y * chunksWidth + x].y = y;
             }
 
-            pos.y = thisPatch->heightData[Y*cPatchVertexWidth+X];
-// Opensim:            pos.z = thisPatch->heightData[Y*cPatchVertexWidth+X];
+        DirtyAllTerrainPatches();
+    }
 
-            manual->position(pos);
-            manual->normal(CalculateNormal(thisPatch->x, thisPatch->y, X, Y));
+    geometry.SetSize(VerticesWidth(), VerticesHeight(), chunkPatches * cPatchSize);
+}
 
-            // The UV set 0 contains the diffuse texture UV map. Do a planar mapping with the given specified UV scale.
-            manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.z + pos.z) * vScale);
-// Opensim:             manual->textureCoord((patchOrigin.x + pos.x) * uScale, (patchOrigin.y + pos.y) * vScale);
+void EC_Terrain::SetChunkIndices(Chunk &chunk, const uint edgeLods[TerrainGeometry::NumChunkEdges])
+{
+    if (!chunk.entity)
+        return;
 
-            // The UV set 1 contains the terrain blend mask UV map, which stretches once across the whole terrain.
-            manual->textureCoord((float)(patch.x*cPatchSize + x)/(VerticesWidth()-1), (float)(patch.y*cPatchSize + y)/(VerticesHeight()-1)); 
+    const u32 indexListId = geometry.ChunkIndexListId(chunk.lod, edgeLods);
+    if (indexListId == chunk.indexListId)
+        return;
 
-            ++curIndex;
-        }
+    Ogre::IndexData *&indexData = chunkIndexData[indexListId];
+    if (!indexData)
+    {
+        const std::vector<u16> &indices = geometry.ChunkIndices(indexListId);
+        indexData = OGRE_NEW Ogre::IndexData();
+        indexData->indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(Ogre::HardwareIndexBuffer::IT_16BIT,
+            indices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        indexData->indexBuffer->writeData(0, indexData->indexBuffer->getSizeInBytes(), &indices[0], true);
+        indexData->indexStart = 0;
+        indexData->indexCount = indices.size();
+    }
 
-    manual->end();
+    // The submesh renders whatever its index data refers to, so switching the level only swaps the shared index buffer.
+    Ogre::IndexData *meshIndexData = chunk.entity->getMesh()->getSubMesh(0)->indexData;
+    meshIndexData->indexBuffer = indexData->indexBuffer;
+    meshIndexData->indexStart = indexData->indexStart;
+    meshIndexData->indexCount = indexData->indexCount;
+    chunk.indexListId = indexListId;
+}
 
-    // If there exists a previously generated GPU Mesh resource, delete it before creating a new one.
-    if (patch.meshGeometryName.length() > 0)
+void EC_Terrain::UpdateChunkLods()
+{
+    if (chunks.empty() || world_.expired())
+        return;
+    Ogre::Camera *camera = world_.lock()->VerifyCurrentSceneCamera();
+    if (!camera)
+        return;
+
+    PROFILE(EC_Terrain_UpdateChunkLods);
+
+    const float3 cameraPos = camera->getDerivedPosition();
+    for(size_t i = 0; i < chunks.size(); ++i)
     {
-        try
+        Chunk &chunk = chunks[i];
+        if (!chunk.entity)
+            continue;
+        const Ogre::AxisAlignedBox &box = chunk.entity->getWorldBoundingBox(true);
+        chunk.lod = geometry.LodLevelForDistance(AABB(box.getMinimum(), box.getMaximum()).Distance(cameraPos), lodDistance);
+    }
+
+    // Stitch each chunk to the coarser levels of its neighbours. Chunks without geometry do not need stitching to.
+    for(uint y = 0; y < chunksHeight; ++y)
+        for(uint x = 0; x < chunksWidth; ++x)
         {
-            Ogre::MeshManager::getSingleton().remove(patch.meshGeometryName);
+            Chunk &chunk = chunks[y * chunksWidth + x];
+            if (!chunk.entity)
+                continue;
+            uint edgeLods[TerrainGeometry::NumChunkEdges] = { chunk.lod, chunk.lod, chunk.lod, chunk.lod };
+            if (x > 0 && chunks[y * chunksWidth + x - 1].entity)
+                edgeLods[TerrainGeometry::EdgeNegX] = chunks[y * chunksWidth + x - 1].lod;
+            if (x + 1 < chunksWidth && chunks[y * chunksWidth + x + 1].entity)
+                edgeLods[TerrainGeometry::EdgePosX] = chunks[y * chunksWidth + x + 1].lod;
+            if (y > 0 && chunks[(y - 1) * chunksWidth + x].entity)
+                edgeLods[TerrainGeometry::EdgeNegY] = chunks[(y - 1) * chunksWidth + x].lod;
+            if (y + 1 < chunksHeight && chunks[(y + 1) * chunksWidth + x].entity)
+                edgeLods[TerrainGeometry::EdgePosY] = chunks[(y + 1) * chunksWidth + x].lod;
+            SetChunkIndices(chunk, edgeLods);
         }
-        catch(...) {}
-    }
+}
 
-    patch.meshGeometryName = world->GetUniqueObjectName("EC_Terrain_patchmesh");
-    Ogre::MeshPtr terrainMesh = manual->convertToMesh(patch.meshGeometryName);
+void EC_Terrain::SetLodDistance(float distance)
+{
+    lodDistance = distance;
+    UpdateChunkLods();
+}
 
-    // Odd: destroyManualObject seems to leave behind a memory leak if we don't call manualObject->clear first.
-    manual->clear();
-    sceneMgr->destroyManualObject(manual);
+void EC_Terrain::SetStreamingObservers(const std::vector<float3> &worldPositions)
+{
+    streamingObservers = worldPositions;
+}
 
-    patch.entity = sceneMgr->createEntity(world->GetUniqueObjectName("EC_Terrain_patchentity"), patch.meshGeometryName);
-    patch.entity->setUserAny(Ogre::Any(static_cast<IComponent *>(this)));
-    patch.entity->setCastShadows(false);
-    // Set UserAny also on subentities
-    for(uint i = 0; i < patch.entity->getNumSubEntities(); ++i)
-        patch.entity->getSubEntity(i)->setUserAny(patch.entity->getUserAny());
+void EC_Terrain::SetStreamingRadius(float radius)
+{
+    streamingRadius = radius;
+    if (StreamTiles())
+        RegenerateDirtyTerrainPatches();
+}
 
-    // Explicitly destroy all attached MovableObjects previously bound to this terrain node.
-    Ogre::SceneNode::ObjectIterator iter = node->getAttachedObjectIterator();
-    while(iter.hasMoreElements())
+void EC_Terrain::StopStreaming()
+{
+    if (!streamingAsset)
+        return;
+
+    for(size_t i = 0; i < loadedTiles.size(); ++i)
+        if (!loadedTiles[i])
+            LoadTile(i % streamingAsset->TilesWidth(), i / streamingAsset->TilesWidth());
+    streamingAsset.reset();
+    loadedTiles.clear();
+}
+
+void EC_Terrain::LoadFromTileAsset(const TerrainTileAssetPtr &asset)
+{
+    if (!asset->IsLoaded())
+        return;
+
+    Destroy();
+
+    streamingAsset = asset;
+    loadedTiles.assign(asset->TilesWidth() * asset->TilesHeight(), false);
+    heightGrid.reset();
+    heightGridRangeValid = false;
+    loadEditedMinX = loadEditedMinY = 0xFFFFFFFF;
+    loadEditedMaxX = loadEditedMaxY = 0;
+    patchWidth = asset->PatchWidth();
+    patchHeight = asset->PatchHeight();
+    // The patches start out not loaded, i.e. with empty height data.
+    patches.clear();
+    patches.resize(patchWidth * patchHeight);
+    for(uint y = 0; y < patchHeight; ++y)
+        for(uint x = 0; x < patchWidth; ++x)
+        {
+            patches[y * patchWidth + x].x = x;
+            patches[y * patchWidth + x].y = y;
+        }
+
+    StreamTiles();
+    RegenerateDirtyTerrainPatches();
+
+    // Like in LoadFromDataInMemory, the size only needs to be changed locally, since the other peers load the same asset.
+    this->xPatches.Set(patchWidth, AttributeChange::Disconnected);
+    this->yPatches.Set(patchHeight, AttributeChange::Disconnected);
+
+    this->xPatches.Changed(AttributeChange::LocalOnly);
+    this->yPatches.Changed(AttributeChange::LocalOnly);
+}
+
+void EC_Terrain::UpdateStreaming(float frametime)
+{
+    if (!streamingAsset)
+        return;
+
+    // Observers move slowly compared to the tile size, so there is no need to check the tiles every frame.
+    const float cStreamingUpdatePeriod = 0.25f;
+    streamingUpdateAcc += frametime;
+    if (streamingUpdateAcc < cStreamingUpdatePeriod)
+        return;
+    streamingUpdateAcc = 0.f;
+
+    if (StreamTiles())
+        RegenerateDirtyTerrainPatches();
+}
+
+bool EC_Terrain::StreamTiles()
+{
+    if (!streamingAsset)
+        return false;
+
+    PROFILE(EC_Terrain_StreamTiles);
+
+    std::vector<float3> observers = streamingObservers;
+    if (observers.empty() && !world_.expired())
     {
-        Ogre::MovableObject *obj = iter.getNext();
-        sceneMgr->destroyMovableObject(obj);
+        Ogre::Camera *camera = world_.lock()->VerifyCurrentSceneCamera();
+        if (camera)
+            observers.push_back(camera->getDerivedPosition());
     }
-    node->detachAllObjects();
-    // Now attach the new built terrain mesh.
-    node->attachObject(patch.entity);
 
-    patch.patch_geometry_dirty = false;
+    // The terrain grid lies on the local XZ plane of the terrain.
+    float3x4 worldToLocal = LocalToWorld();
+    worldToLocal.Inverse();
+    for(size_t i = 0; i < observers.size(); ++i)
+        observers[i] = worldToLocal.MulPos(observers[i]);
+
+    // Unloading only well outside the radius keeps the tiles on the border from being loaded and unloaded repeatedly.
+    const float cUnloadRadiusFactor = 1.25f;
+    const float tileSize = (float)(streamingAsset->TilePatches() * cPatchSize);
+    bool changed = false;
+    for(uint ty = 0; ty < streamingAsset->TilesHeight(); ++ty)
+        for(uint tx = 0; tx < streamingAsset->TilesWidth(); ++tx)
+        {
+            float distance = observers.empty() ? 0.f : std::numeric_limits<float>::max();
+            for(size_t i = 0; i < observers.size(); ++i)
+            {
+                const float dx = max(max(tx * tileSize - observers[i].x, observers[i].x - (tx + 1) * tileSize), 0.f);
+                const float dy = max(max(ty * tileSize - observers[i].z, observers[i].z - (ty + 1) * tileSize), 0.f);
+                distance = min(distance, sqrtf(dx * dx + dy * dy));
+            }
+
+            const bool loaded = loadedTiles[ty * streamingAsset->TilesWidth() + tx];
+            if (!loaded && distance <= streamingRadius)
+            {
+                LoadTile(tx, ty);
+                changed = true;
+            }
+            else if (loaded && distance > streamingRadius * cUnloadRadiusFactor)
+            {
+                UnloadTile(tx, ty);
+                changed = true;
+            }
+        }
+
+    return changed;
+}
+
+void EC_Terrain::LoadTile(uint tileX, uint tileY)
+{
+    std::vector<float> tile;
+    if (!streamingAsset->ReadTile(tileX, tileY, tile))
+        return;
+    loadedTiles[tileY * streamingAsset->TilesWidth() + tileX] = true;
+
+    const uint tilePatches = streamingAsset->TilePatches();
+    const uint patchValues = cPatchSize * cPatchSize;
+    for(uint py = 0; py < tilePatches; ++py)
+        for(uint px = 0; px < tilePatches; ++px)
+        {
+            const uint x = tileX * tilePatches + px;
+            const uint y = tileY * tilePatches + py;
+            if (x >= patchWidth || y >= patchHeight)
+                continue;
+            Patch &patch = GetPatch(x, y);
+            const float *src = &tile[(py * tilePatches + px) * patchValues];
+            patch.heightData.assign(src, src + patchValues);
+            patch.patch_geometry_dirty = true;
+        }
+
+    // The height grid and its range already hold the asset values of the tile, see UnloadTile, so they do not change.
+}
+
+void EC_Terrain::UnloadTile(uint tileX, uint tileY)
+{
+    loadedTiles[tileY * streamingAsset->TilesWidth() + tileX] = false;
+
+    float tileMin, tileMax;
+    streamingAsset->TileHeightRange(tileX, tileY, tileMin, tileMax);
+
+    const uint tilePatches = streamingAsset->TilePatches();
+    for(uint py = 0; py < tilePatches; ++py)
+        for(uint px = 0; px < tilePatches; ++px)
+        {
+            const uint x = tileX * tilePatches + px;
+            const uint y = tileY * tilePatches + py;
+            if (x >= patchWidth || y >= patchHeight)
+                continue;
+            Patch &patch = GetPatch(x, y);
+            // Edits to the tile are discarded, and the grid reverts to the asset values. The range may shrink if an edited value was one of its ends.
+            for(size_t i = 0; heightGridRangeValid && i < patch.heightData.size(); ++i)
+                if (patch.heightData[i] <= heightGridMin || patch.heightData[i] >= heightGridMax)
+                    heightGridRangeValid = false;
+            if (heightGridRangeValid)
+            {
+                heightGridMin = min(heightGridMin, tileMin);
+                heightGridMax = max(heightGridMax, tileMax);
+            }
+            std::vector<float>().swap(patch.heightData); // Release the memory, clear() would keep it reserved.
+            patch.patch_geometry_dirty = true;
+            // The chunk can not be drawn without all of its patches. It is regenerated once they are all loaded again.
+            DestroyPatch(x, y);
+        }
+
+    const uint tileSize = tilePatches * cPatchSize;
+    UpdateHeightGrid(tileX * tileSize, tileY * tileSize, (tileX + 1) * tileSize - 1, (tileY + 1) * tileSize - 1);
 }
 
 void EC_Terrain::CreateRootNode()
@@ -1341,7 +2082,7 @@ void EC_Terrain::CreateRootNode()
     UpdateRootNodeTransform();
 }
 
-void EC_Terrain::CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, uint patchX, uint patchY)
+void EC_Terrain::CreateOgreTerrainChunkNode(Ogre::SceneNode *&node, uint chunkX, uint chunkY)
 {
     if (world_.expired())
         return;
@@ -1354,7 +2095,7 @@ void EC_Terrain::CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, uint patchX,
     if (!rootNode)
         CreateRootNode();
 
-    QString name = QString("EC_Terrain_Patch_") + QString::number(patchX) + "_" + QString::number(patchY);
+    QString name = QString("EC_Terrain_Chunk_") + QString::number(chunkX) + "_" + QString::number(chunkY);
     node = sceneMgr->createSceneNode(world->GetUniqueObjectName(name.toStdString()));
     if (!node)
         return;
@@ -1366,11 +2107,11 @@ void EC_Terrain::CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, uint patchX,
     
     const float vertexSpacingX = 1.f;
     const float vertexSpacingY = 1.f;
-    const float patchSpacingX = 16 * vertexSpacingX;
-    const float patchSpacingY = 16 * vertexSpacingY;
-    const Ogre::Vector3 patchOrigin(patchX * patchSpacingX, 0.f, patchY * patchSpacingY);
+    const float chunkSpacingX = chunkPatches * cPatchSize * vertexSpacingX;
+    const float chunkSpacingY = chunkPatches * cPatchSize * vertexSpacingY;
+    const Ogre::Vector3 chunkOrigin(chunkX * chunkSpacingX, 0.f, chunkY * chunkSpacingY);
 
-    node->setPosition(patchOrigin);
+    node->setPosition(chunkOrigin);
 }
 
 float EC_Terrain::GetTerrainMinHeight() const
@@ -1381,6 +2122,15 @@ float EC_Terrain::GetTerrainMinHeight() const
         for(size_t j = 0; j < patches[i].heightData.size(); ++j)
             minHeight = min(minHeight, patches[i].heightData[j]);
 
+    // The tiles of a streamed terrain that are not loaded store their height range.
+    for(size_t i = 0; i < loadedTiles.size(); ++i)
+        if (!loadedTiles[i])
+        {
+            float tileMin, tileMax;
+            streamingAsset->TileHeightRange(i % streamingAsset->TilesWidth(), i / streamingAsset->TilesWidth(), tileMin, tileMax);
+            minHeight = min(minHeight, tileMin);
+        }
+
     return minHeight;
 }
 
@@ -1392,17 +2142,47 @@ float EC_Terrain::GetTerrainMaxHeight() const
         for(size_t j = 0; j < patches[i].heightData.size(); ++j)
             maxHeight = max(maxHeight, patches[i].heightData[j]);
 
+    for(size_t i = 0; i < loadedTiles.size(); ++i)
+        if (!loadedTiles[i])
+        {
+            float tileMin, tileMax;
+            streamingAsset->TileHeightRange(i % streamingAsset->TilesWidth(), i / streamingAsset->TilesWidth(), tileMin, tileMax);
+            maxHeight = max(maxHeight, tileMax);
+        }
+
     return maxHeight;
 }
 
 void EC_Terrain::Resize(uint newWidth, uint newHeight, uint oldPatchStartX, uint oldPatchStartY)
 {
+    StopStreaming();
+    heightGrid.reset();
+    heightGridRangeValid = false;
+
     std::vector<Patch> newPatches(newWidth * newHeight);
     for(uint y = 0; y < newHeight && y + oldPatchStartY < yPatches.Get(); ++y)
         for(uint x = 0; x < newWidth && x + oldPatchStartX < xPatches.Get(); ++x)
             newPatches[y * newWidth + x] = patches[(y + oldPatchStartY) * xPatches.Get() + x + oldPatchStartX];
 
     patches = newPatches;
+    // The edited heights move along with the patches.
+    if (loadEditedMinX <= loadEditedMaxX)
+    {
+        const uint startX = oldPatchStartX * cPatchSize;
+        const uint startY = oldPatchStartY * cPatchSize;
+        if (loadEditedMaxX < startX || loadEditedMaxY < startY)
+        {
+            loadEditedMinX = loadEditedMinY = 0xFFFFFFFF;
+            loadEditedMaxX = loadEditedMaxY = 0;
+        }
+        else
+        {
+            loadEditedMinX = max(loadEditedMinX, startX) - startX;
+            loadEditedMinY = max(loadEditedMinY, startY) - startY;
+            loadEditedMaxX -= startX;
+            loadEditedMaxY -= startY;
+        }
+    }
     xPatches.Set(newWidth, AttributeChange::Disconnected);
     yPatches.Set(newHeight, AttributeChange::Disconnected);
     patchWidth = newWidth;
@@ -1433,38 +2213,62 @@ void EC_Terrain::RegenerateDirtyTerrainPatches()
     EC_Placeable *position = parentEntity->GetComponent<EC_Placeable>().get();
     if (!GetFramework()->IsHeadless() && (!position || position->visible.Get())) // Only need to create GPU resources if the placeable itself is visible.
     {
-        for(uint y = 0; y < patchHeight; ++y)
-            for(uint x = 0; x < patchWidth; ++x)
+        UpdateChunkLayout();
+
+        // Chunks with dirty patches are generated as a whole. Chunks that only have edited vertices are updated in place.
+        std::vector<ChunkVertexJob> jobs;
+        for(uint y = 0; y < chunksHeight; ++y)
+            for(uint x = 0; x < chunksWidth; ++x)
             {
-                EC_Terrain::Patch &scenePatch = GetPatch(x, y);
-                if (!scenePatch.patch_geometry_dirty || scenePatch.heightData.size() == 0)
+                const Chunk &chunk = chunks[y * chunksWidth + x];
+                ChunkVertexJob job;
+                job.chunkIndex = y * chunksWidth + x;
+                if (ChunkNeedsRegeneration(x, y))
+                {
+                    job.wholeChunk = true;
+                    job.maxX = job.maxY = geometry.ChunkSize();
+                }
+                else if (chunk.entity && chunk.dirtyMinX <= chunk.dirtyMaxX)
+                {
+                    job.minX = chunk.dirtyMinX;
+                    job.minY = chunk.dirtyMinY;
+                    job.maxX = chunk.dirtyMaxX;
+                    job.maxY = chunk.dirtyMaxY;
+                }
+                else
                     continue;
+                jobs.push_back(job);
+            }
 
-                bool neighborsLoaded = true;
+        if (!jobs.empty())
+        {
+            PROFILE(EC_Terrain_GenerateChunkVertices);
+            PatchHeightSource heights(*this);
+            ChunkVertexBatch batch(geometry, heights, &chunks[0], uScale.Get(), vScale.Get(), jobs);
+            batch.Run();
+        }
 
-                const int neighbors[8][2] = 
-                { 
-                    { -1, -1 }, { -1, 0 }, { -1, 1 },
-                    {  0, -1 },            {  0, 1 },
-                    {  1, -1 }, {  1, 0 }, {  1, 1 }
-                };
+        std::vector<bool> regenerated(chunks.size(), false);
+        for(size_t i = 0; i < jobs.size(); ++i)
+        {
+            Chunk &chunk = chunks[jobs[i].chunkIndex];
+            if (jobs[i].wholeChunk)
+            {
+                CreateChunkMesh(chunk, jobs[i].vertices, jobs[i].bounds);
+                regenerated[jobs[i].chunkIndex] = true;
+            }
+            else
+                UpdateChunkVertices(chunk, jobs[i].minX, jobs[i].minY, jobs[i].maxX, jobs[i].maxY, jobs[i].vertices, jobs[i].bounds);
+            chunk.ClearDirtyVertices();
+        }
 
-                for(uint i = 0; i < 8; ++i)
-                {
-                    uint nX = x + neighbors[i][0];
-                    uint nY = y + neighbors[i][1];
-                    if (nX >= 0 && nX < patchWidth &&
-                        nY >= 0 && nY < patchHeight &&
-                        GetPatch(nX, nY).heightData.size() == 0)
-                    {
-                        neighborsLoaded = false;
-                        break;
-                    }
-                }
+        // A patch stays dirty until its own chunk has been regenerated. The chunks of the neighboring patches may have been regenerated already.
+        for(uint y = 0; y < patchHeight; ++y)
+            for(uint x = 0; x < patchWidth; ++x)
+                if (regenerated[(y / chunkPatches) * chunksWidth + x / chunkPatches])
+                    GetPatch(x, y).patch_geometry_dirty = false;
 
-                if (neighborsLoaded)
-                    GenerateTerrainGeometryForOnePatch(x, y);
-            }
+        UpdateChunkLods();
     }
     
     // All the new geometry we created will be visible for Ogre by default. If the EC_Placeable's visible attribute is false,
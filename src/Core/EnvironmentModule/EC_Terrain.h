@@ -10,8 +10,13 @@
 #include "AssetFwd.h"
 #include "AssetRefListener.h"
 #include "OgreModuleFwd.h"
+#include "TerrainGeometry.h"
+#include "TerrainTileAsset.h"
 
-namespace Ogre { class Matrix4; }
+#include <map>
+#include <QVector>
+
+namespace Ogre { class Matrix4; class IndexData; }
 
 /// Adds a heightmap-based terrain to the scene.
 /** <table class="header">
@@ -20,7 +25,12 @@ namespace Ogre { class Matrix4; }
     <td>
     <h2>Terrain</h2>
     Adds a heightmap-based terrain to the scene. A Terrain is composed of a rectangular grid of adjacent "patches".
-    Each patch is a fixed-size 16x16 height map.
+    Each patch is a fixed-size 16x16 height map. For rendering, the patches are grouped into square chunks of up to 4x4 patches,
+    which are drawn with a level of detail that depends on their distance to the active camera, see SetLodDistance.
+
+    If the height map is a tiled terrain asset (.ntt, see TerrainTileAsset), the terrain is streamed: only the patches around the
+    active camera, or around the observers of the clients on a server, are kept loaded. See SetStreamingRadius. The heightfield
+    collision shapes use HeightGrid, which reads the patches that are not loaded from the asset, so the physics always sees the whole terrain.
 
     Registered by EnvironmentComponents plugin.
 
@@ -96,15 +106,18 @@ public:
     /// Each patch is a square containing this many vertices per side.
     static const uint cPatchSize = 16;
 
+    /// The maximum number of patches per chunk side.
+    static const uint cMaxChunkPatches = 4;
+
     /// Describes a single patch that is present in the scene.
     /** A patch can be in one of the following three states:
-        - not loaded. The height data nor the GPU data is present, but the Patch struct itself is initialized. heightData.size() == 0, node == entity == 0. meshGeometryName == "".
-        - heightmap data loaded. The heightData vector contains the heightmap data, but the visible GPU vertex data itself has not been generated yet, due to the neighbors
-          of this patch not being present yet. node == entity == 0, meshGeometryName == "". patch_geometry_dirty == true.
-        - fully loaded. The GPU data is also loaded and the node, entity and meshGeometryName fields specify the used GPU resources. */
+        - not loaded. The height data is not present, but the Patch struct itself is initialized. heightData.size() == 0.
+        - heightmap data loaded. The heightData vector contains the heightmap data, but the GPU geometry of the chunk of this patch has not been generated yet,
+          due to the neighbors of this patch not being present yet. patch_geometry_dirty == true.
+        - fully loaded. The GPU data of the chunk of this patch is also loaded, see Chunk. */
     struct Patch
     {
-        Patch():x(0),y(0), node(0), entity(0), patch_geometry_dirty(true) {}
+        Patch():x(0),y(0), patch_geometry_dirty(true) {}
 
         /// X-coordinate on the grid of patches. In the range [0, EC_Terrain::PatchWidth()].
         uint x;
@@ -116,15 +129,6 @@ public:
         /// If the length is zero, this patch hasn't been loaded in yet.
         std::vector<float> heightData;
 
-        /// Ogre -specific: Store a reference to the actual render hierarchy node.
-        Ogre::SceneNode *node;
-
-        /// Ogre -specific: Store a reference to the entity that is attached to the above SceneNode.
-        Ogre::Entity *entity;
-
-        /// The name of the Ogre Mesh resource that contains the GPU geometry data for this patch.
-        std::string meshGeometryName;
-
         /// If true, the CPU-side heightmap data has changed, but we haven't yet updated
         /// the GPU-side geometry resources since the neighboring patches haven't been loaded
         /// in yet.
@@ -134,6 +138,111 @@ public:
         float GetHeightValue(uint x, uint y) const { return heightData[y*cPatchSize+x]; }
     };
     
+    /// Describes the GPU resources of a square group of adjacent patches, which is drawn as a single batch.
+    /** All LOD levels of a chunk use the same full resolution vertex data. The LOD level is changed by changing the index data of the mesh,
+        which is shared by all chunks with the same LOD level and the same levels of the neighbouring chunks, see TerrainGeometry. */
+    struct Chunk
+    {
+        Chunk() : x(0), y(0), node(0), entity(0), lod(0), indexListId(0xFFFFFFFF) { ClearDirtyVertices(); }
+
+        /// X-coordinate on the grid of chunks. In the range [0, EC_Terrain::ChunksWidth()[.
+        uint x;
+
+        /// Y-coordinate on the grid of chunks. In the range [0, EC_Terrain::ChunksHeight()[.
+        uint y;
+
+        /// Ogre -specific: Store a reference to the actual render hierarchy node.
+        Ogre::SceneNode *node;
+
+        /// Ogre -specific: Store a reference to the entity that is attached to the above SceneNode. Null if the geometry has not been generated.
+        Ogre::Entity *entity;
+
+        /// The name of the Ogre Mesh resource that contains the GPU geometry data for this chunk.
+        std::string meshGeometryName;
+
+        /// The current LOD level of this chunk.
+        uint lod;
+
+        /// Id of the index list the mesh currently uses, see TerrainGeometry::ChunkIndexListId.
+        u32 indexListId;
+
+        /// Bounds of the vertex positions, relative to the chunk node.
+        AABB bounds;
+
+        /// The rectangle of the chunk vertex grid that has been edited since the mesh was last updated. Empty if dirtyMinX > dirtyMaxX.
+        uint dirtyMinX, dirtyMinY, dirtyMaxX, dirtyMaxY;
+
+        /// Marks the whole vertex grid of this chunk clean.
+        void ClearDirtyVertices() { dirtyMinX = dirtyMinY = 0xFFFFFFFF; dirtyMaxX = dirtyMaxY = 0; }
+    };
+
+    /// @return The chunk at given (x,y) coordinates. Pass in values in range [0, ChunksWidth()/ChunksHeight()[. Read only.
+    const Chunk &GetChunk(uint chunkX, uint chunkY) const
+    {
+        assert(chunkX < chunksWidth);
+        assert(chunkY < chunksHeight);
+        return chunks[chunkY * chunksWidth + chunkX];
+    }
+
+    /// Returns how many chunks there currently are in the terrain in the x-direction.
+    uint ChunksWidth() const { return chunksWidth; }
+
+    /// Returns how many chunks there currently are in the terrain in the y-direction.
+    uint ChunksHeight() const { return chunksHeight; }
+
+    /// Sets the world positions around which a streamed terrain is kept loaded.
+    /** Used on servers, which do not have a camera, with the observer positions of the clients. If no positions are set,
+        the active camera is used. If there is no camera either, the whole terrain is loaded. */
+    void SetStreamingObservers(const std::vector<float3> &worldPositions);
+
+    /// Reads the height values of a rectangle of terrain map vertices.
+    /** @param dest [out] Receives width*height height values in row-major order. The vertices of the patches that are not loaded,
+            or that lie outside the terrain, read as NaN. */
+    void GetHeights(uint minX, uint minY, uint width, uint height, float *dest) const;
+
+    /// Sets the height values of a rectangle of terrain map vertices. Works like SetPointHeight for each vertex.
+    /** If the height map asset is still loading, the height values are also kept and set again after it has loaded, so that edits
+        received from the network before the height map are not lost.
+        @param heights width*height height values in row-major order. NaN values, and the vertices of the patches that are not loaded,
+            are skipped. */
+    void SetHeights(uint minX, uint minY, uint width, uint height, const float *heights, AttributeChange::Type change = AttributeChange::Default);
+
+    /// Returns the rectangle of terrain map vertices that has been edited with replicated changes since the previous call, and clears it.
+    /** Used by the scene synchronization to send the edited height values to the other participants, see HeightsEdited.
+        @return False if no height values have been edited. */
+    bool TakeEditedHeights(uint &minX, uint &minY, uint &maxX, uint &maxY);
+
+    /// Returns the rectangle of terrain map vertices that has been edited since the height map was loaded.
+    /** Covers the edits made with replicated changes and the ones added with AddEditedHeightsSinceLoad. Unlike TakeEditedHeights, this
+        is not cleared, so that the server can send the edited height values to the users that join later.
+        @return False if no height values have been edited. */
+    bool EditedHeightsSinceLoad(uint &minX, uint &minY, uint &maxX, uint &maxY) const;
+
+    /// Adds a rectangle of terrain map vertices to EditedHeightsSinceLoad.
+    /** Used by the scene synchronization for the edits received from the network, which are applied locally. */
+    void AddEditedHeightsSinceLoad(uint minX, uint minY, uint maxX, uint maxY);
+
+    /// Returns the height values of all terrain map vertices in row-major order, VerticesWidth() values per row.
+    /** The grid is built on the first call and kept up to date in place while someone holds the pointer, so users like the heightfield
+        collision shapes can refer to it directly instead of copying it. The vertices of the patches of a streamed terrain that are not
+        loaded are read from the asset, so the grid always holds the whole terrain.
+        When the terrain is resized or reloaded, the grid is dropped, and the old grid stays valid for the holders of the pointer until they
+        call this again. TerrainRegenerated is emitted after both. The grid is released when its last holder drops it, so a streamed terrain
+        keeps only its loaded patches in memory unless the grid is in use. */
+    shared_ptr<const std::vector<float> > HeightGrid() const;
+
+    /// Returns the range of the height values in the grid returned by HeightGrid.
+    /** The range is kept up to date as the heights are edited, and the terrain is only scanned again after the range may have shrunk. */
+    void HeightGridRange(float &minHeight, float &maxHeight) const;
+
+    /// Returns the points on the terrain under the given world space positions, and optionally the surface normals at them.
+    /** Works like GetPointOnMap and GetPlaneNormal for each position, but is much faster for large numbers of positions, e.g. for
+        placing objects on the terrain. Does not need the rendering subsystem, so it also works on a headless server.
+        @param worldPositions The positions in world space. They are projected to the terrain along its up axis.
+        @param pointsOnMap [out] Receives count points on the terrain surface in world space.
+        @param normals [out] If not null, receives count unit normals of the terrain surface in world space. */
+    void GetPointsOnMap(const float3 *worldPositions, size_t count, float3 *pointsOnMap, float3 *normals = 0) const;
+
     /// @return The patch at given (x,y) coordinates. Pass in values in range [0, PatchWidth()/PatchHeight[.
     Patch &GetPatch(uint patchX, uint patchY)
     {
@@ -176,26 +285,42 @@ public slots:
     {
         for(uint y = 0; y < patchHeight; ++y)
             for(uint x = 0; x < patchWidth; ++x)
-                if (!PatchExists(x,y) || GetPatch(x,y).heightData.size() == 0 || GetPatch(x,y).node == 0)
+            {
+                if (!PatchExists(x,y) || GetPatch(x,y).heightData.size() == 0)
+                    return false;
+                const uint chunkIndex = (y / chunkPatches) * chunksWidth + x / chunkPatches;
+                if (chunkIndex >= chunks.size() || chunks[chunkIndex].node == 0)
                     return false;
+            }
 
         return true;
     }
 
     /// Returns the height value on the given terrain grid point.
+    /// The points of the patches that are not loaded, e.g. outside the streaming radius of a streamed terrain, read as zero.
     /// @param x In the range [0, EC_Terrain::PatchWidth * EC_Terrain::cPatchSize [.
     /// @param y In the range [0, EC_Terrain::PatchHeight * EC_Terrain::cPatchSize [.
     float GetPoint(uint x, uint y) const;
 
-    /// Sets a new height value to the given terrain map vertex. Marks the patch that vertex is part of dirty,
+    /// Sets a new height value to the given terrain map vertex. Marks the vertex and its neighbors dirty,
     /// but does not immediately recreate the GPU surfaces. Use the RegenerateDirtyTerrainPatches() function
-    /// to regenerate the visible Ogre mesh geometry.
-    void SetPointHeight(uint x, uint y, float height);
+    /// to update the visible Ogre mesh geometry, which only rewrites the vertices that have been edited.
+    /// If the change is replicated, the edited height values are sent to the other participants of the scene
+    /// without re-uploading the height map asset. Note that the height map asset is not modified: save and upload it
+    /// to keep the edits for the clients that connect later.
+    void SetPointHeight(uint x, uint y, float height, AttributeChange::Type change = AttributeChange::Default);
     
     /// Returns the point on the terrain in world space that lies on top of the given world space coordinate.
     /// @param point The point in world space to get the corresponding map point (in world space) for.
     float3 GetPointOnMap(const float3 &point) const;
 
+    /// Returns the terrain surface heights and normals at a batch of world space positions. See GetPointsOnMap.
+    /** Use to query a large number of positions at once instead of calling GetPointOnMap for each of them.
+        @param worldXZ Two numbers per position: the world x and z coordinates.
+        @return Four numbers per position, in the same order as the positions: the world y coordinate of the terrain surface,
+        and the world space normal x, y, z of the surface. */
+    QVector<float> GetHeightsAndNormals(const QVector<float> &worldXZ) const;
+
     /// Returns the point on the terrain in local space that lies on top of the given world space coordinate.
     /// @param point The point in world space to get the corresponding map point (in local space of the terrain) for.
     float3 GetPointOnMapLocal(const float3 &point) const;
@@ -256,9 +381,31 @@ public slots:
     /// Removes all stored terrain patches and the associated Ogre scene nodes.
     void Destroy();
 
-    /// Releases all GPU resources used for the given patch.
+    /// Releases all GPU resources used for the chunk the given patch belongs to.
     void DestroyPatch(uint patchX, uint patchY);
 
+    /// Sets the distance from the camera, in world units, up to which the terrain is drawn at full resolution.
+    /** Each further LOD level is used up to twice the distance of the previous level. Zero disables the LOD. The default is 64. */
+    void SetLodDistance(float distance);
+
+    /// Returns the distance up to which the terrain is drawn at full resolution.
+    float LodDistance() const { return lodDistance; }
+
+    /// Returns true if the height map is streamed from a tiled terrain asset.
+    bool IsStreaming() const { return streamingAsset != 0; }
+
+    /// Sets the radius around the observers, in terrain grid units, inside which the patches of a streamed terrain are kept loaded.
+    /** The patches are loaded a tile at a time, and unloaded once they are farther than 1.25 times the radius, so the memory use
+        is bounded by the radius. The default is read from the "terrain streaming radius" key of the framework config, or 512. */
+    void SetStreamingRadius(float radius);
+
+    /// Returns the radius inside which the patches of a streamed terrain are kept loaded.
+    float StreamingRadius() const { return streamingRadius; }
+
+    /// Loads all the tiles of a streamed terrain and stops streaming.
+    /** Call this before editing a streamed terrain, since edits to the patches are lost when the patches are unloaded. */
+    void StopStreaming();
+
     /// Makes all the vertices of the given patch flat with the given height value.
     /** Dirties the patch, but does not regenerate it. */
     void MakePatchFlat(uint patchX, uint patchY, float heightValue);
@@ -309,6 +456,14 @@ public slots:
     /// Loads the terrain height map data from the given in-memory .ntf file buffer.
     bool LoadFromDataInMemory(const char *data, size_t numBytes);
 
+    /// Saves the terrain height map data to the given file in the tiled format (.ntt), which can be streamed. See TerrainTileAsset.
+    bool SaveToTileFile(QString filename);
+
+    /// Converts a .ntf terrain file to the tiled format (.ntt) without loading it to this terrain. See TerrainTileAsset::ConvertFromNtf.
+    /** @param tilePatches Number of patches per tile side. 0 uses TerrainTileAsset::cDefaultTilePatches.
+        @return True if the conversion succeeded. */
+    bool ConvertNtfToTileFile(QString ntfFilename, QString destFilename, uint tilePatches = 0);
+
     void NormalizeImage(QString filename) const;
 
     /// Loads the terrain from the given image file.
@@ -348,6 +503,12 @@ public slots:
     /// Marks all terrain patches dirty.
     void DirtyAllTerrainPatches();
 
+    /// Marks the geometry of the given rectangle of terrain map vertices dirty, including the maximum row and column.
+    /** Call this after editing height values without SetPointHeight. RegenerateDirtyTerrainPatches() then only rewrites
+        the edited vertices and their neighbors in the existing GPU geometry, instead of regenerating whole patches. */
+    void DirtyTerrainVertices(uint minX, uint minY, uint maxX, uint maxY);
+
+    /// Updates the GPU geometry of the dirty patches and the dirty vertices. The vertices are generated in parallel.
     void RegenerateDirtyTerrainPatches();
 
     /// Returns the minimum height value in the whole terrain.
@@ -367,6 +528,13 @@ signals:
     /// Emitted when the terrain data is regenerated.
     void TerrainRegenerated();
 
+    /// Emitted when height values are edited with a replicated change, and the previous edits have already been taken with TakeEditedHeights.
+    void HeightsEdited();
+
+    /// Emitted before the height values in the grid returned by HeightGrid are edited in place.
+    /** The holders of the grid that read it from other threads, like the physics simulation, must stop reading it before returning. */
+    void HeightGridAboutToChange();
+
 private slots:
     /// Emitted when the parrent entity has been set.
     void UpdateSignals();
@@ -374,6 +542,12 @@ private slots:
     void MaterialAssetLoaded(AssetPtr asset);
     void TerrainAssetLoaded(AssetPtr asset);
 
+    /// Selects the LOD levels of the chunks from their distance to the active camera, and stitches the chunks to their neighbours.
+    void UpdateChunkLods();
+
+    /// Loads and unloads the tiles of a streamed terrain around the observers periodically.
+    void UpdateStreaming(float frametime);
+
     /// (Re)checks whether this entity has EC_Placeable (or if it was just added or removed), and reparents the rootNode of this component to it or the scene root.
     /** Additionally re-applies the visibility of each terrain patch that is currently attached to the terrain node. */
     void AttachTerrainRootNode();
@@ -385,10 +559,10 @@ private:
     /** After this function returns, the 'root' member node will exist, unless Ogre rendering subsystem fails. */
     void CreateRootNode();
 
-    void CreateOgreTerrainPatchNode(Ogre::SceneNode *&node, uint patchX, uint patchY);
+    void CreateOgreTerrainChunkNode(Ogre::SceneNode *&node, uint chunkX, uint chunkY);
 
-    /// Sets the given patch to use the currently set material and textures.
-    void UpdateTerrainPatchMaterial(uint patchX, uint patchY);
+    /// Sets the given chunk to use the currently set material and textures.
+    void UpdateTerrainChunkMaterial(Chunk &chunk);
 
     /// Updates the root node transform from the current attribute values, if the root node exists.
     void UpdateRootNodeTransform();
@@ -403,9 +577,59 @@ private:
     /// @param textureName The Ogre texture resource name to set.
     void SetTerrainMaterialTexture(uint index, const QString &textureName);
 
-    /// Creates Ogre geometry data for the single given patch, or updates the geometry for an existing
-    /// patch if the associated Ogre resources already exist.
-    void GenerateTerrainGeometryForOnePatch(uint patchX, uint patchY);
+    /// Creates the Ogre geometry for the given chunk from its vertices, replacing the existing Ogre resources of the chunk.
+    void CreateChunkMesh(Chunk &chunk, const std::vector<TerrainVertex> &vertices, const AABB &bounds);
+
+    /// Writes the given rectangle of the chunk vertex grid to the existing Ogre geometry of the chunk.
+    void UpdateChunkVertices(Chunk &chunk, uint minX, uint minY, uint maxX, uint maxY, const std::vector<TerrainVertex> &vertices, const AABB &bounds);
+
+    /// Returns true if any patch the vertices of the given chunk are generated from is dirty, and all of them are loaded.
+    bool ChunkNeedsRegeneration(uint chunkX, uint chunkY) const;
+
+    /// Recomputes the size and the number of the chunks from the current number of patches.
+    /** If the layout changes, releases the GPU resources of all chunks and dirties all patches. */
+    void UpdateChunkLayout();
+
+    /// Releases all GPU resources used for the given chunk.
+    void DestroyChunk(Chunk &chunk);
+
+    /// Sets the index data of the given chunk to draw it at its current LOD level, stitched to the given levels of its neighbours.
+    void SetChunkIndices(Chunk &chunk, const uint edgeLods[TerrainGeometry::NumChunkEdges]);
+
+    /// Starts streaming the terrain from the given tiled terrain asset, replacing the current height map.
+    void LoadFromTileAsset(const TerrainTileAssetPtr &asset);
+
+    /// Loads the tiles of a streamed terrain that are inside the streaming radius, and unloads the ones that are far outside it.
+    /** @return True if any patches were loaded or unloaded. */
+    bool StreamTiles();
+
+    /// Reads the given tile of a streamed terrain to its patches and marks them dirty.
+    void LoadTile(uint tileX, uint tileY);
+
+    /// Releases the height data of the patches in the given tile of a streamed terrain, and the GPU resources of their chunks.
+    void UnloadTile(uint tileX, uint tileY);
+
+    /// Returns the height values of all patches in the .ntf order. The patches of a streamed terrain that are not loaded are read from the asset.
+    void ReadAllPatchHeights(std::vector<float> &dest);
+
+    /// Returns the transform from the terrain grid space to world space. Unlike WorldTransform, does not need the Ogre root node.
+    float3x4 LocalToWorld() const;
+
+    /// Copies the given inclusive rectangle of terrain map vertices from the patches to heightGrid.
+    void CopyToHeightGrid(uint minX, uint minY, uint maxX, uint maxY) const;
+
+    /// Updates the given inclusive rectangle of terrain map vertices to heightGrid after the patches have been edited.
+    /** Drops the grid instead, if no one else holds it. */
+    void UpdateHeightGrid(uint minX, uint minY, uint maxX, uint maxY);
+
+    /// Updates the cached height grid range after a single height value has been changed from oldHeight to newHeight.
+    void UpdateHeightGridRange(float oldHeight, float newHeight);
+
+    /// Adds the given rectangle of terrain map vertices to the edited heights, if the change is replicated.
+    void MarkHeightsEdited(uint minX, uint minY, uint maxX, uint maxY, AttributeChange::Type change);
+
+    /// Sets the height values kept by SetHeights while the height map asset was loading.
+    void ReapplyHeightsSetBeforeLoad();
 
     shared_ptr<AssetRefListener> heightMapAsset;
 
@@ -424,6 +648,67 @@ private:
 
     /// Stores the actual height patches.
     std::vector<Patch> patches;
+
+    /// The height values of all terrain map vertices in row-major order, or null if not in use. See HeightGrid.
+    mutable shared_ptr<std::vector<float> > heightGrid;
+
+    /// Number of patches per chunk side.
+    uint chunkPatches;
+    uint chunksWidth;
+    uint chunksHeight;
+
+    /// Stores the GPU resources of the chunks.
+    std::vector<Chunk> chunks;
+
+    /// Generates the vertices and the index lists of the chunks.
+    TerrainGeometry geometry;
+
+    /// Ogre index data of the chunk index lists, by the index list id. Shared by all chunks.
+    std::map<u32, Ogre::IndexData*> chunkIndexData;
+
+    /// Distance up to which the terrain is drawn at full resolution.
+    float lodDistance;
+
+    /// The tiled terrain asset the height map is streamed from, or null if the whole height map is loaded.
+    TerrainTileAssetPtr streamingAsset;
+
+    /// For each tile of the streaming asset, whether it is loaded.
+    std::vector<bool> loadedTiles;
+
+    float streamingRadius;
+
+    /// The world positions set with SetStreamingObservers.
+    std::vector<float3> streamingObservers;
+
+    /// Time since the tiles were last streamed.
+    float streamingUpdateAcc;
+
+    /// The rectangle of terrain map vertices that has been edited with replicated changes. Empty if editedMinX > editedMaxX.
+    uint editedMinX, editedMinY, editedMaxX, editedMaxY;
+
+    /// The rectangle of terrain map vertices that has been edited since the height map was loaded, see EditedHeightsSinceLoad.
+    /// Empty if loadEditedMinX > loadEditedMaxX.
+    uint loadEditedMinX, loadEditedMinY, loadEditedMaxX, loadEditedMaxY;
+
+    /// A rectangle of height values set with SetHeights while the height map asset was loading.
+    struct HeightsSetBeforeLoad
+    {
+        uint minX;
+        uint minY;
+        uint width;
+        uint height;
+        std::vector<float> heights;
+    };
+
+    /// The height values to set again after the height map asset has loaded. See SetHeights.
+    std::vector<HeightsSetBeforeLoad> heightsSetBeforeLoad;
+
+    /// Whether the height map asset has been requested and has not loaded yet.
+    bool heightMapLoading;
+
+    /// The cached range of the height values in the grid, see HeightGridRange. Only valid if heightGridRangeValid is true.
+    mutable float heightGridMin, heightGridMax;
+    mutable bool heightGridRangeValid;
     
     /// Ogre world for referring to the Ogre scene manager
     OgreWorldWeakPtr world_;
@@ -8,6 +8,7 @@
 
 #include "EC_WaterPlane.h"
 #include "EC_Terrain.h"
+#include "TerrainTileAsset.h"
 
 #include "Framework.h"
 #include "SceneAPI.h"
@@ -32,6 +33,8 @@ DEFINE_STATIC_PLUGIN_MAIN(EnvironmentModule)
     fw->Scene()->RegisterComponentFactory(MAKE_SHARED(GenericComponentFactory<EC_WaterPlane>));
     // Create an asset type factory for Terrain assets. The terrain assets are handled as binary blobs - the EC_Terrain parses it when showing the asset.
     fw->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(BinaryAssetFactory, "Terrain", ".ntf"));
+    // Tiled terrain assets are read one tile at a time, so that EC_Terrain can stream the patches around the observers.
+    fw->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<TerrainTileAsset>, "TerrainTiles", ".ntt"));
 }
 
 }
@@ -0,0 +1,452 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "Math/MathFwd.h"
+#include "DebugOperatorNew.h"
+
+#include "TerrainGeometry.h"
+#include "Math/MathFunc.h"
+
+#include <cassert>
+#include <cmath>
+
+#ifdef MATH_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+
+/// Adds a triangle to the index list with the winding of the terrain triangles. Degenerate triangles are skipped.
+void AddTriangle(std::vector<u16> &indices, uint chunkSize, u16 i1, u16 i2, u16 i3)
+{
+    const uint stride = chunkSize + 1;
+    const int x1 = i1 % stride, y1 = i1 / stride;
+    const int x2 = i2 % stride, y2 = i2 / stride;
+    const int x3 = i3 % stride, y3 = i3 / stride;
+    // Note: winding needs to be flipped when terrain X axis goes along world X axis and terrain Y axis along world Z
+    const int cross = (x2 - x1) * (y3 - y1) - (y2 - y1) * (x3 - x1);
+    if (cross == 0)
+        return;
+    indices.push_back(i1);
+    if (cross < 0)
+    {
+        indices.push_back(i2);
+        indices.push_back(i3);
+    }
+    else
+    {
+        indices.push_back(i3);
+        indices.push_back(i2);
+    }
+}
+
+/// Returns the index of the vertex at distance t along the given chunk edge, and distance d inwards from the edge.
+u16 EdgeVertexIndex(TerrainGeometry::ChunkEdge edge, uint t, uint d, uint chunkSize)
+{
+    uint x, y;
+    switch(edge)
+    {
+    case TerrainGeometry::EdgeNegX: x = d; y = t; break;
+    case TerrainGeometry::EdgePosX: x = chunkSize - d; y = t; break;
+    case TerrainGeometry::EdgeNegY: x = t; y = d; break;
+    default: x = t; y = chunkSize - d; break;
+    }
+    return (u16)(y * (chunkSize + 1) + x);
+}
+
+/// Triangulates the strip of cells along a chunk edge.
+/** Zips the edge vertices, which are spaced by the step of the edge, to the vertices of the first inner row, which are spaced by
+    the step of the chunk. The strips of adjacent edges meet at the diagonals of the corner cells. */
+void AddEdgeStrip(std::vector<u16> &indices, TerrainGeometry::ChunkEdge edge, uint step, uint edgeStep, uint chunkSize)
+{
+    uint outer = 0; // Position of the current edge vertex, in [0, chunkSize]
+    uint inner = step; // Position of the current inner vertex, in [step, chunkSize - step]
+    while(outer < chunkSize || inner < chunkSize - step)
+    {
+        const bool advanceOuter = inner >= chunkSize - step || (outer < chunkSize && outer + edgeStep <= inner + step);
+        if (advanceOuter)
+        {
+            AddTriangle(indices, chunkSize, EdgeVertexIndex(edge, outer, 0, chunkSize), EdgeVertexIndex(edge, outer + edgeStep, 0, chunkSize),
+                EdgeVertexIndex(edge, inner, step, chunkSize));
+            outer += edgeStep;
+        }
+        else
+        {
+            AddTriangle(indices, chunkSize, EdgeVertexIndex(edge, outer, 0, chunkSize), EdgeVertexIndex(edge, inner, step, chunkSize),
+                EdgeVertexIndex(edge, inner + step, step, chunkSize));
+            inner += step;
+        }
+    }
+}
+
+/// Maps a range of terrain vertices to the vertices of a chunk along one axis. See TerrainGeometry::ChunkVerticesAffectedBy.
+bool ChunkRangeAffectedBy(uint origin, uint chunkSize, uint numVertices, uint minPos, uint maxPos, uint &chunkMin, uint &chunkMax)
+{
+    if (numVertices == 0)
+        return false;
+    // The normals of the adjacent vertices depend on the changed heights as well.
+    const uint first = minPos > 0 ? minPos - 1 : 0;
+    const uint last = Min(maxPos + 1, numVertices - 1);
+    if (first > last || last < origin || first > origin + chunkSize)
+        return false;
+    chunkMin = first > origin ? first - origin : 0;
+    // The padding vertices beyond the last terrain vertex repeat it.
+    chunkMax = last == numVertices - 1 ? chunkSize : Min(last - origin, chunkSize);
+    return true;
+}
+
+/// Number of bits of each level in an index list id.
+const uint cLodBits = 4;
+
+}
+
+TerrainGeometry::TerrainGeometry() :
+    verticesWidth(0),
+    verticesHeight(0),
+    chunkSize(1)
+{
+}
+
+void TerrainGeometry::SetSize(uint verticesWidth_, uint verticesHeight_, uint chunkSize_)
+{
+    assert(chunkSize_ > 0 && chunkSize_ <= cMaxChunkSize && (chunkSize_ & (chunkSize_ - 1)) == 0);
+    verticesWidth = verticesWidth_;
+    verticesHeight = verticesHeight_;
+    if (chunkSize_ != chunkSize)
+    {
+        chunkSize = chunkSize_;
+        indexLists.clear();
+#ifdef _DEBUG
+        assert(CheckChunkIndexLists());
+#endif
+    }
+}
+
+uint TerrainGeometry::ChunksWidth() const
+{
+    // The last vertex column is shared with the previous chunk, so it does not need a chunk of its own.
+    return verticesWidth > 1 ? (verticesWidth - 1 + chunkSize - 1) / chunkSize : 0;
+}
+
+uint TerrainGeometry::ChunksHeight() const
+{
+    return verticesHeight > 1 ? (verticesHeight - 1 + chunkSize - 1) / chunkSize : 0;
+}
+
+uint TerrainGeometry::NumLodLevels() const
+{
+    uint levels = 1;
+    while((1U << (levels - 1)) < chunkSize)
+        ++levels;
+    return levels;
+}
+
+uint TerrainGeometry::LodLevelForDistance(float distance, float lodDistance) const
+{
+    if (lodDistance <= 0.f || distance < lodDistance)
+        return 0;
+    const uint lod = 1 + (uint)Log2(distance / lodDistance);
+    return Min(lod, NumLodLevels() - 1);
+}
+
+float3 TerrainGeometry::CalculateNormal(const TerrainHeightSource &heights, uint x, uint y)
+{
+    const uint xPrev = x > 0 ? x - 1 : x;
+    const uint yPrev = y > 0 ? y - 1 : y;
+    const uint xNext = x + 1 < heights.VerticesWidth() ? x + 1 : x;
+    const uint yNext = y + 1 < heights.VerticesHeight() ? y + 1 : y;
+
+    // Use central differences, or one-sided differences scaled to the same length on the terrain edges.
+    float xSlope = heights.Height(xPrev, y) - heights.Height(xNext, y);
+    if (xNext - xPrev == 1)
+        xSlope *= 2.f;
+    float ySlope = heights.Height(x, yPrev) - heights.Height(x, yNext);
+    if (yNext - yPrev == 1)
+        ySlope *= 2.f;
+
+    // Note: heightmap X & Y correspond to X & Z world axes, while height is world Y
+    return float3(xSlope, 2.f, ySlope).Normalized();
+}
+
+void TerrainGeometry::SampleSurface(const TerrainHeightSource &heights, const float *xs, const float *ys, size_t count, float *outHeights,
+    float3 *outNormals)
+{
+    const uint verticesWidth = heights.VerticesWidth();
+    const uint verticesHeight = heights.VerticesHeight();
+    assert(verticesWidth >= 2 && verticesHeight >= 2);
+    const float maxX = (float)(verticesWidth - 1);
+    const float maxY = (float)(verticesHeight - 1);
+    const float maxCellX = (float)(verticesWidth - 2);
+    const float maxCellY = (float)(verticesHeight - 2);
+
+    // Both triangles of a cell are evaluated as base + dx*u + dy*v, where u & v are the offsets from the (x, y) corner of the cell.
+    // On the lower triangle the slopes are taken from the (x, y) corner, and on the upper triangle from the (x+1, y+1) corner.
+    size_t i = 0;
+#ifdef MATH_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 maxX4 = _mm_set1_ps(maxX);
+    const __m128 maxY4 = _mm_set1_ps(maxY);
+    const __m128 maxCellX4 = _mm_set1_ps(maxCellX);
+    const __m128 maxCellY4 = _mm_set1_ps(maxCellY);
+    for(; i + 4 <= count; i += 4)
+    {
+        // Clamping to zero first also maps NaNs to zero, as max returns its second operand if either one is a NaN.
+        const __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(xs + i), zero), maxX4);
+        const __m128 y = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(ys + i), zero), maxY4);
+        const __m128 x0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(x)), maxCellX4);
+        const __m128 y0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(y)), maxCellY4);
+        const __m128 u = _mm_sub_ps(x, x0);
+        const __m128 v = _mm_sub_ps(y, y0);
+
+        int cellX[4], cellY[4];
+        _mm_storeu_si128((__m128i*)cellX, _mm_cvttps_epi32(x0));
+        _mm_storeu_si128((__m128i*)cellY, _mm_cvttps_epi32(y0));
+        float corners[4][4];
+        for(int j = 0; j < 4; ++j)
+        {
+            corners[0][j] = heights.Height(cellX[j], cellY[j]);
+            corners[1][j] = heights.Height(cellX[j] + 1, cellY[j]);
+            corners[2][j] = heights.Height(cellX[j], cellY[j] + 1);
+            corners[3][j] = heights.Height(cellX[j] + 1, cellY[j] + 1);
+        }
+        const __m128 h00 = _mm_loadu_ps(corners[0]);
+        const __m128 h10 = _mm_loadu_ps(corners[1]);
+        const __m128 h01 = _mm_loadu_ps(corners[2]);
+        const __m128 h11 = _mm_loadu_ps(corners[3]);
+
+        const __m128 upper = _mm_cmpge_ps(_mm_add_ps(u, v), one);
+        const __m128 dx = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(h11, h01)), _mm_andnot_ps(upper, _mm_sub_ps(h10, h00)));
+        const __m128 dy = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(h11, h10)), _mm_andnot_ps(upper, _mm_sub_ps(h01, h00)));
+        const __m128 base = _mm_or_ps(_mm_and_ps(upper, _mm_sub_ps(_mm_sub_ps(h11, dx), dy)), _mm_andnot_ps(upper, h00));
+        _mm_storeu_ps(outHeights + i, _mm_add_ps(base, _mm_add_ps(_mm_mul_ps(dx, u), _mm_mul_ps(dy, v))));
+
+        if (outNormals)
+        {
+            float slopes[2][4];
+            _mm_storeu_ps(slopes[0], dx);
+            _mm_storeu_ps(slopes[1], dy);
+            for(int j = 0; j < 4; ++j)
+                outNormals[i + j] = float3(-slopes[0][j], 1.f, -slopes[1][j]);
+        }
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        const float x = xs[i] > 0.f ? Min(xs[i], maxX) : 0.f;
+        const float y = ys[i] > 0.f ? Min(ys[i], maxY) : 0.f;
+        const float x0 = Min((float)(int)x, maxCellX);
+        const float y0 = Min((float)(int)y, maxCellY);
+        const float u = x - x0;
+        const float v = y - y0;
+
+        const uint cellX = (uint)x0;
+        const uint cellY = (uint)y0;
+        const float h00 = heights.Height(cellX, cellY);
+        const float h10 = heights.Height(cellX + 1, cellY);
+        const float h01 = heights.Height(cellX, cellY + 1);
+        const float h11 = heights.Height(cellX + 1, cellY + 1);
+
+        float dx, dy, base;
+        if (u + v >= 1.f)
+        {
+            dx = h11 - h01;
+            dy = h11 - h10;
+            base = h11 - dx - dy;
+        }
+        else
+        {
+            dx = h10 - h00;
+            dy = h01 - h00;
+            base = h00;
+        }
+        outHeights[i] = base + dx * u + dy * v;
+        // Note: heightmap X & Y correspond to X & Z local axes, while height is local Y
+        if (outNormals)
+            outNormals[i] = float3(-dx, 1.f, -dy);
+    }
+}
+
+void TerrainGeometry::GenerateChunkVertices(const TerrainHeightSource &heights, uint chunkX, uint chunkY, float uScale, float vScale,
+    std::vector<TerrainVertex> &dest, AABB &bounds) const
+{
+    GenerateChunkVertices(heights, chunkX, chunkY, uScale, vScale, 0, 0, chunkSize, chunkSize, dest, bounds);
+}
+
+void TerrainGeometry::GenerateChunkVertices(const TerrainHeightSource &heights, uint chunkX, uint chunkY, float uScale, float vScale,
+    uint minX, uint minY, uint maxX, uint maxY, std::vector<TerrainVertex> &dest, AABB &bounds) const
+{
+    assert(minX <= maxX && maxX <= chunkSize && minY <= maxY && maxY <= chunkSize);
+    dest.resize((maxX - minX + 1) * (maxY - minY + 1));
+    bounds.SetNegativeInfinity();
+    if (verticesWidth == 0 || verticesHeight == 0)
+        return;
+
+    const uint originX = chunkX * chunkSize;
+    const uint originY = chunkY * chunkSize;
+    const float uvScaleX = verticesWidth > 1 ? 1.f / (verticesWidth - 1) : 0.f;
+    const float uvScaleY = verticesHeight > 1 ? 1.f / (verticesHeight - 1) : 0.f;
+
+    TerrainVertex *vertex = &dest[0];
+    for(uint y = minY; y <= maxY; ++y)
+    {
+        // The chunks at the far edges are padded by repeating the last row and column of the terrain.
+        const uint mapY = Min(originY + y, verticesHeight - 1);
+        for(uint x = minX; x <= maxX; ++x, ++vertex)
+        {
+            const uint mapX = Min(originX + x, verticesWidth - 1);
+            vertex->pos = float3((float)(mapX - originX), heights.Height(mapX, mapY), (float)(mapY - originY));
+            vertex->normal = CalculateNormal(heights, mapX, mapY);
+            vertex->uv0 = float2(mapX * uScale, mapY * vScale);
+            vertex->uv1 = float2(mapX * uvScaleX, mapY * uvScaleY);
+            bounds.Enclose(vertex->pos);
+        }
+    }
+}
+
+bool TerrainGeometry::ChunkVerticesAffectedBy(uint chunkX, uint chunkY, uint minX, uint minY, uint maxX, uint maxY,
+    uint &chunkMinX, uint &chunkMinY, uint &chunkMaxX, uint &chunkMaxY) const
+{
+    return ChunkRangeAffectedBy(chunkX * chunkSize, chunkSize, verticesWidth, minX, maxX, chunkMinX, chunkMaxX) &&
+        ChunkRangeAffectedBy(chunkY * chunkSize, chunkSize, verticesHeight, minY, maxY, chunkMinY, chunkMaxY);
+}
+
+u32 TerrainGeometry::ChunkIndexListId(uint lod, const uint edgeLods[NumChunkEdges]) const
+{
+    const uint maxLod = NumLodLevels() - 1;
+    lod = Min(lod, maxLod);
+    u32 id = lod;
+    for(uint i = 0; i < NumChunkEdges; ++i)
+        id |= Clamp(edgeLods[i], lod, maxLod) << (cLodBits * (i + 1));
+    return id;
+}
+
+const std::vector<u16> &TerrainGeometry::ChunkIndices(u32 indexListId)
+{
+    std::map<u32, std::vector<u16> >::const_iterator iter = indexLists.find(indexListId);
+    if (iter != indexLists.end())
+        return iter->second;
+
+    std::vector<u16> &indices = indexLists[indexListId];
+    GenerateChunkIndices(indexListId, indices);
+    return indices;
+}
+
+void TerrainGeometry::GenerateChunkIndices(u32 indexListId, std::vector<u16> &indices) const
+{
+    const u32 lodMask = (1U << cLodBits) - 1;
+    const uint step = 1U << (indexListId & lodMask);
+    uint edgeSteps[NumChunkEdges];
+    for(uint i = 0; i < NumChunkEdges; ++i)
+        edgeSteps[i] = 1U << ((indexListId >> (cLodBits * (i + 1))) & lodMask);
+
+    indices.clear();
+    indices.reserve((chunkSize / step) * (chunkSize / step) * 6);
+
+    // If no edge is stitched, or the chunk is a single quad, all cells are triangulated the same way. Otherwise the cells
+    // of the outermost ring are triangulated as edge strips, which connect the inner cells to the vertices of the coarser edges.
+    bool stitched = false;
+    for(uint i = 0; i < NumChunkEdges; ++i)
+        if (edgeSteps[i] > step)
+            stitched = true;
+    const uint border = (stitched && step < chunkSize) ? step : 0;
+    const uint stride = chunkSize + 1;
+
+    for(uint y = border; y < chunkSize - border; y += step)
+        for(uint x = border; x < chunkSize - border; x += step)
+        {
+            const u16 i00 = (u16)(y * stride + x);
+            const u16 i10 = (u16)(y * stride + x + step);
+            const u16 i01 = (u16)((y + step) * stride + x);
+            const u16 i11 = (u16)((y + step) * stride + x + step);
+            AddTriangle(indices, chunkSize, i01, i10, i00);
+            AddTriangle(indices, chunkSize, i01, i11, i10);
+        }
+
+    if (border > 0)
+        for(uint i = 0; i < NumChunkEdges; ++i)
+            AddEdgeStrip(indices, (ChunkEdge)i, step, edgeSteps[i], chunkSize);
+}
+
+bool TerrainGeometry::CheckChunkIndexLists(u32 *failedIndexListId) const
+{
+    // The strips of the edges are generated independently of each other, so each edge is checked at each coarser level
+    // with the other edges unstitched, and then all edges together at the coarsest level.
+    const uint maxLod = NumLodLevels() - 1;
+    for(uint lod = 0; lod <= maxLod; ++lod)
+    {
+        uint edgeLods[NumChunkEdges] = { lod, lod, lod, lod };
+        bool valid = CheckChunkIndexList(lod, edgeLods);
+        for(uint edge = 0; edge < NumChunkEdges && valid; ++edge)
+        {
+            for(uint edgeLod = lod + 1; edgeLod <= maxLod && valid; ++edgeLod)
+            {
+                edgeLods[edge] = edgeLod;
+                valid = CheckChunkIndexList(lod, edgeLods);
+            }
+            edgeLods[edge] = lod;
+        }
+        if (valid)
+        {
+            for(uint edge = 0; edge < NumChunkEdges; ++edge)
+                edgeLods[edge] = maxLod;
+            valid = CheckChunkIndexList(lod, edgeLods);
+        }
+        if (!valid)
+        {
+            if (failedIndexListId)
+                *failedIndexListId = ChunkIndexListId(lod, edgeLods);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TerrainGeometry::CheckChunkIndexList(uint lod, const uint edgeLods[NumChunkEdges]) const
+{
+    std::vector<u16> indices;
+    GenerateChunkIndices(ChunkIndexListId(lod, edgeLods), indices);
+    if (indices.empty() || indices.size() % 3 != 0)
+        return false;
+
+    const uint step = 1U << lod;
+    bool stitched = false;
+    uint edgeSteps[NumChunkEdges];
+    for(uint i = 0; i < NumChunkEdges; ++i)
+    {
+        edgeSteps[i] = 1U << Max(edgeLods[i], lod);
+        if (edgeSteps[i] > step)
+            stitched = true;
+    }
+    if (!stitched && indices.size() != (chunkSize / step) * (chunkSize / step) * 6)
+        return false;
+
+    const uint stride = chunkSize + 1;
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i] >= VerticesPerChunk())
+            return false;
+        // A vertex on a stitched edge that is not on the grid of the neighbour would leave a crack.
+        const uint x = indices[i] % stride, y = indices[i] / stride;
+        if ((x == 0 && y % edgeSteps[EdgeNegX] != 0) || (x == chunkSize && y % edgeSteps[EdgePosX] != 0) ||
+            (y == 0 && x % edgeSteps[EdgeNegY] != 0) || (y == chunkSize && x % edgeSteps[EdgePosY] != 0))
+            return false;
+    }
+
+    // The triangles must have the winding of AddTriangle. Overlapping triangles or holes would change the total area.
+    uint doubleArea = 0;
+    for(size_t i = 0; i < indices.size(); i += 3)
+    {
+        const int x1 = indices[i] % stride, y1 = indices[i] / stride;
+        const int x2 = indices[i + 1] % stride, y2 = indices[i + 1] / stride;
+        const int x3 = indices[i + 2] % stride, y3 = indices[i + 2] / stride;
+        const int cross = (x2 - x1) * (y3 - y1) - (y2 - y1) * (x3 - x1);
+        if (cross >= 0)
+            return false;
+        doubleArea += (uint)-cross;
+    }
+    return doubleArea == 2 * chunkSize * chunkSize;
+}
@@ -0,0 +1,159 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "EnvironmentModuleApi.h"
+#include "CoreTypes.h"
+#include "Math/float2.h"
+#include "Math/float3.h"
+#include "Geometry/AABB.h"
+
+#include <vector>
+#include <map>
+
+/// Read access to the height values of a terrain vertex grid.
+class ENVIRONMENT_MODULE_API TerrainHeightSource
+{
+public:
+    virtual ~TerrainHeightSource() {}
+
+    /// Returns the number of vertices in the grid in the local X direction.
+    virtual uint VerticesWidth() const = 0;
+
+    /// Returns the number of vertices in the grid in the local Y direction.
+    virtual uint VerticesHeight() const = 0;
+
+    /// Returns the height value of the given grid vertex. Called only with x < VerticesWidth() and y < VerticesHeight().
+    virtual float Height(uint x, uint y) const = 0;
+};
+
+/// A single vertex of the terrain geometry. The layout matches the vertex declaration of the Ogre meshes EC_Terrain creates.
+struct TerrainVertex
+{
+    float3 pos;
+    float3 normal;
+    /// Diffuse texture UV: a planar mapping scaled by the uScale and vScale attributes of the terrain.
+    float2 uv0;
+    /// Blend mask UV, which stretches once across the whole terrain.
+    float2 uv1;
+};
+
+/// Generates the CPU-side geometry of a heightmap terrain: the vertices of terrain chunks and their geomipmapped index lists.
+/** The vertex grid of the terrain is divided into square chunks of ChunkSize() x ChunkSize() quads. Each chunk has a full
+    resolution grid of (ChunkSize()+1)^2 vertices, the last row and column of which are shared with the next chunks. The chunks
+    at the far edges of the terrain are padded by repeating the last vertex row and column of the terrain.
+
+    A chunk at the LOD level l is drawn using every 2^l'th vertex of its grid. To keep the terrain crack-free, the edge of a chunk
+    that borders a chunk of a coarser level only uses the vertices of the coarser level, and the outermost ring of cells is
+    triangulated as strips that connect those vertices to the inner grid. The index lists only depend on the levels of the chunk
+    and its neighbours, so they are shared by all chunks and generated once.
+
+    Does not depend on Ogre, so the geometry can be generated and profiled without a renderer. */
+class ENVIRONMENT_MODULE_API TerrainGeometry
+{
+public:
+    /// The edges of a chunk, in the order their neighbour levels are passed to ChunkIndexListId.
+    enum ChunkEdge
+    {
+        EdgeNegX = 0,
+        EdgePosX,
+        EdgeNegY,
+        EdgePosY,
+        NumChunkEdges
+    };
+
+    /// The largest supported chunk size. The vertices of larger chunks could not be indexed with 16-bit indices.
+    static const uint cMaxChunkSize = 128;
+
+    TerrainGeometry();
+
+    /// Sets the size of the terrain vertex grid and the size of the chunks.
+    /** Clears the cached index lists if the chunk size changes.
+        @param chunkSize Number of quads per chunk side. Must be a power of two, at most cMaxChunkSize. */
+    void SetSize(uint verticesWidth, uint verticesHeight, uint chunkSize);
+
+    /// Returns the number of quads per chunk side.
+    uint ChunkSize() const { return chunkSize; }
+
+    /// Returns the number of vertices in the vertex grid of a chunk.
+    uint VerticesPerChunk() const { return (chunkSize + 1) * (chunkSize + 1); }
+
+    /// Returns the number of chunks in the local X direction.
+    uint ChunksWidth() const;
+
+    /// Returns the number of chunks in the local Y direction.
+    uint ChunksHeight() const;
+
+    /// Returns the number of LOD levels. Level 0 is the full resolution, and the last level draws a chunk as a single quad.
+    uint NumLodLevels() const;
+
+    /// Returns the LOD level to use for a chunk at the given distance from the camera.
+    /** Level 0 is used up to lodDistance, and each next level up to twice the distance of the previous one.
+        A lodDistance of zero or less disables the LOD, i.e. always returns level 0. */
+    uint LodLevelForDistance(float distance, float lodDistance) const;
+
+    /// Calculates the vertex normal of the given grid vertex from the heights of the neighbouring vertices.
+    static float3 CalculateNormal(const TerrainHeightSource &heights, uint x, uint y);
+
+    /// Samples the surface of a height grid at a batch of points.
+    /** The surface of each grid cell consists of the two triangles the terrain is rendered with, split along the diagonal from
+        (x+1, y) to (x, y+1). Points outside the grid are clamped to its edges. Processes four points at a time with SSE2
+        when MATH_SSE2 is defined.
+        @param heights The height grid. Both of its dimensions must be at least 2.
+        @param xs, ys Positions of the points in grid vertex coordinates.
+        @param outHeights [out] Receives the surface height at each point.
+        @param outNormals [out] If not null, receives the unnormalized normal of the surface triangle at each point. */
+    static void SampleSurface(const TerrainHeightSource &heights, const float *xs, const float *ys, size_t count, float *outHeights,
+        float3 *outNormals);
+
+    /// Generates the vertices of a chunk, in row-major order.
+    /** The positions are relative to the chunk origin, i.e. the grid vertex (chunkX*ChunkSize(), chunkY*ChunkSize()).
+        Heightmap X & Y correspond to the X & Z axes of the positions, while the height is Y.
+        @param bounds [out] Bounds of the generated positions. */
+    void GenerateChunkVertices(const TerrainHeightSource &heights, uint chunkX, uint chunkY, float uScale, float vScale,
+        std::vector<TerrainVertex> &dest, AABB &bounds) const;
+
+    /// Generates the vertices of a rectangle of the chunk vertex grid, in row-major order.
+    /** Used to update the part of a chunk that an edit has changed. The rectangle is given in chunk vertex coordinates,
+        in the range [0, ChunkSize()], and includes its maximum row and column.
+        @param bounds [out] Bounds of the generated positions. */
+    void GenerateChunkVertices(const TerrainHeightSource &heights, uint chunkX, uint chunkY, float uScale, float vScale,
+        uint minX, uint minY, uint maxX, uint maxY, std::vector<TerrainVertex> &dest, AABB &bounds) const;
+
+    /// Computes which vertices of a chunk change when the heights of the given rectangle of terrain vertices change.
+    /** Accounts for the normals of the neighbouring vertices and for the padding of the chunks at the far edges.
+        The rectangles include their maximum row and column.
+        @return False if no vertices of the chunk change. */
+    bool ChunkVerticesAffectedBy(uint chunkX, uint chunkY, uint minX, uint minY, uint maxX, uint maxY,
+        uint &chunkMinX, uint &chunkMinY, uint &chunkMaxX, uint &chunkMaxY) const;
+
+    /// Returns the id of the index list of a chunk at the given LOD level, stitched to the given levels of the neighbouring chunks.
+    /** Neighbour levels that are not coarser than lod are treated as equal to lod, so that the chunk is not stitched on that edge.
+        @param edgeLods LOD levels of the neighbouring chunks, indexed by ChunkEdge. */
+    u32 ChunkIndexListId(uint lod, const uint edgeLods[NumChunkEdges]) const;
+
+    /// Returns the index list of the given id. The list is generated on first use and cached until the chunk size changes.
+    const std::vector<u16> &ChunkIndices(u32 indexListId);
+
+    /// Checks the index lists of each LOD level for the current chunk size, unstitched and stitched to each coarser level on each edge.
+    /** Each list must consist of whole, non-degenerate triangles with the same winding that cover the chunk exactly, an unstitched list
+        must have 6 indices per cell of its level, and the vertices on a stitched edge must lie on the grid of the coarser level.
+        The lists are generated without caching them. Does not need a renderer, so it can be run headless. Debug builds run it
+        whenever the chunk size changes.
+        @param failedIndexListId [out] If not null, receives the id of the first invalid list.
+        @return True if all lists are valid. */
+    bool CheckChunkIndexLists(u32 *failedIndexListId = 0) const;
+
+private:
+    /// Generates the index list of the given id, see ChunkIndices.
+    void GenerateChunkIndices(u32 indexListId, std::vector<u16> &indices) const;
+
+    /// Checks a single index list, see CheckChunkIndexLists.
+    bool CheckChunkIndexList(uint lod, const uint edgeLods[NumChunkEdges]) const;
+
+    uint verticesWidth;
+    uint verticesHeight;
+    uint chunkSize;
+    /// Index lists generated so far, by their ids.
+    std::map<u32, std::vector<u16> > indexLists;
+};
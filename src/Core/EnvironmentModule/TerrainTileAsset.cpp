@@ -0,0 +1,259 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "DebugOperatorNew.h"
+
+#include "TerrainTileAsset.h"
+#include "EC_Terrain.h"
+#include "AssetAPI.h"
+#include "LoggingFunctions.h"
+
+#include <cstring>
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+
+const char cTileFileMagic[4] = { 'N', 'T', 'T', '1' };
+
+/// Size of the file header: the magic and three u32s.
+const size_t cTileFileHeaderSize = 4 + 3 * sizeof(u32);
+
+/// Number of height values per patch.
+const uint cPatchValues = EC_Terrain::cPatchSize * EC_Terrain::cPatchSize;
+
+/// Largest accepted number of patches per terrain side and per tile side. Corrupted headers are rejected before any sizes are computed from them.
+const u32 cMaxPatches = 4096;
+const u32 cMaxTilePatches = 64;
+
+}
+
+TerrainTileAsset::TerrainTileAsset(AssetAPI *owner, const QString &type_, const QString &name_) :
+    IAsset(owner, type_, name_),
+    patchWidth(0),
+    patchHeight(0),
+    tilePatches(0)
+{
+}
+
+TerrainTileAsset::~TerrainTileAsset()
+{
+    Unload();
+}
+
+bool TerrainTileAsset::DeserializeFromData(const u8 *data, size_t numBytes, bool /*allowAsynchronous*/)
+{
+    DoUnload();
+
+    if (numBytes < cTileFileHeaderSize || memcmp(data, cTileFileMagic, sizeof(cTileFileMagic)) != 0)
+    {
+        LogError("TerrainTileAsset::DeserializeFromData: " + Name() + " is not a tiled terrain file!");
+        return false;
+    }
+
+    u32 header[3];
+    memcpy(header, data + sizeof(cTileFileMagic), sizeof(header));
+    if (header[0] == 0 || header[1] == 0 || header[2] == 0 || header[0] > cMaxPatches || header[1] > cMaxPatches || header[2] > cMaxTilePatches)
+    {
+        LogError("TerrainTileAsset::DeserializeFromData: The tiled terrain file " + Name() + " has an invalid size " + QString::number(header[0]) +
+            "x" + QString::number(header[1]) + " with " + QString::number(header[2]) + " patches per tile!");
+        return false;
+    }
+    patchWidth = header[0];
+    patchHeight = header[1];
+    tilePatches = header[2];
+
+    // The tile data of a large terrain can exceed 4GB, so the size is computed in 64 bits.
+    const u64 numTiles = (u64)TilesWidth() * TilesHeight();
+    const u64 tileSize = (u64)tilePatches * tilePatches * cPatchValues * sizeof(float);
+    const u64 expectedSize = cTileFileHeaderSize + numTiles * 2 * sizeof(float) + numTiles * tileSize;
+    if ((u64)numBytes < expectedSize)
+    {
+        LogError("TerrainTileAsset::DeserializeFromData: The tiled terrain file " + Name() + " is truncated or corrupted!");
+        DoUnload();
+        return false;
+    }
+
+    tileHeightRanges.resize(TilesWidth() * TilesHeight() * 2);
+    memcpy(&tileHeightRanges[0], data + cTileFileHeaderSize, tileHeightRanges.size() * sizeof(float));
+
+    // Read the tiles from the disk source on demand if possible, so that the tiles that are not needed do not take any memory.
+    bool streamFromDisk = false;
+    if (DiskSourceType() != IAsset::Bundle && !DiskSource().isEmpty())
+    {
+        file.setFileName(DiskSource());
+        streamFromDisk = file.open(QIODevice::ReadOnly) && (size_t)file.size() == numBytes;
+        if (!streamFromDisk)
+            file.close();
+    }
+    if (!streamFromDisk)
+        memoryData.insert(memoryData.end(), data, data + numBytes);
+
+    assetAPI->AssetLoadCompleted(Name());
+    return true;
+}
+
+bool TerrainTileAsset::SerializeTo(std::vector<u8> &data, const QString &/*serializationParameters*/) const
+{
+    if (!memoryData.empty())
+    {
+        data = memoryData;
+        return true;
+    }
+    if (!file.isOpen())
+        return false;
+
+    QFile source(file.fileName());
+    if (!source.open(QIODevice::ReadOnly))
+        return false;
+    data.resize((size_t)source.size());
+    return data.empty() || source.read((char*)&data[0], data.size()) == (qint64)data.size();
+}
+
+bool TerrainTileAsset::IsLoaded() const
+{
+    return tilePatches > 0;
+}
+
+void TerrainTileAsset::DoUnload()
+{
+    file.close();
+    memoryData.clear();
+    tileHeightRanges.clear();
+    patchWidth = patchHeight = tilePatches = 0;
+}
+
+uint TerrainTileAsset::TilesWidth() const
+{
+    return tilePatches > 0 ? (patchWidth + tilePatches - 1) / tilePatches : 0;
+}
+
+uint TerrainTileAsset::TilesHeight() const
+{
+    return tilePatches > 0 ? (patchHeight + tilePatches - 1) / tilePatches : 0;
+}
+
+size_t TerrainTileAsset::TileSize() const
+{
+    return (size_t)tilePatches * tilePatches * cPatchValues * sizeof(float);
+}
+
+size_t TerrainTileAsset::TilesOffset() const
+{
+    return cTileFileHeaderSize + (size_t)TilesWidth() * TilesHeight() * 2 * sizeof(float);
+}
+
+bool TerrainTileAsset::ReadTile(uint tileX, uint tileY, std::vector<float> &dest)
+{
+    if (!IsLoaded() || tileX >= TilesWidth() || tileY >= TilesHeight())
+        return false;
+
+    const size_t offset = TilesOffset() + ((size_t)tileY * TilesWidth() + tileX) * TileSize();
+    dest.resize(TileSize() / sizeof(float));
+    if (!memoryData.empty())
+    {
+        memcpy(&dest[0], &memoryData[offset], TileSize());
+        return true;
+    }
+
+    if (!file.seek(offset) || file.read((char*)&dest[0], TileSize()) != (qint64)TileSize())
+    {
+        LogError("TerrainTileAsset::ReadTile: Failed to read tile (" + QString::number(tileX) + "," + QString::number(tileY) + ") of " +
+            Name() + " from " + file.fileName() + "!");
+        return false;
+    }
+    return true;
+}
+
+void TerrainTileAsset::TileHeightRange(uint tileX, uint tileY, float &minHeight, float &maxHeight) const
+{
+    if (tileX >= TilesWidth() || tileY >= TilesHeight())
+    {
+        minHeight = maxHeight = 0.f;
+        return;
+    }
+    const size_t index = ((size_t)tileY * TilesWidth() + tileX) * 2;
+    minHeight = tileHeightRanges[index];
+    maxHeight = tileHeightRanges[index + 1];
+}
+
+bool TerrainTileAsset::SaveTiles(const QString &filename, uint patchWidth, uint patchHeight, uint tilePatches, const float *patchData)
+{
+    if (patchWidth == 0 || patchHeight == 0 || tilePatches == 0 || !patchData)
+    {
+        LogError("TerrainTileAsset::SaveTiles: Invalid terrain size " + QString::number(patchWidth) + "x" + QString::number(patchHeight) + "!");
+        return false;
+    }
+
+    QFile dest(filename);
+    if (!dest.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LogError("TerrainTileAsset::SaveTiles: Could not open file " + filename + " for writing!");
+        return false;
+    }
+
+    const uint tilesWidth = (patchWidth + tilePatches - 1) / tilePatches;
+    const uint tilesHeight = (patchHeight + tilePatches - 1) / tilePatches;
+    const u32 header[3] = { patchWidth, patchHeight, tilePatches };
+    bool success = dest.write(cTileFileMagic, sizeof(cTileFileMagic)) == sizeof(cTileFileMagic);
+    success = success && dest.write((const char*)header, sizeof(header)) == sizeof(header);
+
+    // Assemble the tiles first, since the height ranges precede them in the file.
+    const size_t tileValues = (size_t)tilePatches * tilePatches * cPatchValues;
+    std::vector<float> tiles((size_t)tilesWidth * tilesHeight * tileValues, 0.f);
+    std::vector<float> heightRanges((size_t)tilesWidth * tilesHeight * 2, 0.f);
+    for(uint ty = 0; ty < tilesHeight; ++ty)
+        for(uint tx = 0; tx < tilesWidth; ++tx)
+        {
+            const size_t tileIndex = (size_t)ty * tilesWidth + tx;
+            float *tile = &tiles[tileIndex * tileValues];
+            float minHeight = 1e9f;
+            float maxHeight = -1e9f;
+            for(uint py = 0; py < tilePatches; ++py)
+                for(uint px = 0; px < tilePatches; ++px)
+                {
+                    const uint patchX = tx * tilePatches + px;
+                    const uint patchY = ty * tilePatches + py;
+                    if (patchX >= patchWidth || patchY >= patchHeight)
+                        continue;
+                    const float *src = patchData + ((size_t)patchY * patchWidth + patchX) * cPatchValues;
+                    memcpy(tile + ((size_t)py * tilePatches + px) * cPatchValues, src, cPatchValues * sizeof(float));
+                    minHeight = std::min(minHeight, *std::min_element(src, src + cPatchValues));
+                    maxHeight = std::max(maxHeight, *std::max_element(src, src + cPatchValues));
+                }
+            heightRanges[tileIndex * 2] = minHeight;
+            heightRanges[tileIndex * 2 + 1] = maxHeight;
+        }
+
+    success = success && dest.write((const char*)&heightRanges[0], heightRanges.size() * sizeof(float)) == (qint64)(heightRanges.size() * sizeof(float));
+    success = success && dest.write((const char*)&tiles[0], tiles.size() * sizeof(float)) == (qint64)(tiles.size() * sizeof(float));
+    if (!success)
+        LogError("TerrainTileAsset::SaveTiles: Write error in " + filename + "!");
+    return success;
+}
+
+bool TerrainTileAsset::ConvertFromNtf(const QString &ntfFilename, const QString &destFilename, uint tilePatches)
+{
+    QFile source(ntfFilename);
+    if (!source.open(QIODevice::ReadOnly))
+    {
+        LogError("TerrainTileAsset::ConvertFromNtf: Could not open file " + ntfFilename + "!");
+        return false;
+    }
+    QByteArray data = source.readAll();
+
+    u32 size[2] = { 0, 0 };
+    if ((size_t)data.size() >= sizeof(size))
+        memcpy(size, data.constData(), sizeof(size));
+    if (size[0] == 0 || size[1] == 0 || (size_t)data.size() < sizeof(size) + (size_t)size[0] * size[1] * cPatchValues * sizeof(float))
+    {
+        LogError("TerrainTileAsset::ConvertFromNtf: " + ntfFilename + " is not a valid .ntf file!");
+        return false;
+    }
+
+    // Copy the patch data out from behind the 8-byte header, so that it is aligned for float access.
+    std::vector<float> patchData((size_t)size[0] * size[1] * cPatchValues);
+    memcpy(&patchData[0], data.constData() + sizeof(size), patchData.size() * sizeof(float));
+    return SaveTiles(destFilename, size[0], size[1], tilePatches, &patchData[0]);
+}
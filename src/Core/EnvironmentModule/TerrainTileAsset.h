@@ -0,0 +1,98 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "EnvironmentModuleApi.h"
+#include "IAsset.h"
+
+#include <QFile>
+#include <vector>
+
+class TerrainTileAsset;
+typedef shared_ptr<TerrainTileAsset> TerrainTileAssetPtr;
+
+/// A terrain height map that is stored in square tiles of patches, so that it can be read one tile at a time.
+/** Used by EC_Terrain to stream the patches around the observers, instead of keeping the whole height map in memory.
+    When the asset has a disk source, only the header is kept in memory and the tiles are read from the disk source on demand.
+
+    The file format (.ntt) stores the values in the native byte order, like the .ntf format:
+    - char[4] "NTT1"
+    - u32 patch grid width, u32 patch grid height, u32 number of patches per tile side
+    - For each tile, in row-major order: float minimum height, float maximum height
+    - For each tile, in row-major order: the patches of the tile in row-major order, each patch as EC_Terrain::cPatchSize^2
+      height values in row-major order. The patches of the tiles at the far edges that lie outside the patch grid are stored as
+      zeros, so that all tiles are of the same size and can be addressed by their index. */
+class ENVIRONMENT_MODULE_API TerrainTileAsset : public IAsset
+{
+    Q_OBJECT
+
+public:
+    TerrainTileAsset(AssetAPI *owner, const QString &type_, const QString &name_);
+    ~TerrainTileAsset();
+
+    /// The default number of patches per tile side. A tile of 4x4 patches matches the largest EC_Terrain chunk.
+    static const uint cDefaultTilePatches = 4;
+
+    virtual bool DeserializeFromData(const u8 *data, size_t numBytes, bool allowAsynchronous);
+
+    virtual bool SerializeTo(std::vector<u8> &data, const QString &serializationParameters = "") const;
+
+    virtual bool IsLoaded() const;
+
+    /// Reads the height values of the given tile.
+    /** @param dest [out] Receives TilePatches()^2 patches of EC_Terrain::cPatchSize^2 height values, in the order they are stored in the file.
+        @return False if the tile could not be read. */
+    bool ReadTile(uint tileX, uint tileY, std::vector<float> &dest);
+
+    /// Returns the range of the height values in the given tile, without reading the tile.
+    void TileHeightRange(uint tileX, uint tileY, float &minHeight, float &maxHeight) const;
+
+    /// Writes a height map in the tiled format.
+    /** @param patchData The height values in the .ntf order, i.e. patchWidth*patchHeight patches in row-major order, each patch as
+            EC_Terrain::cPatchSize^2 height values in row-major order. */
+    static bool SaveTiles(const QString &filename, uint patchWidth, uint patchHeight, uint tilePatches, const float *patchData);
+
+    /// Converts a .ntf terrain file to the tiled format.
+    static bool ConvertFromNtf(const QString &ntfFilename, const QString &destFilename, uint tilePatches = cDefaultTilePatches);
+
+public slots:
+    /// Returns the width of the patch grid.
+    uint PatchWidth() const { return patchWidth; }
+
+    /// Returns the height of the patch grid.
+    uint PatchHeight() const { return patchHeight; }
+
+    /// Returns the number of patches per tile side.
+    uint TilePatches() const { return tilePatches; }
+
+    /// Returns the number of tiles in the x-direction.
+    uint TilesWidth() const;
+
+    /// Returns the number of tiles in the y-direction.
+    uint TilesHeight() const;
+
+    /// Returns true if the tiles are read from the disk source, and false if they are kept in memory.
+    bool IsStreamedFromDisk() const { return memoryData.empty() && IsLoaded(); }
+
+private:
+    virtual void DoUnload();
+
+    /// Returns the size of a tile in bytes.
+    size_t TileSize() const;
+
+    /// Returns the offset of the first tile in the file.
+    size_t TilesOffset() const;
+
+    uint patchWidth;
+    uint patchHeight;
+    uint tilePatches;
+
+    /// The minimum and maximum height of each tile.
+    std::vector<float> tileHeightRanges;
+
+    /// The file the tiles are read from, if the asset has a disk source.
+    QFile file;
+
+    /// The whole file, if the asset does not have a disk source the tiles could be read from.
+    std::vector<u8> memoryData;
+};
@@ -22,6 +22,7 @@
 #include <Ogre.h>
 #include <OgreTagPoint.h>
 #include <OgreAnimationState.h>
+#include <algorithm>
 
 #include "MemoryLeakCheck.h"
 
@@ -181,6 +182,8 @@ EC_Placeable::EC_Placeable(Scene* scene) :
     parentPlaceable_(0),
     parentMesh_(0),
     attached_(false),
+    worldTransformDirty_(true),
+    worldDecompositionDirty_(true),
     INIT_ATTRIBUTE(transform, "Transform"),
     INIT_ATTRIBUTE_VALUE(drawDebug, "Show bounding box", false),
     INIT_ATTRIBUTE_VALUE(visible, "Visible", true),
@@ -219,14 +222,21 @@ EC_Placeable::EC_Placeable(Scene* scene) :
 
 EC_Placeable::~EC_Placeable()
 {
+    // The parent must not refer to this placeable after it is gone, even if the node is not detached below.
+    if (parentPlaceable_)
+        parentPlaceable_->RemoveChildPlaceable(this);
+
     if (world_.expired())
     {
         if (sceneNode_)
             LogError("EC_Placeable: World has expired, skipping uninitialization!");
+        ForgetChildPlaceables();
         return;
     }
     
+    // The child placeables detach themselves on this signal.
     emit AboutToBeDestroyed();
+    ForgetChildPlaceables();
     
     OgreWorldPtr world = world_.lock();
     Ogre::SceneManager* sceneMgr = world->OgreSceneManager();
@@ -256,6 +266,9 @@ void EC_Placeable::AttachNode()
     }
     OgreWorldPtr world = world_.lock();
     
+    // Whatever we end up attached to, the world transform changes.
+    MarkWorldTransformDirty();
+
     try
     {
         // If already attached, detach first
@@ -320,7 +333,7 @@ void EC_Placeable::AttachNode()
                             // We also need to listen to the parent placeable's transform changes, in case there are no animations playing in the parent skeletal mesh
                             // (in that case bones don't get automatically updated)
                             EC_Placeable* parentPlaceable = parentEntity->GetComponent<EC_Placeable>().get();
-                            parentPlaceable_ = parentPlaceable;
+                            SetParentPlaceable(parentPlaceable);
                             connect(parentPlaceable_, SIGNAL(TransformChanged()), this, SLOT(OnParentPlaceableTransformChanged()), Qt::UniqueConnection);
 
                             parentBone_ = bone;
@@ -363,11 +376,8 @@ void EC_Placeable::AttachNode()
                         parentCheck = parentCheck->parentPlaceable_;
                     }
                     
-                    parentPlaceable_ = parentPlaceable;
+                    SetParentPlaceable(parentPlaceable);
                     parentPlaceable_->GetSceneNode()->addChild(sceneNode_);
-                    
-                    // Connect to destruction of the placeable to be able to detach gracefully
-                    connect(parentPlaceable_, SIGNAL(AboutToBeDestroyed()), this, SLOT(OnParentPlaceableDestroyed()), Qt::UniqueConnection);
                     attached_ = true;
                     return;
                 }
@@ -408,6 +418,8 @@ void EC_Placeable::DetachNode()
     if (!attached_)
         return;
     
+    MarkWorldTransformDirty();
+
     try
     {
         Ogre::SceneManager* sceneMgr = world->OgreSceneManager();
@@ -426,13 +438,12 @@ void EC_Placeable::DetachNode()
             boneAttachmentNode_->removeChild(sceneNode_);
             parentBone_ = 0;
             parentMesh_ = 0;
-            parentPlaceable_ = 0;
+            SetParentPlaceable(0);
         }
         else if (parentPlaceable_)
         {
-            disconnect(parentPlaceable_, SIGNAL(AboutToBeDestroyed()), this, SLOT(OnParentPlaceableDestroyed()));
             parentPlaceable_->GetSceneNode()->removeChild(sceneNode_);
-            parentPlaceable_ = 0;
+            SetParentPlaceable(0);
         }
         else
             root_node->removeChild(sceneNode_);
@@ -685,6 +696,12 @@ void EC_Placeable::RegisterActions()
     }
 }
 
+void EC_Placeable::AttributeChangedDisconnected(IAttribute *attribute)
+{
+    if (attribute == &transform || attribute == &parentBone)
+        MarkWorldTransformDirty();
+}
+
 void EC_Placeable::AttributesChanged()
 {
     // If parent ref or parent bone changed, reattach node to scene hierarchy
@@ -716,6 +733,7 @@ void EC_Placeable::AttributesChanged()
 
         sceneNode_->setScale(scale);
 
+        MarkWorldTransformDirty();
         emit TransformChanged();
     }
     if (drawDebug.ValueChanged())
@@ -941,20 +959,78 @@ float3 EC_Placeable::WorldPosition() const
 
 Quat EC_Placeable::WorldOrientation() const
 {
-    float3 translate;
-    Quat rotate;
-    float3 scale;
-    LocalToWorld().Decompose(translate, rotate, scale);
-    return rotate;
+    UpdateWorldDecomposition();
+    return cachedWorldOrientation_;
 }
 
 float3 EC_Placeable::WorldScale() const
 {
+    UpdateWorldDecomposition();
+    return cachedWorldScale_;
+}
+
+void EC_Placeable::UpdateWorldDecomposition() const
+{
+    const float3x4 localToWorld = LocalToWorld();
+    if (!worldDecompositionDirty_ && !worldTransformDirty_)
+        return;
     float3 translate;
-    Quat rotate;
-    float3 scale;
-    LocalToWorld().Decompose(translate, rotate, scale);
-    return scale;
+    localToWorld.Decompose(translate, cachedWorldOrientation_, cachedWorldScale_);
+    // If the world transform could not be cached (bone attachment), neither can its decomposition.
+    worldDecompositionDirty_ = worldTransformDirty_;
+}
+
+void EC_Placeable::MarkWorldTransformDirty()
+{
+    // The children of a dirty placeable are already dirty, so the propagation can stop there.
+    if (worldTransformDirty_)
+        return;
+    worldTransformDirty_ = true;
+    worldDecompositionDirty_ = true;
+    for(size_t i = 0; i < childPlaceables_.size(); ++i)
+        childPlaceables_[i]->MarkWorldTransformDirty();
+}
+
+void EC_Placeable::SetParentPlaceable(EC_Placeable *parent)
+{
+    if (parentPlaceable_ == parent)
+        return;
+    if (parentPlaceable_)
+    {
+        disconnect(parentPlaceable_, SIGNAL(AboutToBeDestroyed()), this, SLOT(OnParentPlaceableDestroyed()));
+        parentPlaceable_->RemoveChildPlaceable(this);
+    }
+    parentPlaceable_ = parent;
+    if (parentPlaceable_)
+    {
+        parentPlaceable_->AddChildPlaceable(this);
+        // Connect to destruction of the placeable to be able to detach gracefully
+        connect(parentPlaceable_, SIGNAL(AboutToBeDestroyed()), this, SLOT(OnParentPlaceableDestroyed()), Qt::UniqueConnection);
+    }
+    MarkWorldTransformDirty();
+}
+
+void EC_Placeable::ForgetChildPlaceables()
+{
+    for(size_t i = 0; i < childPlaceables_.size(); ++i)
+    {
+        childPlaceables_[i]->parentPlaceable_ = 0;
+        childPlaceables_[i]->MarkWorldTransformDirty();
+    }
+    childPlaceables_.clear();
+}
+
+void EC_Placeable::AddChildPlaceable(EC_Placeable *child)
+{
+    if (std::find(childPlaceables_.begin(), childPlaceables_.end(), child) == childPlaceables_.end())
+        childPlaceables_.push_back(child);
+}
+
+void EC_Placeable::RemoveChildPlaceable(EC_Placeable *child)
+{
+    std::vector<EC_Placeable*>::iterator iter = std::find(childPlaceables_.begin(), childPlaceables_.end(), child);
+    if (iter != childPlaceables_.end())
+        childPlaceables_.erase(iter);
 }
 
 float3 EC_Placeable::Position() const
@@ -975,15 +1051,24 @@ float3 EC_Placeable::Scale() const
 float3x4 EC_Placeable::LocalToWorld() const
 {
     // If we are parented to an Ogre bone, we can't (yet) compute the local-to-world matrix ourselves,
-    // so query Ogre for the world matrix.
+    // so query Ogre for the world matrix. The result is not cached, since the bone can move without notifying us.
     if (!parentBone.Get().isEmpty() && sceneNode_)
         return float4x4(sceneNode_->_getFullTransform()).Float3x4Part();
 
+    if (!worldTransformDirty_)
+        return cachedLocalToWorld_;
+
     // Otherwise, compute the world matrix using our Tundra scene structures (not the Ogre scene structures, which can be out-of-date!)
     EC_Placeable *parentPlaceable = ParentPlaceableComponent();
     assert(parentPlaceable != this);
     float3x4 localToWorld = parentPlaceable ? (parentPlaceable->LocalToWorld() * LocalToParent()) : LocalToParent();
 
+    // The result can be cached only if the parent's world transform was.
+    worldDecompositionDirty_ = true;
+    worldTransformDirty_ = (parentPlaceable && parentPlaceable->worldTransformDirty_);
+    if (!worldTransformDirty_)
+        cachedLocalToWorld_ = localToWorld;
+
 #ifdef _DEBUG
     // But confirm to detect oddities when/if these two don't match.
     if (sceneNode_)
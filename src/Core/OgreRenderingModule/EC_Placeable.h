@@ -214,6 +214,8 @@ public slots:
     float3 Scale() const;
 
     /// Returns the concatenated world transformation of this placeable.
+    /** The world transform is cached, and recomputed only when the transform of this placeable or one of its parents, or the parenting
+        has changed since it was marked out of date. Placeables attached to a bone are not cached, since the bones move without notification. */
     float3x4 LocalToWorld() const;
     /// Returns the matrix that transforms objects from world space into the local coordinate space of this placeable.
     float3x4 WorldToLocal() const;
@@ -324,6 +326,9 @@ private:
     /// Handle attributechange
     void AttributesChanged();
 
+    /// Marks the cached world transform out of date when the transform or the parent bone is set without a change signal.
+    void AttributeChangedDisconnected(IAttribute *attribute);
+
     /// attaches scenenode to parent
     void AttachNode();
     
@@ -351,6 +356,35 @@ private:
     /// attached to scene hierarchy-flag
     bool attached_;
 
+    /// Marks the cached world transform of this placeable and its child placeables out of date.
+    void MarkWorldTransformDirty();
+
+    /// Sets the parent placeable, and registers this placeable as its child.
+    /** Connects to the destruction of the parent, so that this placeable always detaches before the parent is gone. */
+    void SetParentPlaceable(EC_Placeable *parent);
+
+    /// Clears the parent of the child placeables that are still attached. Called on destruction.
+    void ForgetChildPlaceables();
+
+    /// Adds or removes a child placeable whose cached world transform depends on this placeable.
+    void AddChildPlaceable(EC_Placeable *child);
+    void RemoveChildPlaceable(EC_Placeable *child); /**< @copydoc AddChildPlaceable */
+
+    /// Decomposes the cached world transform to the cached world orientation and scale, if they are out of date.
+    void UpdateWorldDecomposition() const;
+
+    /// Placeables attached to this placeable.
+    std::vector<EC_Placeable*> childPlaceables_;
+
+    /// Cached world transform, valid when worldTransformDirty_ is false.
+    /** If a placeable is dirty, so are all its child placeables. */
+    mutable float3x4 cachedLocalToWorld_;
+    /// Cached world orientation & scale, decomposed from cachedLocalToWorld_ when first needed.
+    mutable Quat cachedWorldOrientation_;
+    mutable float3 cachedWorldScale_;
+    mutable bool worldTransformDirty_;
+    mutable bool worldDecompositionDirty_;
+
     friend class BoneAttachmentListener;
     friend class CustomTagPoint;
 };
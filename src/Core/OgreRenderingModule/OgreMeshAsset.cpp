@@ -42,7 +42,7 @@ bool OgreMeshAsset::LoadFromFile(QString filename)
     QString cacheDiskSource;
     if (allowAsynchronous)
     {
-        cacheDiskSource = assetAPI->Cache()->FindInCache(Name());
+        cacheDiskSource = assetAPI->Cache()->FindNamedFileInCache(Name());
         if (cacheDiskSource.isEmpty())
             allowAsynchronous = false;
     }
@@ -71,7 +71,7 @@ bool OgreMeshAsset::DeserializeFromData(const u8 *data_, size_t numBytes, bool a
     QString cacheDiskSource;
     if (allowAsynchronous)
     {
-        cacheDiskSource = assetAPI->Cache()->FindInCache(Name());
+        cacheDiskSource = assetAPI->Cache()->FindNamedFileInCache(Name());
         if (cacheDiskSource.isEmpty())
             allowAsynchronous = false;
     }
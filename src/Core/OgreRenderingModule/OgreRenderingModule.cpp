@@ -147,15 +147,23 @@ void OgreRenderingModule::Load()
     textureExtensions << ".crn";
 
     // Create asset type factories for each asset OgreRenderingModule provides to the system.
-    framework_->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<OgreMeshAsset>, "OgreMesh", meshExtensions));
+    // Meshes, textures and skeletons do not refer to other assets, so identical data under different refs can share a single loaded asset.
+    shared_ptr<GenericAssetFactory<OgreMeshAsset> > meshFactory = MAKE_SHARED(GenericAssetFactory<OgreMeshAsset>, "OgreMesh", meshExtensions);
+    meshFactory->SetContentSharingAllowed(true);
+    framework_->Asset()->RegisterAssetTypeFactory(meshFactory);
 
     // Loading materials crashes Ogre in headless mode because we don't have Ogre Renderer running, so only register the Ogre material asset type if not in headless mode.
     if (!framework_->IsHeadless())
     {
+        shared_ptr<GenericAssetFactory<TextureAsset> > textureFactory = MAKE_SHARED(GenericAssetFactory<TextureAsset>, "Texture", textureExtensions);
+        textureFactory->SetContentSharingAllowed(true);
+        shared_ptr<GenericAssetFactory<OgreSkeletonAsset> > skeletonFactory = MAKE_SHARED(GenericAssetFactory<OgreSkeletonAsset>, "OgreSkeleton", ".skeleton");
+        skeletonFactory->SetContentSharingAllowed(true);
+
         framework_->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<OgreMaterialAsset>, "OgreMaterial", ".material"));
-        framework_->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<TextureAsset>, "Texture", textureExtensions));
+        framework_->Asset()->RegisterAssetTypeFactory(textureFactory);
         framework_->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<OgreParticleAsset>, "OgreParticle", ".particle"));
-        framework_->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(GenericAssetFactory<OgreSkeletonAsset>, "OgreSkeleton", ".skeleton"));
+        framework_->Asset()->RegisterAssetTypeFactory(skeletonFactory);
     }
     else
     {
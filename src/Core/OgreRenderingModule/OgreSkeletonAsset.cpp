@@ -54,7 +54,7 @@ bool OgreSkeletonAsset::DeserializeFromData(const u8 *data_, size_t numBytes, bo
         // We can only do threaded loading from disk, and not any disk location but only from asset cache.
         // local:// refs will return empty string here and those will fall back to the non-threaded loading.
         // Do not change this to do DiskCache() as that directory for local:// refs will not be a known resource location for ogre.
-        QString cacheDiskSource = assetAPI->GetAssetCache()->FindInCache(Name());
+        QString cacheDiskSource = assetAPI->GetAssetCache()->FindNamedFileInCache(Name());
         if (!cacheDiskSource.isEmpty())
         {
             QFileInfo fileInfo(cacheDiskSource);
@@ -61,7 +61,7 @@ bool TextureAsset::LoadFromFile(QString filename)
     QString cacheDiskSource;
     if (allowAsynchronous)
     {
-        cacheDiskSource = assetAPI->Cache()->FindInCache(Name());
+        cacheDiskSource = assetAPI->Cache()->FindNamedFileInCache(Name());
         if (cacheDiskSource.isEmpty())
             allowAsynchronous = false;
     }
@@ -215,7 +215,7 @@ bool TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes, bool all
     QString cacheDiskSource;
     if (allowAsynchronous)
     {
-        cacheDiskSource = assetAPI->Cache()->FindInCache(Name());
+        cacheDiskSource = assetAPI->Cache()->FindNamedFileInCache(Name());
         if (cacheDiskSource.isEmpty())
             allowAsynchronous = false;
     }
@@ -239,7 +239,7 @@ bool TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes, bool all
               into Ogre. 
         */
         QString nameInternal = NameInternal();
-        cacheDiskSource = assetAPI->GetAssetCache()->FindInCache(nameInternal);
+        cacheDiskSource = assetAPI->GetAssetCache()->FindNamedFileInCache(nameInternal);
         if (allowAsynchronous)
         {
             // Only decompress and store dds if the data is new or not in cache.
@@ -261,7 +261,10 @@ bool TextureAsset::DeserializeFromData(const u8 *data, size_t numBytes, bool all
                 if (crnUncompressData.size() == 0)
                     return false;
                 PROFILE(TextureAsset_DeserializeFromData_CRN_CacheStore);
-                cacheDiskSource = assetAPI->GetAssetCache()->StoreAsset(&crnUncompressData[0], crnUncompressData.size(), nameInternal);
+                // Write to the named cache file directly, a content-addressed blob could not be used for threaded loading.
+                cacheDiskSource = assetAPI->GetAssetCache()->GetDiskSourceByRef(nameInternal);
+                if (!SaveAssetFromMemoryToFile(&crnUncompressData[0], crnUncompressData.size(), cacheDiskSource))
+                    cacheDiskSource = "";
                 fileData.clear();
                 ELIFORP(TextureAsset_DeserializeFromData_CRN_CacheStore);
             }
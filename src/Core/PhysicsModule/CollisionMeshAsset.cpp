@@ -0,0 +1,54 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "CollisionMeshAsset.h"
+#include "AssetAPI.h"
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include "MemoryLeakCheck.h"
+
+CollisionMeshAsset::CollisionMeshAsset(AssetAPI *owner, const QString &type_, const QString &name_) :
+    IAsset(owner, type_, name_),
+    loaded(false)
+{
+}
+
+CollisionMeshAsset::~CollisionMeshAsset()
+{
+    Unload();
+}
+
+const QString &CollisionMeshAsset::TypeNameStatic()
+{
+    static const QString typeName("CollisionMesh");
+    return typeName;
+}
+
+bool CollisionMeshAsset::DeserializeFromData(const u8 *data_, size_t numBytes, bool /*allowAsynchronous*/)
+{
+    PROFILE(CollisionMeshAsset_DeserializeFromData);
+
+    Unload();
+
+    OgreMeshReader reader;
+    if (!reader.Read(data_, numBytes, geometry, Name()))
+        return false;
+
+    loaded = true;
+    assetAPI->AssetLoadCompleted(Name());
+    return true;
+}
+
+void CollisionMeshAsset::DoUnload()
+{
+    geometry.Clear();
+    loaded = false;
+}
+
+AssetPtr CollisionMeshAssetFactory::CreateEmptyAsset(AssetAPI *owner, const QString &name)
+{
+    return MAKE_SHARED(CollisionMeshAsset, owner, Type(), name);
+}
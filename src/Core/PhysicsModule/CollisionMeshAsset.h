@@ -0,0 +1,53 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "IAsset.h"
+#include "IAssetTypeFactory.h"
+#include "PhysicsModuleApi.h"
+#include "OgreMeshReader.h"
+
+/// Collision geometry of an Ogre binary mesh, loaded without Ogre.
+/** Used by EC_RigidBody in the headless mode instead of OgreMeshAsset, so that the full Ogre mesh resources do not need
+    to be loaded just for the physics. Only the vertex positions, triangle indices and bounds of the mesh are kept in memory. */
+class PHYSICS_MODULE_API CollisionMeshAsset : public IAsset
+{
+    Q_OBJECT
+
+public:
+    CollisionMeshAsset(AssetAPI *owner, const QString &type_, const QString &name_);
+    ~CollisionMeshAsset();
+
+    /// Returns the asset type name used for requesting Ogre meshes as collision meshes.
+    static const QString &TypeNameStatic();
+
+    /// IAsset override.
+    bool IsLoaded() const { return loaded; }
+
+    /// Returns the collision geometry of the mesh.
+    const OgreMeshGeometry &Geometry() const { return geometry; }
+
+protected:
+    /// IAsset override.
+    virtual bool DeserializeFromData(const u8 *data_, size_t numBytes, bool allowAsynchronous);
+
+private:
+    /// IAsset override.
+    virtual void DoUnload();
+
+    OgreMeshGeometry geometry;
+    bool loaded;
+};
+
+/// Creates CollisionMeshAssets. The type is only used when requested explicitly, so the factory does not claim any file extensions.
+class PHYSICS_MODULE_API CollisionMeshAssetFactory : public IAssetTypeFactory
+{
+public:
+    virtual const QString &Type() const { return CollisionMeshAsset::TypeNameStatic(); }
+    virtual const QStringList &TypeExtensions() const { return extensions; }
+    virtual AssetPtr CreateEmptyAsset(AssetAPI *owner, const QString &name);
+    virtual bool AllowsContentSharing() const { return true; }
+
+private:
+    const QStringList extensions;
+};
@@ -11,6 +11,8 @@
 
 #include <Ogre.h>
 
+#include <QDataStream>
+
 // Disable unreferenced formal parameter coming from Bullet
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -23,6 +25,9 @@
 
 #include "MemoryLeakCheck.h"
 
+/// Version of the serialized convex hull set data. Increment when the format changes.
+static const quint32 cConvexHullSetVersion = 1;
+
 namespace Physics
 {
 
@@ -30,8 +35,12 @@ void GenerateTriangleMesh(Ogre::Mesh* mesh, btTriangleMesh* ptr)
 {
     std::vector<float3> triangles;
     GetTrianglesFromMesh(mesh, triangles);
-    
-    for(uint i = 0; i < triangles.size(); i += 3)
+    GenerateTriangleMesh(triangles, ptr);
+}
+
+void GenerateTriangleMesh(const std::vector<float3>& triangles, btTriangleMesh* ptr)
+{
+    for(uint i = 0; i + 2 < triangles.size(); i += 3)
         ptr->addTriangle(triangles[i], triangles[i+1], triangles[i+2]);
 }
 
@@ -39,6 +48,11 @@ void GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr)
 {
     std::vector<float3> vertices;
     GetTrianglesFromMesh(mesh, vertices);
+    GenerateConvexHullSet(vertices, ptr);
+}
+
+void GenerateConvexHullSet(const std::vector<float3>& vertices, ConvexHullSet* ptr)
+{
     if (!vertices.size())
     {
         LogError("Mesh had no triangles; aborting convex hull generation");
@@ -73,6 +87,58 @@ void GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr)
     lib.ReleaseResult(result);
 }
 
+QByteArray SerializeConvexHullSet(const ConvexHullSet* ptr)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << cConvexHullSetVersion << (quint32)ptr->hulls_.size();
+    for(uint i = 0; i < ptr->hulls_.size(); ++i)
+    {
+        const ConvexHull &hull = ptr->hulls_[i];
+        const btVector3 *points = hull.hull_->getUnscaledPoints();
+        const int numPoints = hull.hull_->getNumPoints();
+        stream << hull.position_.x << hull.position_.y << hull.position_.z << (quint32)numPoints;
+        for(int j = 0; j < numPoints; ++j)
+            stream << (float)points[j].x() << (float)points[j].y() << (float)points[j].z();
+    }
+    return data;
+}
+
+bool DeserializeConvexHullSet(const QByteArray& data, ConvexHullSet* ptr)
+{
+    QDataStream stream(data);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 version = 0, numHulls = 0;
+    stream >> version >> numHulls;
+    if (stream.status() != QDataStream::Ok || version != cConvexHullSetVersion)
+        return false;
+    
+    std::vector<ConvexHull> hulls;
+    std::vector<float3> points;
+    for(quint32 i = 0; i < numHulls; ++i)
+    {
+        ConvexHull hull;
+        quint32 numPoints = 0;
+        stream >> hull.position_.x >> hull.position_.y >> hull.position_.z >> numPoints;
+        // Each point takes 12 bytes, so a corrupted count is detected before allocating
+        if (stream.status() != QDataStream::Ok || numPoints == 0 || (qint64)numPoints * 12 > data.size())
+            return false;
+        points.resize(numPoints);
+        for(quint32 j = 0; j < numPoints; ++j)
+            stream >> points[j].x >> points[j].y >> points[j].z;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+#include "DisableMemoryLeakCheck.h"
+        hull.hull_ = MAKE_SHARED(btConvexHullShape, (const btScalar*)&points[0], (int)numPoints, sizeof(float3));
+#include "EnableMemoryLeakCheck.h"
+        hulls.push_back(hull);
+    }
+    
+    ptr->hulls_.swap(hulls);
+    return true;
+}
+
 void GetTrianglesFromMesh(Ogre::Mesh* mesh, std::vector<float3>& dest)
 {
     dest.clear();
@@ -7,11 +7,21 @@
 #include "PhysicsModuleFwd.h"
 #include "Math/float3.h"
 
+#include <QByteArray>
+
 namespace Ogre { class Mesh; };
 
 namespace Physics
 {
     void PHYSICS_MODULE_API GenerateTriangleMesh(Ogre::Mesh* mesh, btTriangleMesh* ptr);
+    /// Generates a triangle mesh from triangles as returned by GetTrianglesFromMesh.
+    void PHYSICS_MODULE_API GenerateTriangleMesh(const std::vector<float3>& triangles, btTriangleMesh* ptr);
     void PHYSICS_MODULE_API GetTrianglesFromMesh(Ogre::Mesh* mesh, std::vector<float3>& dest);
     void PHYSICS_MODULE_API GenerateConvexHullSet(Ogre::Mesh* mesh, ConvexHullSet* ptr);
+    /// Generates a convex hull set from triangles as returned by GetTrianglesFromMesh.
+    void PHYSICS_MODULE_API GenerateConvexHullSet(const std::vector<float3>& vertices, ConvexHullSet* ptr);
+    /// Serializes the hulls of a convex hull set for storing them to disk.
+    QByteArray PHYSICS_MODULE_API SerializeConvexHullSet(const ConvexHullSet* ptr);
+    /// Deserializes a convex hull set serialized with SerializeConvexHullSet. Returns false if the data is invalid.
+    bool PHYSICS_MODULE_API DeserializeConvexHullSet(const QByteArray& data, ConvexHullSet* ptr);
 }
@@ -117,6 +117,11 @@ void EC_PhysicsConstraint::AttributesChanged()
     bool applyAttributes = false;
     bool applyLimits = false;
 
+    // The constraint is read by a threaded simulation step, so wait for the step in progress before modifying it
+    PhysicsWorld *world = physicsWorld_.lock().get();
+    if (world)
+        world->WaitForSimulation();
+
     if (enabled.ValueChanged())
     {
         if (constraint_)
@@ -159,6 +164,9 @@ void EC_PhysicsConstraint::Create()
 
     Remove();
 
+    // Constructing the constraint reads the Bullet bodies, so a threaded simulation step must not be in progress
+    physicsWorld_.lock()->WaitForSimulation();
+
     rigidBody_ = ParentEntity()->Component<EC_RigidBody>();
 
     /// \todo If the other entity is not yet loaded, the constraint will be mistakenly created as a static one
@@ -257,6 +265,10 @@ void EC_PhysicsConstraint::Remove()
 {
     if (constraint_)
     {
+        PhysicsWorld *world = physicsWorld_.lock().get();
+        if (world)
+            world->WaitForSimulation();
+
         EC_RigidBody *ownRigidComp = rigidBody_.lock().get();
         EC_RigidBody *otherRigidComp = otherRigidBody_.lock().get();
         if (otherRigidComp && otherRigidComp->BulletRigidBody())
@@ -264,7 +276,6 @@ void EC_PhysicsConstraint::Remove()
         if (ownRigidComp && ownRigidComp->BulletRigidBody())
             ownRigidComp->BulletRigidBody()->removeConstraintRef(constraint_);
 
-        PhysicsWorld *world = physicsWorld_.lock().get();
         if (world && world->BulletWorld())
             world->BulletWorld()->removeConstraint(constraint_);
 
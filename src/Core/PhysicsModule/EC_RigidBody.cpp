@@ -7,6 +7,7 @@
 #define MATH_BULLET_INTEROP
 #include "EC_RigidBody.h"
 #include "ConvexHull.h"
+#include "CollisionMeshAsset.h"
 #include "PhysicsModule.h"
 #include "PhysicsUtils.h"
 #include "PhysicsWorld.h"
@@ -44,12 +45,16 @@ struct EC_RigidBody::Impl : public btMotionState
         body(0),
         world(0),
         shape(0),
-        childShape(0),
         heightField(0),
+        heightFieldMinY(0.f),
+        heightFieldMaxY(0.f),
         disconnected(false),
         cachedShapeType(-1),
         cachedSize(float3::zero),
         clientExtrapolating(false),
+        lastSetPosition(float3::zero),
+        lastSetOrientation(Quat::identity),
+        transformSetSerial(0),
         rigidBody(rb)
     {
     }
@@ -57,6 +62,14 @@ struct EC_RigidBody::Impl : public btMotionState
     /// btMotionState override. Called when Bullet wants us to tell the body's initial transform
     void getWorldTransform(btTransform &worldTrans) const
     {
+        // In the threaded mode Bullet queries kinematic bodies from the physics thread, which must not touch the placeable
+        if (world && world->IsThreaded())
+        {
+            worldTrans.setOrigin(lastSetPosition);
+            worldTrans.setRotation(lastSetOrientation);
+            return;
+        }
+
         if (placeable.expired())
             return;
 
@@ -69,6 +82,19 @@ struct EC_RigidBody::Impl : public btMotionState
 
     /// btMotionState override. Called when Bullet wants to tell us the body's current transform
     void setWorldTransform(const btTransform &worldTrans)
+    {
+        // In the threaded mode this is called from the physics thread, so only record the state for PhysicsWorld to apply on the main thread
+        if (world && world->IsThreaded())
+        {
+            world->StoreRigidBodyState(rigidBody, worldTrans, body->getLinearVelocity(), RadToDeg(body->getAngularVelocity()));
+            return;
+        }
+
+        ApplyTransform(worldTrans.getOrigin(), worldTrans.getRotation(), body->getLinearVelocity(), RadToDeg(body->getAngularVelocity()));
+    }
+
+    /// Applies a simulated transform and velocities to the placeable and the velocity attributes
+    void ApplyTransform(float3 position, Quat orientation, const float3 &linearVel, const float3 &angularVel)
     {
         /// \todo For a large scene, applying the changed transforms of rigid bodies is slow (slower than the physics simulation itself,
         /// or handling collisions) due to the large number of Qt signals being fired.
@@ -88,10 +114,6 @@ struct EC_RigidBody::Impl : public btMotionState
     
         AttributeChange::Type changeType = hasAuthority ? AttributeChange::Default : AttributeChange::LocalOnly;
 
-        // Set transform
-        float3 position = worldTrans.getOrigin();
-        Quat orientation = worldTrans.getRotation();
-    
         // Non-parented case
         if (p->parentRef.Get().IsEmpty())
         {
@@ -118,18 +140,13 @@ struct EC_RigidBody::Impl : public btMotionState
             }
         }
         // Set linear & angular velocity
-        if (body)
-        {
-            // Performance optimization: because applying each attribute causes signals to be fired, which is slow in a large scene
-            // (and furthermore, on a server, causes each connection's sync state to be accessed), do not set the linear/angular
-            // velocities if they haven't changed
-            float3 linearVel = body->getLinearVelocity();
-            float3 angularVel = RadToDeg(body->getAngularVelocity());
-            if (!linearVel.Equals(rigidBody->linearVelocity.Get()))
-                rigidBody->linearVelocity.Set(linearVel, changeType);
-            if (!angularVel.Equals(rigidBody->angularVelocity.Get()))
-                rigidBody->angularVelocity.Set(angularVel, changeType);
-        }
+        // Performance optimization: because applying each attribute causes signals to be fired, which is slow in a large scene
+        // (and furthermore, on a server, causes each connection's sync state to be accessed), do not set the linear/angular
+        // velocities if they haven't changed
+        if (!linearVel.Equals(rigidBody->linearVelocity.Get()))
+            rigidBody->linearVelocity.Set(linearVel, changeType);
+        if (!angularVel.Equals(rigidBody->angularVelocity.Get()))
+            rigidBody->angularVelocity.Set(angularVel, changeType);
     
         disconnected = false;
     }
@@ -180,8 +197,6 @@ struct EC_RigidBody::Impl : public btMotionState
     btRigidBody* body;
     /// Bullet collision shape
     btCollisionShape* shape;
-    /// Bullet collision child shape. This is needed to use btScaledBvhTriangleMeshShape
-    btCollisionShape* childShape;
     /// Physics world. May be 0 if the scene does not have a physics world. In that case most of EC_RigidBody's functionality is a no-op
     PhysicsWorld* world;
     /// PhysicsModule pointer
@@ -190,14 +205,23 @@ struct EC_RigidBody::Impl : public btMotionState
     int cachedShapeType;
     /// Cached shapesize (last created)
     float3 cachedSize;
-    /// Bullet triangle mesh
-    shared_ptr<btTriangleMesh> triangleMesh;
+    /// Bullet triangle mesh shape, shared by all rigid bodies with the same collision mesh. Used through btScaledBvhTriangleMeshShape to allow for individual scaling.
+    shared_ptr<btBvhTriangleMeshShape> triangleMeshShape;
     /// Convex hull set
     shared_ptr<ConvexHullSet> convexHullSet;
     /// Bullet heightfield shape. Note: this is always put inside a compound shape (impl->shape)
     btHeightfieldTerrainShape* heightField;
-    /// Heightfield values, for the case the shape is a heightfield.
-    std::vector<float> heightValues;
+    /// Heightfield values, for the case the shape is a heightfield. Shared with the terrain, see EC_Terrain::HeightGrid.
+    shared_ptr<const std::vector<float> > heightValues;
+    /// The height range the heightfield shape was created with.
+    float heightFieldMinY;
+    float heightFieldMaxY;
+    /// World position last set to the body from the main thread. Returned to Bullet in the threaded mode.
+    float3 lastSetPosition;
+    /// World orientation last set to the body from the main thread. Returned to Bullet in the threaded mode.
+    Quat lastSetOrientation;
+    /// PhysicsWorld step serial at the time the transform was last set from the main thread.
+    u32 transformSetSerial;
 };
 
 EC_RigidBody::EC_RigidBody(Scene* scene) :
@@ -221,6 +245,7 @@ EC_RigidBody::EC_RigidBody(Scene* scene) :
     INIT_ATTRIBUTE_VALUE(collisionMask, "Collision Mask", -1),
     INIT_ATTRIBUTE_VALUE(rollingFriction, "Rolling friction", 0.5f),
     INIT_ATTRIBUTE_VALUE(useGravity, "Use gravity", true),
+    INIT_ATTRIBUTE_VALUE(collisionReporting, "Collision reporting", true),
     impl(new Impl(this))
 {
     static AttributeMetadata shapemetadata;
@@ -296,13 +321,7 @@ void EC_RigidBody::ApplyForce(const float3& force, const float3& position)
     if (!impl->body)
         CreateBody();
     if (impl->body)
-    {
-        Activate();
-        if (position == float3::zero)
-            impl->body->applyCentralForce(force);
-        else
-            impl->body->applyForce(force, position);
-    }
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::ApplyForce, force, position));
 }
 
 void EC_RigidBody::ApplyTorque(const float3& torque)
@@ -318,10 +337,7 @@ void EC_RigidBody::ApplyTorque(const float3& torque)
     if (!impl->body)
         CreateBody();
     if (impl->body)
-    {
-        Activate();
-        impl->body->applyTorque(torque);
-    }
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::ApplyTorque, torque));
 }
 
 void EC_RigidBody::ApplyImpulse(const float3& impulse, const float3& position)
@@ -337,13 +353,7 @@ void EC_RigidBody::ApplyImpulse(const float3& impulse, const float3& position)
     if (!impl->body)
         CreateBody();
     if (impl->body)
-    {
-        Activate();
-        if (position == float3::zero)
-            impl->body->applyCentralImpulse(impulse);
-        else
-            impl->body->applyImpulse(impulse, position);
-    }
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::ApplyImpulse, impulse, position));
 }
 
 void EC_RigidBody::ApplyTorqueImpulse(const float3& torqueImpulse)
@@ -359,10 +369,7 @@ void EC_RigidBody::ApplyTorqueImpulse(const float3& torqueImpulse)
     if (!impl->body)
         CreateBody();
     if (impl->body)
-    {
-        Activate();
-        impl->body->applyTorqueImpulse(torqueImpulse);
-    }
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::ApplyTorqueImpulse, torqueImpulse));
 }
 
 void EC_RigidBody::Activate()
@@ -374,17 +381,18 @@ void EC_RigidBody::Activate()
     if (!impl->body)
         CreateBody();
     if (impl->body)
-        impl->body->activate();
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::Activate));
 }
 
 void EC_RigidBody::KeepActive()
 {
     if (impl->body)
-        impl->body->activate(true);
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::KeepActive));
 }
 
 bool EC_RigidBody::IsActive()
 {
+    WaitForSimulation();
     if (impl->body)
         return impl->body->isActive();
     else
@@ -400,7 +408,7 @@ void EC_RigidBody::ResetForces()
     if (!impl->body)
         CreateBody();
     if (impl->body)
-        impl->body->clearForces();
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::ClearForces));
 }
 
 void EC_RigidBody::UpdateSignals()
@@ -440,6 +448,7 @@ void EC_RigidBody::CheckForPlaceableAndTerrain()
         {
             impl->terrain = terrain;
             connect(terrain.get(), SIGNAL(TerrainRegenerated()), this, SLOT(OnTerrainRegenerated()));
+            connect(terrain.get(), SIGNAL(HeightGridAboutToChange()), this, SLOT(OnTerrainHeightGridAboutToChange()));
             connect(terrain.get(), SIGNAL(AttributeChanged(IAttribute*, AttributeChange::Type)), this, SLOT(TerrainUpdated(IAttribute*)));
         }
     }
@@ -474,12 +483,9 @@ void EC_RigidBody::CreateCollisionShape()
         impl->shape = new btCapsuleShape(sizeVec.x * 0.5f, sizeVec.y * 0.5f);
         break;
     case Shape_TriMesh:
-        if (impl->triangleMesh)
-        {
-            // Need to first create a bvhTriangleMeshShape, then a scaled version of it to allow for individual scaling.
-            impl->childShape = new btBvhTriangleMeshShape(impl->triangleMesh.get(), true, true);
-            impl->shape = new btScaledBvhTriangleMeshShape(static_cast<btBvhTriangleMeshShape*>(impl->childShape), btVector3(1.0f, 1.0f, 1.0f));
-        }
+        // The BVH is built only once per mesh, so scale the shared shape for this body
+        if (impl->triangleMeshShape)
+            impl->shape = new btScaledBvhTriangleMeshShape(impl->triangleMeshShape.get(), btVector3(1.0f, 1.0f, 1.0f));
         break;
     case Shape_HeightField:
         CreateHeightFieldFromTerrain();
@@ -500,13 +506,13 @@ void EC_RigidBody::CreateCollisionShape()
 
 void EC_RigidBody::RemoveCollisionShape()
 {
+    WaitForSimulation();
     if (impl->shape)
     {
         if (impl->body)
             impl->body->setCollisionShape(0);
         SAFE_DELETE(impl->shape);
     }
-    SAFE_DELETE(impl->childShape);
     SAFE_DELETE(impl->heightField);
 }
 
@@ -525,6 +531,14 @@ void EC_RigidBody::CreateBody()
     
     impl->GetProperties(localInertia, m, collisionFlags);
     
+    // In the threaded mode Bullet gets the transform from the last set one, see Impl::getWorldTransform
+    EC_Placeable *placeable = impl->placeable.lock().get();
+    if (placeable)
+    {
+        impl->lastSetPosition = placeable->WorldPosition();
+        impl->lastSetOrientation = placeable->WorldOrientation();
+    }
+    
     impl->body = new btRigidBody(m, impl, impl->shape, localInertia);
     // TEST: Adjust the threshold of when to sleep the object - for reducing network bandwidth.
 //    impl->body->setSleepingThresholds(0.2f, 0.5f); // Bullet defaults are 0.8 and 1.0.
@@ -568,6 +582,7 @@ void EC_RigidBody::RemoveBody()
     if (impl->body && impl->world)
     {
         impl->world->BulletWorld()->removeRigidBody(impl->body);
+        impl->world->RigidBodyRemoved(this);
         SAFE_DELETE(impl->body);
     }
 }
@@ -584,12 +599,50 @@ btRigidBody* EC_RigidBody::BulletRigidBody() const
 
 void EC_RigidBody::OnTerrainRegenerated()
 {
-    if (shapeType.Get() == Shape_HeightField)
-        CreateCollisionShape();
+    if (shapeType.Get() != Shape_HeightField)
+        return;
+
+    // The heightfield shape reads the height values of the terrain directly, so the edits the terrain makes in place are seen without
+    // recreating the shape, unless they go outside the height range the shape was created with.
+    EC_Terrain* terrain = impl->terrain.lock().get();
+    if (impl->heightField && terrain && terrain->HeightGrid() == impl->heightValues)
+    {
+        float minY, maxY;
+        terrain->HeightGridRange(minY, maxY);
+        if (minY >= impl->heightFieldMinY && maxY <= impl->heightFieldMaxY)
+            return;
+    }
+    CreateCollisionShape();
+}
+
+void EC_RigidBody::OnTerrainHeightGridAboutToChange()
+{
+    // The heightfield shape reads the grid the terrain edits in place, so a step must not be running in the physics thread meanwhile.
+    if (impl->heightField)
+        WaitForSimulation();
 }
 
 void EC_RigidBody::OnCollisionMeshAssetLoaded(AssetPtr asset)
 {
+    CollisionMeshAsset *collisionMeshAsset = dynamic_cast<CollisionMeshAsset*>(asset.get());
+    if (collisionMeshAsset)
+    {
+        if (shapeType.Get() == Shape_TriMesh)
+        {
+            impl->triangleMeshShape = impl->owner->GetBvhTriangleMeshShapeFromCollisionMesh(collisionMeshAsset);
+            CreateCollisionShape();
+        }
+        if (shapeType.Get() == Shape_ConvexHull)
+        {
+            impl->convexHullSet = impl->owner->GetConvexHullSetFromCollisionMesh(collisionMeshAsset);
+            CreateCollisionShape();
+        }
+
+        impl->cachedShapeType = shapeType.Get();
+        impl->cachedSize = size.Get();
+        return;
+    }
+
     OgreMeshAsset *meshAsset = dynamic_cast<OgreMeshAsset*>(asset.get());
     if (!meshAsset || !meshAsset->ogreMesh.get())
         LogError("EC_RigidBody::OnCollisionMeshAssetLoaded: Mesh asset load finished for asset \"" +
@@ -601,7 +654,7 @@ void EC_RigidBody::OnCollisionMeshAssetLoaded(AssetPtr asset)
     {
         if (shapeType.Get() == Shape_TriMesh)
         {
-            impl->triangleMesh = impl->owner->GetTriangleMeshFromOgreMesh(mesh);
+            impl->triangleMeshShape = impl->owner->GetBvhTriangleMeshShapeFromOgreMesh(mesh);
             CreateCollisionShape();
         }
         if (shapeType.Get() == Shape_ConvexHull)
@@ -627,6 +680,15 @@ void EC_RigidBody::AttributesChanged()
     if (!impl->body)
         return;
     
+    // Velocity changes are passed to a threaded simulation as commands, other changes need the step in progress to complete first
+    const AttributeVector &attrs = Attributes();
+    for(size_t i = 0; i < attrs.size(); ++i)
+        if (attrs[i] && attrs[i]->ValueChanged() && attrs[i] != &linearVelocity && attrs[i] != &angularVelocity)
+        {
+            WaitForSimulation();
+            break;
+        }
+    
     if (mass.ValueChanged() || collisionLayer.ValueChanged() || collisionMask.ValueChanged())
         // Readd body to the world in case static/dynamic classification changed, or if collision mask changed
         ReaddBody();
@@ -700,16 +762,10 @@ void EC_RigidBody::AttributesChanged()
     }
     
     if (linearVelocity.ValueChanged() && !impl->disconnected)
-    {
-        impl->body->setLinearVelocity(linearVelocity.Get());
-        impl->body->activate();
-    }
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::SetLinearVelocity, linearVelocity.Get()));
     
     if (angularVelocity.ValueChanged() && !impl->disconnected)
-    {
-        impl->body->setAngularVelocity(DegToRad(angularVelocity.Get()));
-        impl->body->activate();
-    }
+        SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::SetAngularVelocity, angularVelocity.Get()));
     
     if (useGravity.ValueChanged())
         UpdateGravity();
@@ -730,12 +786,9 @@ void EC_RigidBody::PlaceableUpdated(IAttribute* attribute)
         // Important: when changing both transform and parent, always set parentref first, then transform
         // Otherwise the physics simulation may interpret things wrong and the object ends up
         // in an unintended location
+        // Note: the inertia tensor is recomputed when the position & rotation are applied
         UpdatePosRotFromPlaceable();
         UpdateScale();
-
-        // Since we programmatically changed the orientation of the object outside the simulation, we must recompute the 
-        // inertia tensor matrix of the object manually (it's dependent on the world space orientation of the object)
-        impl->body->updateInertiaTensor();
     }
 }
 
@@ -766,13 +819,7 @@ void EC_RigidBody::SetRotation(const float3& rotation)
         placeable->transform.Set(trans, AttributeChange::Default);
         
         if (impl->body)
-        {
-            btTransform& worldTrans = impl->body->getWorldTransform();
-            btTransform interpTrans = impl->body->getInterpolationWorldTransform();
-            worldTrans.setRotation(trans.Orientation());
-            interpTrans.setRotation(worldTrans.getRotation());
-            impl->body->setInterpolationWorldTransform(interpTrans);
-        }
+            SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::SetRotation, float3::zero, float3::zero, trans.Orientation()));
     }
     
     impl->disconnected = false;
@@ -794,13 +841,7 @@ void EC_RigidBody::Rotate(const float3& rotation)
         placeable->transform.Set(trans, AttributeChange::Default);
         
         if (impl->body)
-        {
-            btTransform& worldTrans = impl->body->getWorldTransform();
-            btTransform interpTrans = impl->body->getInterpolationWorldTransform();
-            worldTrans.setRotation(trans.Orientation());
-            interpTrans.setRotation(worldTrans.getRotation());
-            impl->body->setInterpolationWorldTransform(interpTrans);
-        }
+            SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::SetRotation, float3::zero, float3::zero, trans.Orientation()));
     }
     
     impl->disconnected = false;
@@ -813,7 +854,8 @@ PhysicsWorld* EC_RigidBody::World() const
 
 float3 EC_RigidBody::GetLinearVelocity()
 {
-    if (impl->body)
+    // While the physics thread is stepping, the attribute holds the latest applied state
+    if (impl->body && !(impl->world && impl->world->IsSimulating()))
         return impl->body->getLinearVelocity();
     else 
         return linearVelocity.Get();
@@ -821,7 +863,7 @@ float3 EC_RigidBody::GetLinearVelocity()
 
 float3 EC_RigidBody::GetAngularVelocity()
 {
-    if (impl->body)
+    if (impl->body && !(impl->world && impl->world->IsSimulating()))
         return RadToDeg(impl->body->getAngularVelocity());
     else
         return angularVelocity.Get();
@@ -829,6 +871,7 @@ float3 EC_RigidBody::GetAngularVelocity()
 
 void EC_RigidBody::GetAabbox(float3 &outAabbMin, float3 &outAabbMax)
 {
+    WaitForSimulation();
     btVector3 aabbMin, aabbMax;
     impl->body->getAabb(aabbMin, aabbMax);
     outAabbMin.Set(aabbMin.x(), aabbMin.y(), aabbMin.z());
@@ -845,6 +888,7 @@ bool EC_RigidBody::HasAuthority() const
 
 AABB EC_RigidBody::ShapeAABB() const
 {
+    WaitForSimulation();
     btVector3 aabbMin, aabbMax;
     impl->body->getAabb(aabbMin, aabbMax);
     return AABB(aabbMin, aabbMax);
@@ -894,8 +938,12 @@ void EC_RigidBody::RequestMesh()
 
     if (!collisionMesh.isEmpty())
     {
-        // Do not create shape right now, but request the mesh resource
-        AssetTransferPtr transfer = GetFramework()->Asset()->RequestAsset(collisionMesh);
+        // Do not create shape right now, but request the mesh resource. Headless servers need only the collision
+        // geometry of Ogre binary meshes, so request them as collision meshes which are not loaded into Ogre.
+        QString assetType;
+        if (GetFramework()->IsHeadless() && collisionMesh.endsWith(".mesh", Qt::CaseInsensitive))
+            assetType = CollisionMeshAsset::TypeNameStatic();
+        AssetTransferPtr transfer = GetFramework()->Asset()->RequestAsset(collisionMesh, assetType);
         if (transfer)
             connect(transfer.get(), SIGNAL(Succeeded(AssetPtr)), SLOT(OnCollisionMeshAssetLoaded(AssetPtr)), Qt::UniqueConnection);
     }
@@ -921,10 +969,17 @@ void EC_RigidBody::UpdateScale()
         // Note: for now, world scale is purposefully NOT used, because it would be problematic to change the scale when a parenting change occurs
         const float3& scale = placeable->transform.Get().scale;
         // Trianglemesh or convexhull does not have scaling of its own in the shape, so multiply with the size
+        btVector3 scaling;
         if (shapeType.Get() != Shape_TriMesh && shapeType.Get() != Shape_ConvexHull)
-            impl->shape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+            scaling = btVector3(scale.x, scale.y, scale.z);
         else
-            impl->shape->setLocalScaling(btVector3(sizeVec.x * scale.x, sizeVec.y * scale.y, sizeVec.z * scale.z));
+            scaling = btVector3(sizeVec.x * scale.x, sizeVec.y * scale.y, sizeVec.z * scale.z);
+        // Placeable changes are mostly moves, so do not wait for a threaded simulation step unless the scaling actually changes
+        if (scaling != impl->shape->getLocalScaling())
+        {
+            WaitForSimulation();
+            impl->shape->setLocalScaling(scaling);
+        }
     }
 }
 
@@ -933,6 +988,8 @@ void EC_RigidBody::UpdateGravity()
     if (!impl->body || !impl->world)
         return;
     
+    WaitForSimulation();
+    
     int flags = impl->body->getFlags();
     if (useGravity.Get())
     {
@@ -956,34 +1013,27 @@ void EC_RigidBody::CreateHeightFieldFromTerrain()
     if (!terrain)
         return;
     
-    uint width = terrain->PatchWidth() * EC_Terrain::cPatchSize;
-    uint height = terrain->PatchHeight() * EC_Terrain::cPatchSize;
+    uint width = terrain->VerticesWidth();
+    uint height = terrain->VerticesHeight();
     if (!width || !height)
         return;
     
-    impl->heightValues.resize(width * height);
+    // Refer to the height values of the terrain instead of copying them. The terrain lays them out in the same row-major order as Bullet.
+    impl->heightValues = terrain->HeightGrid();
     
     float xzSpacing = 1.0f;
     float ySpacing = 1.0f;
-    float minY = 1000000000;
-    float maxY = -1000000000;
-    for(uint z = 0; z < height; ++z)
-        for(uint x = 0; x < width; ++x)
-        {
-            float value = terrain->GetPoint(x, z);
-            if (value < minY)
-                minY = value;
-            if (value > maxY)
-                maxY = value;
-            impl->heightValues[z * width + x] = value;
-        }
+    float minY, maxY;
+    terrain->HeightGridRange(minY, maxY);
+    impl->heightFieldMinY = minY;
+    impl->heightFieldMaxY = maxY;
 
     float3 scale = terrain->nodeTransformation.Get().scale;
     float3 bbMin(0, minY, 0);
     float3 bbMax(xzSpacing * (width - 1), maxY, xzSpacing * (height - 1));
     float3 bbCenter = scale.Mul((bbMin + bbMax) * 0.5f);
     
-    impl->heightField = new btHeightfieldTerrainShape(width, height, &impl->heightValues[0], ySpacing, minY, maxY, 1, PHY_FLOAT, false);
+    impl->heightField = new btHeightfieldTerrainShape(width, height, const_cast<float*>(&(*impl->heightValues)[0]), ySpacing, minY, maxY, 1, PHY_FLOAT, false);
     
     /** \todo EC_Terrain uses its own transform that is independent of the placeable. It is not nice to support, since rest of EC_RigidBody assumes
         the transform is in the placeable. Right now, we only support position & scaling. Here, we also counteract Bullet's nasty habit to center 
@@ -1029,20 +1079,18 @@ void EC_RigidBody::UpdatePosRotFromPlaceable()
     if (!placeable || !impl->body)
         return;
     
-    float3 position = placeable->WorldPosition();
-    Quat orientation = placeable->WorldOrientation();
+    SubmitCommand(RigidBodyCommand(this, RigidBodyCommand::SetPosRot, float3::zero, placeable->WorldPosition(), placeable->WorldOrientation()));
+}
 
-    btTransform& worldTrans = impl->body->getWorldTransform();
-    worldTrans.setOrigin(position);
-    worldTrans.setRotation(orientation);
-    
-    // When we forcibly set the physics transform, also set the interpolation transform to prevent jerky motion
-    btTransform interpTrans = impl->body->getInterpolationWorldTransform();
-    interpTrans.setOrigin(worldTrans.getOrigin());
-    interpTrans.setRotation(worldTrans.getRotation());
-    impl->body->setInterpolationWorldTransform(interpTrans);
-    
-    KeepActive();
+void EC_RigidBody::SetCollisionReporting(bool enable)
+{
+    collisionReporting.Set(enable, AttributeChange::Default);
+}
+
+bool EC_RigidBody::IsCollisionReportingEnabled() const
+{
+    // Note: this is read by the physics thread during a step, which only causes a collision to be reported or not one step late
+    return collisionReporting.Get();
 }
 
 void EC_RigidBody::EmitPhysicsCollision(Entity* otherEntity, const float3& position, const float3& normal, float distance, float impulse, bool newCollision)
@@ -1051,3 +1099,112 @@ void EC_RigidBody::EmitPhysicsCollision(Entity* otherEntity, const float3& posit
     emit PhysicsCollision(otherEntity, position, normal, distance, impulse, newCollision);
 }
 
+void EC_RigidBody::SubmitCommand(const RigidBodyCommand &command)
+{
+    if (impl->world && impl->world->IsSimulating())
+        impl->world->QueueCommand(command);
+    else
+        ApplyCommand(command);
+}
+
+void EC_RigidBody::ApplyCommand(const RigidBodyCommand &command)
+{
+    btRigidBody *body = impl->body;
+    if (!body)
+        return;
+    
+    switch(command.type)
+    {
+    case RigidBodyCommand::ApplyForce:
+        body->activate();
+        if (command.pos == float3::zero)
+            body->applyCentralForce(command.vec);
+        else
+            body->applyForce(command.vec, command.pos);
+        break;
+    case RigidBodyCommand::ApplyTorque:
+        body->activate();
+        body->applyTorque(command.vec);
+        break;
+    case RigidBodyCommand::ApplyImpulse:
+        body->activate();
+        if (command.pos == float3::zero)
+            body->applyCentralImpulse(command.vec);
+        else
+            body->applyImpulse(command.vec, command.pos);
+        break;
+    case RigidBodyCommand::ApplyTorqueImpulse:
+        body->activate();
+        body->applyTorqueImpulse(command.vec);
+        break;
+    case RigidBodyCommand::SetLinearVelocity:
+        body->setLinearVelocity(command.vec);
+        body->activate();
+        break;
+    case RigidBodyCommand::SetAngularVelocity:
+        body->setAngularVelocity(DegToRad(command.vec));
+        body->activate();
+        break;
+    case RigidBodyCommand::SetPosRot:
+    {
+        btTransform& worldTrans = body->getWorldTransform();
+        worldTrans.setOrigin(command.pos);
+        worldTrans.setRotation(command.rot);
+        
+        // When we forcibly set the physics transform, also set the interpolation transform to prevent jerky motion
+        btTransform interpTrans = body->getInterpolationWorldTransform();
+        interpTrans.setOrigin(worldTrans.getOrigin());
+        interpTrans.setRotation(worldTrans.getRotation());
+        body->setInterpolationWorldTransform(interpTrans);
+        
+        // Since we programmatically changed the orientation of the object outside the simulation, we must recompute the 
+        // inertia tensor matrix of the object manually (it's dependent on the world space orientation of the object)
+        body->updateInertiaTensor();
+        body->activate(true);
+        
+        impl->lastSetPosition = command.pos;
+        impl->lastSetOrientation = command.rot;
+        if (impl->world)
+            impl->transformSetSerial = impl->world->stepSerial_;
+        break;
+    }
+    case RigidBodyCommand::SetRotation:
+    {
+        btTransform& worldTrans = body->getWorldTransform();
+        btTransform interpTrans = body->getInterpolationWorldTransform();
+        worldTrans.setRotation(command.rot);
+        interpTrans.setRotation(worldTrans.getRotation());
+        body->setInterpolationWorldTransform(interpTrans);
+        
+        impl->lastSetPosition = worldTrans.getOrigin();
+        impl->lastSetOrientation = command.rot;
+        if (impl->world)
+            impl->transformSetSerial = impl->world->stepSerial_;
+        break;
+    }
+    case RigidBodyCommand::Activate:
+        body->activate();
+        break;
+    case RigidBodyCommand::KeepActive:
+        body->activate(true);
+        break;
+    case RigidBodyCommand::ClearForces:
+        body->clearForces();
+        break;
+    }
+}
+
+void EC_RigidBody::ApplySimulatedState(const float3 &position, const Quat &orientation, const float3 &linearVel, const float3 &angularVel, u32 stepSerial)
+{
+    // If the transform was set after the step was started, the simulated state is already outdated
+    if (impl->transformSetSerial == stepSerial)
+        return;
+    
+    impl->ApplyTransform(position, orientation, linearVel, angularVel);
+}
+
+void EC_RigidBody::WaitForSimulation() const
+{
+    if (impl->world)
+        impl->world->WaitForSimulation();
+}
@@ -59,6 +59,8 @@
     <div>@copydoc rollingFriction</div>
     <li>bool: useGravity
     <div>@copydoc useGravity</div>
+    <li>bool: collisionReporting
+    <div>@copydoc collisionReporting</div>
     </ul>
 
     <b>Exposes the following scriptable functions:</b>
@@ -201,6 +203,13 @@ public:
     Q_PROPERTY(bool useGravity READ getuseGravity WRITE setuseGravity)
     DEFINE_QPROPERTY_ATTRIBUTE(bool, useGravity)
 
+    /// Collision reporting enable. If true (default), the collisions of this body are reported.
+    /** Disable for bodies whose collisions nobody is interested in, e.g. static level geometry, to save the work of collecting
+        them. A collision is reported, also by the PhysicsWorld collision signals, if either of the bodies has reporting enabled,
+        but PhysicsCollision is emitted only on the bodies that have it enabled. */
+    Q_PROPERTY(bool collisionReporting READ getcollisionReporting WRITE setcollisionReporting)
+    DEFINE_QPROPERTY_ATTRIBUTE(bool, collisionReporting)
+
     void SetClientExtrapolating(bool isClientExtrapolating);
 
     btRigidBody* BulletRigidBody() const;
@@ -215,17 +224,22 @@ public:
 
 signals:
     /// A physics collision has happened between this rigid body and another entity
-    /** If there are several contact points, the signal will be sent multiple times for each contact.
+    /** The signal is sent once per colliding entity on each simulation step, with the contact points aggregated.
+        Not emitted if collisionReporting is disabled.
         @param otherEntity The second entity
-        @param position World position of collision
-        @param normal World normal of collision
-        @param distance Contact distance
-        @param impulse Impulse applied to the objects to separate them
-        @param newCollision True if same collision did not happen on the previous frame.
-        If collision has multiple contact points, newCollision can only be true for the first of them. */
+        @param position World position of the contact with the strongest impulse
+        @param normal Average world normal of the contacts
+        @param distance Smallest contact distance
+        @param impulse Strongest impulse applied to the objects to separate them
+        @param newCollision True if same collision did not happen on the previous step. */
     void PhysicsCollision(Entity* otherEntity, const float3& position, const float3& normal, float distance, float impulse, bool newCollision);
 
 public slots:
+    /// Sets the collisionReporting attribute.
+    void SetCollisionReporting(bool enable);
+    /// Returns whether the collisions of this body are reported, see collisionReporting.
+    bool IsCollisionReportingEnabled() const;
+
     /// Set collision mesh from visible mesh. Also sets mass 0 (static) because trimeshes cannot move in Bullet
     /** @return true if successful (EC_Mesh could be found and contained a mesh reference) */
     bool SetShapeFromVisibleMesh();
@@ -325,6 +339,9 @@ private slots:
     /// Called when EC_Terrain has been regenerated
     void OnTerrainRegenerated();
 
+    /// Called when EC_Terrain is about to edit the height grid the heightfield shape reads.
+    void OnTerrainHeightGridAboutToChange();
+
     /// Called when collision mesh has been downloaded.
     void OnCollisionMeshAssetLoaded(AssetPtr asset);
 
@@ -369,6 +386,19 @@ private:
     /// Emit a physics collision. Called from PhysicsWorld
     void EmitPhysicsCollision(Entity* otherEntity, const float3& position, const float3& normal, float distance, float impulse, bool newCollision);
 
+    /// Applies a command to the Bullet body now, or queues it to the physics world if a step is in progress in the physics thread.
+    void SubmitCommand(const RigidBodyCommand &command);
+
+    /// Applies a command to the Bullet body. Called from PhysicsWorld for queued commands.
+    void ApplyCommand(const RigidBodyCommand &command);
+
+    /// Applies the state of the body simulated in the physics thread. Called from PhysicsWorld.
+    /** @param stepSerial Serial of the step that produced the state. The state is ignored if the transform has been set after that step was started. */
+    void ApplySimulatedState(const float3 &position, const Quat &orientation, const float3 &linearVel, const float3 &angularVel, u32 stepSerial);
+
+    /// Waits for the step in progress in the physics thread, if any, before accessing the Bullet body directly.
+    void WaitForSimulation() const;
+
     struct Impl;
     Impl *impl;
 };
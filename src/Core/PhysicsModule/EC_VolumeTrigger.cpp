@@ -129,6 +129,9 @@ bool EC_VolumeTrigger::IsPivotInside(Entity *entity) const
     shared_ptr<EC_RigidBody> rigidbody = rigidbody_.lock();
     if (placeable && rigidbody)
     {
+        if (rigidbody->World())
+            rigidbody->World()->WaitForSimulation();
+
         const Transform& trans = placeable->transform.Get();
         const float3& pivot = trans.pos;
 
@@ -148,6 +151,8 @@ bool EC_VolumeTrigger::IsInsideVolume(const float3& point) const
         return false;
     }
 
+    if (rigidbody->World())
+        rigidbody->World()->WaitForSimulation();
     return RayTestSingle(float3(point.x, point.y - 1e7f, point.z), point, rigidbody->GetRigidBody()) &&
            RayTestSingle(float3(point.x, point.y + 1e7f, point.z), point, rigidbody->GetRigidBody());
 }
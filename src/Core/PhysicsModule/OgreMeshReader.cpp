@@ -0,0 +1,427 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "OgreMeshReader.h"
+#include "LoggingFunctions.h"
+
+#include <cstring>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+
+/// Chunk ids of the Ogre binary mesh format, see OgreMeshFileFormat.h
+enum MeshChunkId
+{
+    ChunkHeader = 0x1000,
+    ChunkMesh = 0x3000,
+    ChunkSubMesh = 0x4000,
+    ChunkSubMeshOperation = 0x4010,
+    ChunkSubMeshBoneAssignment = 0x4100,
+    ChunkSubMeshTextureAlias = 0x4200,
+    ChunkGeometry = 0x5000,
+    ChunkGeometryVertexDeclaration = 0x5100,
+    ChunkGeometryVertexElement = 0x5110,
+    ChunkGeometryVertexBuffer = 0x5200,
+    ChunkGeometryVertexBufferData = 0x5210,
+    ChunkMeshSkeletonLink = 0x6000,
+    ChunkMeshBoneAssignment = 0x7000,
+    ChunkMeshLod = 0x8000,
+    ChunkMeshBounds = 0x9000,
+    ChunkSubMeshNameTable = 0xA000,
+    ChunkEdgeLists = 0xB000,
+    ChunkPoses = 0xC000,
+    ChunkAnimations = 0xD000,
+    ChunkTableExtremes = 0xE000
+};
+
+/// Size of a chunk header: u16 id and u32 length. The length includes the header.
+const u32 cChunkHeaderSize = 6;
+
+/// Ogre::VES_POSITION
+const u16 cSemanticPosition = 1;
+/// Ogre::VET_FLOAT3 and Ogre::VET_FLOAT4
+const u16 cTypeFloat3 = 2;
+const u16 cTypeFloat4 = 3;
+
+u16 SwapBytes(u16 value)
+{
+    return (u16)((value >> 8) | (value << 8));
+}
+
+u32 SwapBytes(u32 value)
+{
+    return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+}
+
+}
+
+void OgreMeshGeometry::Triangles(std::vector<float3> &dest) const
+{
+    dest.clear();
+    for(size_t i = 0; i < subMeshes.size(); ++i)
+    {
+        const SubMesh &subMesh = subMeshes[i];
+        const std::vector<float3> &positions = subMesh.useSharedVertices ? sharedPositions : subMesh.positions;
+        const size_t numTris = subMesh.indices.size() / 3;
+        for(size_t k = 0; k < numTris * 3; k += 3)
+        {
+            const u32 i1 = subMesh.indices[k];
+            const u32 i2 = subMesh.indices[k+1];
+            const u32 i3 = subMesh.indices[k+2];
+            if (i1 >= positions.size() || i2 >= positions.size() || i3 >= positions.size())
+                continue;
+            dest.push_back(positions[i1]);
+            dest.push_back(positions[i2]);
+            dest.push_back(positions[i3]);
+        }
+    }
+}
+
+void OgreMeshGeometry::Clear()
+{
+    sharedPositions.clear();
+    subMeshes.clear();
+    bounds.SetNegativeInfinity();
+}
+
+OgreMeshReader::OgreMeshReader() :
+    data(0),
+    size(0),
+    pos(0),
+    swapBytes(false),
+    overflow(false)
+{
+}
+
+bool OgreMeshReader::Read(const u8 *data_, size_t numBytes, OgreMeshGeometry &dest, const QString &name)
+{
+    data = data_;
+    size = data_ ? numBytes : 0;
+    pos = 0;
+    swapBytes = false;
+    overflow = false;
+    dest.Clear();
+
+    // The file header has no length. Its byte order tells the byte order of the file
+    const u16 header = ReadU16();
+    if (header == SwapBytes((u16)ChunkHeader))
+        swapBytes = true;
+    else if (header != ChunkHeader)
+    {
+        LogError("OgreMeshReader::Read: " + name + " is not an Ogre binary mesh!");
+        return false;
+    }
+    SkipString(); // Serializer version, e.g. [MeshSerializer_v1.8]
+
+    bool hasMesh = false;
+    bool success = !overflow;
+    while(success && pos < size)
+    {
+        u16 id;
+        u32 length;
+        success = ReadChunkHeader(id, length);
+        if (!success)
+            break;
+        if (id == ChunkMesh)
+        {
+            success = ReadMesh(dest);
+            hasMesh = true;
+        }
+        else
+            success = SkipChunk(length);
+    }
+
+    if (!success || !hasMesh)
+    {
+        LogError("OgreMeshReader::Read: Failed to read the geometry of mesh " + name + ", the data is corrupted or of an unsupported version!");
+        dest.Clear();
+        return false;
+    }
+
+    // Meshes written by old serializers may not have bounds
+    if (!dest.bounds.IsFinite() || dest.bounds.IsDegenerate())
+    {
+        dest.bounds.SetNegativeInfinity();
+        for(size_t i = 0; i < dest.sharedPositions.size(); ++i)
+            dest.bounds.Enclose(dest.sharedPositions[i]);
+        for(size_t i = 0; i < dest.subMeshes.size(); ++i)
+            for(size_t j = 0; j < dest.subMeshes[i].positions.size(); ++j)
+                dest.bounds.Enclose(dest.subMeshes[i].positions[j]);
+    }
+
+    return true;
+}
+
+bool OgreMeshReader::ReadMesh(OgreMeshGeometry &dest)
+{
+    ReadBool(); // Skeletally animated
+
+    // Read the chunks of the mesh, until a chunk that does not belong to it
+    while(!overflow && pos < size)
+    {
+        u16 id;
+        u32 length;
+        if (!ReadChunkHeader(id, length))
+            return false;
+
+        bool success = true;
+        switch(id)
+        {
+        case ChunkGeometry:
+            success = ReadGeometry(dest.sharedPositions);
+            break;
+        case ChunkSubMesh:
+            success = ReadSubMesh(dest);
+            break;
+        case ChunkMeshBounds:
+        {
+            float3 minPoint, maxPoint;
+            minPoint.x = ReadFloat();
+            minPoint.y = ReadFloat();
+            minPoint.z = ReadFloat();
+            maxPoint.x = ReadFloat();
+            maxPoint.y = ReadFloat();
+            maxPoint.z = ReadFloat();
+            ReadFloat(); // Bounding sphere radius
+            dest.bounds = AABB(minPoint, maxPoint);
+            break;
+        }
+        case ChunkMeshSkeletonLink:
+        case ChunkMeshBoneAssignment:
+        case ChunkMeshLod:
+        case ChunkSubMeshNameTable:
+        case ChunkEdgeLists:
+        case ChunkPoses:
+        case ChunkAnimations:
+        case ChunkTableExtremes:
+            success = SkipChunk(length);
+            break;
+        default:
+            RewindChunkHeader();
+            return true;
+        }
+
+        if (!success)
+            return false;
+    }
+
+    return !overflow;
+}
+
+bool OgreMeshReader::ReadSubMesh(OgreMeshGeometry &dest)
+{
+    dest.subMeshes.push_back(OgreMeshGeometry::SubMesh());
+    OgreMeshGeometry::SubMesh &subMesh = dest.subMeshes.back();
+
+    SkipString(); // Material name
+    subMesh.useSharedVertices = ReadBool();
+    const u32 indexCount = ReadU32();
+    const bool indexes32Bit = ReadBool();
+    if (overflow || !CanRead((size_t)indexCount * (indexes32Bit ? 4 : 2)))
+        return false;
+
+    subMesh.indices.resize(indexCount);
+    for(u32 i = 0; i < indexCount; ++i)
+        subMesh.indices[i] = indexes32Bit ? ReadU32() : (u32)ReadU16();
+
+    if (!subMesh.useSharedVertices)
+    {
+        u16 id;
+        u32 length;
+        if (!ReadChunkHeader(id, length) || id != ChunkGeometry)
+            return false;
+        if (!ReadGeometry(subMesh.positions))
+            return false;
+    }
+
+    // Skip the chunks of the submesh, until a chunk that does not belong to it
+    while(!overflow && pos < size)
+    {
+        u16 id;
+        u32 length;
+        if (!ReadChunkHeader(id, length))
+            return false;
+        if (id != ChunkSubMeshOperation && id != ChunkSubMeshBoneAssignment && id != ChunkSubMeshTextureAlias)
+        {
+            RewindChunkHeader();
+            break;
+        }
+        if (!SkipChunk(length))
+            return false;
+    }
+
+    return !overflow;
+}
+
+bool OgreMeshReader::ReadGeometry(std::vector<float3> &positions)
+{
+    const u32 vertexCount = ReadU32();
+
+    bool hasPositionElement = false;
+    u16 positionSource = 0;
+    u16 positionOffset = 0;
+
+    while(!overflow && pos < size)
+    {
+        u16 id;
+        u32 length;
+        if (!ReadChunkHeader(id, length))
+            return false;
+
+        if (id == ChunkGeometryVertexDeclaration)
+        {
+            while(!overflow && pos < size)
+            {
+                if (!ReadChunkHeader(id, length))
+                    return false;
+                if (id != ChunkGeometryVertexElement)
+                {
+                    RewindChunkHeader();
+                    break;
+                }
+                const u16 source = ReadU16();
+                const u16 type = ReadU16();
+                const u16 semantic = ReadU16();
+                const u16 offset = ReadU16();
+                ReadU16(); // Index of the semantic
+                if (semantic == cSemanticPosition && !hasPositionElement)
+                {
+                    if (type != cTypeFloat3 && type != cTypeFloat4)
+                    {
+                        LogError("OgreMeshReader: Unsupported vertex position type " + QString::number(type) + "!");
+                        return false;
+                    }
+                    hasPositionElement = true;
+                    positionSource = source;
+                    positionOffset = offset;
+                }
+            }
+        }
+        else if (id == ChunkGeometryVertexBuffer)
+        {
+            const u16 bindIndex = ReadU16();
+            const u16 vertexSize = ReadU16();
+            if (!ReadChunkHeader(id, length) || id != ChunkGeometryVertexBufferData)
+                return false;
+            const size_t bufferSize = (size_t)vertexCount * vertexSize;
+            if (!CanRead(bufferSize))
+                return false;
+
+            // Read only the positions from the buffer that has them, and skip the rest of the vertex data
+            if (hasPositionElement && bindIndex == positionSource)
+            {
+                if ((u32)positionOffset + 3 * sizeof(float) > vertexSize)
+                    return false;
+                const size_t bufferStart = pos;
+                positions.resize(vertexCount);
+                for(u32 i = 0; i < vertexCount; ++i)
+                {
+                    pos = bufferStart + (size_t)i * vertexSize + positionOffset;
+                    positions[i].x = ReadFloat();
+                    positions[i].y = ReadFloat();
+                    positions[i].z = ReadFloat();
+                }
+                pos = bufferStart;
+            }
+            Skip(bufferSize);
+        }
+        else
+        {
+            RewindChunkHeader();
+            break;
+        }
+    }
+
+    return !overflow;
+}
+
+bool OgreMeshReader::ReadChunkHeader(u16 &id, u32 &length)
+{
+    id = ReadU16();
+    length = ReadU32();
+    return !overflow;
+}
+
+void OgreMeshReader::RewindChunkHeader()
+{
+    pos -= cChunkHeaderSize;
+}
+
+bool OgreMeshReader::SkipChunk(u32 length)
+{
+    if (length < cChunkHeaderSize)
+        return false;
+    return Skip(length - cChunkHeaderSize);
+}
+
+bool OgreMeshReader::SkipString()
+{
+    // Strings are terminated by a newline
+    const void *end = memchr(data + pos, '\n', size - pos);
+    if (!end)
+    {
+        overflow = true;
+        return false;
+    }
+    pos = static_cast<const u8*>(end) - data + 1;
+    return true;
+}
+
+bool OgreMeshReader::Skip(size_t numBytes)
+{
+    if (!CanRead(numBytes))
+    {
+        overflow = true;
+        return false;
+    }
+    pos += numBytes;
+    return true;
+}
+
+u16 OgreMeshReader::ReadU16()
+{
+    if (!CanRead(sizeof(u16)))
+    {
+        overflow = true;
+        return 0;
+    }
+    u16 value;
+    memcpy(&value, data + pos, sizeof(u16));
+    pos += sizeof(u16);
+    return swapBytes ? SwapBytes(value) : value;
+}
+
+u32 OgreMeshReader::ReadU32()
+{
+    if (!CanRead(sizeof(u32)))
+    {
+        overflow = true;
+        return 0;
+    }
+    u32 value;
+    memcpy(&value, data + pos, sizeof(u32));
+    pos += sizeof(u32);
+    return swapBytes ? SwapBytes(value) : value;
+}
+
+float OgreMeshReader::ReadFloat()
+{
+    const u32 bits = ReadU32();
+    float value;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+bool OgreMeshReader::ReadBool()
+{
+    if (!CanRead(1))
+    {
+        overflow = true;
+        return false;
+    }
+    return data[pos++] != 0;
+}
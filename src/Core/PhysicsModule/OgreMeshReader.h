@@ -0,0 +1,74 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "CoreTypes.h"
+#include "PhysicsModuleApi.h"
+#include "Math/float3.h"
+#include "Geometry/AABB.h"
+
+#include <QString>
+#include <vector>
+
+/// Collision geometry of an Ogre mesh: the vertex positions and triangle indices of the submeshes, and the mesh bounds.
+struct PHYSICS_MODULE_API OgreMeshGeometry
+{
+    /// Geometry of a submesh. A submesh that uses the shared vertices of the mesh has no positions of its own.
+    struct SubMesh
+    {
+        SubMesh() : useSharedVertices(false) {}
+
+        bool useSharedVertices;
+        std::vector<float3> positions;
+        std::vector<u32> indices;
+    };
+
+    /// Positions of the vertices shared by the submeshes
+    std::vector<float3> sharedPositions;
+    std::vector<SubMesh> subMeshes;
+    AABB bounds;
+
+    /// Returns the vertices of the triangles, three per triangle.
+    /** The order is the same in which Physics::GetTrianglesFromMesh returns the triangles of an Ogre mesh loaded from the same data. */
+    void Triangles(std::vector<float3> &dest) const;
+
+    void Clear();
+};
+
+/// Reads the collision geometry from Ogre binary .mesh data without Ogre.
+/** Only the vertex positions, the triangle indices and the bounds are read: all other mesh data is skipped without being loaded.
+    Both byte orders of the Ogre 1.x mesh formats are supported. */
+class PHYSICS_MODULE_API OgreMeshReader
+{
+public:
+    OgreMeshReader();
+
+    /// Reads the geometry of a mesh. Returns false and logs an error if the data is not a valid Ogre binary mesh.
+    /** @param name Name of the mesh for the error messages. */
+    bool Read(const u8 *data, size_t numBytes, OgreMeshGeometry &dest, const QString &name = "");
+
+private:
+    bool ReadMesh(OgreMeshGeometry &dest);
+    bool ReadSubMesh(OgreMeshGeometry &dest);
+    bool ReadGeometry(std::vector<float3> &positions);
+
+    bool ReadChunkHeader(u16 &id, u32 &length);
+    void RewindChunkHeader();
+    bool SkipChunk(u32 length);
+    bool SkipString();
+    bool Skip(size_t numBytes);
+    u16 ReadU16();
+    u32 ReadU32();
+    float ReadFloat();
+    bool ReadBool();
+    /// Returns whether the given number of bytes can be read.
+    bool CanRead(size_t numBytes) const { return numBytes <= size - pos; }
+
+    const u8 *data;
+    size_t size;
+    size_t pos;
+    /// Whether the data has the opposite byte order than the machine
+    bool swapBytes;
+    /// Set when reading past the end of the data
+    bool overflow;
+};
@@ -7,6 +7,7 @@
 #include "PhysicsWorld.h"
 #include "CollisionShapeUtils.h"
 #include "ConvexHull.h"
+#include "CollisionMeshAsset.h"
 #include "EC_RigidBody.h"
 #include "EC_VolumeTrigger.h"
 #include "EC_PhysicsMotor.h"
@@ -27,6 +28,8 @@
 #include "QScriptEngineHelpers.h"
 #include "LoggingFunctions.h"
 #include "StaticPluginRegistry.h"
+#include "AssetAPI.h"
+#include "AssetCache.h"
 
 // Disable unreferenced formal parameter coming from Bullet
 #ifdef _MSC_VER
@@ -40,6 +43,7 @@
 
 #include <QtScript>
 #include <QTreeWidgetItem>
+#include <QFile>
 
 #include <Ogre.h>
 
@@ -47,6 +51,31 @@
 
 using namespace Physics;
 
+/// Version of the collision data stored to the asset cache. Increment when the generated data changes, so stale cache entries are not used.
+static const int cCollisionDataCacheVersion = 1;
+
+namespace
+{
+
+/// Deletes a shared BVH triangle mesh shape, and the buffer of its BVH if it was deserialized in place.
+/** Also keeps the triangle mesh referenced by the shape alive as long as the shape. */
+struct BvhTriangleMeshShapeDeleter
+{
+    BvhTriangleMeshShapeDeleter(const shared_ptr<btTriangleMesh> &mesh, void *buffer) : triangleMesh(mesh), bvhBuffer(buffer) {}
+
+    void operator()(btBvhTriangleMeshShape *shape)
+    {
+        delete shape;
+        if (bvhBuffer)
+            btAlignedFree(bvhBuffer);
+    }
+
+    shared_ptr<btTriangleMesh> triangleMesh;
+    void *bvhBuffer;
+};
+
+}
+
 PhysicsModule::PhysicsModule()
 :IModule("Physics"),
 defaultPhysicsUpdatePeriod_(1.0f / 60.0f),
@@ -64,6 +93,10 @@ void PhysicsModule::Load()
     framework_->Scene()->RegisterComponentFactory(MAKE_SHARED(GenericComponentFactory<EC_VolumeTrigger>));
     framework_->Scene()->RegisterComponentFactory(MAKE_SHARED(GenericComponentFactory<EC_PhysicsMotor>));
     framework_->Scene()->RegisterComponentFactory(MAKE_SHARED(GenericComponentFactory<EC_PhysicsConstraint>));
+
+    // Headless servers read only the collision geometry of meshes, without loading them into Ogre.
+    if (framework_->IsHeadless())
+        framework_->Asset()->RegisterAssetTypeFactory(MAKE_SHARED(CollisionMeshAssetFactory));
 }
 
 void PhysicsModule::Initialize()
@@ -210,6 +243,7 @@ void PhysicsModule::OnScriptEngineCreated(QScriptEngine* engine)
     qScriptRegisterQObjectMetaType<PhysicsModule*>(engine);
     qScriptRegisterQObjectMetaType<PhysicsWorld*>(engine);
     qScriptRegisterQObjectMetaType<PhysicsRaycastResult*>(engine);
+    qScriptRegisterSequenceMetaType<PhysicsQueryArray>(engine);
 }
 
 shared_ptr<btTriangleMesh> PhysicsModule::GetTriangleMeshFromOgreMesh(Ogre::Mesh* mesh)
@@ -224,14 +258,23 @@ shared_ptr<btTriangleMesh> PhysicsModule::GetTriangleMeshFromOgreMesh(Ogre::Mesh
         return iter->second;
     
     // Create new, then interrogate the Ogre mesh
-#include "DisableMemoryLeakCheck.h"
-    ptr = MAKE_SHARED(btTriangleMesh);
-#include "EnableMemoryLeakCheck.h"
-    GenerateTriangleMesh(mesh, ptr.get());
+    std::vector<float3> triangles;
+    GetTrianglesFromMesh(mesh, triangles);
+    return CreateTriangleMesh(mesh->getName(), triangles);
+}
+
+shared_ptr<btBvhTriangleMeshShape> PhysicsModule::GetBvhTriangleMeshShapeFromOgreMesh(Ogre::Mesh* mesh)
+{
+    shared_ptr<btBvhTriangleMeshShape> ptr;
+    if (!mesh)
+        return ptr;
     
-    triangleMeshes_[mesh->getName()] = ptr;
+    // Check if has already been created
+    BvhTriangleMeshShapeMap::const_iterator iter = bvhTriangleMeshShapes_.find(mesh->getName());
+    if (iter != bvhTriangleMeshShapes_.end())
+        return iter->second;
     
-    return ptr;
+    return CreateBvhTriangleMeshShape(mesh->getName(), GetTriangleMeshFromOgreMesh(mesh));
 }
 
 shared_ptr<ConvexHullSet> PhysicsModule::GetConvexHullSetFromOgreMesh(Ogre::Mesh* mesh)
@@ -246,14 +289,160 @@ shared_ptr<ConvexHullSet> PhysicsModule::GetConvexHullSetFromOgreMesh(Ogre::Mesh
         return iter->second;
     
     // Create new, then interrogate the Ogre mesh
-    ptr = MAKE_SHARED(ConvexHullSet);
-    GenerateConvexHullSet(mesh, ptr.get());
+    std::vector<float3> vertices;
+    GetTrianglesFromMesh(mesh, vertices);
+    return CreateConvexHullSet(mesh->getName(), vertices);
+}
+
+shared_ptr<btBvhTriangleMeshShape> PhysicsModule::GetBvhTriangleMeshShapeFromCollisionMesh(CollisionMeshAsset* mesh)
+{
+    shared_ptr<btBvhTriangleMeshShape> ptr;
+    if (!mesh || !mesh->IsLoaded())
+        return ptr;
+    
+    const std::string name = mesh->Name().toStdString();
+    BvhTriangleMeshShapeMap::const_iterator iter = bvhTriangleMeshShapes_.find(name);
+    if (iter != bvhTriangleMeshShapes_.end())
+        return iter->second;
+    
+    shared_ptr<btTriangleMesh> triangleMesh;
+    TriangleMeshMap::const_iterator meshIter = triangleMeshes_.find(name);
+    if (meshIter != triangleMeshes_.end())
+        triangleMesh = meshIter->second;
+    else
+    {
+        std::vector<float3> triangles;
+        mesh->Geometry().Triangles(triangles);
+        triangleMesh = CreateTriangleMesh(name, triangles);
+    }
+    return CreateBvhTriangleMeshShape(name, triangleMesh);
+}
+
+shared_ptr<ConvexHullSet> PhysicsModule::GetConvexHullSetFromCollisionMesh(CollisionMeshAsset* mesh)
+{
+    shared_ptr<ConvexHullSet> ptr;
+    if (!mesh || !mesh->IsLoaded())
+        return ptr;
+    
+    const std::string name = mesh->Name().toStdString();
+    ConvexHullSetMap::const_iterator iter = convexHullSets_.find(name);
+    if (iter != convexHullSets_.end())
+        return iter->second;
+    
+    std::vector<float3> vertices;
+    mesh->Geometry().Triangles(vertices);
+    return CreateConvexHullSet(name, vertices);
+}
+
+shared_ptr<btTriangleMesh> PhysicsModule::CreateTriangleMesh(const std::string &name, const std::vector<float3> &triangles)
+{
+#include "DisableMemoryLeakCheck.h"
+    shared_ptr<btTriangleMesh> ptr = MAKE_SHARED(btTriangleMesh);
+#include "EnableMemoryLeakCheck.h"
+    GenerateTriangleMesh(triangles, ptr.get());
+    
+    triangleMeshes_[name] = ptr;
+    if (!triangles.empty())
+        meshContentHashes_[name] = AssetCache::ContentHash(reinterpret_cast<const u8*>(&triangles[0]), triangles.size() * sizeof(float3));
+    
+    return ptr;
+}
 
-    convexHullSets_[mesh->getName()] = ptr;
+shared_ptr<btBvhTriangleMeshShape> PhysicsModule::CreateBvhTriangleMeshShape(const std::string &name, const shared_ptr<btTriangleMesh> &triangleMesh)
+{
+    PROFILE(PhysicsModule_CreateBvhTriangleMeshShape);
+    
+    // The serialized BVH layout depends on the pointer size, so it is cached separately for each pointer size.
+    AssetCache *cache = framework_->Asset()->Cache();
+    const QString cacheRef = CollisionDataCacheRef(meshContentHashes_[name], "bvh" + QString::number(sizeof(void*) * 8));
+    
+    // Try to deserialize the BVH in place from the cached file. The buffer must be kept for the lifetime of the shape.
+    void *bvhBuffer = 0;
+    btOptimizedBvh *bvh = 0;
+    if (!cacheRef.isEmpty())
+    {
+        QFile file(cache->FindInCache(cacheRef));
+        if (file.size() > 0 && file.open(QIODevice::ReadOnly))
+        {
+            bvhBuffer = btAlignedAlloc((size_t)file.size(), 16);
+            if (file.read(static_cast<char*>(bvhBuffer), file.size()) == file.size())
+                bvh = btOptimizedBvh::deSerializeInPlace(bvhBuffer, (unsigned int)file.size(), false);
+            if (!bvh)
+            {
+                LogWarning("PhysicsModule: Ignoring invalid cached BVH " + file.fileName() + " for mesh " + QString::fromStdString(name));
+                btAlignedFree(bvhBuffer);
+                bvhBuffer = 0;
+            }
+        }
+    }
+    
+#include "DisableMemoryLeakCheck.h"
+    btBvhTriangleMeshShape *shape = new btBvhTriangleMeshShape(triangleMesh.get(), true, bvh == 0);
+#include "EnableMemoryLeakCheck.h"
+    if (bvh)
+        shape->setOptimizedBvh(bvh);
+    else if (!cacheRef.isEmpty())
+    {
+        // Store the newly built BVH for the next session
+        const btOptimizedBvh *builtBvh = shape->getOptimizedBvh();
+        const unsigned int size = builtBvh->calculateSerializeBufferSize();
+        void *buffer = btAlignedAlloc(size, 16);
+        if (builtBvh->serializeInPlace(buffer, size, false))
+            cache->StoreAsset(static_cast<const u8*>(buffer), size, cacheRef);
+        btAlignedFree(buffer);
+    }
+    
+    shared_ptr<btBvhTriangleMeshShape> ptr(shape, BvhTriangleMeshShapeDeleter(triangleMesh, bvhBuffer));
+    bvhTriangleMeshShapes_[name] = ptr;
     
     return ptr;
 }
 
+shared_ptr<ConvexHullSet> PhysicsModule::CreateConvexHullSet(const std::string &name, const std::vector<float3> &vertices)
+{
+    PROFILE(PhysicsModule_CreateConvexHullSet);
+    
+    shared_ptr<ConvexHullSet> ptr = MAKE_SHARED(ConvexHullSet);
+    
+    QString cacheRef;
+    if (!vertices.empty())
+        cacheRef = CollisionDataCacheRef(AssetCache::ContentHash(reinterpret_cast<const u8*>(&vertices[0]), vertices.size() * sizeof(float3)), "hulls");
+    
+    // Hull generation is slow, so use the hulls generated from identical mesh data in a previous session if available
+    bool loaded = false;
+    if (!cacheRef.isEmpty())
+    {
+        QFile file(framework_->Asset()->Cache()->FindInCache(cacheRef));
+        if (file.open(QIODevice::ReadOnly))
+        {
+            loaded = DeserializeConvexHullSet(file.readAll(), ptr.get());
+            if (!loaded)
+                LogWarning("PhysicsModule: Ignoring invalid cached convex hulls " + file.fileName() + " for mesh " + QString::fromStdString(name));
+        }
+    }
+    
+    if (!loaded)
+    {
+        GenerateConvexHullSet(vertices, ptr.get());
+        if (!cacheRef.isEmpty() && !ptr->hulls_.empty())
+        {
+            QByteArray data = SerializeConvexHullSet(ptr.get());
+            framework_->Asset()->Cache()->StoreAsset(reinterpret_cast<const u8*>(data.constData()), data.size(), cacheRef);
+        }
+    }
+
+    convexHullSets_[name] = ptr;
+    
+    return ptr;
+}
+
+QString PhysicsModule::CollisionDataCacheRef(const QString &contentHash, const QString &suffix) const
+{
+    if (contentHash.isEmpty() || !framework_->Asset()->Cache())
+        return QString();
+    return "physics-v" + QString::number(cCollisionDataCacheVersion) + "-" + contentHash + "." + suffix;
+}
+
 #ifdef PROFILING
 static QTreeWidgetItem *FindItemByName(QTreeWidgetItem *parent, const char *name)
 {
@@ -7,6 +7,8 @@
 #include "IModule.h"
 #include "SceneFwd.h"
 
+#include "Math/float3.h"
+
 #include <set>
 #include <QObject>
 #include <QMetaType>
@@ -42,10 +44,25 @@ public:
     /** If already has been generated, returns the previously created one */
     shared_ptr<btTriangleMesh> GetTriangleMeshFromOgreMesh(Ogre::Mesh* mesh);
 
+    /// Get a Bullet triangle mesh shape with an optimized BVH corresponding to an Ogre mesh.
+    /** If already has been generated, returns the previously created one. The shape is shared by all rigid bodies using the mesh,
+        so it must not be modified: scale it with btScaledBvhTriangleMeshShape instead.
+        The BVH is stored to the asset cache keyed by the mesh content, and loaded from there instead of rebuilding it when available. */
+    shared_ptr<btBvhTriangleMeshShape> GetBvhTriangleMeshShapeFromOgreMesh(Ogre::Mesh* mesh);
+
     /// Get a Bullet convex hull set (using minimum recursion, not very accurate but fast) corresponding to an Ogre mesh.
-    /** If already has been generated, returns the previously created one */
+    /** If already has been generated, returns the previously created one.
+        The hulls are stored to the asset cache keyed by the mesh content, and loaded from there instead of regenerating them when available. */
     shared_ptr<ConvexHullSet> GetConvexHullSetFromOgreMesh(Ogre::Mesh* mesh);
 
+    /// Get a Bullet triangle mesh shape with an optimized BVH corresponding to a collision mesh asset loaded without Ogre.
+    /** @see GetBvhTriangleMeshShapeFromOgreMesh */
+    shared_ptr<btBvhTriangleMeshShape> GetBvhTriangleMeshShapeFromCollisionMesh(CollisionMeshAsset* mesh);
+
+    /// Get a Bullet convex hull set corresponding to a collision mesh asset loaded without Ogre.
+    /** @see GetConvexHullSetFromOgreMesh */
+    shared_ptr<ConvexHullSet> GetConvexHullSetFromCollisionMesh(CollisionMeshAsset* mesh);
+
     /// Set default physics update rate for new physics worlds
     void SetDefaultPhysicsUpdatePeriod(float updatePeriod);
 
@@ -92,9 +109,26 @@ private:
     /// Bullet triangle meshes generated from Ogre meshes
     TriangleMeshMap triangleMeshes_;
 
+    typedef std::map<std::string, shared_ptr<btBvhTriangleMeshShape> > BvhTriangleMeshShapeMap;
+    /// Bullet BVH triangle mesh shapes generated from Ogre meshes
+    BvhTriangleMeshShapeMap bvhTriangleMeshShapes_;
+
     typedef std::map<std::string, shared_ptr<ConvexHullSet> > ConvexHullSetMap;
     /// Bullet convex hull sets generated from Ogre meshes
     ConvexHullSetMap convexHullSets_;
+
+    /// Content hashes of the triangles of Ogre meshes, used as asset cache keys for the collision data generated from them
+    std::map<std::string, QString> meshContentHashes_;
+
+    /// Creates a Bullet triangle mesh from triangles, and stores it by name.
+    shared_ptr<btTriangleMesh> CreateTriangleMesh(const std::string &name, const std::vector<float3> &triangles);
+    /// Creates a BVH triangle mesh shape for a triangle mesh created with CreateTriangleMesh, and stores it by name.
+    shared_ptr<btBvhTriangleMeshShape> CreateBvhTriangleMeshShape(const std::string &name, const shared_ptr<btTriangleMesh> &triangleMesh);
+    /// Creates a convex hull set from triangles, and stores it by name.
+    shared_ptr<ConvexHullSet> CreateConvexHullSet(const std::string &name, const std::vector<float3> &vertices);
+
+    /// Returns the asset cache ref for collision data generated from triangles with the given content hash, or an empty string if there is no asset cache.
+    QString CollisionDataCacheRef(const QString &contentHash, const QString &suffix) const;
     
     float defaultPhysicsUpdatePeriod_;
     int defaultMaxSubSteps_;
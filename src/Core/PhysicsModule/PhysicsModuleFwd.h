@@ -23,12 +23,16 @@ class PhysicsWorld;
 class PhysicsRaycastResult;
 class EC_RigidBody;
 class EC_VolumeTrigger;
+class CollisionMeshAsset;
+struct RigidBodyCommand;
 
 typedef shared_ptr<PhysicsWorld> PhysicsWorldPtr;
 typedef weak_ptr<PhysicsWorld> PhysicsWorldWeakPtr;
 
 // From Bullet:
 class btTriangleMesh;
+class btBvhTriangleMeshShape;
+class btConvexShape;
 class btCollisionConfiguration;
 class btBroadphaseInterface;
 class btConstraintSolver;
@@ -39,3 +43,4 @@ class btConvexHullShape;
 class btRigidBody;
 class btCollisionShape;
 class btHeightfieldTerrainShape;
+class btTransform;
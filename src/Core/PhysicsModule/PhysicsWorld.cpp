@@ -17,6 +17,7 @@
 #include "Math/float3x3.h"
 #include "Math/Quat.h"
 #include "Entity.h"
+#include "ParallelFor.h"
 
 #include <LinearMath/btIDebugDraw.h>
 // Disable unreferenced formal parameter coming from Bullet
@@ -31,22 +32,100 @@
 
 #include <Ogre.h>
 
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
 #include "MemoryLeakCheck.h"
 
-namespace
+/// Steps the Bullet world of a threaded PhysicsWorld.
+class PhysicsWorld::Thread : public QThread
 {
+public:
+    explicit Thread(PhysicsWorld *owner) :
+        world(owner),
+        frametime(0.0),
+        stepPending(false),
+        quit(false)
+    {
+    }
 
-struct CollisionSignal
-{
-    weak_ptr<EC_RigidBody> bodyA;
-    weak_ptr<EC_RigidBody> bodyB;
-    float3 position;
-    float3 normal;
-    float distance;
-    float impulse;
-    bool newCollision;
+    /// Starts a step of the given length. The previous step must have been completed.
+    void StartStep(f64 stepFrametime)
+    {
+        QMutexLocker lock(&mutex);
+        assert(!stepPending);
+        frametime = stepFrametime;
+        stepPending = true;
+        stepRequested.wakeOne();
+    }
+
+    /// Waits for the step in progress, if any, to complete.
+    void WaitForStep()
+    {
+        QMutexLocker lock(&mutex);
+        while(stepPending)
+            stepCompleted.wait(&mutex);
+    }
+
+    /// Returns whether a step is in progress.
+    bool IsStepping()
+    {
+        QMutexLocker lock(&mutex);
+        return stepPending;
+    }
+
+    /// Waits for the step in progress, if any, to complete and stops the thread.
+    void Stop()
+    {
+        WaitForStep();
+        {
+            QMutexLocker lock(&mutex);
+            quit = true;
+            stepRequested.wakeOne();
+        }
+        wait();
+    }
+
+private:
+    /// QThread override
+    void run()
+    {
+        for(;;)
+        {
+            f64 stepFrametime;
+            {
+                QMutexLocker lock(&mutex);
+                while(!stepPending && !quit)
+                    stepRequested.wait(&mutex);
+                if (quit)
+                    return;
+                stepFrametime = frametime;
+            }
+
+            world->StepBulletWorld(stepFrametime);
+
+            QMutexLocker lock(&mutex);
+            stepPending = false;
+            stepCompleted.wakeAll();
+        }
+    }
+
+    PhysicsWorld *world;
+    QMutex mutex;
+    QWaitCondition stepRequested;
+    QWaitCondition stepCompleted;
+    f64 frametime;
+    bool stepPending;
+    bool quit;
 };
 
+namespace
+{
+
+/// Bullet's internal profiler (CProfileManager) is a global that is not thread-safe, so the worlds take turns stepping.
+QMutex bulletStepMutex;
+
 struct ObbCallback : public btCollisionWorld::ContactResultCallback
 {
     ObbCallback(std::set<btCollisionObjectWrapper*>& result) : result_(result) {}
@@ -61,15 +140,380 @@ struct ObbCallback : public btCollisionWorld::ContactResultCallback
     std::set<btCollisionObjectWrapper*>& result_;
 };
 
+/// Open addressing hash set of colliding object pairs. Keeps its memory when cleared, so that tracking the collisions of a substep does not allocate.
+class CollisionPairSet
+{
+public:
+    struct Entry
+    {
+        Entry() : objectA(0), objectB(0), bodyA(0), bodyB(0), index(-1) {}
+
+        /// Objects in the order the pair was inserted. objectA is null for an empty slot.
+        const btCollisionObject *objectA;
+        const btCollisionObject *objectB;
+        EC_RigidBody *bodyA;
+        EC_RigidBody *bodyB;
+        /// Index of the pair in the collision results of the substep, or -1 if the pair is not reported.
+        int index;
+    };
+
+    CollisionPairSet() : size(0), slots(64) {}
+
+    /// Returns the entry of the pair in either order, or null if not found.
+    Entry *Find(const btCollisionObject *objectA, const btCollisionObject *objectB)
+    {
+        const size_t mask = slots.size() - 1;
+        for(size_t i = Hash(objectA, objectB) & mask; slots[i].objectA; i = (i + 1) & mask)
+            if ((slots[i].objectA == objectA && slots[i].objectB == objectB) || (slots[i].objectA == objectB && slots[i].objectB == objectA))
+                return &slots[i];
+        return 0;
+    }
+
+    /// Inserts a pair that is not in the set. The returned entry is valid until the next insertion.
+    Entry *Insert(const btCollisionObject *objectA, const btCollisionObject *objectB, EC_RigidBody *bodyA, EC_RigidBody *bodyB)
+    {
+        // Keep the load factor at most 1/2 so that the probe sequences stay short
+        if ((size + 1) * 2 > slots.size())
+            Rehash(slots.size() * 2);
+        
+        const size_t mask = slots.size() - 1;
+        size_t i = Hash(objectA, objectB) & mask;
+        while(slots[i].objectA)
+            i = (i + 1) & mask;
+        
+        Entry &entry = slots[i];
+        entry.objectA = objectA;
+        entry.objectB = objectB;
+        entry.bodyA = bodyA;
+        entry.bodyB = bodyB;
+        entry.index = -1;
+        ++size;
+        return &entry;
+    }
+
+    void Clear()
+    {
+        if (size == 0)
+            return;
+        for(size_t i = 0; i < slots.size(); ++i)
+            slots[i].objectA = 0;
+        size = 0;
+    }
+
+    /// Removes all pairs of a rigid body.
+    void RemoveBody(EC_RigidBody *body)
+    {
+        bool found = false;
+        for(size_t i = 0; i < slots.size() && !found; ++i)
+            found = slots[i].objectA && (slots[i].bodyA == body || slots[i].bodyB == body);
+        if (!found)
+            return;
+        
+        // Linear probing does not allow removing single entries, so rebuild the set from the remaining pairs
+        std::vector<Entry> old(slots.size());
+        old.swap(slots);
+        size = 0;
+        for(size_t i = 0; i < old.size(); ++i)
+            if (old[i].objectA && old[i].bodyA != body && old[i].bodyB != body)
+                Insert(old[i].objectA, old[i].objectB, old[i].bodyA, old[i].bodyB)->index = old[i].index;
+    }
+
+    void Swap(CollisionPairSet &rhs)
+    {
+        std::swap(size, rhs.size);
+        slots.swap(rhs.slots);
+    }
+
+    /// Returns all the slots of the set, including the empty ones.
+    const std::vector<Entry> &Slots() const { return slots; }
+
+private:
+    static size_t Hash(const btCollisionObject *objectA, const btCollisionObject *objectB)
+    {
+        // Order-independent: hash the lower address first
+        u64 x = (u64)(size_t)(objectA < objectB ? objectA : objectB);
+        u64 y = (u64)(size_t)(objectA < objectB ? objectB : objectA);
+        u64 h = x * 0x9E3779B97F4A7C15ULL ^ y * 0xC2B2AE3D27D4EB4FULL;
+        return (size_t)(h ^ (h >> 29));
+    }
+
+    void Rehash(size_t numSlots)
+    {
+        std::vector<Entry> old(numSlots);
+        old.swap(slots);
+        size = 0;
+        for(size_t i = 0; i < old.size(); ++i)
+            if (old[i].objectA)
+                Insert(old[i].objectA, old[i].objectB, old[i].bodyA, old[i].bodyB)->index = old[i].index;
+    }
+
+    size_t size;
+    /// Power-of-two number of slots
+    std::vector<Entry> slots;
+};
+
 void TickCallback(btDynamicsWorld *world, btScalar timeStep)
 {
     static_cast<PhysicsWorld*>(world->getWorldUserInfo())->ProcessPostTick(timeStep);
 }
 
+/// Number of queries of a batch that a thread performs at a time, see ParallelFor.
+const size_t cQueryChunkSize = 64;
+
+/// Stores a hit of a query to a query result.
+void SetQueryHit(PhysicsQueryResult &result, const btCollisionObject *object, const float3 &pos, const float3 &normal, float distance)
+{
+    EC_RigidBody* body = object ? static_cast<EC_RigidBody*>(object->getUserPointer()) : 0;
+    result.entity = body ? body->ParentEntity() : 0;
+    result.pos = pos;
+    result.normal = normal;
+    result.distance = distance;
+}
+
+/// Performs the narrowphase ray test for the collision objects whose broadphase AABB the ray hits.
+/** The AABB trees of the broadphase are traversed with the static btDbvt functions, which keep their traversal stack on the stack
+    of the calling thread, instead of btBroadphaseInterface::rayTest, which may reuse a stack stored in the broadphase. */
+struct RayTestCollector : public btDbvt::ICollide
+{
+    RayTestCollector(const btTransform &from_, const btTransform &to_, btCollisionWorld::RayResultCallback &callback_) :
+        from(from_), to(to_), callback(callback_)
+    {
+    }
+
+    void Process(const btDbvtNode *leaf)
+    {
+        btBroadphaseProxy *proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+        if (!callback.needsCollision(proxy))
+            return;
+        btCollisionObject *object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+        btCollisionWorld::rayTestSingle(from, to, object, object->getCollisionShape(), object->getWorldTransform(), callback);
+    }
+
+    const btTransform &from;
+    const btTransform &to;
+    btCollisionWorld::RayResultCallback &callback;
+};
+
+/// Performs the narrowphase convex sweep for the collision objects whose broadphase AABB overlaps the AABB of the sweep.
+struct ConvexSweepCollector : public btDbvt::ICollide
+{
+    ConvexSweepCollector(const btConvexShape *shape_, const btTransform &from_, const btTransform &to_,
+        btCollisionWorld::ConvexResultCallback &callback_, btScalar allowedPenetration_) :
+        shape(shape_), from(from_), to(to_), callback(callback_), allowedPenetration(allowedPenetration_)
+    {
+    }
+
+    void Process(const btDbvtNode *leaf)
+    {
+        btBroadphaseProxy *proxy = static_cast<btBroadphaseProxy*>(leaf->data);
+        if (!callback.needsCollision(proxy))
+            return;
+        btCollisionObject *object = static_cast<btCollisionObject*>(proxy->m_clientObject);
+        btCollisionWorld::objectQuerySingle(shape, from, to, object, object->getCollisionShape(), object->getWorldTransform(),
+            callback, allowedPenetration);
+    }
+
+    const btConvexShape *shape;
+    const btTransform &from;
+    const btTransform &to;
+    btCollisionWorld::ConvexResultCallback &callback;
+    btScalar allowedPenetration;
+};
+
+/// Casts each ray of a batch against both AABB trees of the broadphase.
+class RayQueryBatch : public IParallelTask
+{
+public:
+    RayQueryBatch(btDbvtBroadphase *broadphase_, const float3 *origins_, const float3 *directions_, float maxDistance_,
+        PhysicsQueryResult *results_, int collisionGroup_, int collisionMask_) :
+        broadphase(broadphase_),
+        origins(origins_),
+        directions(directions_),
+        maxDistance(maxDistance_),
+        results(results_),
+        collisionGroup(collisionGroup_),
+        collisionMask(collisionMask_)
+    {
+    }
+
+    void RunItem(size_t index)
+    {
+        const float3 origin = origins[index];
+        const btTransform from(btQuaternion::getIdentity(), origin);
+        const btTransform to(btQuaternion::getIdentity(), origin + maxDistance * directions[index].Normalized());
+
+        btCollisionWorld::ClosestRayResultCallback rayCallback(from.getOrigin(), to.getOrigin());
+        rayCallback.m_collisionFilterGroup = collisionGroup;
+        rayCallback.m_collisionFilterMask = collisionMask;
+
+        RayTestCollector collector(from, to, rayCallback);
+        for(int i = 0; i < 2; ++i)
+            btDbvt::rayTest(broadphase->m_sets[i].m_root, from.getOrigin(), to.getOrigin(), collector);
+
+        PhysicsQueryResult &result = results[index];
+        result = PhysicsQueryResult();
+        if (rayCallback.hasHit())
+        {
+            const float3 pos = rayCallback.m_hitPointWorld;
+            SetQueryHit(result, rayCallback.m_collisionObject, pos, rayCallback.m_hitNormalWorld, (pos - origin).Length());
+        }
+    }
+
+private:
+    btDbvtBroadphase *broadphase;
+    const float3 *origins;
+    const float3 *directions;
+    float maxDistance;
+    PhysicsQueryResult *results;
+    int collisionGroup;
+    int collisionMask;
+};
+
+/// Sweeps a convex shape along each segment of a batch against both AABB trees of the broadphase.
+class ConvexSweepQueryBatch : public IParallelTask
+{
+public:
+    ConvexSweepQueryBatch(btDbvtBroadphase *broadphase_, const btConvexShape *shape_, const float3 *starts_, const float3 *ends_,
+        btScalar allowedPenetration_, PhysicsQueryResult *results_, int collisionGroup_, int collisionMask_) :
+        broadphase(broadphase_),
+        shape(shape_),
+        starts(starts_),
+        ends(ends_),
+        allowedPenetration(allowedPenetration_),
+        results(results_),
+        collisionGroup(collisionGroup_),
+        collisionMask(collisionMask_)
+    {
+    }
+
+    void RunItem(size_t index)
+    {
+        const btTransform from(btQuaternion::getIdentity(), starts[index]);
+        const btTransform to(btQuaternion::getIdentity(), ends[index]);
+
+        btCollisionWorld::ClosestConvexResultCallback sweepCallback(from.getOrigin(), to.getOrigin());
+        sweepCallback.m_collisionFilterGroup = collisionGroup;
+        sweepCallback.m_collisionFilterMask = collisionMask;
+
+        // The swept volume is enclosed by the AABBs of the shape at the start and end positions
+        btVector3 aabbMin, aabbMax, endAabbMin, endAabbMax;
+        shape->getAabb(from, aabbMin, aabbMax);
+        shape->getAabb(to, endAabbMin, endAabbMax);
+        aabbMin.setMin(endAabbMin);
+        aabbMax.setMax(endAabbMax);
+        const btDbvtVolume volume = btDbvtVolume::FromMM(aabbMin, aabbMax);
+
+        ConvexSweepCollector collector(shape, from, to, sweepCallback, allowedPenetration);
+        for(int i = 0; i < 2; ++i)
+            broadphase->m_sets[i].collideTV(broadphase->m_sets[i].m_root, volume, collector);
+
+        PhysicsQueryResult &result = results[index];
+        result = PhysicsQueryResult();
+        if (sweepCallback.hasHit())
+            SetQueryHit(result, sweepCallback.m_hitCollisionObject, sweepCallback.m_hitPointWorld, sweepCallback.m_hitNormalWorld,
+                sweepCallback.m_closestHitFraction * (ends[index] - starts[index]).Length());
+    }
+
+private:
+    btDbvtBroadphase *broadphase;
+    const btConvexShape *shape;
+    const float3 *starts;
+    const float3 *ends;
+    btScalar allowedPenetration;
+    PhysicsQueryResult *results;
+    int collisionGroup;
+    int collisionMask;
+};
+
+/// Reads pairs of positions or vectors from a flat array of six numbers per query.
+size_t ReadQueryArray(const PhysicsQueryArray &src, std::vector<float3> &first, std::vector<float3> &second, const QString &functionName)
+{
+    if (src.size() % 6 != 0)
+        LogWarning(functionName + ": The number of elements is not divisible by 6, ignoring the last " + QString::number(src.size() % 6) + ".");
+    const size_t numQueries = src.size() / 6;
+    first.resize(numQueries);
+    second.resize(numQueries);
+    const double *data = src.constData();
+    for(size_t i = 0; i < numQueries; ++i, data += 6)
+    {
+        first[i] = float3((float)data[0], (float)data[1], (float)data[2]);
+        second[i] = float3((float)data[3], (float)data[4], (float)data[5]);
+    }
+    return numQueries;
+}
+
+/// Writes query results to a flat array of eight numbers per query.
+PhysicsQueryArray WriteQueryArray(const std::vector<PhysicsQueryResult> &results)
+{
+    PhysicsQueryArray dest(results.size() * 8);
+    double *data = dest.data();
+    for(size_t i = 0; i < results.size(); ++i, data += 8)
+    {
+        const PhysicsQueryResult &result = results[i];
+        data[0] = result.entity ? (double)result.entity->Id() : 0.0;
+        data[1] = result.distance;
+        data[2] = result.pos.x;
+        data[3] = result.pos.y;
+        data[4] = result.pos.z;
+        data[5] = result.normal.x;
+        data[6] = result.normal.y;
+        data[7] = result.normal.z;
+    }
+    return dest;
+}
+
 } // ~unnamed namespace
 
 struct PhysicsWorld::Impl : public btIDebugDraw
 {
+    /// Simulated state of a rigid body after a step.
+    struct RigidBodyState
+    {
+        /// Body as recorded during the step. Only dereferenced on the main thread.
+        EC_RigidBody *bodyPtr;
+        /// Body resolved from bodyPtr on the main thread.
+        weak_ptr<EC_RigidBody> body;
+        float3 position;
+        Quat orientation;
+        float3 linearVelocity;
+        /// Angular velocity in degrees / sec.
+        float3 angularVelocity;
+    };
+
+    /// Substep of a step.
+    struct SubStep
+    {
+        float time;
+        /// Number of collisions of this substep in SimulationResults::collisions.
+        size_t numCollisions;
+    };
+
+    /// Everything a step produces for the main thread. The vectors are cleared instead of freed, so that their memory is reused on every step.
+    struct SimulationResults
+    {
+        std::vector<SubStep> subSteps;
+        PhysicsCollisionPairList collisions;
+        /// Bodies of the collisions as recorded during the step, resolved to the body pointers of collisions on the main thread.
+        std::vector<std::pair<EC_RigidBody*, EC_RigidBody*> > collisionBodies;
+        std::vector<RigidBodyState> states;
+
+        void Clear()
+        {
+            subSteps.clear();
+            collisions.clear();
+            collisionBodies.clear();
+            states.clear();
+        }
+
+        void Swap(SimulationResults &rhs)
+        {
+            subSteps.swap(rhs.subSteps);
+            collisions.swap(rhs.collisions);
+            collisionBodies.swap(rhs.collisionBodies);
+            states.swap(rhs.states);
+        }
+    };
+
     explicit Impl(PhysicsWorld *owner) :
         collisionConfiguration(0),
         collisionDispatcher(0),
@@ -77,7 +521,8 @@ struct PhysicsWorld::Impl : public btIDebugDraw
         solver(0),
         world(0),
         debugDrawMode(0),
-        cachedOgreWorld(0)
+        cachedOgreWorld(0),
+        thread(0)
     {
 #include "DisableMemoryLeakCheck.h"
         collisionConfiguration = new btDefaultCollisionConfiguration();
@@ -127,6 +572,125 @@ struct PhysicsWorld::Impl : public btIDebugDraw
 
     bool IsDebugGeometryEnabled() const { return getDebugMode() != btIDebugDraw::DBG_NoDebug; }
 
+    /// Resolves the body pointers of the results recorded by the physics thread, dropping the bodies that have been removed since.
+    void ResolveResults(SimulationResults &results)
+    {
+        for(size_t i = 0; i < results.states.size(); ++i)
+        {
+            RigidBodyState &state = results.states[i];
+            if (removedBodies.find(state.bodyPtr) == removedBodies.end())
+                state.body = static_pointer_cast<EC_RigidBody>(state.bodyPtr->shared_from_this());
+        }
+        // Collisions with removed bodies are left with expired body pointers, and skipped when emitting
+        for(size_t i = 0; i < results.collisions.size(); ++i)
+        {
+            EC_RigidBody *bodyA = results.collisionBodies[i].first;
+            EC_RigidBody *bodyB = results.collisionBodies[i].second;
+            if (removedBodies.find(bodyA) != removedBodies.end() || removedBodies.find(bodyB) != removedBodies.end())
+                continue;
+            results.collisions[i].bodyA = static_pointer_cast<EC_RigidBody>(bodyA->shared_from_this());
+            results.collisions[i].bodyB = static_pointer_cast<EC_RigidBody>(bodyB->shared_from_this());
+        }
+        removedBodies.clear();
+    }
+
+    /// Aggregates the contacts of the current substep to one collision per body pair, and appends them to results, followed by the pairs that stopped colliding.
+    /** Pairs are reported if either body has collision reporting enabled. Called from the physics thread in the threaded mode.
+        @param logErrors Whether to log inconsistent scene state. The physics thread must not log. */
+    void CollectCollisions(SimulationResults &results, bool logErrors)
+    {
+        const size_t firstIndex = results.collisions.size();
+        currentPairs.Clear();
+        
+        int numManifolds = collisionDispatcher->getNumManifolds();
+        for(int i = 0; i < numManifolds; ++i)
+        {
+            btPersistentManifold* contactManifold = collisionDispatcher->getManifoldByIndexInternal(i);
+            int numContacts = contactManifold->getNumContacts();
+            if (numContacts == 0)
+                continue;
+
+            const btCollisionObject* objectA = contactManifold->getBody0();
+            const btCollisionObject* objectB = contactManifold->getBody1();
+            EC_RigidBody* bodyA = static_cast<EC_RigidBody*>(objectA->getUserPointer());
+            EC_RigidBody* bodyB = static_cast<EC_RigidBody*>(objectB->getUserPointer());
+            
+            // We are only interested in collisions where both EC_RigidBody components are known
+            if (!bodyA || !bodyB)
+            {
+                if (logErrors)
+                    LogError("Inconsistent Bullet physics scene state! An object exists in the physics scene which does not have an associated EC_RigidBody!");
+                continue;
+            }
+            // Also, both bodies should have valid parent entities
+            if (!bodyA->ParentEntity() || !bodyB->ParentEntity())
+            {
+                if (logErrors)
+                    LogError("Inconsistent Bullet physics scene state! A parentless EC_RigidBody exists in the physics scene!");
+                continue;
+            }
+            
+            // A pair may have several manifolds, e.g. with compound shapes
+            CollisionPairSet::Entry *pair = currentPairs.Find(objectA, objectB);
+            if (!pair)
+                pair = currentPairs.Insert(objectA, objectB, bodyA, bodyB);
+            
+            // Sleeping pairs are tracked so that they do not count as new collisions when woken up, but are not reported
+            if (!objectA->isActive() && !objectB->isActive())
+                continue;
+            
+            if (pair->index < 0)
+            {
+                if (!bodyA->IsCollisionReportingEnabled() && !bodyB->IsCollisionReportingEnabled())
+                    continue;
+                pair->index = (int)results.collisions.size();
+                results.collisions.push_back(PhysicsCollisionPair());
+                results.collisions.back().state = previousPairs.Find(objectA, objectB) ? PhysicsCollisionPair::Stayed : PhysicsCollisionPair::Entered;
+                results.collisionBodies.push_back(std::make_pair(pair->bodyA, pair->bodyB));
+            }
+            
+            // The collision is reported in the order the pair was first seen, so flip the contacts of a manifold with the opposite order
+            PhysicsCollisionPair &collision = results.collisions[pair->index];
+            const bool flipped = (objectA != pair->objectA);
+            for(int j = 0; j < numContacts; ++j)
+            {
+                const btManifoldPoint& point = contactManifold->getContactPoint(j);
+                if (collision.numContacts == 0 || point.m_appliedImpulse > collision.impulse)
+                {
+                    collision.position = flipped ? point.m_positionWorldOnA : point.m_positionWorldOnB;
+                    collision.impulse = point.m_appliedImpulse;
+                }
+                if (collision.numContacts == 0 || point.m_distance1 < collision.distance)
+                    collision.distance = point.m_distance1;
+                if (flipped)
+                    collision.normal -= float3(point.m_normalWorldOnB);
+                else
+                    collision.normal += float3(point.m_normalWorldOnB);
+                ++collision.numContacts;
+            }
+        }
+        
+        for(size_t i = firstIndex; i < results.collisions.size(); ++i)
+            if (!results.collisions[i].normal.IsZero())
+                results.collisions[i].normal.Normalize();
+        
+        // Report the pairs that were colliding on the previous substep, but are not anymore
+        const std::vector<CollisionPairSet::Entry> &previous = previousPairs.Slots();
+        for(size_t i = 0; i < previous.size(); ++i)
+        {
+            const CollisionPairSet::Entry &pair = previous[i];
+            if (!pair.objectA || currentPairs.Find(pair.objectA, pair.objectB))
+                continue;
+            if (!pair.bodyA->IsCollisionReportingEnabled() && !pair.bodyB->IsCollisionReportingEnabled())
+                continue;
+            results.collisions.push_back(PhysicsCollisionPair());
+            results.collisions.back().state = PhysicsCollisionPair::Exited;
+            results.collisionBodies.push_back(std::make_pair(pair.bodyA, pair.bodyB));
+        }
+        
+        previousPairs.Swap(currentPairs);
+    }
+
     /// Bullet collision config
     btCollisionConfiguration* collisionConfiguration;
     /// Bullet collision dispatcher
@@ -141,6 +705,22 @@ struct PhysicsWorld::Impl : public btIDebugDraw
     int debugDrawMode;
     /// Cached OgreWorld pointer for drawing debug geometry
     OgreWorld* cachedOgreWorld;
+    /// Physics thread. Null if the world is not threaded
+    Thread *thread;
+    /// Results of the step in progress, written by the physics thread
+    SimulationResults backResults;
+    /// Results of the previous step, applied on the main thread
+    SimulationResults frontResults;
+    /// Rigid body commands queued during the step in progress
+    std::vector<RigidBodyCommand> queuedCommands;
+    /// Rigid bodies removed from the Bullet world after backResults were recorded
+    std::set<EC_RigidBody*> removedBodies;
+    /// Pairs colliding on the previous substep. Used to know whether a collision is new or "ongoing"
+    CollisionPairSet previousPairs;
+    /// Pairs colliding on the current substep
+    CollisionPairSet currentPairs;
+    /// Collisions of a single substep, for emitting a part of the results of a threaded step as a batch
+    PhysicsCollisionPairList subStepCollisions;
 };
 
 PhysicsWorld::PhysicsWorld(const ScenePtr &scene, bool isClient) :
@@ -151,14 +731,27 @@ PhysicsWorld::PhysicsWorld(const ScenePtr &scene, bool isClient) :
     runPhysics_(true),
     drawDebugManuallySet_(false),
     useVariableTimestep_(false),
+    threaded_(false),
+    stepSerial_(0),
     impl(new Impl(this))
 {
     if (scene->GetFramework()->HasCommandLineParameter("--variablephysicsstep"))
         useVariableTimestep_ = true;
+    if (scene->GetFramework()->HasCommandLineParameter("--threadedphysics"))
+    {
+        threaded_ = true;
+        impl->thread = new Thread(this);
+        impl->thread->start();
+    }
 }
 
 PhysicsWorld::~PhysicsWorld()
 {
+    if (impl->thread)
+    {
+        impl->thread->Stop();
+        delete impl->thread;
+    }
     delete impl;
 }
 
@@ -178,19 +771,31 @@ void PhysicsWorld::SetMaxSubSteps(int steps)
 
 void PhysicsWorld::SetGravity(const float3& gravity)
 {
-    impl->world->setGravity(gravity);
+    BulletWorld()->setGravity(gravity);
 }
 
 float3 PhysicsWorld::Gravity() const
 {
-    return impl->world->getGravity();
+    return BulletWorld()->getGravity();
 }
 
 btDiscreteDynamicsWorld* PhysicsWorld::BulletWorld() const
 {
+    WaitForSimulation();
     return impl->world;
 }
 
+bool PhysicsWorld::IsSimulating() const
+{
+    return impl->thread && impl->thread->IsStepping();
+}
+
+void PhysicsWorld::WaitForSimulation() const
+{
+    if (impl->thread)
+        impl->thread->WaitForStep();
+}
+
 void PhysicsWorld::Simulate(f64 frametime)
 {
     if (!runPhysics_)
@@ -198,137 +803,126 @@ void PhysicsWorld::Simulate(f64 frametime)
     
     PROFILE(PhysicsWorld_Simulate);
     
-    emit AboutToUpdate((float)frametime);
-    
+    if (threaded_)
     {
-        PROFILE(Bullet_stepSimulation); ///\note Do not delete or rename this PROFILE() block. The DebugStats profiler uses this string as a label to know where to inject the Bullet internal profiling data.
-        
-        // Use variable timestep if enabled, and if frame timestep exceeds the single physics simulation substep
-        if (useVariableTimestep_ && frametime > physicsUpdatePeriod_)
         {
-            float clampedTimeStep = (float)frametime;
-            if (clampedTimeStep > 0.1f)
-                clampedTimeStep = 0.1f; // Advance max. 1/10 sec. during one frame
-            impl->world->stepSimulation(clampedTimeStep, 0, clampedTimeStep);
+            PROFILE(Bullet_stepSimulation); ///\note Do not delete or rename this PROFILE() block. The DebugStats profiler uses this string as a label to know where to inject the Bullet internal profiling data.
+            WaitForSimulation();
         }
-        else
-            impl->world->stepSimulation((float)frametime, maxSubSteps_, physicsUpdatePeriod_);
+        
+        // Take the results of the completed step for applying, and apply the writes that were made while it was in progress
+        impl->frontResults.Swap(impl->backResults);
+        impl->backResults.Clear();
+        impl->ResolveResults(impl->frontResults);
+        ApplyQueuedCommands();
     }
     
-    // Automatically enable debug geometry if at least one debug-enabled rigidbody. Automatically disable if no debug-enabled rigidbodies
-    // However, do not do this if user has used the physicsdebug console command
-    if (!drawDebugManuallySet_)
+    emit AboutToUpdate((float)frametime);
+    
+    ++stepSerial_;
+    
+    if (threaded_)
     {
-        if (!IsDebugGeometryEnabled() && !debugRigidBodies_.empty())
-            SetDebugGeometryEnabled(true);
-        if (IsDebugGeometryEnabled() && debugRigidBodies_.empty())
-            SetDebugGeometryEnabled(false);
+        // Debug geometry is read from the Bullet world, so draw it before starting the step
+        DrawDebugGeometry();
+        // Let the physics thread step while the main thread applies the results of the previous step, and runs the rest of the frame
+        impl->thread->StartStep(frametime);
+        ApplySimulationResults();
+        return;
     }
     
-    if (IsDebugGeometryEnabled())
-        DrawDebugGeometry();
+    {
+        PROFILE(Bullet_stepSimulation); ///\note Do not delete or rename this PROFILE() block. The DebugStats profiler uses this string as a label to know where to inject the Bullet internal profiling data.
+        StepBulletWorld(frametime);
+    }
+    
+    DrawDebugGeometry();
+}
+
+void PhysicsWorld::StepBulletWorld(f64 frametime)
+{
+    QMutexLocker lock(&bulletStepMutex);
+    
+    // Use variable timestep if enabled, and if frame timestep exceeds the single physics simulation substep
+    if (useVariableTimestep_ && frametime > physicsUpdatePeriod_)
+    {
+        float clampedTimeStep = (float)frametime;
+        if (clampedTimeStep > 0.1f)
+            clampedTimeStep = 0.1f; // Advance max. 1/10 sec. during one frame
+        impl->world->stepSimulation(clampedTimeStep, 0, clampedTimeStep);
+    }
+    else
+        impl->world->stepSimulation((float)frametime, maxSubSteps_, physicsUpdatePeriod_);
 }
 
 void PhysicsWorld::ProcessPostTick(float substeptime)
 {
-    PROFILE(PhysicsWorld_ProcessPostTick);
-    // Check contacts and send collision signals for them
-    int numManifolds = impl->collisionDispatcher->getNumManifolds();
+    if (threaded_)
+    {
+        // Called from the physics thread: only record the collisions, the main thread emits the signals after the step.
+        Impl::SimulationResults &results = impl->backResults;
+        size_t numCollisions = results.collisions.size();
+        impl->CollectCollisions(results, false);
+        Impl::SubStep subStep;
+        subStep.time = substeptime;
+        subStep.numCollisions = results.collisions.size() - numCollisions;
+        results.subSteps.push_back(subStep);
+        return;
+    }
     
-    std::set<std::pair<const btCollisionObject*, const btCollisionObject*> > currentCollisions;
+    PROFILE(PhysicsWorld_ProcessPostTick);
     
-    // Collect all collision signals to a list before emitting any of them, in case a collision
+    // Collect all collisions to a list before emitting any of them, in case a collision
     // handler changes physics state before the loop below is over (which would lead into catastrophic
-    // consequences)
-    std::vector<CollisionSignal> collisions;
-    collisions.reserve(numManifolds * 3); // Guess some initial memory size for the collision list.
-
-    if (numManifolds > 0)
+    // consequences). The results of the threaded mode are unused here, so reuse their memory.
+    Impl::SimulationResults &results = impl->backResults;
     {
         PROFILE(PhysicsWorld_SendCollisions);
-        
-        for(int i = 0; i < numManifolds; ++i)
-        {
-            btPersistentManifold* contactManifold = impl->collisionDispatcher->getManifoldByIndexInternal(i);
-            int numContacts = contactManifold->getNumContacts();
-            if (numContacts == 0)
-                continue;
-
-            const btCollisionObject* objectA = contactManifold->getBody0();
-            const btCollisionObject* objectB = contactManifold->getBody1();
-			
-            std::pair<const btCollisionObject*, const btCollisionObject*> objectPair;
-            if (objectA < objectB)
-                objectPair = std::make_pair(objectA, objectB);
-            else
-                objectPair = std::make_pair(objectB, objectA);
-            
-            EC_RigidBody* bodyA = static_cast<EC_RigidBody*>(objectA->getUserPointer());
-            EC_RigidBody* bodyB = static_cast<EC_RigidBody*>(objectB->getUserPointer());
-            
-            // We are only interested in collisions where both EC_RigidBody components are known
-            if (!bodyA || !bodyB)
-            {
-                LogError("Inconsistent Bullet physics scene state! An object exists in the physics scene which does not have an associated EC_RigidBody!");
-                continue;
-            }
-            // Also, both bodies should have valid parent entities
-            Entity* entityA = bodyA->ParentEntity();
-            Entity* entityB = bodyB->ParentEntity();
-            if (!entityA || !entityB)
-            {
-                LogError("Inconsistent Bullet physics scene state! A parentless EC_RigidBody exists in the physics scene!");
-                continue;
-            }
-            // Check that at least one of the bodies is active
-            if (!objectA->isActive() && !objectB->isActive())
-                continue;
-            
-            bool newCollision = previousCollisions_.find(objectPair) == previousCollisions_.end();
-            
-            for(int j = 0; j < numContacts; ++j)
-            {
-                btManifoldPoint& point = contactManifold->getContactPoint(j);
-                
-                CollisionSignal s;
-                s.bodyA = static_pointer_cast<EC_RigidBody>(bodyA->shared_from_this());
-                s.bodyB = static_pointer_cast<EC_RigidBody>(bodyB->shared_from_this());
-                s.position = point.m_positionWorldOnB;
-                s.normal = point.m_normalWorldOnB;
-                s.distance = point.m_distance1;
-                s.impulse = point.m_appliedImpulse;
-                s.newCollision = newCollision;
-                collisions.push_back(s);
-                
-                // Report newCollision = true only for the first contact, in case there are several contacts, and application does some logic depending on it
-                // (for example play a sound -> avoid multiple sounds being played)
-                newCollision = false;
-            }
-            
-            currentCollisions.insert(objectPair);
-        }
+        results.Clear();
+        impl->CollectCollisions(results, true);
+        impl->ResolveResults(results);
     }
+    
+    EmitSubStepSignals(substeptime, results.collisions, 0, results.collisions.size());
+}
 
+void PhysicsWorld::EmitSubStepSignals(float substeptime, const PhysicsCollisionPairList &collisions, size_t begin, size_t end)
+{
     // Now fire all collision signals. Safeguard for the body components expiring in case signal handlers delete them from the scene
+    if (begin < end)
     {
         PROFILE(PhysicsWorld_emit_PhysicsCollisions);
-        for(size_t i = 0; i < collisions.size(); ++i)
+        
+        if (begin == 0 && end == collisions.size())
+            emit PhysicsCollisions(collisions);
+        else
+        {
+            impl->subStepCollisions.assign(collisions.begin() + begin, collisions.begin() + end);
+            emit PhysicsCollisions(impl->subStepCollisions);
+        }
+        
+        for(size_t i = begin; i < end; ++i)
         {
-            if (collisions[i].bodyA.expired() || collisions[i].bodyB.expired())
+            const PhysicsCollisionPair &c = collisions[i];
+            if (c.state == PhysicsCollisionPair::Exited)
+                continue;
+            const bool newCollision = (c.state == PhysicsCollisionPair::Entered);
+            
+            if (c.bodyA.expired() || c.bodyB.expired())
                 continue;
-            emit PhysicsCollision(collisions[i].bodyA.lock()->ParentEntity(), collisions[i].bodyB.lock()->ParentEntity(), collisions[i].position, collisions[i].normal, collisions[i].distance, collisions[i].impulse, collisions[i].newCollision);
+            emit PhysicsCollision(c.bodyA.lock()->ParentEntity(), c.bodyB.lock()->ParentEntity(), c.position, c.normal, c.distance, c.impulse, newCollision);
             
-            if (collisions[i].bodyA.expired() || collisions[i].bodyB.expired())
+            if (c.bodyA.expired() || c.bodyB.expired())
                 continue;
-            collisions[i].bodyA.lock()->EmitPhysicsCollision(collisions[i].bodyB.lock()->ParentEntity(), collisions[i].position, collisions[i].normal, collisions[i].distance, collisions[i].impulse, collisions[i].newCollision);
+            if (c.bodyA.lock()->IsCollisionReportingEnabled())
+                c.bodyA.lock()->EmitPhysicsCollision(c.bodyB.lock()->ParentEntity(), c.position, c.normal, c.distance, c.impulse, newCollision);
             
-            if (collisions[i].bodyA.expired() || collisions[i].bodyB.expired())
+            if (c.bodyA.expired() || c.bodyB.expired())
                 continue;
-            collisions[i].bodyB.lock()->EmitPhysicsCollision(collisions[i].bodyA.lock()->ParentEntity(), collisions[i].position, collisions[i].normal, collisions[i].distance, collisions[i].impulse, collisions[i].newCollision);
+            if (c.bodyB.lock()->IsCollisionReportingEnabled())
+                c.bodyB.lock()->EmitPhysicsCollision(c.bodyA.lock()->ParentEntity(), c.position, c.normal, c.distance, c.impulse, newCollision);
         }
     }
-
-    previousCollisions_ = currentCollisions;
     
     {
         PROFILE(PhysicsWorld_ProcessPostTick_Updated);
@@ -336,12 +930,97 @@ void PhysicsWorld::ProcessPostTick(float substeptime)
     }
 }
 
+std::vector<std::pair<const btCollisionObject*, const btCollisionObject*> > PhysicsWorld::PreviousFrameCollisions() const
+{
+    std::vector<std::pair<const btCollisionObject*, const btCollisionObject*> > collisions;
+    const std::vector<CollisionPairSet::Entry> &pairs = impl->previousPairs.Slots();
+    for(size_t i = 0; i < pairs.size(); ++i)
+        if (pairs[i].objectA)
+            collisions.push_back(std::make_pair(pairs[i].objectA, pairs[i].objectB));
+    return collisions;
+}
+
+void PhysicsWorld::ApplySimulationResults()
+{
+    PROFILE(PhysicsWorld_ApplySimulationResults);
+    
+    const Impl::SimulationResults &results = impl->frontResults;
+    
+    // Same order as in the non-threaded mode: the signals of each substep, then the motion states
+    size_t collisionIndex = 0;
+    for(size_t i = 0; i < results.subSteps.size(); ++i)
+    {
+        const Impl::SubStep &subStep = results.subSteps[i];
+        EmitSubStepSignals(subStep.time, results.collisions, collisionIndex, collisionIndex + subStep.numCollisions);
+        collisionIndex += subStep.numCollisions;
+    }
+    
+    // The results are from the step started before the current one
+    const u32 resultSerial = stepSerial_ - 1;
+    for(size_t i = 0; i < results.states.size(); ++i)
+    {
+        const Impl::RigidBodyState &state = results.states[i];
+        shared_ptr<EC_RigidBody> body = state.body.lock();
+        if (body)
+            body->ApplySimulatedState(state.position, state.orientation, state.linearVelocity, state.angularVelocity, resultSerial);
+    }
+}
+
+void PhysicsWorld::QueueCommand(const RigidBodyCommand &command)
+{
+    impl->queuedCommands.push_back(command);
+}
+
+void PhysicsWorld::ApplyQueuedCommands()
+{
+    if (impl->queuedCommands.empty())
+        return;
+    
+    PROFILE(PhysicsWorld_ApplyQueuedCommands);
+    
+    std::vector<RigidBodyCommand> commands;
+    commands.swap(impl->queuedCommands);
+    for(size_t i = 0; i < commands.size(); ++i)
+        commands[i].body->ApplyCommand(commands[i]);
+}
+
+void PhysicsWorld::StoreRigidBodyState(EC_RigidBody *body, const btTransform &worldTrans, const float3 &linearVelocity, const float3 &angularVelocity)
+{
+    Impl::RigidBodyState state;
+    state.bodyPtr = body;
+    state.position = worldTrans.getOrigin();
+    state.orientation = worldTrans.getRotation();
+    state.linearVelocity = linearVelocity;
+    state.angularVelocity = angularVelocity;
+    impl->backResults.states.push_back(state);
+}
+
+void PhysicsWorld::RigidBodyRemoved(EC_RigidBody *body)
+{
+    // The pairs hold raw pointers to the body, and a new body could be allocated to the same address
+    impl->previousPairs.RemoveBody(body);
+    
+    if (!threaded_)
+        return;
+    
+    impl->removedBodies.insert(body);
+    for(std::vector<RigidBodyCommand>::iterator i = impl->queuedCommands.begin(); i != impl->queuedCommands.end();)
+    {
+        if (i->body == body)
+            i = impl->queuedCommands.erase(i);
+        else
+            ++i;
+    }
+}
+
 PhysicsRaycastResult* PhysicsWorld::Raycast(const float3& origin, const float3& direction, float maxdistance, int collisiongroup, int collisionmask)
 {
     PROFILE(PhysicsWorld_Raycast);
     
     static PhysicsRaycastResult result;
     
+    WaitForSimulation();
+    
     float3 normalizedDir = direction.Normalized();
     
     btCollisionWorld::ClosestRayResultCallback rayCallback(origin, origin + maxdistance * normalizedDir);
@@ -369,6 +1048,65 @@ PhysicsRaycastResult* PhysicsWorld::Raycast(const float3& origin, const float3&
     return &result;
 }
 
+void PhysicsWorld::RaycastBatch(const float3 *origins, const float3 *directions, size_t numRays, float maxDistance, PhysicsQueryResult *results,
+    int collisionGroup, int collisionMask)
+{
+    if (numRays == 0)
+        return;
+
+    PROFILE(PhysicsWorld_RaycastBatch);
+
+    WaitForSimulation();
+
+    RayQueryBatch batch(static_cast<btDbvtBroadphase*>(impl->broadphase), origins, directions, maxDistance, results,
+        collisionGroup, collisionMask);
+    ParallelFor(batch, numRays, cQueryChunkSize);
+}
+
+void PhysicsWorld::ConvexSweepBatch(const btConvexShape *shape, const float3 *starts, const float3 *ends, size_t numSweeps, PhysicsQueryResult *results,
+    int collisionGroup, int collisionMask)
+{
+    if (numSweeps == 0 || !shape)
+        return;
+
+    PROFILE(PhysicsWorld_ConvexSweepBatch);
+
+    WaitForSimulation();
+
+    ConvexSweepQueryBatch batch(static_cast<btDbvtBroadphase*>(impl->broadphase), shape, starts, ends,
+        impl->world->getDispatchInfo().m_allowedCcdPenetration, results, collisionGroup, collisionMask);
+    ParallelFor(batch, numSweeps, cQueryChunkSize);
+}
+
+PhysicsQueryArray PhysicsWorld::RaycastBatch(const PhysicsQueryArray &rays, float maxDistance, int collisionGroup, int collisionMask)
+{
+    std::vector<float3> origins, directions;
+    const size_t numRays = ReadQueryArray(rays, origins, directions, "PhysicsWorld::RaycastBatch");
+    std::vector<PhysicsQueryResult> results(numRays);
+    if (numRays > 0)
+        RaycastBatch(&origins[0], &directions[0], numRays, maxDistance, &results[0], collisionGroup, collisionMask);
+    return WriteQueryArray(results);
+}
+
+PhysicsQueryArray PhysicsWorld::SphereSweepBatch(const PhysicsQueryArray &sweeps, float radius, int collisionGroup, int collisionMask)
+{
+    if (radius <= 0.0f)
+    {
+        LogError("PhysicsWorld::SphereSweepBatch: Invalid sphere radius " + QString::number(radius) + ".");
+        return PhysicsQueryArray();
+    }
+
+    std::vector<float3> starts, ends;
+    const size_t numSweeps = ReadQueryArray(sweeps, starts, ends, "PhysicsWorld::SphereSweepBatch");
+    std::vector<PhysicsQueryResult> results(numSweeps);
+    if (numSweeps > 0)
+    {
+        btSphereShape sphere(radius);
+        ConvexSweepBatch(&sphere, &starts[0], &ends[0], numSweeps, &results[0], collisionGroup, collisionMask);
+    }
+    return WriteQueryArray(results);
+}
+
 EntityList PhysicsWorld::ObbCollisionQuery(const OBB &obb, int collisionGroup, int collisionMask)
 {
     PROFILE(PhysicsWorld_ObbCollisionQuery);
@@ -376,6 +1114,8 @@ EntityList PhysicsWorld::ObbCollisionQuery(const OBB &obb, int collisionGroup, i
     std::set<btCollisionObjectWrapper*> objects;
     EntityList entities;
     
+    WaitForSimulation();
+    
     btBoxShape box(obb.HalfSize()); // Note: Bullet uses box halfsize
     float3x3 m(obb.axis[0], obb.axis[1], obb.axis[2]);
     btTransform t1(m.ToQuat(), obb.CenterPoint());
@@ -408,6 +1148,7 @@ void PhysicsWorld::SetDebugGeometryEnabled(bool enable)
         return;
 
     /// @todo Make possisble to set other debug modes too.
+    WaitForSimulation();
     impl->setDebugMode(enable ? btIDebugDraw::DBG_DrawWireframe | btIDebugDraw::DBG_DrawConstraintLimits | btIDebugDraw::DBG_DrawConstraints : btIDebugDraw::DBG_NoDebug);
 }
 
@@ -418,6 +1159,16 @@ bool PhysicsWorld::IsDebugGeometryEnabled() const
 
 void PhysicsWorld::DrawDebugGeometry()
 {
+    // Automatically enable debug geometry if at least one debug-enabled rigidbody. Automatically disable if no debug-enabled rigidbodies
+    // However, do not do this if user has used the physicsdebug console command
+    if (!drawDebugManuallySet_)
+    {
+        if (!IsDebugGeometryEnabled() && !debugRigidBodies_.empty())
+            SetDebugGeometryEnabled(true);
+        if (IsDebugGeometryEnabled() && debugRigidBodies_.empty())
+            SetDebugGeometryEnabled(false);
+    }
+    
     if (!IsDebugGeometryEnabled())
         return;
 
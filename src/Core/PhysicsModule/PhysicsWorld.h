@@ -7,10 +7,13 @@
 #include "PhysicsModuleApi.h"
 #include "PhysicsModuleFwd.h"
 #include "Math/float3.h"
+#include "Math/Quat.h"
 #include "Math/MathFwd.h"
 
 #include <set>
+#include <vector>
 #include <QObject>
+#include <QVector>
 #include <QMetaType>
 
 class OgreWorld;
@@ -40,6 +43,82 @@ public:
 };
 Q_DECLARE_METATYPE(PhysicsRaycastResult*);
 
+/// Result of a single ray or sweep of a batched physics query.
+/** Other fields are valid only if distance is non-negative.
+    @sa PhysicsWorld::RaycastBatch, PhysicsWorld::ConvexSweepBatch */
+struct PhysicsQueryResult
+{
+    PhysicsQueryResult() : entity(0), distance(-1.0f) {}
+
+    bool HasHit() const { return distance >= 0.0f; }
+
+    Entity* entity; ///< Entity that was hit, null if none
+    float3 pos; ///< World coordinates of hit position
+    float3 normal; ///< World face normal of hit.
+    float distance; ///< Distance from the ray origin or the sweep start position to the hit point, -1 if nothing was hit.
+};
+
+/// Flat array of numbers passed to and returned from the batched physics queries of scripts.
+typedef QVector<double> PhysicsQueryArray;
+Q_DECLARE_METATYPE(PhysicsQueryArray);
+
+/// Collision between two rigid bodies during a single physics simulation step, aggregated over all contact points of the pair.
+/** @sa PhysicsWorld::PhysicsCollisions */
+struct PhysicsCollisionPair
+{
+    /// Collision state of the pair
+    enum State
+    {
+        Entered = 0, ///< The bodies started touching on this step
+        Stayed, ///< The bodies were touching already on the previous step
+        Exited ///< The bodies stopped touching on this step. The contact fields are zero.
+    };
+
+    PhysicsCollisionPair() : position(float3::zero), normal(float3::zero), distance(0.0f), impulse(0.0f), numContacts(0), state(Entered) {}
+
+    weak_ptr<EC_RigidBody> bodyA; ///< The first body
+    weak_ptr<EC_RigidBody> bodyB; ///< The second body
+    float3 position; ///< World position of the contact with the strongest impulse, on bodyB
+    float3 normal; ///< Average world normal of the contacts, pointing from bodyB to bodyA
+    float distance; ///< Smallest contact distance
+    float impulse; ///< Strongest impulse applied to the bodies to separate them
+    int numContacts; ///< Number of contact points
+    State state; ///< Collision state
+};
+typedef std::vector<PhysicsCollisionPair> PhysicsCollisionPairList;
+
+/// Deferred write to the Bullet state of a rigid body.
+/** EC_RigidBody queues these while a threaded PhysicsWorld is stepping, and the world applies them in order before the next step.
+    @sa PhysicsWorld::IsThreaded */
+struct RigidBodyCommand
+{
+    enum Type
+    {
+        ApplyForce = 0, ///< Apply force vec at object space position pos
+        ApplyTorque, ///< Apply torque vec
+        ApplyImpulse, ///< Apply impulse vec at object space position pos
+        ApplyTorqueImpulse, ///< Apply torque impulse vec
+        SetLinearVelocity, ///< Set linear velocity to vec
+        SetAngularVelocity, ///< Set angular velocity to vec, in degrees / sec
+        SetPosRot, ///< Set world position to pos and world orientation to rot
+        SetRotation, ///< Set world orientation to rot
+        Activate, ///< Wake up the body
+        KeepActive, ///< Keep the body awake
+        ClearForces ///< Reset accumulated force & torque
+    };
+
+    RigidBodyCommand(EC_RigidBody *body_, Type type_, const float3 &vec_ = float3::zero, const float3 &pos_ = float3::zero, const Quat &rot_ = Quat::identity) :
+        body(body_), type(type_), vec(vec_), pos(pos_), rot(rot_)
+    {
+    }
+
+    EC_RigidBody *body;
+    Type type;
+    float3 vec;
+    float3 pos;
+    Quat rot;
+};
+
 /// A physics world that encapsulates a Bullet physics world
 class PHYSICS_MODULE_API PhysicsWorld : public QObject, public enable_shared_from_this<PhysicsWorld>
 {
@@ -69,9 +148,9 @@ public:
     /// Dynamic scene property name
     static const char* PropertyName() { return "physics"; }
 
-    /// Returns the set of collisions that occurred during the previous frame.
-    /// \important Use this function only for debugging, the availability of this set data structure is not guaranteed in the future.
-    const std::set<std::pair<const btCollisionObject*, const btCollisionObject*> > &PreviousFrameCollisions() const { return previousCollisions_; }
+    /// Returns the pairs of objects that were colliding during the previous simulation step.
+    /// \important Use this function only for debugging, it is not optimized for performance. In the threaded mode, call WaitForSimulation first.
+    std::vector<std::pair<const btCollisionObject*, const btCollisionObject*> > PreviousFrameCollisions() const;
 
     /// Set physics update period (= length of each simulation step.) By default 1/60th of a second.
     /** @param updatePeriod Update period */
@@ -107,8 +186,47 @@ public:
     bool IsRunning() const { return runPhysics_; }
 
     /// Return the Bullet world object
+    /** If the world is threaded, waits for the step in progress to complete before returning. */
     btDiscreteDynamicsWorld* BulletWorld() const;
 
+    /// Returns whether the Bullet world is stepped in a dedicated physics thread.
+    /** Enabled with the --threadedphysics command line parameter. In threaded mode Simulate starts the step for the current frame
+        in the physics thread and then applies the results of the previous step: collision signals, Updated signals and the
+        transforms & velocities of the rigid bodies are emitted on the main thread in the same order as in the non-threaded mode,
+        but one frame later. The simulation itself is stepped with the same time steps, so it stays deterministic. */
+    bool IsThreaded() const { return threaded_; }
+
+    /// Returns whether a step is in progress in the physics thread. While it is, the Bullet world must not be accessed from the main thread.
+    bool IsSimulating() const;
+
+    /// Waits for the step in progress in the physics thread, if any, to complete.
+    /** Call this before accessing the Bullet objects directly. Is a no-op in the non-threaded mode. */
+    void WaitForSimulation() const;
+
+    /// Raycasts a batch of rays to the world. Returns only the closest result of each ray.
+    /** The rays are processed in parallel in worker threads and the calling thread. Returns once all rays have been processed.
+        @param origins World origin positions of the rays
+        @param directions Directions of the rays. Will be normalized automatically
+        @param numRays Number of rays, i.e. the number of elements in origins, directions and results
+        @param maxDistance Length of the rays
+        @param results Results of the rays, in the same order as the rays
+        @param collisionGroup Collision layer. Default has all bits set.
+        @param collisionMask Collision mask. Default has all bits set. */
+    void RaycastBatch(const float3 *origins, const float3 *directions, size_t numRays, float maxDistance, PhysicsQueryResult *results,
+        int collisionGroup = -1, int collisionMask = -1);
+
+    /// Sweeps a convex shape along a batch of line segments in the world. Returns only the first hit of each sweep.
+    /** The sweeps are processed in parallel in worker threads, see RaycastBatch. The shape is not rotated.
+        @param shape Shape to sweep. It does not need to belong to the world.
+        @param starts World start positions of the sweeps
+        @param ends World end positions of the sweeps
+        @param numSweeps Number of sweeps, i.e. the number of elements in starts, ends and results
+        @param results Results of the sweeps, in the same order as the sweeps. The position is the contact point.
+        @param collisionGroup Collision layer. Default has all bits set.
+        @param collisionMask Collision mask. Default has all bits set. */
+    void ConvexSweepBatch(const btConvexShape *shape, const float3 *starts, const float3 *ends, size_t numSweeps, PhysicsQueryResult *results,
+        int collisionGroup = -1, int collisionMask = -1);
+
 public slots:
     /// Return whether the physics world is for a client scene. Client scenes only simulate local entities' motion on their own.
     bool IsClient() const { return isClient_; }
@@ -119,9 +237,28 @@ public slots:
         @param maxDistance Length of ray
         @param collisionGroup Collision layer. Default has all bits set.
         @param collisionMask Collision mask. Default has all bits set.
-        @return result PhysicsRaycastResult structure */
+        @return result PhysicsRaycastResult structure. It is overwritten by the next call, so use RaycastBatch to cast many rays at once. */
     PhysicsRaycastResult* Raycast(const float3& origin, const float3& direction, float maxDistance, int collisionGroup = -1, int collisionMask = -1);
 
+    /// Raycasts a batch of rays to the world. Returns only the closest result of each ray.
+    /** Use to cast a large number of rays at once instead of calling Raycast for each of them.
+        @param rays Six numbers per ray: the origin x, y, z and the direction x, y, z. Directions will be normalized automatically
+        @param maxDistance Length of the rays
+        @param collisionGroup Collision layer. Default has all bits set.
+        @param collisionMask Collision mask. Default has all bits set.
+        @return Eight numbers per ray, in the same order as the rays: id of the entity hit (0 if none), distance to the hit point
+        (-1 if nothing was hit), hit position x, y, z and hit normal x, y, z. */
+    PhysicsQueryArray RaycastBatch(const PhysicsQueryArray &rays, float maxDistance, int collisionGroup = -1, int collisionMask = -1);
+
+    /// Sweeps a sphere along a batch of line segments in the world. Returns only the first hit of each sweep.
+    /** @param sweeps Six numbers per sweep: the start position x, y, z and the end position x, y, z.
+        @param radius Radius of the sphere
+        @param collisionGroup Collision layer. Default has all bits set.
+        @param collisionMask Collision mask. Default has all bits set.
+        @return Eight numbers per sweep, in the same order as the sweeps: id of the entity hit (0 if none), distance the sphere travelled
+        before the hit (-1 if nothing was hit), contact position x, y, z and contact normal x, y, z. */
+    PhysicsQueryArray SphereSweepBatch(const PhysicsQueryArray &sweeps, float radius, int collisionGroup = -1, int collisionMask = -1);
+
     /// Performs collision query for OBB.
     /** @param obb Oriented bounding box to test
         @param collisionGroup Collision layer of the OBB. Default has all bits set.
@@ -131,30 +268,59 @@ public slots:
 
 signals:
     /// A physics collision has happened between two entities. 
-    /** Note: both rigidbodies participating in the collision will also emit a signal separately. 
-        Also, if there are several contact points, the signal will be sent multiple times for each contact.
+    /** Note: rigidbodies participating in the collision that have collision reporting enabled will also emit a signal separately.
+        The signal is sent once per colliding pair on each simulation step, with the contact points of the pair aggregated.
+        Collisions between two rigidbodies that both have collision reporting disabled are not reported, see EC_RigidBody::collisionReporting.
         @param entityA The first entity
         @param entityB The second entity
-        @param position World position of collision
-        @param normal World normal of collision
-        @param distance Contact distance
-        @param impulse Impulse applied to the objects to separate them
-        @param newCollision True if same collision did not happen on the previous frame.
-                If collision has multiple contact points, newCollision can only be true for the first of them. */
+        @param position World position of the contact with the strongest impulse
+        @param normal Average world normal of the contacts
+        @param distance Smallest contact distance
+        @param impulse Strongest impulse applied to the objects to separate them
+        @param newCollision True if same collision did not happen on the previous step. */
     void PhysicsCollision(Entity* entityA, Entity* entityB, const float3& position, const float3& normal, float distance, float impulse, bool newCollision);
+
+    /// All collisions of a simulation step as a single batch, including the pairs that stopped colliding.
+    /** Emitted before the PhysicsCollision signals of the step. Reports the same collisions as PhysicsCollision.
+        @param collisions The colliding pairs. The list is valid only during the signal. */
+    void PhysicsCollisions(const PhysicsCollisionPairList &collisions);
     
     /// Emitted before the simulation steps. Note: emitted only once per frame, not before each substep.
     /** @param frametime Length of simulation steps */
     void AboutToUpdate(float frametime);
     
     /// Emitted after each simulation step
-    /** @param frametime Length of simulation step */
+    /** In the threaded mode, emitted on the main thread when the results of the step are applied, see IsThreaded.
+        @param frametime Length of simulation step */
     void Updated(float frametime);
 
 private:
-    /// Draw physics debug geometry, if debug drawing enabled
+    class Thread;
+
+    /// Draw physics debug geometry, if debug drawing enabled. Also enables or disables debug drawing automatically, unless set manually.
     void DrawDebugGeometry();
 
+    /// Steps the Bullet world. Called from the physics thread in the threaded mode.
+    void StepBulletWorld(f64 frametime);
+
+    /// Emits the collision signals of collisions [begin, end) and the Updated signal of a single substep.
+    void EmitSubStepSignals(float substeptime, const PhysicsCollisionPairList &collisions, size_t begin, size_t end);
+
+    /// Applies the results of the previous step of the physics thread to the scene.
+    void ApplySimulationResults();
+
+    /// Queues a rigid body command to be applied before the next step. Called by EC_RigidBody while a step is in progress.
+    void QueueCommand(const RigidBodyCommand &command);
+
+    /// Applies all queued rigid body commands.
+    void ApplyQueuedCommands();
+
+    /// Records the simulated state of a rigid body. Called by EC_RigidBody from the physics thread.
+    void StoreRigidBodyState(EC_RigidBody *body, const btTransform &worldTrans, const float3 &linearVelocity, const float3 &angularVelocity);
+
+    /// Forgets all collision tracking and pending state of a rigid body. Called by EC_RigidBody when the body is removed from the Bullet world.
+    void RigidBodyRemoved(EC_RigidBody *body);
+
     struct Impl;
     Impl *impl;
     /// Length of one physics simulation step
@@ -165,14 +331,16 @@ private:
     bool isClient_;
     /// Parent scene
     SceneWeakPtr scene_;
-    /// Previous frame's collisions. We store these to know whether the collision was new or "ongoing"
-    std::set<std::pair<const btCollisionObject*, const btCollisionObject*> > previousCollisions_;
     /// Debug geometry manually enabled/disabled (with physicsdebug console command). If true, do not automatically enable/disable debug geometry anymore
     bool drawDebugManuallySet_;
     /// Whether should run physics. Default true
     bool runPhysics_;
     /// Variable timestep flag
     bool useVariableTimestep_;
+    /// Threaded simulation flag
+    bool threaded_;
+    /// Number of steps started. In the threaded mode, rigid bodies use this to know whether their transform was set after a step was started.
+    u32 stepSerial_;
     /// Debug draw-enabled rigidbodies. Note: these pointers are never dereferenced, it is just used for counting
     std::set<EC_RigidBody*> debugRigidBodies_;
 };
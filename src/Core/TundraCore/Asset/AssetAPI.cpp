@@ -35,6 +35,7 @@
 AssetAPI::AssetAPI(Framework *framework, bool headless) :
     fw(framework),
     isHeadless(headless),
+    shareIdenticalAssets(framework->HasCommandLineParameter("--shareIdenticalAssets")),
     assetCache(0),
     diskSourceChangeWatcher(0)
 {
@@ -449,6 +450,13 @@ AssetPtr AssetAPI::CreateAssetFromFile(QString assetType, QString assetFile)
 
 bool AssetAPI::ForgetAsset(QString assetRef, bool removeDiskSource)
 {
+    // Forgetting a ref that shares the data of another asset only removes the ref, the shared asset stays loaded.
+    if (RemoveSharedAssetRef(assetRef))
+    {
+        if (removeDiskSource && assetCache)
+            assetCache->DeleteAsset(assetRef);
+        return true;
+    }
     return ForgetAsset(GetAsset(assetRef), removeDiskSource);
 }
 
@@ -492,6 +500,24 @@ bool AssetAPI::ForgetAsset(AssetPtr asset, bool removeDiskSource)
     if (diskSourceChangeWatcher && !asset->DiskSource().isEmpty())
         diskSourceChangeWatcher->removePath(asset->DiskSource());
     assets.erase(iter);
+
+    // Remove all refs that were sharing this asset.
+    std::map<QString, QString, QStringLessThanNoCase>::iterator keyIter = sharableAssetKeys.find(asset->Name());
+    if (keyIter != sharableAssetKeys.end())
+    {
+        sharableAssets.erase(keyIter->second);
+        sharableAssetKeys.erase(keyIter);
+    }
+    for(std::map<QString, QString, QStringLessThanNoCase>::iterator refIter = sharedAssetRefs.begin(); refIter != sharedAssetRefs.end();)
+    {
+        if (refIter->second.compare(asset->Name(), Qt::CaseInsensitive) == 0)
+        {
+            assets.erase(refIter->first);
+            sharedAssetRefs.erase(refIter++);
+        }
+        else
+            ++refIter;
+    }
     return true;
 }
 
@@ -730,6 +756,9 @@ void AssetAPI::Reset()
     currentUploadTransfers.clear();
     currentTransfers.clear();
     providers.clear();
+    sharableAssets.clear();
+    sharableAssetKeys.clear();
+    sharedAssetRefs.clear();
 }
 
 std::vector<AssetTransferPtr> AssetAPI::PendingTransfers() const
@@ -1606,8 +1635,8 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
 
             // Cache the bundle.
             QString bundleDiskSource = transfer->DiskSource(); // The asset provider may have specified an explicit filename to use as a disk source.
-            if (transfer->CachingAllowed() && transfer->rawAssetData.size() > 0 && assetCache)
-                bundleDiskSource = assetCache->StoreAsset(&transfer->rawAssetData[0], transfer->rawAssetData.size(), transfer->source.ref);
+            if (transfer->CachingAllowed() && !transfer->rawAssetData.IsEmpty() && assetCache)
+                bundleDiskSource = assetCache->StoreAsset(transfer->rawAssetData.Data(), transfer->rawAssetData.Size(), transfer->source.ref);
             assetBundle->SetDiskSource(bundleDiskSource);
 
             // The bundle has now been downloaded and cached (if allowed by policy).
@@ -1621,9 +1650,9 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
             bool success = assetBundle->DeserializeFromDiskSource();
             if (!success && !assetBundle->RequiresDiskSource())
             {
-                const u8 *bundleData = (transfer->rawAssetData.size() > 0 ? &transfer->rawAssetData[0] : 0);
+                const u8 *bundleData = transfer->rawAssetData.Data();
                 if (bundleData)
-                    success = assetBundle->DeserializeFromData(bundleData, transfer->rawAssetData.size());
+                    success = assetBundle->DeserializeFromData(bundleData, transfer->rawAssetData.Size());
             }
 
             // If all of the above returned false, this means asset could not be loaded.
@@ -1649,6 +1678,41 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
     // Transfer is for a normal asset.
     else
     {
+        // Save this asset to cache, and find out which file will represent a cached version of this asset.
+        QString assetDiskSource = transfer->DiskSource(); // The asset provider may have specified an explicit filename to use as a disk source.
+        if (!transfer->rawAssetData.IsEmpty() && assetCache)
+        {
+            if (transfer->CachingAllowed())
+                assetDiskSource = assetCache->StoreAsset(transfer->rawAssetData.Data(), transfer->rawAssetData.Size(), transfer->source.ref);
+            // In the content-addressed mode, move the data the provider already wrote to the cache into a shared blob.
+            else if (assetCache->IsContentAddressed() && !assetDiskSource.isEmpty() && assetDiskSource == assetCache->GetDiskSourceByRef(transfer->source.ref))
+                assetDiskSource = assetCache->StoreAsset(transfer->rawAssetData.Data(), transfer->rawAssetData.Size(), transfer->source.ref);
+        }
+
+        // If disksource is still empty, forcibly look up if the asset exists in the cache now.
+        if (assetDiskSource.isEmpty() && assetCache)
+            assetDiskSource = assetCache->FindInCache(transfer->source.ref);
+
+        // This ref was sharing the data of another asset. As new data has now arrived for it, detach it to a separate asset.
+        if (transfer->asset && transfer->asset->Name().compare(transfer->source.ref, Qt::CaseInsensitive) != 0 && RemoveSharedAssetRef(transfer->source.ref))
+            transfer->asset.reset();
+
+        // Check if an asset with identical data has already been loaded from another ref, and share it if the asset type allows it.
+        QString contentKey;
+        if (shareIdenticalAssets && !transfer->rawAssetData.IsEmpty())
+        {
+            AssetTypeFactoryPtr factory = AssetTypeFactory(transfer->assetType);
+            if (factory && factory->AllowsContentSharing())
+            {
+                QString contentHash = (assetCache ? assetCache->ContentHashForRef(transfer->source.ref) : "");
+                if (contentHash.isEmpty())
+                    contentHash = AssetCache::ContentHash(transfer->rawAssetData.Data(), transfer->rawAssetData.Size());
+                contentKey = transfer->assetType + ":" + contentHash;
+                if (!transfer->asset && ShareIdenticalAsset(transfer, contentKey))
+                    return;
+            }
+        }
+
         // We've finished an asset data download, now create an actual instance of an asset of that type if it did not exist already
         if (!transfer->asset)
             transfer->asset = CreateNewAsset(transfer->assetType, transfer->source.ref);
@@ -1663,15 +1727,16 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
         // Connect to Loaded() signal of the asset to be able to notify any dependent assets
         connect(transfer->asset.get(), SIGNAL(Loaded(AssetPtr)), this, SLOT(OnAssetLoaded(AssetPtr)), Qt::UniqueConnection);
 
-        // Save this asset to cache, and find out which file will represent a cached version of this asset.
-        QString assetDiskSource = transfer->DiskSource(); // The asset provider may have specified an explicit filename to use as a disk source.
-        if (transfer->CachingAllowed() && transfer->rawAssetData.size() > 0 && assetCache)
-            assetDiskSource = assetCache->StoreAsset(&transfer->rawAssetData[0], transfer->rawAssetData.size(), transfer->source.ref);
+        // Remember the content of this asset so that later refs with identical data can share it.
+        if (!contentKey.isEmpty())
+        {
+            QString &previousKey = sharableAssetKeys[transfer->asset->Name()];
+            if (!previousKey.isEmpty() && previousKey != contentKey)
+                sharableAssets.erase(previousKey);
+            previousKey = contentKey;
+            sharableAssets[contentKey] = transfer->asset;
+        }
 
-        // If disksource is still empty, forcibly look up if the asset exists in the cache now.
-        if (assetDiskSource.isEmpty() && assetCache)
-            assetDiskSource = assetCache->FindInCache(transfer->source.ref);
-        
         // Save for the asset the storage and provider it came from.
         transfer->asset->SetDiskSource(assetDiskSource.trimmed());
         transfer->asset->SetDiskSourceType(transfer->diskSourceType);
@@ -1682,9 +1747,9 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
         transfer->EmitAssetDownloaded();
 
         bool success = false;
-        const u8 *data = (transfer->rawAssetData.size() > 0 ? &transfer->rawAssetData[0] : 0);
+        const u8 *data = transfer->rawAssetData.Data();
         if (data)
-            success = transfer->asset->LoadFromFileInMemory(data, transfer->rawAssetData.size());
+            success = transfer->asset->LoadFromFileInMemory(data, transfer->rawAssetData.Size());
         else
             success = transfer->asset->LoadFromFile(transfer->asset->DiskSource());
 
@@ -1697,6 +1762,42 @@ void AssetAPI::AssetTransferCompleted(IAssetTransfer *transfer_)
     }
 }
 
+bool AssetAPI::ShareIdenticalAsset(AssetTransferPtr transfer, const QString &contentKey)
+{
+    std::map<QString, AssetWeakPtr>::iterator iter = sharableAssets.find(contentKey);
+    if (iter == sharableAssets.end())
+        return false;
+
+    // Only assets without references can be shared, as relative references would resolve differently in the context of another ref.
+    AssetPtr existing = iter->second.lock();
+    if (!existing || !existing->IsLoaded() || existing->IsModified() || !existing->FindReferences().empty() || HasPendingDependencies(existing))
+        return false;
+
+    LogDebug("AssetAPI: Asset \"" + transfer->source.ref + "\" has identical data with the loaded asset \"" + existing->Name() + "\", sharing it.");
+    transfer->asset = existing;
+    assets[transfer->source.ref] = existing;
+    sharedAssetRefs[transfer->source.ref] = existing->Name();
+
+    // The shared asset is already loaded with all of its dependencies, so complete the transfer right away like a virtual transfer.
+    transfer->EmitAssetDownloaded();
+    transfer->EmitTransferSucceeded();
+    pendingDownloadRequests.erase(transfer->source.ref);
+    AssetTransferMap::iterator transferIter = FindTransferIterator(transfer.get());
+    if (transferIter != currentTransfers.end())
+        currentTransfers.erase(transferIter);
+    return true;
+}
+
+bool AssetAPI::RemoveSharedAssetRef(const QString &assetRef)
+{
+    std::map<QString, QString, QStringLessThanNoCase>::iterator iter = sharedAssetRefs.find(assetRef);
+    if (iter == sharedAssetRefs.end())
+        return false;
+    assets.erase(assetRef);
+    sharedAssetRefs.erase(iter);
+    return true;
+}
+
 void AssetAPI::AssetTransferFailed(IAssetTransfer *transfer, QString reason)
 {
     if (!transfer)
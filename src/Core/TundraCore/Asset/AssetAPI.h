@@ -520,8 +520,28 @@ private:
     /// Overload that takes in AssetBundlePtr instead of refs.
     bool LoadSubAssetToTransfer(AssetTransferPtr transfer, IAssetBundle *bundle, const QString &fullSubAssetRef, QString subAssetType = QString());
 
+    /// Completes the given transfer with an already loaded asset that has identical data, if such an asset exists and can be shared.
+    /** @param contentKey The type and content hash of the transfer data in the form "<type>:<hash>".
+        @return True if the transfer was completed with a shared asset, false if the asset has to be loaded normally. */
+    bool ShareIdenticalAsset(AssetTransferPtr transfer, const QString &contentKey);
+
+    /// Removes the given asset ref that shares the data of another asset. Returns false if the ref was not a shared ref.
+    bool RemoveSharedAssetRef(const QString &assetRef);
+
     bool isHeadless;
 
+    /// If true, asset refs that resolve to identical data share a single loaded asset when the asset type factory allows it.
+    bool shareIdenticalAssets;
+
+    /// Maps "<type>:<content hash>" keys to the loaded assets that other refs with identical data can share.
+    std::map<QString, AssetWeakPtr> sharableAssets;
+
+    /// Maps the names of sharable assets to their keys in sharableAssets.
+    std::map<QString, QString, QStringLessThanNoCase> sharableAssetKeys;
+
+    /// Maps the asset refs that share the data of another asset to the name of that asset.
+    std::map<QString, QString, QStringLessThanNoCase> sharedAssetRefs;
+
     /// Stores all the currently ongoing asset transfers.
     AssetTransferMap currentTransfers;
 
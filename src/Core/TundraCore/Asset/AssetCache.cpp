@@ -10,6 +10,7 @@
 #include "CoreDefines.h"
 #include "Framework.h"
 #include "LoggingFunctions.h"
+#include "Profiler.h"
 
 #include <QDateTime>
 #include <QUrl>
@@ -17,6 +18,8 @@
 #include <QDataStream>
 #include <QFileInfo>
 #include <QScopedPointer>
+#include <QTextStream>
+#include <QCryptographicHash>
 
 #ifdef Q_WS_WIN
 #include "Win.h"
@@ -29,7 +32,8 @@
 
 AssetCache::AssetCache(AssetAPI *owner, QString assetCacheDirectory) : 
     assetAPI(owner),
-    cacheDirectory(GuaranteeTrailingSlash(QDir::fromNativeSeparators(assetCacheDirectory)))
+    cacheDirectory(GuaranteeTrailingSlash(QDir::fromNativeSeparators(assetCacheDirectory))),
+    contentAddressed(false)
 {
     LogInfo("* Asset cache directory  : " + QDir::toNativeSeparators(cacheDirectory));  
 
@@ -49,6 +53,18 @@ AssetCache::AssetCache(AssetAPI *owner, QString assetCacheDirectory) :
         assetDir.mkdir("data");
     assetDataDir = QDir(cacheDirectory + "data");
 
+    // Check --contentAddressedAssetCache start param
+    if (owner->GetFramework()->HasCommandLineParameter("--contentAddressedAssetCache"))
+    {
+        if (!assetDataDir.exists("blobs"))
+            assetDataDir.mkdir("blobs");
+        blobDir = QDir(assetDataDir.absoluteFilePath("blobs"));
+        contentIndexFile = cacheDirectory + "contentindex";
+        contentAddressed = true;
+        LoadContentIndex();
+        LogInfo(QString("AssetCache: Content-addressed mode enabled, %1 refs share %2 blobs.").arg(contentEntries.size()).arg(blobRefCounts.size()));
+    }
+
     // Check --clearAssetCache start param
     if (owner->GetFramework()->HasCommandLineParameter("--clearAssetCache") ||
         owner->GetFramework()->HasCommandLineParameter("--clear-asset-cache")) /**< @todo Remove support for the deprecated parameter version at some point. */
@@ -58,13 +74,45 @@ AssetCache::AssetCache(AssetAPI *owner, QString assetCacheDirectory) :
     }
 }
 
+QString AssetCache::ContentHash(const u8 *data, size_t numBytes)
+{
+    return QString(QCryptographicHash::hash(QByteArray::fromRawData((const char*)data, (int)numBytes), QCryptographicHash::Sha1).toHex());
+}
+
+QString AssetCache::ContentHashForRef(const QString &assetRef) const
+{
+    if (!contentAddressed)
+        return "";
+    ContentEntryMap::const_iterator iter = contentEntries.find(AssetAPI::SanitateAssetRef(assetRef));
+    return (iter != contentEntries.end() ? iter->second.hash : "");
+}
+
 QString AssetCache::FindInCache(const QString &assetRef)
 {
+    // A file written directly to the ref's own cache path is always the most recent copy of the data.
     QString absolutePath = GetDiskSourceByRef(assetRef);
     if (QFile::exists(absolutePath))
         return absolutePath;
-    else // The file is not in cache, return an empty string to denote that.
-        return "";
+
+    if (contentAddressed)
+    {
+        ContentEntryMap::const_iterator iter = contentEntries.find(AssetAPI::SanitateAssetRef(assetRef));
+        if (iter != contentEntries.end())
+        {
+            QString blobPath = BlobPath(iter->second.hash);
+            if (QFile::exists(blobPath))
+                return blobPath;
+        }
+    }
+
+    // The file is not in cache, return an empty string to denote that.
+    return "";
+}
+
+QString AssetCache::FindNamedFileInCache(const QString &assetRef)
+{
+    QString absolutePath = GetDiskSourceByRef(assetRef);
+    return (QFile::exists(absolutePath) ? absolutePath : "");
 }
 
 QString AssetCache::GetDiskSourceByRef(const QString &assetRef)
@@ -88,6 +136,30 @@ QString AssetCache::StoreAsset(AssetPtr asset)
 
 QString AssetCache::StoreAsset(const u8 *data, size_t numBytes, const QString &assetName)
 {
+    if (contentAddressed)
+    {
+        PROFILE(AssetCache_StoreAsset_ContentAddressed);
+        const QString hash = ContentHash(data, numBytes);
+        const QString blobPath = BlobPath(hash);
+        if (!QFile::exists(blobPath) && !SaveAssetFromMemoryToFile(data, numBytes, blobPath))
+            return "";
+
+        // If the data was already written to the ref's own cache path (f.ex. by an asset provider), carry over
+        // its last modified time and remove the file, the blob is the only copy of the data from now on.
+        QDateTime lastModified;
+        const QString refPath = GetDiskSourceByRef(assetName);
+        if (QFile::exists(refPath))
+        {
+            lastModified = FileLastModified(refPath, assetName);
+            QFile::remove(refPath);
+        }
+        if (!lastModified.isValid())
+            lastModified = QDateTime::currentDateTimeUtc();
+
+        MapRefToBlob(AssetAPI::SanitateAssetRef(assetName), hash, lastModified);
+        return blobPath;
+    }
+
     QString absolutePath = GetDiskSourceByRef(assetName);
     bool success = SaveAssetFromMemoryToFile(data, numBytes, absolutePath);
     if (success)
@@ -101,6 +173,19 @@ QDateTime AssetCache::LastModified(const QString &assetRef)
     if (absolutePath.isEmpty())
         return QDateTime();
 
+    // Blobs are shared between refs, so their last modified times are tracked per ref in the content index.
+    if (contentAddressed && absolutePath != GetDiskSourceByRef(assetRef))
+    {
+        ContentEntryMap::const_iterator iter = contentEntries.find(AssetAPI::SanitateAssetRef(assetRef));
+        if (iter != contentEntries.end())
+            return iter->second.lastModified;
+    }
+
+    return FileLastModified(absolutePath, assetRef);
+}
+
+QDateTime AssetCache::FileLastModified(const QString &absolutePath, const QString &assetRef)
+{
 #ifdef Q_WS_WIN
     HANDLE fileHandle = (HANDLE)OpenFileHandle(absolutePath);
     if (fileHandle == INVALID_HANDLE_VALUE)
@@ -160,6 +245,21 @@ bool AssetCache::SetLastModified(const QString &assetRef, const QDateTime &dateT
     if (absolutePath.isEmpty())
         return false;
 
+    if (contentAddressed && absolutePath != GetDiskSourceByRef(assetRef))
+    {
+        const QString sanitatedRef = AssetAPI::SanitateAssetRef(assetRef);
+        ContentEntryMap::iterator iter = contentEntries.find(sanitatedRef);
+        if (iter != contentEntries.end())
+        {
+            // Ignore msec, same as for the files on disk.
+            QDateTime utcTime = dateTime.toUTC();
+            utcTime.setTime(QTime(utcTime.time().hour(), utcTime.time().minute(), utcTime.time().second(), 0));
+            iter->second.lastModified = utcTime;
+            WriteContentIndexEntry(sanitatedRef);
+            return true;
+        }
+    }
+
     QDate date = dateTime.date();
     QTime time = dateTime.time();
 
@@ -241,6 +341,8 @@ void AssetCache::DeleteAsset(const QString &assetRef)
     QString absolutePath = GetDiskSourceByRef(assetRef);
     if (QFile::exists(absolutePath))
         QFile::remove(absolutePath);
+    if (contentAddressed)
+        UnmapRef(AssetAPI::SanitateAssetRef(assetRef));
 }
 
 void AssetCache::ClearAssetCache()
@@ -256,4 +358,124 @@ void AssetCache::ClearAssetCache()
                 LogWarning("AssetCache::ClearAssetCache could not remove file " + entry.absoluteFilePath());
         }
     }
+
+    if (contentAddressed)
+    {
+        entries = blobDir.entryInfoList(QDir::Files|QDir::NoSymLinks|QDir::NoDotAndDotDot);
+        foreach(QFileInfo entry, entries)
+            if (!blobDir.remove(entry.fileName()))
+                LogWarning("AssetCache::ClearAssetCache could not remove file " + entry.absoluteFilePath());
+        contentEntries.clear();
+        blobRefCounts.clear();
+        QFile::remove(contentIndexFile);
+    }
+}
+
+QString AssetCache::BlobPath(const QString &hash) const
+{
+    return blobDir.absolutePath() + "/" + hash;
+}
+
+void AssetCache::LoadContentIndex()
+{
+    PROFILE(AssetCache_LoadContentIndex);
+    QFile file(contentIndexFile);
+    if (file.open(QIODevice::ReadOnly))
+    {
+        // The index is an append-only log of "<hash> <lastModifiedMsecs> <sanitatedRef>" lines, where a hash
+        // of "-" removes the mapping. Replay it in order, the last entry for each ref wins.
+        QTextStream in(&file);
+        while(!in.atEnd())
+        {
+            QString line = in.readLine();
+            QString hash = line.section(' ', 0, 0);
+            QString sanitatedRef = line.section(' ', 2);
+            if (hash.isEmpty() || sanitatedRef.isEmpty())
+                continue;
+            if (hash == "-")
+            {
+                contentEntries.erase(sanitatedRef);
+                continue;
+            }
+            ContentEntry &entry = contentEntries[sanitatedRef];
+            entry.hash = hash;
+            entry.lastModified = QDateTime::fromMSecsSinceEpoch(line.section(' ', 1, 1).toLongLong()).toUTC();
+        }
+        file.close();
+    }
+
+    // Drop entries whose blob has disappeared and recount the references.
+    for(ContentEntryMap::iterator iter = contentEntries.begin(); iter != contentEntries.end();)
+    {
+        if (!QFile::exists(BlobPath(iter->second.hash)))
+            contentEntries.erase(iter++);
+        else
+        {
+            ++blobRefCounts[iter->second.hash];
+            ++iter;
+        }
+    }
+
+    // Rewrite the index in compacted form.
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        QTextStream out(&file);
+        for(ContentEntryMap::const_iterator iter = contentEntries.begin(); iter != contentEntries.end(); ++iter)
+            out << iter->second.hash << " " << iter->second.lastModified.toMSecsSinceEpoch() << " " << iter->first << "\n";
+        file.close();
+    }
+    else
+        LogError("AssetCache: Failed to write content index file " + contentIndexFile);
+}
+
+void AssetCache::WriteContentIndexEntry(const QString &sanitatedRef)
+{
+    QFile file(contentIndexFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        LogError("AssetCache: Failed to open content index file " + contentIndexFile + " for writing.");
+        return;
+    }
+    QTextStream out(&file);
+    ContentEntryMap::const_iterator iter = contentEntries.find(sanitatedRef);
+    if (iter != contentEntries.end())
+        out << iter->second.hash << " " << iter->second.lastModified.toMSecsSinceEpoch() << " " << sanitatedRef << "\n";
+    else
+        out << "- 0 " << sanitatedRef << "\n";
+}
+
+void AssetCache::MapRefToBlob(const QString &sanitatedRef, const QString &hash, const QDateTime &lastModified)
+{
+    ContentEntryMap::iterator iter = contentEntries.find(sanitatedRef);
+    if (iter != contentEntries.end() && iter->second.hash != hash)
+    {
+        UnmapRef(sanitatedRef);
+        iter = contentEntries.end();
+    }
+    if (iter == contentEntries.end())
+    {
+        iter = contentEntries.insert(std::make_pair(sanitatedRef, ContentEntry())).first;
+        iter->second.hash = hash;
+        ++blobRefCounts[hash];
+    }
+    iter->second.lastModified = lastModified;
+    WriteContentIndexEntry(sanitatedRef);
+}
+
+void AssetCache::UnmapRef(const QString &sanitatedRef)
+{
+    ContentEntryMap::iterator iter = contentEntries.find(sanitatedRef);
+    if (iter == contentEntries.end())
+        return;
+
+    const QString hash = iter->second.hash;
+    contentEntries.erase(iter);
+    WriteContentIndexEntry(sanitatedRef);
+
+    std::map<QString, int>::iterator countIter = blobRefCounts.find(hash);
+    if (countIter != blobRefCounts.end() && --countIter->second <= 0)
+    {
+        blobRefCounts.erase(countIter);
+        QFile::remove(BlobPath(hash));
+    }
 }
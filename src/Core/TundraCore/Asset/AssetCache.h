@@ -5,13 +5,19 @@
 #include "TundraCoreApi.h"
 #include "CoreTypes.h"
 #include "AssetFwd.h"
+#include "CoreStringUtils.h"
 
 #include <QString>
 #include <QDir>
 #include <QObject>
 #include <QDateTime>
 
+#include <map>
+
 /// Implements a disk cache for asset files to avoid re-downloading assets between runs.
+/** If Tundra is started with --contentAddressedAssetCache, the cache stores the data of each asset
+    by its content hash into a shared blob file. Asset refs that resolve to identical data will then
+    share a single file on disk. The ref->blob mappings are refcounted and persisted in an index file. */
 class TUNDRACORE_API AssetCache : public QObject
 {
     Q_OBJECT
@@ -19,15 +25,34 @@ class TUNDRACORE_API AssetCache : public QObject
 public:
     explicit AssetCache(AssetAPI *owner, QString assetCacheDirectory);
 
+    /// Returns a hex-encoded SHA-1 hash of the given data.
+    /** This is the key that is used to identify identical asset data in the content-addressed mode. */
+    static QString ContentHash(const u8 *data, size_t numBytes);
+
+    /// Returns true if the cache stores asset data by content hash.
+    bool IsContentAddressed() const { return contentAddressed; }
+
+    /// Returns the content hash of the cached data of the given asset ref.
+    /** If the cache is not content-addressed or the ref is not stored in the cache, an empty string is returned. */
+    QString ContentHashForRef(const QString &assetRef) const;
+
 public slots:
     /// Returns the absolute path on the local file system that contains a cached copy of the given asset ref.
     /// If the given asset file does not exist in the cache, an empty string is returned.
     /// @param assetRef The asset reference URL, which must be of type AssetRefExternalUrl.
     QString FindInCache(const QString &assetRef);
 
+    /// Returns the absolute path to the cached copy of the given asset ref, if it is stored in a file of its own named after the ref.
+    /// Threaded Ogre loading finds cache files by their file name, so only these files can be used for it. In the content-addressed
+    /// mode data that is stored in a shared blob is not returned. If such a file does not exist, an empty string is returned.
+    /// @param assetRef The asset reference URL, which must be of type AssetRefExternalUrl.
+    QString FindNamedFileInCache(const QString &assetRef);
+
     /// Returns the absolute path on the local file system for the cached version of the given asset ref.
     /// This function is otherwise identical to FindInCache, except this version does not check whether the asset exists 
     /// in the cache, but simply returns the absolute path where the asset would be stored in the cache.
+    /// @note In the content-addressed mode the data of the asset may reside in a shared blob file instead. Use FindInCache
+    /// to get the path to the actual cached data. The path returned from this function can always be written to directly.
     /// @param assetRef The asset reference URL, which must be of type AssetRefExternalUrl.
     QString GetDiskSourceByRef(const QString &assetRef);
     
@@ -68,6 +93,44 @@ private:
     /// Windows specific helper to open a file handle to absolutePath
     void *OpenFileHandle(const QString &absolutePath);
 #endif
+    /// Returns the last modified time of the given file on the local file system.
+    QDateTime FileLastModified(const QString &absolutePath, const QString &assetRef);
+
+    /// Returns the absolute path to the blob file of the given content hash.
+    QString BlobPath(const QString &hash) const;
+
+    /// Reads the content index file and compacts it.
+    void LoadContentIndex();
+
+    /// Appends a mapping entry of the given sanitated ref to the content index file.
+    void WriteContentIndexEntry(const QString &sanitatedRef);
+
+    /// Maps the given sanitated ref to a blob and releases the previous blob the ref was mapped to.
+    void MapRefToBlob(const QString &sanitatedRef, const QString &hash, const QDateTime &lastModified);
+
+    /// Removes the blob mapping of the given sanitated ref. The blob file is deleted if no other refs point to it.
+    void UnmapRef(const QString &sanitatedRef);
+
+    /// A single ref->blob mapping in the content-addressed mode.
+    struct ContentEntry
+    {
+        QString hash;
+        QDateTime lastModified;
+    };
+    typedef std::map<QString, ContentEntry, QStringLessThanNoCase> ContentEntryMap;
+
+    /// Maps sanitated asset refs to the blobs that hold their data.
+    ContentEntryMap contentEntries;
+
+    /// Number of refs that point to each blob, keyed by content hash.
+    std::map<QString, int> blobRefCounts;
+
+    /// Is the cache in the content-addressed mode.
+    bool contentAddressed;
+
+    /// Absolute path to the append-only content index file.
+    QString contentIndexFile;
+
     /// Cache directory, passed here from AssetAPI in the ctor.
     QString cacheDirectory;
 
@@ -76,4 +139,7 @@ private:
 
     /// Asset data dir.
     QDir assetDataDir;
+
+    /// Content-addressed blob dir.
+    QDir blobDir;
 };
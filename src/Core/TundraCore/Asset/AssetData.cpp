@@ -0,0 +1,99 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "AssetData.h"
+
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include <QFile>
+
+#include "MemoryLeakCheck.h"
+
+AssetData::AssetData() :
+    data(0),
+    size(0)
+{
+}
+
+bool AssetData::LoadFile(const QString &filename)
+{
+    PROFILE(AssetData_LoadFile);
+    Clear();
+
+    shared_ptr<QFile> file = MAKE_SHARED(QFile, filename);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        LogError("AssetData::LoadFile: Failed to open file '" + filename + "' for reading.");
+        return false;
+    }
+    qint64 fileSize = file->size();
+    if (fileSize <= 0)
+    {
+        LogWarning(QString("AssetData::LoadFile: Source file '%1' exists but size is 0. Reading is reported to be successfull but read data is empty!").arg(filename));
+        return true;
+    }
+
+    // Large files are mapped to memory. The pages are read in by the OS on demand and shared with the file system cache, so no copy is made.
+    if (fileSize >= cMinMappedFileSize)
+    {
+        uchar *mapped = file->map(0, fileSize);
+        if (mapped)
+        {
+            mappedFile = file;
+            data = mapped;
+            size = (size_t)fileSize;
+            return true;
+        }
+        LogDebug("AssetData::LoadFile: Failed to memory-map file '" + filename + "', reading it to memory instead.");
+    }
+
+    QByteArray contents = file->readAll();
+    if (contents.size() < fileSize)
+    {
+        LogError(QString("AssetData::LoadFile: Failed to read full %1 bytes from file '%2', instead read %3 bytes.").arg(fileSize).arg(filename).arg(contents.size()));
+        return false;
+    }
+    SetByteArray(contents);
+    return true;
+}
+
+void AssetData::SetByteArray(const QByteArray &byteArray_)
+{
+    Clear();
+    byteArray = byteArray_;
+    if (!byteArray.isEmpty())
+    {
+        data = (const u8*)byteArray.constData();
+        size = (size_t)byteArray.size();
+    }
+}
+
+void AssetData::SetVector(std::vector<u8> &vector_)
+{
+    Clear();
+    if (vector_.empty())
+        return;
+    vector = MAKE_SHARED(std::vector<u8>);
+    vector->swap(vector_);
+    data = &(*vector)[0];
+    size = vector->size();
+}
+
+void AssetData::Clear()
+{
+    data = 0;
+    size = 0;
+    byteArray.clear();
+    vector.reset();
+    mappedFile.reset();
+}
+
+QByteArray AssetData::ToByteArray() const
+{
+    if (!byteArray.isEmpty() || !data)
+        return byteArray;
+    return QByteArray((const char*)data, (int)size);
+}
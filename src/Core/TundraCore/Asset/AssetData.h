@@ -0,0 +1,60 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+
+#include <QByteArray>
+#include <QString>
+#include <vector>
+
+class QFile;
+
+/// Read-only raw asset data that is passed between the stages of the asset pipeline without copying.
+/** The data is backed either by a memory-mapped file, an implicitly shared QByteArray or a byte vector.
+    Copying an AssetData is cheap, as all the copies refer to the same reference-counted backing storage. */
+class TUNDRACORE_API AssetData
+{
+public:
+    AssetData();
+
+    /// Files smaller than this are read to memory instead of memory-mapping them.
+    static const qint64 cMinMappedFileSize = 64 * 1024;
+
+    /// Returns a pointer to the data, or null if the data is empty.
+    const u8 *Data() const { return data; }
+
+    /// Returns the size of the data in bytes.
+    size_t Size() const { return size; }
+
+    /// Returns true if there is no data.
+    bool IsEmpty() const { return size == 0; }
+
+    /// Returns true if the data is a memory-mapped view to a file.
+    bool IsMapped() const { return mappedFile.get() != 0; }
+
+    /// Loads the contents of the given file. Clears all previous data.
+    /** Files of at least cMinMappedFileSize bytes are memory-mapped. Smaller files, and files that cannot be mapped, are read to memory.
+        @return True on success. An empty file is considered a success, in which case the data is left empty. */
+    bool LoadFile(const QString &filename);
+
+    /// Sets the data to refer to the given byte array. The array is implicitly shared and not copied.
+    void SetByteArray(const QByteArray &byteArray);
+
+    /// Takes over the contents of the given vector without copying. The vector is left empty.
+    void SetVector(std::vector<u8> &vector);
+
+    /// Releases the data. If the data was memory-mapped, the file is unmapped once no other copy refers to it.
+    void Clear();
+
+    /// Returns the data as a QByteArray. A copy is made unless the data is backed by a QByteArray.
+    QByteArray ToByteArray() const;
+
+private:
+    const u8 *data;
+    size_t size;
+    QByteArray byteArray;
+    shared_ptr<std::vector<u8> > vector;
+    shared_ptr<QFile> mappedFile;
+};
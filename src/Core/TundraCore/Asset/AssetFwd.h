@@ -8,6 +8,8 @@ class Framework;
 class AssetAPI;
 class AssetCache;
 
+class AssetData;
+
 class IAsset;
 typedef shared_ptr<IAsset> AssetPtr;
 typedef weak_ptr<IAsset> AssetWeakPtr;
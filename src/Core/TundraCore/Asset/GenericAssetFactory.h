@@ -14,7 +14,8 @@ class GenericAssetFactory : public IAssetTypeFactory
 public:
     explicit GenericAssetFactory(const QString &assetType_, const QString &assetTypeExtension) :
         assetType(assetType_.trimmed()),
-        assetTypeExtensions(assetTypeExtension)
+        assetTypeExtensions(assetTypeExtension),
+        contentSharing(false)
     {
         assert(!assetType.isEmpty() && "Must specify an asset type for asset factory!");
         // assetTypeExtension can be empty in the case of BinaryAsset, don't assert it.
@@ -22,7 +23,8 @@ public:
 
     explicit GenericAssetFactory(const QString &assetType_, const QStringList &assetTypeExtensions_) :
         assetType(assetType_.trimmed()),
-        assetTypeExtensions(assetTypeExtensions_)
+        assetTypeExtensions(assetTypeExtensions_),
+        contentSharing(false)
     {
         assert(!assetType.isEmpty() && "Must specify an asset type for asset factory!");
         assert(!assetTypeExtensions.isEmpty() && "Must specify at least one asset type extension for asset factory!");
@@ -34,9 +36,15 @@ public:
 
     virtual AssetPtr CreateEmptyAsset(AssetAPI *owner, const QString &name) { return MAKE_SHARED(AssetType, owner, Type(), name); }
 
+    virtual bool AllowsContentSharing() const { return contentSharing; }
+
+    /// Sets whether assets of this type can be shared between asset refs that have identical data. Default: false.
+    void SetContentSharingAllowed(bool allowed) { contentSharing = allowed; }
+
 private:
     const QString assetType;
     const QStringList assetTypeExtensions;
+    bool contentSharing;
 };
 
 /// For simple asset types the client wants to parse, we define the BinaryAssetFactory type.
@@ -5,6 +5,7 @@
 
 #include "IAsset.h"
 #include "AssetAPI.h"
+#include "AssetData.h"
 
 #include "Profiler.h"
 #include "LoggingFunctions.h"
@@ -146,15 +147,16 @@ bool IAsset::LoadFromFile(QString filename)
         return false;
     }
 
-    std::vector<u8> fileData;
-    bool success = LoadFileToVector(filename, fileData);
+    // Large files are memory-mapped, so the data is not copied to a separate buffer before deserialization.
+    AssetData fileData;
+    bool success = fileData.LoadFile(filename);
     if (!success)
     {
         LogDebug("LoadFromFile failed for file \"" + filename + "\", could not read file!");
         return false;
     }
 
-    if (fileData.size() == 0)
+    if (fileData.IsEmpty())
     {
         LogDebug("LoadFromFile failed for file \"" + filename + "\", file size was 0!");
         return false;
@@ -163,7 +165,7 @@ bool IAsset::LoadFromFile(QString filename)
     // Invoke the actual virtual function to load the asset.
     // Do not allow asynchronous loading due the caller of this 
     // expects the asset to be usable when this function returns.
-    return LoadFromFileInMemory(&fileData[0], fileData.size(), false);
+    return LoadFromFileInMemory(fileData.Data(), fileData.Size(), false);
 }
 
 bool IAsset::LoadFromFileInMemory(const u8 *data, size_t numBytes, bool allowAsynchronous)
@@ -68,10 +68,7 @@ bool IAssetTransfer::CachingAllowed() const
 
 QByteArray IAssetTransfer::RawData() const
 {
-    if (rawAssetData.size() == 0) 
-        return QByteArray(); 
-    else 
-        return QByteArray((const char*)&rawAssetData[0], (int)rawAssetData.size());
+    return rawAssetData.ToByteArray();
 }
 
 QString IAssetTransfer::SourceUrl() const
@@ -7,6 +7,7 @@
 #include "AssetFwd.h"
 #include "AssetReference.h"
 #include "IAsset.h"
+#include "AssetData.h"
 
 #include <QObject>
 #include <vector>
@@ -52,7 +53,8 @@ public:
     void EmitAssetFailed(QString reason);
 
     /// Stores the raw asset bytes for this asset.
-    std::vector<u8> rawAssetData;
+    /** Providers should hand over their buffers to this without copying, f.ex. with AssetData::SetByteArray or AssetData::LoadFile. */
+    AssetData rawAssetData;
 
 public slots:
     /// Aborts the transfer immediately. Override this function in a subclass implementation.
@@ -23,5 +23,10 @@ public:
     /// Creates a new asset of the given type that is initialized to the "empty" asset of this type.
     /// @param name The name to give for this asset.
     virtual AssetPtr CreateEmptyAsset(AssetAPI *owner, const QString &name) = 0;
+
+    /// Returns true if a single loaded asset of this type can be shared between asset refs that have identical data.
+    /** The default implementation returns false. Only asset types whose loaded content depends solely on the raw asset data
+        should allow this, see AssetAPI and the --shareIdenticalAssets command line parameter. */
+    virtual bool AllowsContentSharing() const { return false; }
 };
 
@@ -0,0 +1,98 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   ParallelFor.cpp
+    @brief  Runs independent work items in parallel on the global thread pool. */
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+#include "ParallelFor.h"
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QAtomicInt>
+
+#include <algorithm>
+
+#include "MemoryLeakCheck.h"
+
+namespace
+{
+
+/// Hands out the chunks of a ParallelFor call to the threads working on it.
+class ParallelForRun
+{
+public:
+    ParallelForRun(IParallelTask &task_, size_t numItems_, size_t itemsPerChunk_) :
+        task(task_), numItems(numItems_), itemsPerChunk(itemsPerChunk_), nextChunk(0)
+    {
+    }
+
+    /// Runs chunks until none are left.
+    void RunChunks()
+    {
+        for(;;)
+        {
+            const size_t begin = (size_t)nextChunk.fetchAndAddOrdered(1) * itemsPerChunk;
+            if (begin >= numItems)
+                return;
+            const size_t end = std::min(begin + itemsPerChunk, numItems);
+            for(size_t i = begin; i < end; ++i)
+                task.RunItem(i);
+        }
+    }
+
+    IParallelTask &task;
+    size_t numItems;
+    size_t itemsPerChunk;
+    QAtomicInt nextChunk;
+    QSemaphore finishedWorkers;
+};
+
+class ParallelForWorker : public QRunnable
+{
+public:
+    explicit ParallelForWorker(ParallelForRun *run_) : run(run_) {}
+
+    void run()
+    {
+        run->RunChunks();
+        run->finishedWorkers.release();
+    }
+
+private:
+    ParallelForRun *run;
+};
+
+}
+
+void ParallelFor(IParallelTask &task, size_t numItems, size_t itemsPerChunk)
+{
+    if (numItems == 0)
+        return;
+    itemsPerChunk = std::max(itemsPerChunk, (size_t)1);
+
+    ParallelForRun run(task, numItems, itemsPerChunk);
+    const size_t numChunks = (numItems + itemsPerChunk - 1) / itemsPerChunk;
+    const size_t maxWorkers = std::min(numChunks - 1, (size_t)std::max(QThread::idealThreadCount() - 1, 0));
+
+    // Only idle threads are used: queueing the workers behind the long-running jobs of the pool would make this call wait for them.
+    int numWorkers = 0;
+    for(size_t i = 0; i < maxWorkers; ++i)
+    {
+        ParallelForWorker *worker = new ParallelForWorker(&run);
+        if (!QThreadPool::globalInstance()->tryStart(worker))
+        {
+            delete worker;
+            break;
+        }
+        ++numWorkers;
+    }
+
+    run.RunChunks();
+    // The workers that start after the calling thread has taken the last chunk return immediately.
+    if (numWorkers > 0)
+        run.finishedWorkers.acquire(numWorkers);
+}
@@ -0,0 +1,27 @@
+/**
+    For conditions of distribution and use, see copyright notice in LICENSE
+
+    @file   ParallelFor.h
+    @brief  Runs independent work items in parallel on the global thread pool. */
+
+#pragma once
+
+#include "TundraCoreApi.h"
+
+#include <cstddef>
+
+/// A set of independent work items, see ParallelFor.
+class TUNDRACORE_API IParallelTask
+{
+public:
+    virtual ~IParallelTask() {}
+
+    /// Runs a single item. Called from several threads at the same time, so it may only touch data that belongs to the item.
+    virtual void RunItem(size_t index) = 0;
+};
+
+/// Runs the items [0, numItems) of the task in parallel, and returns once all are done.
+/** The items are taken in chunks of itemsPerChunk by the calling thread and the threads of QThreadPool::globalInstance() that are idle,
+    so that all parallel work shares the same threads instead of each user creating its own. The number of threads used, including
+    the calling thread, does not exceed QThread::idealThreadCount. If no threads are idle, all items are run on the calling thread. */
+void TUNDRACORE_API ParallelFor(IParallelTask &task, size_t numItems, size_t itemsPerChunk = 1);
@@ -0,0 +1,41 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "CoreTypes.h"
+
+/** @file BinarySceneFormat.h
+    Constants of the versioned binary scene format, shared by the reader in Scene and the writer in SceneSnapshot. */
+
+/// Identifies the versioned binary scene format. Reads as "TBIN" at the start of a file.
+/** The earlier unversioned format starts with the number of root-level entities instead, which is never this large. */
+const u32 cBinarySceneMagic = 0x4E494254;
+/// Version of the binary scene format that is written.
+const u32 cBinarySceneVersion = 2;
+/// Size of the fixed part of the header: magic, version, string table offset and the number of entity chunks.
+const int cBinarySceneHeaderSize = 4 * sizeof(u32);
+/// Largest size of a binary scene in bytes. The offsets are stored as u32, and the loader takes the size as an int.
+const u64 cBinarySceneMaxSize = 0x7FFFFFFF;
+
+/// Flag bits of the entities and components in the binary scene format.
+const u8 cBinaryReplicated = 1;
+const u8 cBinaryTemporary = 2;
+
+/* Layout of the versioned binary scene format:
+
+   u32 magic, u32 version
+   u32 string table offset, u32 number of entity chunks
+   u32 offset of each entity chunk
+   entity chunks, one per root-level entity
+   string table: VLE number of strings, then per string VLE byte length and the UTF-8 bytes
+
+   All offsets are in bytes from the start of the data, so that single entity chunks can be read without parsing the rest.
+   Entity chunk:
+   u32 id, u8 flags, VLE number of components, components, VLE number of child entities, child entity chunks
+   Component:
+   VLE type name string, VLE type id, VLE name string, u8 flags, u32 data size, VLE number of attributes, attributes
+   Attribute:
+   u8 index, VLE id string, VLE type id, u32 value size, value
+
+   Asset reference values are stored as indices to the string table, other values as written by IAttribute::ToBinary.
+   The sizes allow skipping components and attributes that are unknown when loading. */
@@ -177,12 +177,9 @@ IAttribute *EC_DynamicComponent::CreateAttribute(const QString &typeName, const
 
 void EC_DynamicComponent::RemoveAttribute(const QString &id, AttributeChange::Type change)
 {
-    for(AttributeVector::const_iterator iter = attributes.begin(); iter != attributes.end(); ++iter)
-        if(*iter && (*iter)->Id().compare(id, Qt::CaseInsensitive) == 0)
-        {
-            IComponent::RemoveAttribute((*iter)->Index(), change);
-            break;
-        }
+    IAttribute *attr = AttributeById(id);
+    if (attr)
+        IComponent::RemoveAttribute(attr->Index(), change);
 }
 
 void EC_DynamicComponent::RemoveAllAttributes(AttributeChange::Type change)
@@ -27,14 +27,43 @@
 #include <QScriptEngine>
 #include <QPoint>
 
+#include <map>
+#include <list>
+#include <cstring>
+
 #include <kNet/DataDeserializer.h>
 #include <kNet/DataSerializer.h>
 
 #include "MemoryLeakCheck.h"
 
+namespace
+{
+
+struct CStringLess
+{
+    bool operator()(const char *a, const char *b) const { return strcmp(a, b) < 0; }
+};
+
+/// Returns a string for the id or name of a static attribute, shared by the attributes of all components of the same type.
+/** Static attributes are constructed with string literals, once per component, so sharing the strings saves two allocations
+    per attribute. The strings are keyed by their content rather than by the literal address, as the literals of different
+    modules may have different addresses. Components are only created in the main thread. */
+QString SharedAttributeString(const char *str)
+{
+    static std::list<QByteArray> keys;
+    static std::map<const char *, QString, CStringLess> strings;
+    std::map<const char *, QString, CStringLess>::const_iterator iter = strings.find(str);
+    if (iter != strings.end())
+        return iter->second;
+    keys.push_back(QByteArray(str));
+    return strings.insert(std::make_pair(keys.back().constData(), QString(str))).first->second;
+}
+
+}
+
 IAttribute::IAttribute(IComponent* owner_, const char* id_) :
-    id(id_),
-    name(id_),
+    id(owner_ ? SharedAttributeString(id_) : QString(id_)),
+    name(id),
     metadata(0),
     dynamic(false),
     owner(0),
@@ -46,8 +75,8 @@ IAttribute::IAttribute(IComponent* owner_, const char* id_) :
 }
 
 IAttribute::IAttribute(IComponent* owner_, const char* id_, const char* name_) :
-    id(id_),
-    name(name_),
+    id(owner_ ? SharedAttributeString(id_) : QString(id_)),
+    name(owner_ ? SharedAttributeString(name_) : QString(name_)),
     metadata(0),
     dynamic(false),
     owner(0),
@@ -68,6 +97,13 @@ void IAttribute::Changed(AttributeChange::Type change)
 void IAttribute::SetName(const QString& newName)
 {
     name = newName;
+    if (owner)
+    {
+        // The lookup tables of static attributes are shared by all components of the same type, so the owner needs its own.
+        if (!dynamic)
+            owner->staticAttributeRenamed_ = true;
+        owner->InvalidateAttributeLookup(!dynamic);
+    }
 }
 
 void IAttribute::SetMetadata(AttributeMetadata *meta)
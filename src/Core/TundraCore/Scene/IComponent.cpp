@@ -29,7 +29,8 @@ IComponent::IComponent(Scene* scene) :
     replicated(true),
     temporary(false),
     internalQObjectPropertyUpdateOngoing_(false),
-    id(0)
+    id(0),
+    staticAttributeRenamed_(false)
 {
 }
 
@@ -160,20 +161,112 @@ IAttribute* IComponent::GetAttribute(const QString &name) const
     return AttributeByName(name);
 }
 
+struct IComponent::AttributeLookup
+{
+    AttributeLookup() : numAttributes(0) {}
+
+    /// Fills the tables from the attributes in the range [begin, end). Of attributes with the same key, the first one is found.
+    void Build(const AttributeVector &attributes, size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+        {
+            if (!attributes[i])
+                continue;
+            Insert(ids, attributes[i]->Id(), (int)i);
+            Insert(names, attributes[i]->Name(), (int)i);
+            Insert(foldedIds, attributes[i]->Id().toCaseFolded(), (int)i);
+            Insert(foldedNames, attributes[i]->Name().toCaseFolded(), (int)i);
+        }
+        numAttributes = end;
+    }
+
+    static void Insert(QHash<QString, int> &table, const QString &key, int index)
+    {
+        if (!table.contains(key))
+            table.insert(key, index);
+    }
+
+    QHash<QString, int> ids; ///< Attribute indices by id, as is.
+    QHash<QString, int> names; ///< Attribute indices by name, as is.
+    QHash<QString, int> foldedIds; ///< Attribute indices by case-folded id.
+    QHash<QString, int> foldedNames; ///< Attribute indices by case-folded name.
+    size_t numAttributes; ///< End of the range of attribute indices the tables were built from.
+};
+
+int IComponent::AttributeIndex(const QString &key, bool byName) const
+{
+    if (!staticLookup_)
+    {
+        // The static attributes come first, and are the same for all components of the same type.
+        const size_t numStatic = (size_t)NumStaticAttributes();
+        shared_ptr<const AttributeLookup> &shared = SharedAttributeLookup(TypeId());
+        if (!staticAttributeRenamed_ && shared && shared->numAttributes == numStatic)
+            staticLookup_ = shared;
+        else
+        {
+            shared_ptr<AttributeLookup> lookup(new AttributeLookup);
+            lookup->Build(attributes, 0, numStatic);
+            staticLookup_ = lookup;
+            if (!staticAttributeRenamed_)
+                shared = lookup;
+        }
+    }
+    if (!dynamicLookup_ && attributes.size() > staticLookup_->numAttributes)
+    {
+        shared_ptr<AttributeLookup> lookup(new AttributeLookup);
+        lookup->Build(attributes, staticLookup_->numAttributes, attributes.size());
+        dynamicLookup_ = lookup;
+    }
+
+    // Most lookups use the same case as the attribute, so try that before case-folding the key.
+    const AttributeLookup *lookups[] = { staticLookup_.get(), dynamicLookup_.get() };
+    for(int i = 0; i < 2; ++i)
+    {
+        if (!lookups[i])
+            continue;
+        const QHash<QString, int> &table = byName ? lookups[i]->names : lookups[i]->ids;
+        QHash<QString, int>::const_iterator iter = table.find(key);
+        if (iter != table.end())
+            return iter.value();
+    }
+    const QString folded = key.toCaseFolded();
+    for(int i = 0; i < 2; ++i)
+    {
+        if (!lookups[i])
+            continue;
+        const QHash<QString, int> &table = byName ? lookups[i]->foldedNames : lookups[i]->foldedIds;
+        QHash<QString, int>::const_iterator iter = table.find(folded);
+        if (iter != table.end())
+            return iter.value();
+    }
+    return -1;
+}
+
+shared_ptr<const IComponent::AttributeLookup> &IComponent::SharedAttributeLookup(u32 typeId)
+{
+    /// @note Not thread-safe, like the rest of the component. Accessed from the main thread only.
+    static QHash<u32, shared_ptr<const AttributeLookup> > sharedLookups;
+    return sharedLookups[typeId];
+}
+
+void IComponent::InvalidateAttributeLookup(bool staticAttributes)
+{
+    if (staticAttributes)
+        staticLookup_.reset();
+    // The dynamic tables start where the static ones end, so they are dropped in both cases.
+    dynamicLookup_.reset();
+}
+
 IAttribute* IComponent::AttributeById(const QString &id) const
 {
-    for(unsigned int i = 0; i < attributes.size(); ++i)
-        if(attributes[i] && attributes[i]->Id().compare(id, Qt::CaseInsensitive) == 0)
-            return attributes[i];
-    return 0;
+    const int index = AttributeIndex(id, false);
+    return index >= 0 && index < (int)attributes.size() ? attributes[index] : 0;
 }
 
 IAttribute* IComponent::AttributeByName(const QString &name) const
 {
-    for(unsigned int i = 0; i < attributes.size(); ++i)
-        if(attributes[i] && attributes[i]->Name().compare(name, Qt::CaseInsensitive) == 0)
-            return attributes[i];
-    return 0;
+    const int index = AttributeIndex(name, true);
+    return index >= 0 && index < (int)attributes.size() ? attributes[index] : 0;
 }
 
 int IComponent::NumAttributes() const
@@ -265,6 +358,7 @@ void IComponent::RemoveAttribute(u8 index, AttributeChange::Type change)
         // Trigger internal signal(s)
         emit AttributeAboutToBeRemoved(attr);
         SAFE_DELETE(attributes[index]);
+        InvalidateAttributeLookup(false);
     }
     else
         LogError("Can not remove nonexisting attribute at index " + QString::number(index));
@@ -274,9 +368,18 @@ void IComponent::AddAttribute(IAttribute* attr)
 {
     if (!attr)
         return;
+    InvalidateAttributeLookup(!attr->IsDynamic());
     // If attribute is static (member variable attributes), we can just push_back it.
     if (!attr->IsDynamic())
     {
+        // Called from the initializer list of the derived component, whose type id is already available. Reserve room
+        // for all the static attributes at once, if known from an earlier component of the same type.
+        if (attributes.empty())
+        {
+            const shared_ptr<const AttributeLookup> &shared = SharedAttributeLookup(TypeId());
+            if (shared)
+                attributes.reserve(shared->numAttributes);
+        }
         attr->index = (u8)attributes.size();
         attr->owner = this;
         attributes.push_back(attr);
@@ -307,6 +410,7 @@ bool IComponent::AddAttribute(IAttribute* attr, u8 index)
 {
     if (!attr)
         return false;
+    InvalidateAttributeLookup(!attr->IsDynamic());
     if (index < attributes.size())
     {
         IAttribute* existing = attributes[index];
@@ -501,7 +605,11 @@ void IComponent::EmitAttributeChanged(IAttribute* attribute, AttributeChange::Ty
     assert(change != AttributeChange::Default);
 
     if (change == AttributeChange::Disconnected)
-        return; // No signals
+    {
+        // No signals
+        AttributeChangedDisconnected(attribute);
+        return;
+    }
     
     // Trigger scenemanager signal
     Scene* scene = ParentScene();
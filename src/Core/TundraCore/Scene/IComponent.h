@@ -188,10 +188,7 @@ public:
     template<typename T>
     Attribute<T> *AttributeByName(const QString &name) const
     {
-        for(size_t i = 0; i < attributes.size(); ++i)
-            if (attributes[i] && attributes[i]->Name().compare(name, Qt::CaseInsensitive) == 0)
-                return dynamic_cast<Attribute<T> *>(&attributes[i]);
-        return 0;
+        return dynamic_cast<Attribute<T> *>(AttributeByName(name));
     }
     
     /// Finds and returns an attribute of type 'Attribute<T>' and given ID
@@ -202,23 +199,21 @@ public:
     template<typename T>
     Attribute<T> *AttributeById(const QString &id) const
     {
-        for(size_t i = 0; i < attributes.size(); ++i)
-            if (attributes[i] && attributes[i]->Id().compare(id, Qt::CaseInsensitive) == 0)
-                return dynamic_cast<Attribute<T> *>(&attributes[i]);
-        return 0;
+        return dynamic_cast<Attribute<T> *>(AttributeById(id));
     }
     
     /// Returns a pointer to the Framework instance.
     Framework *GetFramework() const { return framework; }
 
     /// Returns an Attribute of this component with the given ID.
-    /** This function iterates through the attribute vector and tries to find a member attribute with the given ID
+    /** The ID is compared case-insensitively. The lookup is hashed: the static attributes are looked up from tables shared
+        by all components of the same type, and the dynamic attributes from tables of this component.
         @param The ID of the attribute to look for.
         @return A pointer to the attribute, or null if no attribute with the given ID exists */
     IAttribute* AttributeById(const QString &name) const;
     
     /// Returns an Attribute of this component with the given name.
-    /** This function iterates through the attribute vector and tries to find a member attribute with the given name.
+    /** The name is compared case-insensitively, and looked up the same way as in AttributeById.
         @param The name of the attribute to look for.
         @return A pointer to the attribute, or null if no attribute with the given name exists. 
         @note attribute names are human-readable (shown in editor) and may be subject to change, while id's
@@ -452,6 +447,10 @@ private:
     /// and after reacting to the change, call IAttribute::ClearChangedFlag().
     virtual void AttributesChanged() {}
 
+    /// Called instead of AttributesChanged when an attribute is set with AttributeChange::Disconnected, which emits no signals.
+    /** A derived class can override this to invalidate state it derives from the attribute, like cached values. */
+    virtual void AttributeChangedDisconnected(IAttribute * /*attribute*/) {}
+
     /// Set component id. Called by Entity
     void SetNewId(component_id_t newId);
 
@@ -461,4 +460,23 @@ private:
 
     /// Update a QObject dynamic property.
     QHash<QString, QByteArray> dynamicPropertyNames_;
+
+    /// Hash tables for looking up attributes by id and name.
+    struct AttributeLookup;
+
+    /// Returns the index of the attribute with the given id, or name if byName is true, or -1 if there is none.
+    int AttributeIndex(const QString &key, bool byName) const;
+
+    /// Returns the lookup tables of the static attributes shared by the components of the given type. Null until built on the first lookup.
+    static shared_ptr<const AttributeLookup> &SharedAttributeLookup(u32 typeId);
+
+    /// Drops the lookup tables after the attributes have changed. They are rebuilt on the next lookup.
+    void InvalidateAttributeLookup(bool staticAttributes);
+
+    /// Lookup tables of the static attributes. Shared by all components of the same type, unless a static attribute has been renamed.
+    mutable shared_ptr<const AttributeLookup> staticLookup_;
+    /// Lookup tables of the attributes not in staticLookup_, i.e. the dynamic attributes of this component.
+    mutable shared_ptr<const AttributeLookup> dynamicLookup_;
+    /// Set when a static attribute of this component has been renamed, so that its static lookup tables can not be shared.
+    bool staticAttributeRenamed_;
 };
@@ -7,40 +7,57 @@
 #include "Scene/Scene.h"
 #include "Entity.h"
 #include "SceneDesc.h"
+#include "SceneSnapshot.h"
+#include "BinarySceneFormat.h"
 #include "IComponent.h"
 #include "IAttribute.h"
 #include "EC_Name.h"
 #include "AttributeMetadata.h"
 #include "ChangeRequest.h"
 #include "EntityReference.h"
+#include "AssetReference.h"
 #include "Framework.h"
 #include "Application.h"
 #include "AssetAPI.h"
 #include "FrameAPI.h"
 #include "Profiler.h"
+#include "HighPerfClock.h"
+#include "Transform.h"
 #include "LoggingFunctions.h"
+#include "ParallelFor.h"
 
 #include <QString>
 #include <QRegExp>
 #include <QDomDocument>
+#include <QXmlStreamReader>
 #include <QFile>
+#include <QBuffer>
 #include <QDir>
 #include <QTextStream>
 #include <QHash>
+#include <QThreadPool>
+#include <QRunnable>
 
 #include <kNet/DataDeserializer.h>
 #include <kNet/DataSerializer.h>
 
 #include <utility>
+#include <algorithm>
 #include "MemoryLeakCheck.h"
 
 using namespace kNet;
 
+/// Type id and name of EC_Placeable, whose parent references and transforms the scene loading handles.
+/** The component lives in OgreRenderingModule, so it can not be referred to directly here. */
+const u32 cPlaceableTypeId = 20;
+const char * const cPlaceableTypeName = "EC_Placeable";
+
 Scene::Scene(const QString &name, Framework *framework, bool viewEnabled, bool authority) :
     name_(name),
     framework_(framework),
     interpolating_(false),
-    authority_(authority)
+    authority_(authority),
+    backgroundSaves_(0)
 {
     // In headless mode only view disabled-scenes can be created
     viewEnabled_ = framework->IsHeadless() ? false : viewEnabled;
@@ -51,6 +68,8 @@ Scene::Scene(const QString &name, Framework *framework, bool viewEnabled, bool a
 
 Scene::~Scene()
 {
+    // Let the background saves finish, so that they can signal their completion.
+    delete backgroundSaves_;
     EndAllAttributeInterpolations();
     
     // Do not send entity removal or scene cleared events on destruction
@@ -199,6 +218,9 @@ bool Scene::RemoveEntity(entity_id_t id, AttributeChange::Type change)
 
 void Scene::RemoveAllEntities(bool signal, AttributeChange::Type change)
 {
+    // The rest of an incremental load would be created to the cleared scene, with IDs allocated before the clear.
+    CancelIncrementalLoad();
+
     // If we don't want to emit signals, make sure the change mode is disconnected.
     if (!signal && change != AttributeChange::Disconnected)
         change = AttributeChange::Disconnected;
@@ -440,6 +462,34 @@ QByteArray Scene::GetSceneXML(bool serializeTemporary, bool serializeLocal) cons
     return SerializeToXmlString(serializeTemporary, serializeLocal);
 }
 
+namespace
+{
+
+/// Reads the element the XML stream is at, with its attributes and contents, into a DOM element of the given document.
+/** Leaves the stream at the end of the element. */
+QDomElement ReadXmlStreamElement(QXmlStreamReader &reader, QDomDocument &doc)
+{
+    QDomElement element = doc.createElement(reader.qualifiedName().toString());
+    foreach(const QXmlStreamAttribute &attribute, reader.attributes())
+        element.setAttribute(attribute.qualifiedName().toString(), attribute.value().toString());
+
+    while(!reader.atEnd())
+    {
+        reader.readNext();
+        if (reader.isStartElement())
+            element.appendChild(ReadXmlStreamElement(reader, doc));
+        else if (reader.isEndElement())
+            break;
+        else if (reader.isCDATA())
+            element.appendChild(doc.createCDATASection(reader.text().toString()));
+        else if (reader.isCharacters() && !reader.isWhitespace())
+            element.appendChild(doc.createTextNode(reader.text().toString()));
+    }
+    return element;
+}
+
+}
+
 QList<Entity *> Scene::LoadSceneXML(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change)
 {
     QList<Entity *> ret;
@@ -451,14 +501,13 @@ QList<Entity *> Scene::LoadSceneXML(const QString& filename, bool clearScene, bo
         return ret;
     }
 
-    QTextStream stream(&file);
-    stream.setCodec("UTF-8");
-    QDomDocument scene_doc("Scene");
-    QString errorMsg;
-    int errorLine, errorColumn;
-    if (!scene_doc.setContent(stream.readAll(), &errorMsg, &errorLine, &errorColumn))
+    // Parse the file as a stream instead of building a DOM of it, so that large scenes do not need to fit in memory several times over.
+    // The old scene is kept if the file is not a scene at all.
+    QXmlStreamReader reader(&file);
+    if (!reader.readNextStartElement() || reader.name() != "scene")
     {
-        LogError(QString("Parsing scene XML from %1 failed when loading Scene XML: %2 at line %3 column %4.").arg(filename).arg(errorMsg).arg(errorLine).arg(errorColumn));
+        LogError(QString("Parsing scene XML from %1 failed when loading Scene XML: %2 at line %3 column %4.").arg(filename)
+            .arg(reader.hasError() ? reader.errorString() : "Could not find 'scene' element").arg(reader.lineNumber()).arg(reader.columnNumber()));
         file.close();
         return ret;
     }
@@ -467,27 +516,12 @@ QList<Entity *> Scene::LoadSceneXML(const QString& filename, bool clearScene, bo
     if (clearScene)
         RemoveAllEntities(true, change);
 
-    return CreateContentFromXml(scene_doc, useEntityIDsFromFile, change);
+    return CreateContentFromXml(reader, useEntityIDsFromFile, change);
 }
 
 QByteArray Scene::SerializeToXmlString(bool serializeTemporary, bool serializeLocal) const
 {
-    QDomDocument sceneDoc("Scene");
-    QDomElement sceneElem = sceneDoc.createElement("scene");
-
-    EntityList rootLevel = RootLevelEntities();
-
-    for(EntityList::const_iterator iter = rootLevel.begin(); iter != rootLevel.end(); ++iter)
-    {
-        EntityPtr ent = *iter;
-        if ((ent->IsLocal() && !serializeLocal) || (ent->IsTemporary() && !serializeTemporary))
-            continue;
-        ent->SerializeToXML(sceneDoc, sceneElem, serializeTemporary);
-    }
-
-    sceneDoc.appendChild(sceneElem);
-
-    return sceneDoc.toByteArray();
+    return CreateSnapshot(serializeTemporary, serializeLocal)->SerializeToXmlString();
 }
 
 bool Scene::SaveSceneXML(const QString& filename, bool saveTemporary, bool saveLocal)
@@ -507,6 +541,540 @@ bool Scene::SaveSceneXML(const QString& filename, bool saveTemporary, bool saveL
     }
 }
 
+/// An attribute value read from scene content, before the entity it belongs to has been created.
+struct ParsedAttribute
+{
+    ParsedAttribute() : index(0) {}
+
+    QString id; ///< Id of the attribute. If empty, the attribute is looked up by name.
+    QString name; ///< Human-readable name of the attribute.
+    QString value; ///< The value in its string form, if read from text. Null if read from binary.
+    u8 index; ///< Index of the attribute, for creating dynamic attributes read from binary.
+    shared_ptr<IAttribute> parsed; ///< The parsed value, in an attribute that does not belong to any component. Null if the type is not known.
+};
+
+/// A component read from scene content, before the entity it belongs to has been created.
+struct ParsedComponent
+{
+    ParsedComponent() : typeId(0xffffffff), replicated(true), temporary(false), damaged(false), desc(0) {}
+
+    QString typeName;
+    u32 typeId;
+    QString name;
+    bool replicated;
+    bool temporary;
+    bool damaged; ///< Reading the attribute data failed part-way. The attributes hold what could be read.
+    std::vector<ParsedAttribute> attributes;
+    QDomElement element; ///< The component element, if read from XML.
+    const ComponentDesc *desc; ///< The component description, if read from a scene description.
+};
+
+/// An entity read from scene content, with its components and child entities, before it has been created to the scene.
+/** Reading the entities does not touch the scene, so it is done on worker threads. The entities are then created
+    on the main thread in their original order, see Scene::CreateEntityFromParsed. */
+struct ParsedEntity
+{
+    ParsedEntity() : id(0), replicated(true), temporary(false) {}
+
+    entity_id_t id;
+    bool replicated;
+    bool temporary;
+    std::vector<ParsedComponent> components;
+    std::vector<ParsedEntity> children;
+
+    /// Swaps the contents with another entity, without copying the components and child entities.
+    void Swap(ParsedEntity &other)
+    {
+        std::swap(id, other.id);
+        std::swap(replicated, other.replicated);
+        std::swap(temporary, other.temporary);
+        components.swap(other.components);
+        children.swap(other.children);
+    }
+};
+
+/// A root-level entity to be read on a worker thread. Only the members of the source it is read from are set.
+struct EntityParseItem
+{
+    EntityParseItem() : data(0), size(0), strings(0), desc(0), failed(false) {}
+
+    const char *data; ///< Entity chunk of the versioned binary scene format.
+    u32 size; ///< Size of the entity chunk.
+    const QStringList *strings; ///< String table of the binary scene.
+    QDomDocument doc; ///< Document the entity element was read to from an XML stream.
+    QDomElement element; ///< Entity element.
+    const EntityDesc *desc; ///< Entity description.
+    std::vector<ParsedEntity> entities; ///< The entity that was read. Empty if nothing of it could be read.
+    bool failed; ///< The entity chunk turned out to be damaged. The entities hold what could be read of it.
+};
+
+/// Scene content that is created over several frames, see Scene::LoadSceneIncrementally.
+struct IncrementalSceneLoad
+{
+    IncrementalSceneLoad() : next(0), useEntityIDsFromFile(true), change(AttributeChange::Default),
+        maxEntitiesPerFrame(0), maxMillisecondsPerFrame(0.f), collecting(true), numCreated(0), numTotal(0) {}
+
+    std::vector<ParsedEntity> roots; ///< The root-level entities read from the file.
+    std::vector<float3> positions; ///< Positions of the root-level entities, for ordering them by distance.
+    std::vector<bool> hasPosition; ///< Whether the root-level entities have a position.
+    std::vector<size_t> order; ///< Indices of the root-level entities in the order they are created.
+    size_t next; ///< Index of the next entity to create in the order.
+    QList<QDomDocument> documents; ///< Documents that own the component elements of entities read from XML.
+    QHash<entity_id_t, entity_id_t> oldToNewIds;
+    bool useEntityIDsFromFile;
+    AttributeChange::Type change;
+    int maxEntitiesPerFrame;
+    float maxMillisecondsPerFrame;
+    bool collecting; ///< The file is still being read, so the parsed entities are collected instead of created.
+    int numCreated; ///< Number of entities created so far, including child entities.
+    int numTotal; ///< Number of entities in the load, including child entities.
+};
+
+namespace
+{
+
+/// The parsed header of data in the versioned binary scene format.
+struct BinarySceneHeader
+{
+    QStringList strings;
+    std::vector<u32> chunkOffsets;
+    u32 stringTableOffset;
+
+    /// Returns the size of the entity chunk at the given index.
+    u32 ChunkSize(size_t index) const
+    {
+        const u32 end = index + 1 < chunkOffsets.size() ? chunkOffsets[index + 1] : stringTableOffset;
+        return end - chunkOffsets[index];
+    }
+};
+
+/// Returns whether the data is in the versioned binary scene format, rather than in the earlier unversioned format.
+bool IsVersionedBinaryScene(const char *data, size_t numBytes)
+{
+    u32 magic = 0;
+    if (numBytes >= sizeof(u32))
+        memcpy(&magic, data, sizeof(u32));
+    return magic == cBinarySceneMagic;
+}
+
+/// Reads the header and the string table of data in the versioned binary scene format.
+/** @return False if the data is of an unsupported version or its header is invalid. */
+bool ReadBinarySceneHeader(const char *data, size_t numBytes, BinarySceneHeader &header)
+{
+    if (numBytes < (size_t)cBinarySceneHeaderSize)
+        return false;
+    DataDeserializer source(data, numBytes);
+    if (source.Read<u32>() != cBinarySceneMagic)
+        return false;
+    const u32 version = source.Read<u32>();
+    if (version != cBinarySceneVersion)
+    {
+        LogError("Unsupported binary scene format version " + QString::number(version) + ".");
+        return false;
+    }
+    header.stringTableOffset = source.Read<u32>();
+    const u32 numChunks = source.Read<u32>();
+    if (header.stringTableOffset > numBytes || numChunks > source.BytesLeft() / sizeof(u32))
+        return false;
+    header.chunkOffsets.resize(numChunks);
+    u32 previousOffset = cBinarySceneHeaderSize + numChunks * sizeof(u32);
+    for(u32 i = 0; i < numChunks; ++i)
+    {
+        header.chunkOffsets[i] = source.Read<u32>();
+        if (header.chunkOffsets[i] < previousOffset || header.chunkOffsets[i] > header.stringTableOffset)
+            return false;
+        previousOffset = header.chunkOffsets[i];
+    }
+
+    try
+    {
+        DataDeserializer table(data + header.stringTableOffset, numBytes - header.stringTableOffset);
+        const u32 numStrings = table.ReadVLE<VLE8_16_32>();
+        for(u32 i = 0; i < numStrings; ++i)
+        {
+            const u32 length = table.ReadVLE<VLE8_16_32>();
+            const char *str = table.CurrentData();
+            table.SkipBytes(length);
+            header.strings.append(QString::fromUtf8(str, length));
+        }
+    }
+    catch(...)
+    {
+        return false;
+    }
+    return true;
+}
+
+/// Reads the attributes of a component from the versioned binary scene format.
+/** Does not log, so that it can be called outside the main thread. Throws if the data is damaged. */
+void ParseBinaryAttributes(DataDeserializer &source, const QStringList &strings, std::vector<ParsedAttribute> &dest)
+{
+    const u32 numAttributes = source.ReadVLE<VLE8_16_32>();
+    for(u32 i = 0; i < numAttributes; ++i)
+    {
+        ParsedAttribute attr;
+        attr.index = source.Read<u8>();
+        attr.id = strings.value(source.ReadVLE<VLE8_16_32>());
+        const u32 typeId = source.ReadVLE<VLE8_16_32>();
+        const u32 size = source.Read<u32>();
+        const char *valueData = source.CurrentData();
+        source.SkipBytes(size);
+
+        // Values of unknown types are left unparsed, and skipped when the attributes are applied.
+        if (typeId != cAttributeNone && typeId < cNumAttributeTypes)
+        {
+            attr.parsed = shared_ptr<IAttribute>(SceneAPI::CreateAttribute(typeId, attr.id));
+            DataDeserializer value(valueData, size);
+            if (typeId == cAttributeAssetReference)
+                static_cast<Attribute<AssetReference> *>(attr.parsed.get())->Set(AssetReference(strings.value(value.ReadVLE<VLE8_16_32>())), AttributeChange::Disconnected);
+            else if (typeId == cAttributeAssetReferenceList)
+            {
+                AssetReferenceList refs;
+                const u32 numRefs = value.ReadVLE<VLE8_16_32>();
+                for(u32 j = 0; j < numRefs; ++j)
+                    refs.Append(AssetReference(strings.value(value.ReadVLE<VLE8_16_32>())));
+                static_cast<Attribute<AssetReferenceList> *>(attr.parsed.get())->Set(refs, AttributeChange::Disconnected);
+            }
+            else
+                attr.parsed->FromBinary(value, AttributeChange::Disconnected);
+        }
+        dest.push_back(attr);
+    }
+}
+
+/// Sets parsed attribute values to a component, without signalling the changes.
+/** Dynamic attributes read from binary are created if the component supports them. Attributes that the component
+    does not have are skipped, as are binary values of a different type than the attribute. */
+void ApplyParsedAttributes(IComponent *comp, const std::vector<ParsedAttribute> &attributes)
+{
+    for(size_t i = 0; i < attributes.size(); ++i)
+    {
+        const ParsedAttribute &a = attributes[i];
+        IAttribute *attr = !a.id.isEmpty() ? comp->AttributeById(a.id) : comp->AttributeByName(a.name);
+        if (!attr && a.value.isNull() && a.parsed && comp->SupportsDynamicAttributes())
+            attr = comp->CreateAttribute(a.index, a.parsed->TypeId(), a.id, AttributeChange::Disconnected);
+
+        if (attr && a.parsed && attr->TypeId() == a.parsed->TypeId())
+        {
+            if (attr->TypeId() == cAttributeAssetReferenceList)
+            {
+                // The asset type of the list is set by the component, and not stored in the scene.
+                AssetReferenceList refs = static_cast<Attribute<AssetReferenceList> *>(a.parsed.get())->Get();
+                refs.type = static_cast<Attribute<AssetReferenceList> *>(attr)->Get().type;
+                static_cast<Attribute<AssetReferenceList> *>(attr)->Set(refs, AttributeChange::Disconnected);
+            }
+            else
+                attr->CopyValue(a.parsed.get(), AttributeChange::Disconnected);
+        }
+        else if (attr && !a.value.isNull())
+            attr->FromString(a.value, AttributeChange::Disconnected);
+        else
+            LogWarning(comp->TypeName() + ": Skipping unknown attribute \"" + (!a.id.isEmpty() ? a.id : a.name) + "\" in the scene content.");
+    }
+}
+
+/// Reads the attributes of a component from the versioned binary scene format, without signalling the changes.
+/** Attributes that the component does not have, and can not create, are skipped. */
+void ReadBinaryAttributes(IComponent *comp, DataDeserializer &source, const QStringList &strings)
+{
+    std::vector<ParsedAttribute> attributes;
+    ParseBinaryAttributes(source, strings, attributes);
+    ApplyParsedAttributes(comp, attributes);
+}
+
+/// Reads an entity chunk of the versioned binary scene format, with its child entities, and appends the entity to the list.
+/** Throws if the chunk is damaged, leaving what could be read of it to the list. */
+void ParseEntityFromBinary(DataDeserializer &source, const QStringList &strings, std::vector<ParsedEntity> &dest)
+{
+    const entity_id_t id = source.Read<u32>();
+    const u8 flags = source.Read<u8>();
+    dest.push_back(ParsedEntity());
+    ParsedEntity &entity = dest.back();
+    entity.id = id;
+    entity.replicated = (flags & cBinaryReplicated) != 0;
+    entity.temporary = (flags & cBinaryTemporary) != 0;
+
+    const u32 numComponents = source.ReadVLE<VLE8_16_32>();
+    for(u32 i = 0; i < numComponents; ++i)
+    {
+        ParsedComponent comp;
+        comp.typeName = strings.value(source.ReadVLE<VLE8_16_32>());
+        comp.typeId = source.ReadVLE<VLE8_16_32>();
+        comp.name = strings.value(source.ReadVLE<VLE8_16_32>());
+        const u8 compFlags = source.Read<u8>();
+        comp.replicated = (compFlags & cBinaryReplicated) != 0;
+        comp.temporary = (compFlags & cBinaryTemporary) != 0;
+        const u32 dataSize = source.Read<u32>();
+        // Read the attributes from the component's own part of the chunk, so that the rest of the chunk can be read even if something goes wrong
+        const char *compData = source.CurrentData();
+        source.SkipBytes(dataSize);
+
+        try
+        {
+            DataDeserializer comp_source(compData, dataSize);
+            ParseBinaryAttributes(comp_source, strings, comp.attributes);
+        }
+        catch(...)
+        {
+            comp.damaged = true;
+        }
+        entity.components.push_back(comp);
+    }
+
+    const u32 numChildren = source.ReadVLE<VLE8_16_32>();
+    for(u32 i = 0; i < numChildren; ++i)
+        ParseEntityFromBinary(source, strings, entity.children);
+}
+
+/// Saves a scene snapshot to a file, and signals the completion in the main thread.
+class BackgroundSaveTask : public QRunnable
+{
+public:
+    BackgroundSaveTask(Scene *scene_, const QString &filename_, const SceneSnapshotPtr &snapshot_) :
+        scene(scene_), filename(filename_), snapshot(snapshot_)
+    {
+    }
+
+    void run()
+    {
+        const bool success = snapshot->Save(filename);
+        QMetaObject::invokeMethod(scene, "BackgroundSaveFinished", Qt::QueuedConnection, Q_ARG(QString, filename), Q_ARG(bool, success));
+    }
+
+private:
+    Scene *scene;
+    QString filename;
+    SceneSnapshotPtr snapshot;
+};
+
+/// Returns the root-level entities that are wanted to be saved.
+EntityList SerializableEntities(const EntityList &rootLevel, bool serializeTemporary, bool serializeLocal)
+{
+    EntityList ret;
+    for(EntityList::const_iterator iter = rootLevel.begin(); iter != rootLevel.end(); ++iter)
+        if ((serializeLocal || !(*iter)->IsLocal()) && (serializeTemporary || !(*iter)->IsTemporary()))
+            ret.push_back(*iter);
+    return ret;
+}
+
+/// Reads a file for loading a binary scene. Maps the file to memory if possible, otherwise reads its contents to the given byte array.
+/** @return The file data, or null if reading the file failed or the file is larger than cBinarySceneMaxSize. */
+const char *MapBinarySceneFile(QFile &file, QByteArray &bytes, qint64 &numBytes)
+{
+    numBytes = file.size();
+    if (numBytes <= 0)
+        return 0;
+    if ((u64)numBytes > cBinarySceneMaxSize)
+    {
+        LogError("File " + file.fileName() + " is too large to be a binary scene.");
+        numBytes = 0;
+        return 0;
+    }
+    uchar *mapped = file.map(0, numBytes);
+    if (mapped)
+        return (const char *)mapped;
+    bytes = file.readAll();
+    numBytes = bytes.size();
+    return bytes.size() ? bytes.constData() : 0;
+}
+
+/// Parses an attribute value from its string form to an attribute that does not belong to any component.
+/** @return The attribute, or null if the type is not known. */
+shared_ptr<IAttribute> ParseAttributeValue(const QString &typeName, const QString &id, const QString &value)
+{
+    // Check the type first, as SceneAPI::CreateAttribute logs unknown types, which must not be done outside the main thread.
+    const u32 typeId = SceneAPI::AttributeTypeIdForTypeName(typeName);
+    shared_ptr<IAttribute> attr(typeId ? SceneAPI::CreateAttribute(typeId, id) : 0);
+    if (attr)
+        attr->FromString(value, AttributeChange::Disconnected);
+    return attr;
+}
+
+/// Reads an entity element, with its child entities, and appends the entity to the list.
+void ParseEntityFromXml(const QDomElement &ent_elem, std::vector<ParsedEntity> &dest)
+{
+    dest.push_back(ParsedEntity());
+    ParsedEntity &entity = dest.back();
+    entity.replicated = ParseBool(ent_elem.attribute("sync"), true);
+    entity.temporary = ParseBool(ent_elem.attribute("temporary"), false);
+    const QString id_str = ent_elem.attribute("id");
+    entity.id = !id_str.isEmpty() ? static_cast<entity_id_t>(id_str.toInt()) : 0;
+
+    QDomElement comp_elem = ent_elem.firstChildElement("component");
+    while(!comp_elem.isNull())
+    {
+        entity.components.push_back(ParsedComponent());
+        ParsedComponent &comp = entity.components.back();
+        comp.typeName = comp_elem.attribute("type");
+        comp.typeId = ParseUInt(comp_elem.attribute("typeId"), 0xffffffff);
+        comp.name = comp_elem.attribute("name");
+        comp.replicated = ParseBool(comp_elem.attribute("sync"), true);
+        comp.temporary = ParseBool(comp_elem.attribute("temporary"), false);
+        comp.element = comp_elem;
+
+        QDomElement attr_elem = comp_elem.firstChildElement("attribute");
+        while(!attr_elem.isNull())
+        {
+            ParsedAttribute attr;
+            attr.id = attr_elem.attribute("id");
+            attr.name = attr_elem.attribute("name");
+            attr.value = attr_elem.attribute("value", "");
+            attr.parsed = ParseAttributeValue(attr_elem.attribute("type"), !attr.id.isEmpty() ? attr.id : attr.name, attr.value);
+            comp.attributes.push_back(attr);
+            attr_elem = attr_elem.nextSiblingElement("attribute");
+        }
+        comp_elem = comp_elem.nextSiblingElement("component");
+    }
+
+    QDomElement childEnt_elem = ent_elem.firstChildElement("entity");
+    while(!childEnt_elem.isNull())
+    {
+        ParseEntityFromXml(childEnt_elem, entity.children);
+        childEnt_elem = childEnt_elem.nextSiblingElement("entity");
+    }
+}
+
+/// Reads an entity description, with its child entities, and appends the entity to the list.
+void ParseEntityFromDesc(const EntityDesc &desc, std::vector<ParsedEntity> &dest)
+{
+    dest.push_back(ParsedEntity());
+    ParsedEntity &entity = dest.back();
+    entity.id = static_cast<entity_id_t>(desc.id.toInt());
+    entity.replicated = !desc.local;
+    entity.temporary = desc.temporary;
+
+    for(int i = 0; i < desc.components.size(); ++i)
+    {
+        const ComponentDesc &c = desc.components[i];
+        if (c.typeName.isNull())
+            continue;
+
+        entity.components.push_back(ParsedComponent());
+        ParsedComponent &comp = entity.components.back();
+        comp.typeName = c.typeName;
+        comp.name = c.name;
+        comp.desc = &c;
+        for(int j = 0; j < c.attributes.size(); ++j)
+        {
+            const AttributeDesc &a = c.attributes[j];
+            ParsedAttribute attr;
+            attr.name = a.name;
+            attr.value = !a.value.isNull() ? a.value : "";
+            attr.parsed = ParseAttributeValue(a.typeName, !a.id.isEmpty() ? a.id : a.name, attr.value);
+            comp.attributes.push_back(attr);
+        }
+    }
+
+    for(int i = 0; i < desc.children.size(); ++i)
+        ParseEntityFromDesc(desc.children[i], entity.children);
+}
+
+/// Reads a batch of root-level entities in parallel.
+/** Reading only touches the source data and attributes that do not belong to any component, so it is safe to do
+    outside the main thread. The entities are created to the scene on the main thread afterwards. */
+class EntityParseBatch : public IParallelTask
+{
+public:
+    explicit EntityParseBatch(std::vector<EntityParseItem> &items_) : items(items_) {}
+
+    /// Reads all the items. Returns once all are done.
+    void Run()
+    {
+        ParallelFor(*this, items.size());
+    }
+
+    void RunItem(size_t index)
+    {
+        EntityParseItem &item = items[index];
+        if (item.desc)
+            ParseEntityFromDesc(*item.desc, item.entities);
+        else if (!item.element.isNull())
+            ParseEntityFromXml(item.element, item.entities);
+        else
+        {
+            try
+            {
+                DataDeserializer source(item.data, item.size);
+                ParseEntityFromBinary(source, *item.strings, item.entities);
+            }
+            catch(...)
+            {
+                item.failed = true;
+            }
+        }
+    }
+
+private:
+    std::vector<EntityParseItem> &items;
+};
+
+/// Number of root-level entities read in parallel before they are created to the scene. Bounds the memory used for the read entities.
+const size_t cEntityParseBatchSize = 1024;
+
+/// Returns the number of entities in a parsed entity, including its child entities.
+int NumParsedEntities(const ParsedEntity &entity)
+{
+    int num = 1;
+    for(size_t i = 0; i < entity.children.size(); ++i)
+        num += NumParsedEntities(entity.children[i]);
+    return num;
+}
+
+/// Gives new IDs to a parsed entity and its child entities, recording the mapping from the IDs of the file.
+/** Done before any of the entities are created, so that the parent refs of entities created on later frames can be fixed too. */
+void AssignNewEntityIds(Scene &scene, ParsedEntity &entity, QHash<entity_id_t, entity_id_t> &oldToNewIds)
+{
+    // Entities without an ID get a new one when they are created.
+    if (entity.id != 0)
+    {
+        const entity_id_t newId = entity.replicated ? scene.NextFreeId() : scene.NextFreeIdLocal();
+        if (!oldToNewIds.contains(entity.id))
+            oldToNewIds[entity.id] = newId;
+        entity.id = newId;
+    }
+    for(size_t i = 0; i < entity.children.size(); ++i)
+        AssignNewEntityIds(scene, entity.children[i], oldToNewIds);
+}
+
+/// Finds the position of a parsed entity from the transform of its placeable component.
+/** @return False if the entity has no placeable component with a transform. */
+bool ParsedEntityPosition(const ParsedEntity &entity, float3 &position)
+{
+    for(size_t i = 0; i < entity.components.size(); ++i)
+    {
+        const ParsedComponent &comp = entity.components[i];
+        if (comp.typeId != cPlaceableTypeId && IComponent::EnsureTypeNameWithPrefix(comp.typeName) != cPlaceableTypeName)
+            continue;
+        for(size_t j = 0; j < comp.attributes.size(); ++j)
+        {
+            const ParsedAttribute &a = comp.attributes[j];
+            if ((a.id == "transform" || (a.id.isEmpty() && a.name == "Transform")) && a.parsed && a.parsed->TypeId() == cAttributeTransform)
+            {
+                position = static_cast<Attribute<Transform> *>(a.parsed.get())->Get().pos;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// Orders the root-level entities of an incremental load by their distance to a position. Entities without a position come first.
+class NearerToFocus
+{
+public:
+    NearerToFocus(const IncrementalSceneLoad &load_, const float3 &focus_) : load(load_), focus(focus_) {}
+
+    bool operator()(size_t a, size_t b) const { return DistanceSq(a) < DistanceSq(b); }
+
+private:
+    float DistanceSq(size_t index) const { return load.hasPosition[index] ? load.positions[index].DistanceSq(focus) : 0.f; }
+
+    const IncrementalSceneLoad &load;
+    float3 focus;
+};
+
+}
+
 QList<Entity *> Scene::LoadSceneBinary(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change)
 {
     QList<Entity *> ret;
@@ -517,11 +1085,10 @@ QList<Entity *> Scene::LoadSceneBinary(const QString& filename, bool clearScene,
         return ret;
     }
 
-    ///\todo Use Latin 1?
-    QByteArray bytes = file.readAll();
-    file.close();
-
-    if (!bytes.size())
+    QByteArray bytes;
+    qint64 numBytes = 0;
+    const char *data = MapBinarySceneFile(file, bytes, numBytes);
+    if (!data)
     {
         LogError("File " + filename + " contained 0 bytes when loading scene binary.");
         return ret;
@@ -530,74 +1097,205 @@ QList<Entity *> Scene::LoadSceneBinary(const QString& filename, bool clearScene,
     if (clearScene)
         RemoveAllEntities(true, change);
 
-    return CreateContentFromBinary(bytes.data(), bytes.size(), useEntityIDsFromFile, change);
+    return CreateContentFromBinary(data, (int)numBytes, useEntityIDsFromFile, change);
 }
 
 bool Scene::SaveSceneBinary(const QString& filename, bool getTemporary, bool getLocal) const
 {
-    QByteArray bytes;
-    // Assume 4MB max for now
-    bytes.resize(4 * 1024 * 1024);
-    DataSerializer dest(bytes.data(), bytes.size());
-    
-    // Count number of entities we accept
-    uint num_entities = 0;
-    EntityList rootLevel = RootLevelEntities();
+    // Written to a temporary file first, so that a failed save does not destroy the previous file.
+    if (!CreateSnapshot(getTemporary, getLocal)->SaveBinary(filename))
+    {
+        LogError("Failed to write file " + filename + " when saving scene binary");
+        return false;
+    }
+    return true;
+}
 
-    for(EntityList::const_iterator iter = rootLevel.begin(); iter != rootLevel.end(); ++iter)
+QByteArray Scene::SerializeToBinary(bool serializeTemporary, bool serializeLocal) const
+{
+    return SerializeToBinary(SerializableEntities(RootLevelEntities(), serializeTemporary, serializeLocal), serializeTemporary);
+}
+
+QByteArray Scene::SerializeToBinary(const EntityList &entities, bool serializeTemporary) const
+{
+    QByteArray bytes = SceneSnapshot(entities, serializeTemporary).SerializeToBinary();
+    if (bytes.isEmpty())
+        LogError("Scene::SerializeToBinary: failed to serialize entities.");
+    return bytes;
+}
+
+SceneSnapshotPtr Scene::CreateSnapshot(bool serializeTemporary, bool serializeLocal) const
+{
+    PROFILE(Scene_CreateSnapshot);
+    return SceneSnapshotPtr(new SceneSnapshot(SerializableEntities(RootLevelEntities(), serializeTemporary, serializeLocal), serializeTemporary));
+}
+
+void Scene::SaveSceneInBackground(const QString& filename, bool saveTemporary, bool saveLocal)
+{
+    if (!backgroundSaves_)
     {
-        bool serialize = true;
-        EntityPtr ent = *iter;
-        if (ent->IsLocal() && !getLocal)
-            serialize = false;
-        if (ent->IsTemporary() && !getTemporary)
-            serialize = false;
-        if (serialize)
-            ++num_entities;
+        backgroundSaves_ = new QThreadPool(this);
+        backgroundSaves_->setMaxThreadCount(1);
     }
-    
-    dest.Add<u32>(num_entities);
+    backgroundSaves_->start(new BackgroundSaveTask(this, filename, CreateSnapshot(saveTemporary, saveLocal)));
+}
 
-    for(EntityList::const_iterator iter = rootLevel.begin(); iter != rootLevel.end(); ++iter)
+bool Scene::LoadSceneIncrementally(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change, int maxEntitiesPerFrame, float maxMillisecondsPerFrame)
+{
+    const bool binary = filename.endsWith(".tbin", Qt::CaseInsensitive);
+    if (!binary && !filename.endsWith(".txml", Qt::CaseInsensitive))
     {
-        bool serialize = true;
-        EntityPtr ent = *iter;
-        if (ent->IsLocal() && !getLocal)
-            serialize = false;
-        if (ent->IsTemporary() && !getTemporary)
-            serialize = false;
-        if (serialize)
-            ent->SerializeToBinary(dest, getTemporary);
+        LogError("Scene::LoadSceneIncrementally: Unsupported file extension: " + filename);
+        return false;
     }
-    
-    bytes.resize((int)dest.BytesFilled());
-    QFile scenefile(filename);
-    if (scenefile.open(QFile::WriteOnly))
+
+    if (incrementalLoad_)
     {
-        scenefile.write(bytes);
-        scenefile.close();
+        LogWarning("Scene::LoadSceneIncrementally: Cancelling the incremental load in progress to load " + filename);
+        CancelIncrementalLoad();
+    }
+    if (clearScene)
+        RemoveAllEntities(true, change);
+
+    shared_ptr<IncrementalSceneLoad> load(new IncrementalSceneLoad);
+    load->useEntityIDsFromFile = useEntityIDsFromFile;
+    load->change = change;
+    load->maxEntitiesPerFrame = maxEntitiesPerFrame;
+    load->maxMillisecondsPerFrame = maxMillisecondsPerFrame;
+
+    // Read the file like when loading it at once, except that the parsed entities are collected instead of created.
+    incrementalLoad_ = load;
+    QList<Entity *> created = (binary ? LoadSceneBinary(filename, false, useEntityIDsFromFile, change) :
+        LoadSceneXML(filename, false, useEntityIDsFromFile, change));
+    load->collecting = false;
+    if (load->roots.empty())
+    {
+        incrementalLoad_.reset();
+        if (created.isEmpty())
+            return false;
+        // The earlier unversioned binary format is not read through the parser, so it is created at once.
+        emit IncrementalLoadProgress(created.size(), created.size());
+        emit IncrementalLoadFinished();
         return true;
     }
-    else
+
+    load->positions.resize(load->roots.size());
+    load->hasPosition.resize(load->roots.size());
+    load->order.resize(load->roots.size());
+    for(size_t i = 0; i < load->roots.size(); ++i)
     {
-        LogError("Could not open file " + filename + " for writing when saving scene binary");
-        return false;
+        if (!useEntityIDsFromFile)
+            AssignNewEntityIds(*this, load->roots[i], load->oldToNewIds);
+        load->hasPosition[i] = ParsedEntityPosition(load->roots[i], load->positions[i]);
+        load->order[i] = i;
+        load->numTotal += NumParsedEntities(load->roots[i]);
     }
+    return true;
+}
+
+void Scene::SetIncrementalLoadFocus(const float3 &position)
+{
+    if (!incrementalLoad_ || incrementalLoad_->collecting)
+        return;
+    IncrementalSceneLoad &load = *incrementalLoad_;
+    std::stable_sort(load.order.begin() + load.next, load.order.end(), NearerToFocus(load, position));
+}
+
+void Scene::CancelIncrementalLoad()
+{
+    incrementalLoad_.reset();
+}
+
+void Scene::ProcessIncrementalLoad()
+{
+    PROFILE(Scene_ProcessIncrementalLoad);
+
+    // Keep the load alive, as the signals emitted for the created entities may cancel it or start a new one.
+    shared_ptr<IncrementalSceneLoad> load = incrementalLoad_;
+    const tick_t startTime = GetCurrentClockTime();
+    const tick_t maxTicks = (tick_t)(load->maxMillisecondsPerFrame * 0.001 * GetCurrentClockFreq());
+    int numCreated = 0;
+    // Each root-level entity is created and signalled together with its child entities, at least one per frame.
+    while(load->next < load->order.size())
+    {
+        ParsedEntity &parsed = load->roots[load->order[load->next++]];
+        std::vector<EntityWeakPtr> entities;
+        // The new IDs, if wanted, were assigned when the load was started.
+        CreateEntityFromParsed(EntityPtr(), parsed, true, entities, load->oldToNewIds);
+        numCreated += NumParsedEntities(parsed);
+        parsed = ParsedEntity();
+
+        EmitContentCreated(entities, load->oldToNewIds, load->useEntityIDsFromFile, load->change);
+        if (incrementalLoad_ != load)
+            return;
+        if ((load->maxEntitiesPerFrame > 0 && numCreated >= load->maxEntitiesPerFrame) ||
+            (load->maxMillisecondsPerFrame > 0.f && GetCurrentClockTime() - startTime >= maxTicks))
+            break;
+    }
+
+    load->numCreated += numCreated;
+    const bool finished = load->next >= load->order.size();
+    if (finished)
+        incrementalLoad_.reset();
+    emit IncrementalLoadProgress(load->numCreated, load->numTotal);
+    if (finished)
+        emit IncrementalLoadFinished();
 }
 
 QList<Entity *> Scene::CreateContentFromXml(const QString &xml,  bool useEntityIDsFromFile, AttributeChange::Type change)
 {
     QList<Entity *> ret;
-    QString errorMsg;
-    QDomDocument scene_doc("Scene");
-    int errorLine, errorColumn;
-    if (!scene_doc.setContent(xml, false, &errorMsg, &errorLine, &errorColumn))
+    QXmlStreamReader reader(xml);
+    if (!reader.readNextStartElement() || reader.name() != "scene")
     {
-        LogError(QString("Parsing scene XML from text failed when loading Scene XML: %1 at line %2 column %3.").arg(errorMsg).arg(errorLine).arg(errorColumn));
+        LogError(QString("Parsing scene XML from text failed when loading Scene XML: %1 at line %2 column %3.")
+            .arg(reader.hasError() ? reader.errorString() : "Could not find 'scene' element").arg(reader.lineNumber()).arg(reader.columnNumber()));
         return ret;
     }
 
-    return CreateContentFromXml(scene_doc, useEntityIDsFromFile, change);
+    return CreateContentFromXml(reader, useEntityIDsFromFile, change);
+}
+
+QList<Entity *> Scene::CreateContentFromXml(QXmlStreamReader &reader, bool useEntityIDsFromFile, AttributeChange::Type change)
+{
+    PROFILE(Scene_CreateContentFromXmlStream);
+
+    /// @todo Make server fix any broken parenting when it changes the entity IDs from unacked to replicated!
+    if (!IsAuthority() && !useEntityIDsFromFile)
+        LogWarning("Scene: The created entitity IDs need to be verified from the server. This will break EC_Placeable parenting.");
+
+    std::vector<EntityWeakPtr> entities;
+    QHash<entity_id_t, entity_id_t> oldToNewIds;
+
+    // Create the storages and spawn the entities in the order they appear in the file. Each root-level entity is read
+    // to its own DOM document, which is small compared to the whole scene, and the entities are parsed in batches.
+    std::vector<EntityParseItem> items;
+    items.reserve(cEntityParseBatchSize);
+    while(reader.readNextStartElement())
+    {
+        if (reader.name() == "storage")
+        {
+            CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
+            framework_->Asset()->DeserializeAssetStorageFromString(Application::ParseWildCardFilename(reader.attributes().value("specifier").toString()), false);
+            reader.skipCurrentElement();
+        }
+        else if (reader.name() == "entity")
+        {
+            items.push_back(EntityParseItem());
+            items.back().element = ReadXmlStreamElement(reader, items.back().doc);
+            if (items.size() >= cEntityParseBatchSize)
+                CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
+        }
+        else
+            reader.skipCurrentElement();
+    }
+    CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
+
+    if (reader.hasError())
+        LogError(QString("Parsing scene XML failed when loading Scene XML: %1 at line %2 column %3. Creating the %4 entities read before the error.")
+            .arg(reader.errorString()).arg(reader.lineNumber()).arg(reader.columnNumber()).arg(entities.size()));
+
+    return EmitContentCreated(entities, oldToNewIds, useEntityIDsFromFile, change);
 }
 
 QList<Entity *> Scene::CreateContentFromXml(const QDomDocument &xml, bool useEntityIDsFromFile, AttributeChange::Type change)
@@ -634,6 +1332,11 @@ QList<Entity *> Scene::CreateContentFromXml(const QDomDocument &xml, bool useEnt
         ent_elem = ent_elem.nextSiblingElement("entity");
     }
 
+    return EmitContentCreated(entities, oldToNewIds, useEntityIDsFromFile, change);
+}
+
+QList<Entity *> Scene::EmitContentCreated(const std::vector<EntityWeakPtr> &entities, const QHash<entity_id_t, entity_id_t> &oldToNewIds, bool useEntityIDsFromFile, AttributeChange::Type change)
+{
     // Now that we have each entity spawned to the scene, trigger all the signals for EntityCreated/ComponentChanged messages.
     for(unsigned i = 0; i < entities.size(); ++i)
     {
@@ -646,7 +1349,7 @@ QList<Entity *> Scene::CreateContentFromXml(const QDomDocument &xml, bool useEnt
             for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
             {
                 /// @todo Duplicate code
-                if (!useEntityIDsFromFile && i->second->TypeId() == 20 /*EC_Placeable*/)
+                if (!useEntityIDsFromFile && i->second->TypeId() == cPlaceableTypeId)
                 {
                     // Go and fix parent ref of EC_Placeable if new entity IDs were generated
                     Attribute<EntityReference> *parentRef = dynamic_cast<Attribute<EntityReference> *>(i->second->AttributeById("parentRef"));
@@ -683,6 +1386,133 @@ void Scene::CreateEntityFromXml(EntityPtr parent, const QDomElement& ent_elem, b
 
     QString id_str = ent_elem.attribute("id");
     entity_id_t id = !id_str.isEmpty() ? static_cast<entity_id_t>(id_str.toInt()) : 0;
+    EntityPtr entity = CreateEntityWithFileId(parent, id, replicated, useEntityIDsFromFile, oldToNewIds);
+    if (entity)
+    {
+        entity->SetTemporary(temporary);
+
+        QDomElement comp_elem = ent_elem.firstChildElement("component");
+        while(!comp_elem.isNull())
+        {
+            CreateComponentFromXml(entity.get(), comp_elem);
+            comp_elem = comp_elem.nextSiblingElement("component");
+        }
+        entities.push_back(entity);
+    }
+
+    // Spawn any child entities
+    QDomElement childEnt_elem = ent_elem.firstChildElement("entity");
+    while (!childEnt_elem.isNull())
+    {
+        CreateEntityFromXml(entity, childEnt_elem, useEntityIDsFromFile, change, entities, oldToNewIds);
+        childEnt_elem = childEnt_elem.nextSiblingElement("entity");
+    }
+}
+
+void Scene::CreateEntitiesFromParseItems(std::vector<EntityParseItem>& items, bool useEntityIDsFromFile, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds)
+{
+    if (items.empty())
+        return;
+
+    {
+        PROFILE(Scene_ParseEntities);
+        EntityParseBatch(items).Run();
+    }
+
+    PROFILE(Scene_CreateParsedEntities);
+    IncrementalSceneLoad *load = (incrementalLoad_ && incrementalLoad_->collecting ? incrementalLoad_.get() : 0);
+    for(size_t i = 0; i < items.size(); ++i)
+    {
+        // A damaged binary chunk only loses the entities in it.
+        if (items[i].failed)
+            LogError("Scene: Failed to read an entity chunk of binary scene content. Creating what could be read of it.");
+        if (load)
+        {
+            // When loading incrementally, the entities are only collected here, and created over the following frames.
+            if (!items[i].doc.isNull())
+                load->documents.append(items[i].doc);
+            for(size_t j = 0; j < items[i].entities.size(); ++j)
+            {
+                load->roots.push_back(ParsedEntity());
+                load->roots.back().Swap(items[i].entities[j]);
+            }
+        }
+        else
+        {
+            for(size_t j = 0; j < items[i].entities.size(); ++j)
+                CreateEntityFromParsed(EntityPtr(), items[i].entities[j], useEntityIDsFromFile, entities, oldToNewIds);
+        }
+    }
+    items.clear();
+}
+
+void Scene::CreateEntityFromParsed(EntityPtr parent, ParsedEntity& parsed, bool useEntityIDsFromFile, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds)
+{
+    EntityPtr entity = CreateEntityWithFileId(parent, parsed.id, parsed.replicated, useEntityIDsFromFile, oldToNewIds);
+    if (entity)
+    {
+        entity->SetTemporary(parsed.temporary);
+        for(size_t i = 0; i < parsed.components.size(); ++i)
+            CreateComponentFromParsed(entity.get(), parsed.components[i]);
+        entities.push_back(entity);
+    }
+
+    // Spawn any child entities
+    for(size_t i = 0; i < parsed.children.size(); ++i)
+        CreateEntityFromParsed(entity, parsed.children[i], useEntityIDsFromFile, entities, oldToNewIds);
+}
+
+void Scene::CreateComponentFromParsed(Entity* entity, ParsedComponent& parsed)
+{
+    // If we encounter an unknown component type, now is the time to register a placeholder type for it
+    // The XML and the component desc hold all needed data for it, while binary doesn't
+    SceneAPI* sceneAPI = framework_->Scene();
+    if (!parsed.typeName.isEmpty() && !sceneAPI->IsComponentTypeRegistered(parsed.typeName))
+    {
+        if (!parsed.element.isNull())
+            sceneAPI->RegisterPlaceholderComponentType(parsed.element);
+        else if (parsed.desc)
+            sceneAPI->RegisterPlaceholderComponentType(*parsed.desc);
+    }
+
+    ComponentPtr comp = (!parsed.typeName.isEmpty() ? entity->GetOrCreateComponent(parsed.typeName, parsed.name, AttributeChange::Default, parsed.replicated) :
+        entity->GetOrCreateComponent(parsed.typeId, parsed.name, AttributeChange::Default, parsed.replicated));
+    if (!comp)
+    {
+        LogError("Failed to load component \"" + (!parsed.typeName.isEmpty() ? parsed.typeName : sceneAPI->ComponentTypeNameForTypeId(parsed.typeId)) + "\"!");
+        return;
+    }
+    if (parsed.damaged)
+        LogError("Failed to load all attributes of component \"" + comp->TypeName() + "\"!");
+
+    comp->SetTemporary(parsed.temporary);
+    // Trigger no signal yet when scene is in incoherent state
+    if (comp->SupportsDynamicAttributes() && !parsed.element.isNull())
+        comp->DeserializeFrom(parsed.element, AttributeChange::Disconnected);
+    else if (comp->SupportsDynamicAttributes() && parsed.desc)
+    {
+        // The dynamic attributes are created from an XML element, so build one from the desc.
+        QDomDocument temp_doc;
+        QDomElement root_elem = temp_doc.createElement("component");
+        root_elem.setAttribute("type", parsed.desc->typeName);
+        root_elem.setAttribute("name", parsed.desc->name);
+        root_elem.setAttribute("sync", parsed.desc->sync);
+        foreach(const AttributeDesc &a, parsed.desc->attributes)
+        {
+            QDomElement child_elem = temp_doc.createElement("attribute");
+            child_elem.setAttribute("value", a.value);
+            child_elem.setAttribute("type", a.typeName);
+            child_elem.setAttribute("name", a.name);
+            root_elem.appendChild(child_elem);
+        }
+        comp->DeserializeFrom(root_elem, AttributeChange::Disconnected);
+    }
+    else
+        ApplyParsedAttributes(comp.get(), parsed.attributes);
+}
+
+EntityPtr Scene::CreateEntityWithFileId(EntityPtr parent, entity_id_t id, bool replicated, bool useEntityIDsFromFile, QHash<entity_id_t, entity_id_t>& oldToNewIds)
+{
     if (!useEntityIDsFromFile || id == 0) // If we don't want to use entity IDs from file, or if file doesn't contain one, generate a new one.
     {
         entity_id_t originaId = id;
@@ -709,48 +1539,31 @@ void Scene::CreateEntityFromXml(EntityPtr parent, const QDomElement& ent_elem, b
     else
         entity = parent->CreateChild(id);
 
-    if (entity)
-    {
-        entity->SetTemporary(temporary);
-
-        QDomElement comp_elem = ent_elem.firstChildElement("component");
-        while(!comp_elem.isNull())
-        {
-            const QString typeName = comp_elem.attribute("type");
-            const u32 typeId = ParseUInt(comp_elem.attribute("typeId"), 0xffffffff);
-            const QString name = comp_elem.attribute("name");
-            const bool compReplicated = ParseBool(comp_elem.attribute("sync"), true);
-            const bool temporary = ParseBool(comp_elem.attribute("temporary"), false);
-
-            // If we encounter an unknown component type, now is the time to register a placeholder type for it
-            // The XML holds all needed data for it, while binary doesn't
-            SceneAPI* sceneAPI = framework_->Scene();
-            if (!sceneAPI->IsComponentTypeRegistered(typeName))
-                sceneAPI->RegisterPlaceholderComponentType(comp_elem);
-            
-            ComponentPtr new_comp = (!typeName.isEmpty() ? entity->GetOrCreateComponent(typeName, name, AttributeChange::Default, compReplicated) :
-                entity->GetOrCreateComponent(typeId, name, AttributeChange::Default, compReplicated));
-            if (new_comp)
-            {
-                new_comp->SetTemporary(temporary);
-                new_comp->DeserializeFrom(comp_elem, AttributeChange::Disconnected);// Trigger no signal yet when scene is in incoherent state
-            }
-
-            comp_elem = comp_elem.nextSiblingElement("component");
-        }
-        entities.push_back(entity);
-    }
-    else
-    {
+    if (!entity)
         LogError("Scene::CreateContentFromXml: Failed to create entity with id " + QString::number(id) + "!");
-    }
+    return entity;
+}
+
+void Scene::CreateComponentFromXml(Entity* entity, QDomElement& comp_elem)
+{
+    const QString typeName = comp_elem.attribute("type");
+    const u32 typeId = ParseUInt(comp_elem.attribute("typeId"), 0xffffffff);
+    const QString name = comp_elem.attribute("name");
+    const bool compReplicated = ParseBool(comp_elem.attribute("sync"), true);
+    const bool temporary = ParseBool(comp_elem.attribute("temporary"), false);
 
-    // Spawn any child entities
-    QDomElement childEnt_elem = ent_elem.firstChildElement("entity");
-    while (!childEnt_elem.isNull())
+    // If we encounter an unknown component type, now is the time to register a placeholder type for it
+    // The XML holds all needed data for it, while binary doesn't
+    SceneAPI* sceneAPI = framework_->Scene();
+    if (!sceneAPI->IsComponentTypeRegistered(typeName))
+        sceneAPI->RegisterPlaceholderComponentType(comp_elem);
+    
+    ComponentPtr new_comp = (!typeName.isEmpty() ? entity->GetOrCreateComponent(typeName, name, AttributeChange::Default, compReplicated) :
+        entity->GetOrCreateComponent(typeId, name, AttributeChange::Default, compReplicated));
+    if (new_comp)
     {
-        CreateEntityFromXml(entity, childEnt_elem, useEntityIDsFromFile, change, entities, oldToNewIds);
-        childEnt_elem = childEnt_elem.nextSiblingElement("entity");
+        new_comp->SetTemporary(temporary);
+        new_comp->DeserializeFrom(comp_elem, AttributeChange::Disconnected);// Trigger no signal yet when scene is in incoherent state
     }
 }
 
@@ -765,16 +1578,16 @@ QList<Entity *> Scene::CreateContentFromBinary(const QString &filename, bool use
         return QList<Entity*>();
     }
 
-    QByteArray bytes = file.readAll();
-    file.close();
-    
-    if (!bytes.size())
+    QByteArray bytes;
+    qint64 numBytes = 0;
+    const char *data = MapBinarySceneFile(file, bytes, numBytes);
+    if (!data)
     {
         LogError("File " + filename + "contained 0 bytes when loading scene binary.");
         return QList<Entity*>();
     }
 
-    return CreateContentFromBinary(bytes.data(), bytes.size(), useEntityIDsFromFile, change);
+    return CreateContentFromBinary(data, (int)numBytes, useEntityIDsFromFile, change);
 }
 
 QList<Entity *> Scene::CreateContentFromBinary(const char *data, int numBytes, bool useEntityIDsFromFile, AttributeChange::Type change)
@@ -787,58 +1600,47 @@ QList<Entity *> Scene::CreateContentFromBinary(const char *data, int numBytes, b
     assert(data);
     assert(numBytes > 0);
     QHash<entity_id_t, entity_id_t> oldToNewIds;
-    try
+    if (IsVersionedBinaryScene(data, numBytes))
     {
-        DataDeserializer source(data, numBytes);
+        BinarySceneHeader header;
+        if (!ReadBinarySceneHeader(data, numBytes, header))
+        {
+            LogError("Scene::CreateContentFromBinary: Invalid binary scene header.");
+            return QList<Entity *>();
+        }
 
-        uint num_entities = source.Read<u32>();
-        for(uint i = 0; i < num_entities; ++i)
-            CreateEntityFromBinary(EntityPtr(), source, useEntityIDsFromFile, change, entities, oldToNewIds);
+        // Each root-level entity is read from its own chunk, so the chunks are parsed in parallel, in batches.
+        std::vector<EntityParseItem> items;
+        items.reserve(std::min(header.chunkOffsets.size(), cEntityParseBatchSize));
+        for(size_t i = 0; i < header.chunkOffsets.size(); ++i)
+        {
+            items.push_back(EntityParseItem());
+            items.back().data = data + header.chunkOffsets[i];
+            items.back().size = header.ChunkSize(i);
+            items.back().strings = &header.strings;
+            if (items.size() >= cEntityParseBatchSize)
+                CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
+        }
+        CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
     }
-    catch(...)
+    else
     {
-        // Note: if exception happens, no change signals are emitted
-        return QList<Entity *>();
-    }
+        try
+        {
+            DataDeserializer source(data, numBytes);
 
-    // Now that we have each entity spawned to the scene, trigger all the signals for EntityCreated/ComponentChanged messages.
-    for(unsigned i = 0; i < entities.size(); ++i)
-    {
-        if (!entities[i].expired())
-            EmitEntityCreated(entities[i].lock().get(), change);
-        if (!entities[i].expired())
+            uint num_entities = source.Read<u32>();
+            for(uint i = 0; i < num_entities; ++i)
+                CreateEntityFromBinary(EntityPtr(), source, useEntityIDsFromFile, change, entities, oldToNewIds);
+        }
+        catch(...)
         {
-            EntityPtr entityShared = entities[i].lock();
-            const Entity::ComponentMap &components = entityShared->Components();
-            for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
-            {
-                /// @todo Duplicate code
-                if (!useEntityIDsFromFile && i->second->TypeId() == 20 /* EC_Placeable*/)
-                {
-                    // Go and fix parent ref of EC_Placeable if new entity IDs were generated
-                    Attribute<EntityReference> *parentRef = dynamic_cast<Attribute<EntityReference> *>(i->second->AttributeById("parentRef"));
-                    if (parentRef && !parentRef->Get().IsEmpty())
-                    {
-                        // We only need to fix the id parent refs.
-                        // Ones with entity names should work as expected.
-                        bool isNumber = false;
-                        entity_id_t refId = parentRef->Get().ref.toUInt(&isNumber);
-                        if (isNumber && refId > 0 && oldToNewIds.contains(refId))
-                            parentRef->Set(EntityReference(oldToNewIds[refId]), change);
-                    }
-                }
-                i->second->ComponentChanged(change);
-            }
+            // Note: if exception happens, no change signals are emitted
+            return QList<Entity *>();
         }
     }
-    
-    // The above signals may have caused scripts to remove entities. Return those that still exist.
-    QList<Entity *> ret;
-    for(unsigned i = 0; i < entities.size(); ++i)
-        if (!entities[i].expired())
-            ret.append(entities[i].lock().get());
 
-    return ret;
+    return EmitContentCreated(entities, oldToNewIds, useEntityIDsFromFile, change);
 }
 
 void Scene::CreateEntityFromBinary(EntityPtr parent, kNet::DataDeserializer& source, bool useEntityIDsFromFile, AttributeChange::Type change, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds)
@@ -924,128 +1726,28 @@ void Scene::CreateEntityFromBinary(EntityPtr parent, kNet::DataDeserializer& sou
 
 QList<Entity *> Scene::CreateContentFromSceneDesc(const SceneDesc &desc, bool useEntityIDsFromFile, AttributeChange::Type change)
 {
-    QList<Entity *> ret;
-
     if (desc.entities.empty())
     {
         LogError("Empty scene description.");
-        return ret;
+        return QList<Entity *>();
     }
 
+    std::vector<EntityWeakPtr> entities;
     QHash<entity_id_t, entity_id_t> oldToNewIds;
 
-    foreach(const EntityDesc &e, desc.entities)
-        CreateEntityFromDesc(EntityPtr(), e, useEntityIDsFromFile, change, ret, oldToNewIds);
-
-    // All entities & components have been loaded. Trigger change for them now.
-    foreach(Entity *entity, ret)
-    {
-        EmitEntityCreated(entity, change);
-        const Entity::ComponentMap &components = entity->Components();
-        for(Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
-        {
-            /// @todo Duplicate code
-            if (!useEntityIDsFromFile && i->second->TypeId() == 20 /*EC_Placeable*/)
-            {
-                // Go and fix parent ref of EC_Placeable if new entity IDs were generated
-                Attribute<EntityReference> *parentRef = dynamic_cast<Attribute<EntityReference> *>(i->second->AttributeById("parentRef"));
-                if (parentRef && !parentRef->Get().IsEmpty())
-                {
-                    // We only need to fix the id parent refs.
-                    // Ones with entity names should work as expected.
-                    bool isNumber = false;
-                    entity_id_t refId = parentRef->Get().ref.toUInt(&isNumber);
-                    if (isNumber && refId > 0 && oldToNewIds.contains(refId))
-                        parentRef->Set(EntityReference(oldToNewIds[refId]), change);
-                }
-            }
-            i->second->ComponentChanged(change);
-        }
-    }
-
-    return ret;
-}
-
-void Scene::CreateEntityFromDesc(EntityPtr parent, const EntityDesc& e, bool useEntityIDsFromFile, AttributeChange::Type change, QList<Entity *>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds)
-{
-    entity_id_t id = static_cast<entity_id_t>(e.id.toInt());
-
-    if (e.id.isEmpty() || !useEntityIDsFromFile)
-    {
-        entity_id_t originaId = id;
-        id = e.local ? NextFreeIdLocal() : NextFreeId();
-        if (originaId != 0 && !oldToNewIds.contains(originaId))
-            oldToNewIds[originaId] = id;
-    }
-
-    if (HasEntity(id)) // If the entity we are about to add conflicts in ID with an existing entity in the scene.
+    std::vector<EntityParseItem> items;
+    items.reserve(std::min((size_t)desc.entities.size(), cEntityParseBatchSize));
+    for(int i = 0; i < desc.entities.size(); ++i)
     {
-        LogDebug("Scene::CreateContentFromSceneDescription: Destroying previous entity with id " + QString::number(id) + " to avoid conflict with new created entity with the same id.");
-        LogError("Warning: Invoking buggy behavior: Object with id " + QString::number(id) + " might not replicate properly!");
-        RemoveEntity(id, AttributeChange::Replicate); ///<@todo Consider do we want to always use Replicate
+        items.push_back(EntityParseItem());
+        items.back().desc = &desc.entities[i];
+        if (items.size() >= cEntityParseBatchSize)
+            CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
     }
+    CreateEntitiesFromParseItems(items, useEntityIDsFromFile, entities, oldToNewIds);
 
-    EntityPtr entity;
-    if (!parent)
-        entity = CreateEntity(id);
-    else
-        entity = parent->CreateChild(id);
-
-    assert(entity);
-    if (entity)
-    {
-        foreach(const ComponentDesc &c, e.components)
-        {
-            if (c.typeName.isNull())
-                continue;
-
-            // If we encounter an unknown component type, now is the time to register a placeholder type for it
-            // The componentdesc holds all needed data for it
-            SceneAPI* sceneAPI = framework_->Scene();
-            if (!sceneAPI->IsComponentTypeRegistered(c.typeName))
-                sceneAPI->RegisterPlaceholderComponentType(c);
-
-            ComponentPtr comp = entity->GetOrCreateComponent(c.typeName, c.name);
-            assert(comp);
-            if (!comp)
-            {
-                LogError(QString("Scene::CreateContentFromSceneDesc: failed to create component %1 %2 .").arg(c.typeName).arg(c.name));
-                continue;
-            }
-            if (comp->TypeId() == 25 /*EC_DynamicComponent*/)
-            {
-                QDomDocument temp_doc;
-                QDomElement root_elem = temp_doc.createElement("component");
-                root_elem.setAttribute("type", c.typeName);
-                root_elem.setAttribute("name", c.name);
-                root_elem.setAttribute("sync", c.sync);
-                foreach(const AttributeDesc &a, c.attributes)
-                {
-                    QDomElement child_elem = temp_doc.createElement("attribute");
-                    child_elem.setAttribute("value", a.value);
-                    child_elem.setAttribute("type", a.typeName);
-                    child_elem.setAttribute("name", a.name);
-                    root_elem.appendChild(child_elem);
-                }
-                comp->DeserializeFrom(root_elem, AttributeChange::Default);
-            }
-            else
-            {
-                foreach(IAttribute *attr, comp->Attributes())
-                    if (attr)
-                        foreach(const AttributeDesc &a, c.attributes)
-                            if (attr->TypeName() == a.typeName && attr->Name() == a.name)
-                                attr->FromString(a.value, AttributeChange::Disconnected); // Trigger no signal yet when scene is in incoherent state
-            }
-        }
-
-        entity->SetTemporary(e.temporary);
-        entities.append(entity.get());
-
-        // Create child entities recursively
-        foreach(const EntityDesc &ce, e.children)
-            CreateEntityFromDesc(entity, ce, useEntityIDsFromFile, change, entities, oldToNewIds);
-    }
+    // All entities & components have been loaded. Trigger change for them now.
+    return EmitContentCreated(entities, oldToNewIds, useEntityIDsFromFile, change);
 }
 
 SceneDesc Scene::CreateSceneDescFromXml(const QString &filename) const
@@ -1285,8 +1987,11 @@ SceneDesc Scene::CreateSceneDescFromBinary(const QString &filename) const
         return sceneDesc;
     }
 
-    QByteArray bytes = file.readAll();
-    file.close();
+    QByteArray bytes;
+    qint64 numBytes = 0;
+    const char *data = MapBinarySceneFile(file, bytes, numBytes);
+    if (data && bytes.isEmpty())
+        bytes = QByteArray::fromRawData(data, (int)numBytes); // Refers to the mapped file, which stays open until we return.
 
     return CreateSceneDescFromBinary(bytes, sceneDesc);
 }
@@ -1300,6 +2005,30 @@ SceneDesc Scene::CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDes
         return sceneDesc;
     }
 
+    if (IsVersionedBinaryScene(bytes.constData(), bytes.size()))
+    {
+        BinarySceneHeader header;
+        if (!ReadBinarySceneHeader(bytes.constData(), bytes.size(), header))
+        {
+            LogError("File " + sceneDesc.filename + " has an invalid binary scene header.");
+            return SceneDesc();
+        }
+
+        for(size_t i = 0; i < header.chunkOffsets.size(); ++i)
+        {
+            try
+            {
+                DataDeserializer source(bytes.constData() + header.chunkOffsets[i], header.ChunkSize(i));
+                CreateEntityDescFromBinary(sceneDesc, sceneDesc.entities, source, header.strings);
+            }
+            catch(...)
+            {
+                LogError("Failed to read entity chunk " + QString::number(i) + " of " + sceneDesc.filename + ".");
+            }
+        }
+        return sceneDesc;
+    }
+
     try
     {
         DataDeserializer source(bytes.data(), bytes.size());
@@ -1316,11 +2045,10 @@ SceneDesc Scene::CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDes
             {
                 SceneAPI *sceneAPI = framework_->Scene();
 
-                ComponentDesc compDesc;
-                compDesc.typeId = source.Read<u32>(); /**< @todo VLE this! */
-                compDesc.typeName = sceneAPI->ComponentTypeNameForTypeId(compDesc.typeId);
-                compDesc.name = QString::fromStdString(source.ReadString());
-                compDesc.sync = source.Read<u8>() ? true : false;
+                u32 typeId = source.Read<u32>(); /**< @todo VLE this! */
+                QString typeName = sceneAPI->ComponentTypeNameForTypeId(typeId);
+                QString name = QString::fromStdString(source.ReadString());
+                bool sync = source.Read<u8>() ? true : false;
                 uint data_size = source.Read<u32>();
 
                 // Read the component data into a separate byte array, then deserialize from there.
@@ -1332,7 +2060,7 @@ SceneDesc Scene::CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDes
 
                 try
                 {
-                    ComponentPtr comp = sceneAPI->CreateComponentById(0, compDesc.typeId, compDesc.name);
+                    ComponentPtr comp = sceneAPI->CreateComponentById(0, typeId, name);
                     if (comp)
                     {
                         if (data_size)
@@ -1340,47 +2068,15 @@ SceneDesc Scene::CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDes
                             DataDeserializer comp_source(comp_bytes.data(), comp_bytes.size());
                             // Trigger no signal yet when scene is in incoherent state
                             comp->DeserializeFromBinary(comp_source, AttributeChange::Disconnected);
-                            foreach(IAttribute *a, comp->Attributes())
-                            {
-                                if (!a)
-                                    continue;
-                                
-                                QString typeName = a->TypeName();
-                                AttributeDesc attrDesc = { typeName, a->Name(), a->ToString(), a->Id() };
-                                compDesc.attributes.append(attrDesc);
-
-                                QString attrValue = a->ToString();
-                                if ((typeName.compare("AssetReference", Qt::CaseInsensitive) == 0 || typeName.compare("AssetReferenceList", Qt::CaseInsensitive) == 0 || 
-                                    (a->Metadata() && a->Metadata()->elementType.compare("AssetReference", Qt::CaseInsensitive) == 0)) &&
-                                    !attrValue.isEmpty())
-                                {
-                                    // We might have multiple references, ";" used as a separator.
-                                    QStringList values = attrValue.split(";");
-                                    foreach(QString value, values)
-                                    {
-                                        AssetDesc ad;
-                                        ad.typeName = a->Name();
-                                        ad.dataInMemory = false;
-
-                                        // Rewrite source refs for asset descs, if necessary.
-                                        QString basePath = QFileInfo(sceneDesc.filename).dir().path();
-                                        framework_->Asset()->ResolveLocalAssetPath(value, basePath, ad.source);
-                                        ad.destinationName = AssetAPI::ExtractFilenameFromAssetRef(ad.source);
-
-                                        sceneDesc.assets[qMakePair(ad.source, ad.subname)] = ad;
-                                    }
-                                }
-                            }
                         }
-
-                        entityDesc.components.append(compDesc);
+                        CreateComponentDesc(sceneDesc, entityDesc, comp.get(), sync);
                     }
                     else
-                        LogError("Failed to load component " + compDesc.typeName);
+                        LogError("Failed to load component " + typeName);
                 }
                 catch(...)
                 {
-                    LogError("Failed to load component " + compDesc.typeName);
+                    LogError("Failed to load component " + typeName);
                 }
             }
 
@@ -1396,6 +2092,105 @@ SceneDesc Scene::CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDes
     return sceneDesc;
 }
 
+void Scene::CreateEntityDescFromBinary(SceneDesc& sceneDesc, QList<EntityDesc>& dest, kNet::DataDeserializer& source, const QStringList& strings) const
+{
+    EntityDesc entityDesc;
+    const entity_id_t id = source.Read<u32>();
+    const u8 flags = source.Read<u8>();
+    entityDesc.id = QString::number((int)id);
+    entityDesc.local = (flags & cBinaryReplicated) == 0;
+    entityDesc.temporary = (flags & cBinaryTemporary) != 0;
+
+    SceneAPI *sceneAPI = framework_->Scene();
+    const u32 numComponents = source.ReadVLE<VLE8_16_32>();
+    for(u32 i = 0; i < numComponents; ++i)
+    {
+        const QString typeName = strings.value(source.ReadVLE<VLE8_16_32>());
+        const u32 typeId = source.ReadVLE<VLE8_16_32>();
+        const QString name = strings.value(source.ReadVLE<VLE8_16_32>());
+        const u8 compFlags = source.Read<u8>();
+        const u32 dataSize = source.Read<u32>();
+        const char *compData = source.CurrentData();
+        source.SkipBytes(dataSize);
+
+        try
+        {
+            ComponentPtr comp = (!typeName.isEmpty() ? sceneAPI->CreateComponentByName(0, typeName, name) :
+                sceneAPI->CreateComponentById(0, typeId, name));
+            if (comp)
+            {
+                DataDeserializer comp_source(compData, dataSize);
+                ReadBinaryAttributes(comp.get(), comp_source, strings);
+
+                // A bit of a hack to get the name from EC_Name.
+                if (entityDesc.name.isEmpty() && comp->TypeId() == EC_Name::ComponentTypeId)
+                {
+                    EC_Name *ecName = checked_static_cast<EC_Name*>(comp.get());
+                    entityDesc.name = ecName->name.Get();
+                    entityDesc.group = ecName->group.Get();
+                }
+
+                CreateComponentDesc(sceneDesc, entityDesc, comp.get(), (compFlags & cBinaryReplicated) != 0);
+            }
+            else
+                LogError("Failed to load component " + typeName);
+        }
+        catch(...)
+        {
+            LogError("Failed to load component " + typeName);
+        }
+    }
+
+    const u32 numChildren = source.ReadVLE<VLE8_16_32>();
+    for(u32 i = 0; i < numChildren; ++i)
+        CreateEntityDescFromBinary(sceneDesc, entityDesc.children, source, strings);
+
+    dest.append(entityDesc);
+}
+
+void Scene::CreateComponentDesc(SceneDesc& sceneDesc, EntityDesc& entityDesc, IComponent* comp, bool sync) const
+{
+    ComponentDesc compDesc;
+    compDesc.typeId = comp->TypeId();
+    compDesc.typeName = comp->TypeName();
+    compDesc.name = comp->Name();
+    compDesc.sync = sync;
+
+    foreach(IAttribute *a, comp->Attributes())
+    {
+        if (!a)
+            continue;
+        
+        QString typeName = a->TypeName();
+        AttributeDesc attrDesc = { typeName, a->Name(), a->ToString(), a->Id() };
+        compDesc.attributes.append(attrDesc);
+
+        QString attrValue = a->ToString();
+        if ((typeName.compare("AssetReference", Qt::CaseInsensitive) == 0 || typeName.compare("AssetReferenceList", Qt::CaseInsensitive) == 0 || 
+            (a->Metadata() && a->Metadata()->elementType.compare("AssetReference", Qt::CaseInsensitive) == 0)) &&
+            !attrValue.isEmpty())
+        {
+            // We might have multiple references, ";" used as a separator.
+            QStringList values = attrValue.split(";");
+            foreach(QString value, values)
+            {
+                AssetDesc ad;
+                ad.typeName = a->Name();
+                ad.dataInMemory = false;
+
+                // Rewrite source refs for asset descs, if necessary.
+                QString basePath = QFileInfo(sceneDesc.filename).dir().path();
+                framework_->Asset()->ResolveLocalAssetPath(value, basePath, ad.source);
+                ad.destinationName = AssetAPI::ExtractFilenameFromAssetRef(ad.source);
+
+                sceneDesc.assets[qMakePair(ad.source, ad.subname)] = ad;
+            }
+        }
+    }
+
+    entityDesc.components.append(compDesc);
+}
+
 QByteArray Scene::GetEntityXml(Entity *entity) const
 {
     LogWarning("Scene::GetEntityXml: this function is deprecated and will be removed. Use Entity::SerializeToXMLString instead.");
@@ -1435,50 +2230,183 @@ bool Scene::StartAttributeInterpolation(IAttribute* attr, IAttribute* endvalue,
     if (!endvalue)
         return false;
     
-    IComponent* comp = attr ? attr->Owner() : 0;
-    Entity* entity = comp ? comp->ParentEntity() : 0;
-    Scene* scene = entity ? entity->ParentScene() : 0;
+    // float3, Quat and Transform endpoints are stored by value, so the end value attribute is not needed further.
+    const u32 typeId = attr ? attr->TypeId() : 0;
+    if (typeId == cAttributeFloat3 || typeId == cAttributeQuat || typeId == cAttributeTransform)
+    {
+        bool success = endvalue->TypeId() == typeId && StartTypedAttributeInterpolation(attr, *endvalue, length);
+        delete endvalue;
+        return success;
+    }
     
-    if (length <= 0.0f || !attr || !attr->Metadata() || attr->Metadata()->interpolation == AttributeMetadata::None ||
-        !comp || !entity || !scene || scene != this)
+    if (!CanInterpolateAttribute(attr, length))
     {
         delete endvalue;
         return false;
     }
     
-    // End previous interpolation if existed
-    bool previous = EndAttributeInterpolation(attr);
-    
     // If previous interpolation does not exist, perform a direct snapping to the end value
     // but still start an interpolation period, so that on the next update we detect that an interpolation is going on,
     // and will interpolate normally
-    if (!previous)
+    if (!FindAttributeInterpolation(attr))
         attr->CopyValue(endvalue, AttributeChange::LocalOnly);
     
-    AttributeInterpolation newInterp;
-    newInterp.dest = AttributeWeakPtr(comp->shared_from_this(), attr);
-    newInterp.start = AttributeWeakPtr(comp->shared_from_this(), attr->Clone());
-    newInterp.end = AttributeWeakPtr(comp->shared_from_this(), endvalue);
-    newInterp.length = length;
+    // Restart a previous interpolation from the current value, reusing its start value attribute.
+    AttributeInterpolation &interp = AttributeInterpolationSlot(attr, length);
+    if (interp.start)
+        interp.start->CopyValue(attr, AttributeChange::Disconnected);
+    else
+        interp.start = attr->Clone();
+    delete interp.end;
+    interp.end = endvalue;
+    return true;
+}
+
+bool Scene::StartAttributeInterpolation(IAttribute& attr, kNet::DataDeserializer& source, float length)
+{
+    switch(attr.TypeId())
+    {
+    case cAttributeFloat3:
+    {
+        Attribute<float3> endValue(0, "");
+        endValue.FromBinary(source, AttributeChange::Disconnected);
+        return StartTypedAttributeInterpolation(&attr, endValue, length);
+    }
+    case cAttributeQuat:
+    {
+        Attribute<Quat> endValue(0, "");
+        endValue.FromBinary(source, AttributeChange::Disconnected);
+        return StartTypedAttributeInterpolation(&attr, endValue, length);
+    }
+    case cAttributeTransform:
+    {
+        Attribute<Transform> endValue(0, "");
+        endValue.FromBinary(source, AttributeChange::Disconnected);
+        return StartTypedAttributeInterpolation(&attr, endValue, length);
+    }
+    default:
+    {
+        IAttribute* endValue = attr.Clone();
+        endValue->FromBinary(source, AttributeChange::Disconnected);
+        return StartAttributeInterpolation(&attr, endValue, length);
+    }
+    }
+}
+
+bool Scene::StartTypedAttributeInterpolation(IAttribute* attr, IAttribute& end, float length)
+{
+    if (!CanInterpolateAttribute(attr, length))
+        return false;
+    
+    // Snap to the end value if no previous interpolation exists, see above. This emits the change signals, so it is done
+    // before taking a reference to the interpolation.
+    if (!FindAttributeInterpolation(attr))
+        attr->CopyValue(&end, AttributeChange::LocalOnly);
     
-    interpolations_.push_back(newInterp);
+    AttributeInterpolation &interp = AttributeInterpolationSlot(attr, length);
+    switch(interp.typeId)
+    {
+    case cAttributeFloat3:
+        interp.startTransform.pos = static_cast<Attribute<float3>*>(attr)->Get();
+        interp.endTransform.pos = static_cast<Attribute<float3>&>(end).Get();
+        break;
+    case cAttributeQuat:
+        interp.startRot = static_cast<Attribute<Quat>*>(attr)->Get();
+        interp.endRot = static_cast<Attribute<Quat>&>(end).Get();
+        break;
+    case cAttributeTransform:
+        interp.startTransform = static_cast<Attribute<Transform>*>(attr)->Get();
+        interp.endTransform = static_cast<Attribute<Transform>&>(end).Get();
+        // Convert the orientations once here instead of on every update.
+        interp.startRot = interp.startTransform.Orientation();
+        interp.endRot = interp.endTransform.Orientation();
+        break;
+    }
     return true;
 }
 
-bool Scene::EndAttributeInterpolation(IAttribute* attr)
+bool Scene::CanInterpolateAttribute(IAttribute* attr, float length) const
 {
-    for(uint i = 0; i < interpolations_.size(); ++i)
+    IComponent* comp = attr ? attr->Owner() : 0;
+    Entity* entity = comp ? comp->ParentEntity() : 0;
+    Scene* scene = entity ? entity->ParentScene() : 0;
+    
+    return length > 0.0f && attr && attr->Metadata() && attr->Metadata()->interpolation != AttributeMetadata::None &&
+        comp && entity && scene == this;
+}
+
+Scene::AttributeInterpolation *Scene::FindAttributeInterpolation(IAttribute* attr)
+{
+    QHash<IAttribute*, size_t>::const_iterator iter = interpolationIndices_.find(attr);
+    if (iter == interpolationIndices_.end())
+        return 0;
+    
+    const size_t index = iter.value();
+    if (interpolations_[index].dest.Expired())
     {
-        AttributeInterpolation& interp = interpolations_[i];
-        if (interp.dest.Get() == attr)
-        {
-            delete interp.start.Get();
-            delete interp.end.Get();
-            interpolations_.erase(interpolations_.begin() + i);
-            return true;
-        }
+        // The component of the interpolated attribute has been deleted, and the attribute pointer has been reused since.
+        RemoveAttributeInterpolation(index);
+        return 0;
     }
-    return false;
+    return &interpolations_[index];
+}
+
+Scene::AttributeInterpolation &Scene::AttributeInterpolationSlot(IAttribute* attr, float length)
+{
+    AttributeInterpolation* interp = FindAttributeInterpolation(attr);
+    if (!interp)
+    {
+        interpolationIndices_[attr] = interpolations_.size();
+        interpolations_.push_back(AttributeInterpolation());
+        interp = &interpolations_.back();
+        interp->dest = AttributeWeakPtr(attr->Owner()->shared_from_this(), attr);
+        interp->typeId = attr->TypeId();
+    }
+    interp->time = 0.0f;
+    interp->length = length;
+    return *interp;
+}
+
+void Scene::RemoveAttributeInterpolation(size_t index)
+{
+    if (interpolating_)
+    {
+        // Called from a change signal handler during UpdateAttributeInterpolations. Moving the last interpolation in place now could
+        // move it to a slot the update has already passed, so that it would skip a frame. Only detach the slot from its attribute
+        // instead, and let the update erase it as expired.
+        AttributeInterpolation& interp = interpolations_[index];
+        interpolationIndices_.remove(interp.dest.attribute);
+        interp.dest = AttributeWeakPtr();
+        return;
+    }
+    EraseAttributeInterpolation(index);
+}
+
+void Scene::EraseAttributeInterpolation(size_t index)
+{
+    AttributeInterpolation& interp = interpolations_[index];
+    delete interp.start;
+    delete interp.end;
+    if (interp.dest.attribute)
+        interpolationIndices_.remove(interp.dest.attribute);
+    
+    if (index + 1 < interpolations_.size())
+    {
+        interp = interpolations_.back();
+        if (interp.dest.attribute) // Detached interpolations are no longer indexed.
+            interpolationIndices_[interp.dest.attribute] = index;
+    }
+    interpolations_.pop_back();
+}
+
+bool Scene::EndAttributeInterpolation(IAttribute* attr)
+{
+    QHash<IAttribute*, size_t>::const_iterator iter = interpolationIndices_.find(attr);
+    if (iter == interpolationIndices_.end())
+        return false;
+    
+    RemoveAttributeInterpolation(iter.value());
+    return true;
 }
 
 void Scene::EndAllAttributeInterpolations()
@@ -1486,11 +2414,12 @@ void Scene::EndAllAttributeInterpolations()
     for(uint i = 0; i < interpolations_.size(); ++i)
     {
         AttributeInterpolation& interp = interpolations_[i];
-        delete interp.start.Get();
-        delete interp.end.Get();
+        delete interp.start;
+        delete interp.end;
     }
     
     interpolations_.clear();
+    interpolationIndices_.clear();
 }
 
 void Scene::UpdateAttributeInterpolations(float frametime)
@@ -1499,40 +2428,58 @@ void Scene::UpdateAttributeInterpolations(float frametime)
     
     interpolating_ = true;
     
-    for(size_t i = interpolations_.size() - 1; i < interpolations_.size(); --i)
+    // Update all interpolations in one pass. Finished interpolations are erased by moving the last one in their place,
+    // which is then processed next. Setting a value emits the change signals, whose handlers may start or end
+    // interpolations, so the interpolation is not accessed after its value has been set. The interpolations ended by
+    // the handlers are only detached meanwhile, see RemoveAttributeInterpolation, so no interpolation is moved behind i.
+    for(size_t i = 0; i < interpolations_.size();)
     {
         AttributeInterpolation& interp = interpolations_[i];
-        bool finished = false;
         
-        // Check that the component still exists i.e. it's safe to access the attribute
-        if (!interp.start.owner.expired())
+        // Check that the component still exists i.e. it's safe to access the attribute, abort the interpolation if not
+        if (interp.dest.Expired())
         {
-            // Allow the interpolation to persist for 2x time, though we are no longer setting the value
-            // This is for the continuous/discontinuous update detection in StartAttributeInterpolation()
-            if (interp.time <= interp.length)
-            {
-                interp.time += frametime;
-                float t = interp.time / interp.length;
-                if (t > 1.0f)
-                    t = 1.0f;
-                interp.dest.Get()->Interpolate(interp.start.Get(), interp.end.Get(), t, AttributeChange::LocalOnly);
-            }
+            EraseAttributeInterpolation(i);
+            continue;
+        }
+        
+        // Allow the interpolation to persist for 2x time, though we are no longer setting the value
+        // This is for the continuous/discontinuous update detection in StartAttributeInterpolation()
+        if (interp.time > interp.length)
+        {
+            interp.time += frametime;
+            if (interp.time >= interp.length * 2.0f)
+                EraseAttributeInterpolation(i);
             else
-            {
-                interp.time += frametime;
-                if (interp.time >= interp.length * 2.0f)
-                    finished = true;
-            }
+                ++i;
+            continue;
         }
-        else // Component pointer has expired, abort this interpolation
-            finished = true;
         
-        // Remove interpolation (& delete start/endpoints) when done
-        if (finished)
+        interp.time += frametime;
+        const float t = std::min(interp.time / interp.length, 1.0f);
+        IAttribute* dest = interp.dest.attribute;
+        ++i;
+        
+        switch(interp.typeId)
+        {
+        case cAttributeFloat3:
+            static_cast<Attribute<float3>*>(dest)->Set(Lerp(interp.startTransform.pos, interp.endTransform.pos, t), AttributeChange::LocalOnly);
+            break;
+        case cAttributeQuat:
+            static_cast<Attribute<Quat>*>(dest)->Set(Slerp(interp.startRot, interp.endRot, t), AttributeChange::LocalOnly);
+            break;
+        case cAttributeTransform:
         {
-            delete interp.start.Get();
-            delete interp.end.Get();
-            interpolations_.erase(interpolations_.begin() + i);
+            Transform value;
+            value.pos = Lerp(interp.startTransform.pos, interp.endTransform.pos, t);
+            value.SetOrientation(Slerp(interp.startRot, interp.endRot, t));
+            value.scale = Lerp(interp.startTransform.scale, interp.endTransform.scale, t);
+            static_cast<Attribute<Transform>*>(dest)->Set(value, AttributeChange::LocalOnly);
+            break;
+        }
+        default:
+            dest->Interpolate(interp.start, interp.end, t, AttributeChange::LocalOnly);
+            break;
         }
     }
 
@@ -1558,6 +2505,9 @@ void Scene::OnUpdated(float /*frameTime*/)
     }
     
     entitiesCreatedThisFrame_.clear();
+
+    if (incrementalLoad_ && !incrementalLoad_->collecting)
+        ProcessIncrementalLoad();
 }
 
 EntityList Scene::FindEntities(const QString &pattern) const
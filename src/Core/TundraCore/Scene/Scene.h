@@ -9,11 +9,14 @@
 #include "EntityAction.h"
 #include "UniqueIdGenerator.h"
 #include "Math/float3.h"
+#include "Math/Quat.h"
+#include "Transform.h"
 #include "SceneDesc.h"
 #include "Entity.h"
 
 #include <QObject>
 #include <QVariant>
+#include <QHash>
 
 #include <map>
 
@@ -22,6 +25,12 @@ class Framework;
 /// Maybe have some kind of UserConnection interface class defined in Framework and use that instead.
 class UserConnection;
 class QDomDocument;
+class QXmlStreamReader;
+class QThreadPool;
+struct ParsedEntity;
+struct ParsedComponent;
+struct EntityParseItem;
+struct IncrementalSceneLoad;
 
 /// A collection of entities which form an observable world.
 /** Acts as a factory for all entities.
@@ -91,6 +100,16 @@ public:
                 must be static-structured, component must be in an entity which is in a scene, scene must be us) */
     bool StartAttributeInterpolation(IAttribute* attr, IAttribute* endvalue, float length);
 
+    /// Starts an attribute interpolation, reading the endpoint value from binary data.
+    /** Does not allocate an endpoint attribute for float3, Quat and Transform attributes. The value is read even if the
+        interpolation cannot be started, so that the data that follows can still be read. The attribute is taken by reference,
+        since the type of the value, and so its size in the data, is only known from the attribute.
+        @param attr Attribute inside a static-structured component.
+        @param source Binary data in the format written by IAttribute::ToBinary.
+        @param length Time length
+        @return true if successful. See the overload above for the requirements. */
+    bool StartAttributeInterpolation(IAttribute& attr, kNet::DataDeserializer& source, float length);
+
     /// Ends an attribute interpolation. The last set value will remain.
     /** @param attr Attribute inside a static-structured component.
         @return true if an interpolation existed */
@@ -118,12 +137,25 @@ public:
     SceneDesc CreateSceneDescFromXml(QByteArray &data, SceneDesc &sceneDesc) const;
 
     /// Inspects file and returns a scene description structure from the contents of binary file.
-    /** @param filename File name. */
+    /** Both the versioned and the earlier unversioned binary scene format are supported.
+        @param filename File name. */
     SceneDesc CreateSceneDescFromBinary(const QString &filename) const;
     /// @overload
     /** @param data Binary data to be processed. */
     SceneDesc CreateSceneDescFromBinary(QByteArray &data, SceneDesc &sceneDesc) const;
 
+    /// Serializes the given entities and their children in the binary scene format.
+    /** @param entities Root entities to serialize.
+        @param serializeTemporary Are temporary child entities and components wanted to be included. */
+    QByteArray SerializeToBinary(const EntityList &entities, bool serializeTemporary) const;
+
+    /// Copies the scene content to a snapshot, which can be serialized outside the main thread while the scene keeps changing.
+    /** The snapshot holds the values at the time of the call, so call this between frames rather than in the middle of
+        an operation that changes several attributes.
+        @param serializeTemporary Are temporary entities wanted to be included.
+        @param serializeLocal Are local entities wanted to be included. */
+    SceneSnapshotPtr CreateSnapshot(bool serializeTemporary, bool serializeLocal) const;
+
     /// Inspects .js file content for dependencies and adds them to sceneDesc.assets
     ///@todo This function is a duplicate copy of void ScriptAsset::ParseReferences(). Delete this code. -jj.
     /** @param filePath. Path to the file that is opened for inspection.
@@ -345,7 +377,9 @@ public slots:
     EntityList RootLevelEntities() const;
 
     /// Loads the scene from XML.
-    /** @param filename File name
+    /** The file is parsed incrementally, and the entities are created as they are read, so the whole document is never held in memory.
+        If the file is malformed after the scene element has been found, the entities read before the error are still created.
+        @param filename File name
         @param clearScene Do we want to clear the existing scene.
         @param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file. 
                   If the scene contains any previous entities with conflicting IDs, those are removed. If false, the entity IDs from the files are ignored,
@@ -360,6 +394,11 @@ public slots:
         @return The scene XML as a byte array string. */
     QByteArray SerializeToXmlString(bool serializeTemporary, bool serializeLocal) const;
 
+    /// Returns scene content in the binary scene format.
+    /** @param serializeTemporary Are temporary entities wanted to be included.
+        @param serializeLocal Are local entities wanted to be included. */
+    QByteArray SerializeToBinary(bool serializeTemporary, bool serializeLocal) const;
+
     /// Saves the scene to XML.
     /** @param filename File name
         @param saveTemporary Are temporary entities wanted to be included.
@@ -367,8 +406,19 @@ public slots:
         @return true if successful */
     bool SaveSceneXML(const QString& filename, bool saveTemporary, bool saveLocal);
 
+    /// Saves the scene to a file on a background thread.
+    /** The scene is copied to a snapshot right away, and serialized and written while the simulation continues. Saves as
+        binary if the file name ends in ".tbin", otherwise as XML. The file is replaced only once the new one has been
+        written completely. Background saves are done one at a time, in the order they were requested.
+        BackgroundSaveFinished is emitted when the save is done.
+        @param filename File name
+        @param saveTemporary Are temporary entities wanted to be included.
+        @param saveLocal Are local entities wanted to be included. */
+    void SaveSceneInBackground(const QString& filename, bool saveTemporary, bool saveLocal);
+
     /// Loads the scene from a binary file.
-    /** @param filename File name
+    /** The file is memory-mapped for loading. Both the versioned and the earlier unversioned binary scene format are supported.
+        @param filename File name
         @param clearScene Do we want to clear the existing scene.
         @param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file. 
                   If the scene contains any previous entities with conflicting IDs, those are removed. If false, the entity IDs from the files are ignored,
@@ -377,15 +427,47 @@ public slots:
         @return List of created entities. */
     QList<Entity *> LoadSceneBinary(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change);
 
+    /// Loads a scene file over several frames, instead of creating all of its entities at once.
+    /** The file is read right away, but the entities are created and signalled on the following frame updates, a few root-level
+        entities at a time, so that the components they create do not block the application for the whole load.
+        IncrementalLoadProgress is emitted after each frame's share, and IncrementalLoadFinished once all entities have been created.
+        Starting a new incremental load or clearing the scene cancels the one in progress.
+        @param filename File name, either .txml or .tbin.
+        @param clearScene Do we want to clear the existing scene.
+        @param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file.
+                  If false, new IDs are reserved for the entities when the load starts.
+        @param change Change type that will be used, when removing the old scene, and deserializing the new
+        @param maxEntitiesPerFrame Number of entities, including child entities, after which no more root-level entities
+                  are created on the frame. 0 for no limit.
+        @param maxMillisecondsPerFrame Time after which no more root-level entities are created on the frame. 0 for no limit.
+        @return False if the file could not be read, or contained no entities.
+        @sa SetIncrementalLoadFocus */
+    bool LoadSceneIncrementally(const QString& filename, bool clearScene, bool useEntityIDsFromFile, AttributeChange::Type change,
+        int maxEntitiesPerFrame = 100, float maxMillisecondsPerFrame = 10.f);
+
+    /// Orders the entities of the incremental load in progress that have not been created yet by their distance to a position.
+    /** The distance is that of the root-level entity's placeable position. Entities without a placeable are created first.
+        Re-sorts the remaining entities, so call again only when the position has moved considerably. */
+    void SetIncrementalLoadFocus(const float3 &position);
+
+    /// Returns whether an incremental load is in progress.
+    bool IsLoadingIncrementally() const { return incrementalLoad_.get() != 0; }
+
+    /// Cancels the incremental load in progress, if any. The entities created so far are left in the scene.
+    void CancelIncrementalLoad();
+
     /// Save the scene to binary
-    /** @param filename File name
+    /** The scene is written to the file one root-level entity at a time, so its size is not limited by a preallocated buffer.
+        The data is written to a temporary file that replaces the given file when complete, so a failed save leaves the old file intact.
+        @param filename File name
         @param saveTemporary Are temporary entities wanted to be included.
         @param saveLocal Are local entities wanted to be included.
         @return true if successful */
     bool SaveSceneBinary(const QString& filename, bool saveTemporary, bool saveLocal) const;
 
     /// Creates scene content from XML.
-    /** @param xml XML document as string.
+    /** The string is parsed incrementally like in LoadSceneXML.
+        @param xml XML document as string.
         @param useEntityIDsFromFile If true, the created entities will use the Entity IDs from the original file.
                   If the scene contains any previous entities with conflicting IDs, those are removed. If false, the entity IDs from the files are ignored,
                   and new IDs are generated for the created entities.
@@ -495,6 +577,17 @@ signals:
     /// An entity's parent has changed.
     void EntityParentChanged(Entity* entity, Entity* newParent, AttributeChange::Type change);
 
+    /// Emitted after each frame's share of the entities of an incremental load has been created.
+    /** @param numCreated Number of entities created so far, including child entities.
+        @param numTotal Number of entities in the load, including child entities. */
+    void IncrementalLoadProgress(int numCreated, int numTotal);
+
+    /// Emitted when all entities of an incremental load have been created. Not emitted if the load is cancelled.
+    void IncrementalLoadFinished();
+
+    /// Emitted when a save started with SaveSceneInBackground is done.
+    void BackgroundSaveFinished(const QString &filename, bool success);
+
 private slots:
     /// Handle frame update. Signal this frame's entity creations.
     void OnUpdated(float frameTime);
@@ -504,22 +597,59 @@ private:
 
     /// Create entity from an XML element and recurse into child entities. Called internally.
     void CreateEntityFromXml(EntityPtr parent, const QDomElement& ent_elem, bool useEntityIDsFromFile, AttributeChange::Type change, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds);
+    /// Creates an entity with the given ID from a scene file, resolving conflicts with the existing entities. Called internally.
+    EntityPtr CreateEntityWithFileId(EntityPtr parent, entity_id_t id, bool replicated, bool useEntityIDsFromFile, QHash<entity_id_t, entity_id_t>& oldToNewIds);
+    /// Create component from an XML element to the given entity, without signalling the change. Called internally.
+    void CreateComponentFromXml(Entity* entity, QDomElement& comp_elem);
+    /// Parses the root-level entities on worker threads, then creates them in their original order and clears the list.
+    /** When an incremental load is being read, collects the parsed entities to it instead. Called internally. */
+    void CreateEntitiesFromParseItems(std::vector<EntityParseItem>& items, bool useEntityIDsFromFile, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds);
+    /// Create entity from a parsed entity and recurse into child entities. Called internally.
+    void CreateEntityFromParsed(EntityPtr parent, ParsedEntity& parsed, bool useEntityIDsFromFile, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds);
+    /// Create component from a parsed component to the given entity, without signalling the change. Called internally.
+    void CreateComponentFromParsed(Entity* entity, ParsedComponent& parsed);
+    /// Creates the current frame's share of the entities of the incremental load in progress. Called internally.
+    void ProcessIncrementalLoad();
+    /// Creates scene content from the scene element the XML stream is at, parsing the entities in batches as they are read. Called internally.
+    QList<Entity *> CreateContentFromXml(QXmlStreamReader& reader, bool useEntityIDsFromFile, AttributeChange::Type change);
+    /// Emits the creation signals for the entities created from a scene file, and fixes their parent refs. Returns the entities that still exist afterwards. Called internally.
+    QList<Entity *> EmitContentCreated(const std::vector<EntityWeakPtr>& entities, const QHash<entity_id_t, entity_id_t>& oldToNewIds, bool useEntityIDsFromFile, AttributeChange::Type change);
     /// Create entity from binary data and recurse into child entities. Called internally.
     void CreateEntityFromBinary(EntityPtr parent, kNet::DataDeserializer& source, bool useEntityIDsFromFile, AttributeChange::Type change, std::vector<EntityWeakPtr>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds);
-    /// Create entity from entity desc and recurse into child entities. Called internally.
-    void CreateEntityFromDesc(EntityPtr parent, const EntityDesc& source, bool useEntityIDsFromFile, AttributeChange::Type change, QList<Entity *>& entities, QHash<entity_id_t, entity_id_t>& oldToNewIds);
+    /// Create entity desc from an entity chunk of the versioned binary format and recurse into child entities. Called internally.
+    void CreateEntityDescFromBinary(SceneDesc& sceneDesc, QList<EntityDesc>& dest, kNet::DataDeserializer& source, const QStringList& strings) const;
+    /// Create component desc from a deserialized component and append it to the entity desc, adding the assets it refers to to the scene desc. Called internally.
+    void CreateComponentDesc(SceneDesc& sceneDesc, EntityDesc& entityDesc, IComponent* comp, bool sync) const;
     /// Create entity desc from an XML element and recurse into child entities. Called internally.
     void CreateEntityDescFromXml(SceneDesc& sceneDesc, QList<EntityDesc>& dest, const QDomElement& ent_elem) const;
 
     /// Container for an ongoing attribute interpolation
+    /** float3, Quat and Transform attributes store their endpoints by value. Other types hold clones of the endpoints. */
     struct AttributeInterpolation
     {
-        AttributeInterpolation() : time(0.0f), length(0.0f) {}
-        AttributeWeakPtr dest, start, end;
+        AttributeInterpolation() : typeId(0), start(0), end(0), time(0.0f), length(0.0f) {}
+        AttributeWeakPtr dest;
+        u32 typeId; ///< Type of the destination attribute, which tells which of the endpoint members are used.
+        Transform startTransform, endTransform; ///< Endpoints of a Transform attribute. The position also holds the endpoints of a float3 attribute.
+        Quat startRot, endRot; ///< Endpoints of a Quat attribute, or the orientations of the Transform endpoints.
+        IAttribute *start, *end; ///< Endpoints of the other types.
         float time;
         float length;
     };
 
+    /// Starts an interpolation of a float3, Quat or Transform attribute. The end attribute must be of the same type. Called internally.
+    bool StartTypedAttributeInterpolation(IAttribute* attr, IAttribute& end, float length);
+    /// Returns whether an interpolation of the attribute can be started. Called internally.
+    bool CanInterpolateAttribute(IAttribute* attr, float length) const;
+    /// Returns the running interpolation of the attribute, or null if none. Called internally.
+    AttributeInterpolation *FindAttributeInterpolation(IAttribute* attr);
+    /// Returns the running interpolation of the attribute, or a new one if none, restarted with the given length. Called internally.
+    AttributeInterpolation &AttributeInterpolationSlot(IAttribute* attr, float length);
+    /// Removes an interpolation. During UpdateAttributeInterpolations only detaches it from its attribute, and the update erases it. Called internally.
+    void RemoveAttributeInterpolation(size_t index);
+    /// Erases an interpolation by moving the last one in its place, and deletes its endpoints. Called internally.
+    void EraseAttributeInterpolation(size_t index);
+
     UniqueIdGenerator idGenerator_; ///< Entity ID generator
     EntityMap entities_; ///< All entities in the scene.
     Framework *framework_; ///< Parent framework.
@@ -527,8 +657,11 @@ private:
     bool viewEnabled_; ///< View enabled -flag.
     bool interpolating_; ///< Currently doing interpolation-flag.
     bool authority_; ///< Authority -flag
-    std::vector<AttributeInterpolation> interpolations_; ///< Running attribute interpolations.
+    std::vector<AttributeInterpolation> interpolations_; ///< Running attribute interpolations, in no particular order.
+    QHash<IAttribute*, size_t> interpolationIndices_; ///< Indices of the running interpolations in interpolations_, by destination attribute.
     std::vector<std::pair<EntityWeakPtr, AttributeChange::Type> > entitiesCreatedThisFrame_; ///< Entities to signal for creation at frame end.
+    shared_ptr<IncrementalSceneLoad> incrementalLoad_; ///< Incremental load in progress, if any.
+    QThreadPool *backgroundSaves_; ///< Runs the saves started with SaveSceneInBackground, one at a time. Created on first use.
 };
 
 #include "Scene.inl"
@@ -18,6 +18,7 @@ class IComponentFactory;
 class IAttribute;
 class AttributeMetadata;
 class ChangeRequest;
+class SceneSnapshot;
 
 struct SceneDesc;
 struct EntityDesc;
@@ -36,3 +37,4 @@ typedef weak_ptr<IComponent> ComponentWeakPtr;
 typedef shared_ptr<IComponentFactory> ComponentFactoryPtr;
 typedef std::vector<IAttribute*> AttributeVector;
 typedef std::map<QString, ScenePtr> SceneMap;
+typedef shared_ptr<SceneSnapshot> SceneSnapshotPtr;
@@ -0,0 +1,653 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneJournal.h"
+#include "Scene/Scene.h"
+#include "SceneSnapshot.h"
+#include "SceneAPI.h"
+#include "Entity.h"
+#include "IComponent.h"
+#include "IAttribute.h"
+#include "AssetReference.h"
+#include "Framework.h"
+#include "FrameAPI.h"
+#include "Profiler.h"
+#include "LoggingFunctions.h"
+
+#include <QFile>
+#include <QRunnable>
+
+#include <kNet/DataDeserializer.h>
+#include <kNet/DataSerializer.h>
+
+#include <algorithm>
+#include <cstring>
+#include "MemoryLeakCheck.h"
+
+using namespace kNet;
+
+namespace
+{
+
+/// Identifies a scene journal file. Reads as "TJNL" at the start of a file.
+const u32 cJournalMagic = 0x4C4E4A54;
+/// Version of the journal format that is written.
+const u32 cJournalVersion = 1;
+/// Size of the journal header: magic, version, and the size and checksum of the snapshot the journal applies to.
+const int cJournalHeaderSize = 4 * sizeof(u32);
+/// Size of the header of a batch of records: the size and checksum of the records.
+const int cJournalBatchHeaderSize = 2 * sizeof(u32);
+
+/// Types of the journal records.
+const u8 cRecordEntity = 1; ///< The whole state of an entity: parent, components and all their attributes.
+const u8 cRecordAttributes = 2; ///< Values of some attributes of an entity.
+const u8 cRecordRemoveEntity = 3; ///< The entity was removed.
+
+/// Initial size of the buffer records are serialized to.
+const int cRecordInitialSize = 16 * 1024;
+/// Largest buffer a record can be serialized to, before giving up.
+const int cRecordMaxSize = 256 * 1024 * 1024;
+
+/// The journal is compacted when it grows larger than the snapshot, but not before it reaches this size.
+const qint64 cMinCompactionSize = 1024 * 1024;
+
+/* Layout of the journal:
+
+   u32 magic, u32 version
+   u32 snapshot size, u32 snapshot checksum
+   batches, one per flush:
+       u32 size, u32 checksum of the records
+       records:
+           u8 type, u32 entity id
+           entity: u32 parent id, VLE number of components, components
+           attributes: VLE number of components, components
+           remove entity: nothing
+
+   component: string type name, string name, u8 replicated, VLE number of attributes, attributes
+   attribute: u8 index, string id, VLE type id, u32 size, value as serialized by IAttribute::ToBinary
+   string: VLE length, UTF-8 data
+
+   The checksums are CRC-16 as computed by qChecksum. */
+
+void WriteUtf8(DataSerializer &dest, const QString &str)
+{
+    const QByteArray utf8 = str.toUtf8();
+    dest.AddVLE<VLE8_16_32>(utf8.size());
+    if (utf8.size())
+        dest.AddArray<u8>((const u8 *)utf8.constData(), utf8.size());
+}
+
+QString ReadUtf8(DataDeserializer &source)
+{
+    const u32 length = source.ReadVLE<VLE8_16_32>();
+    const char *str = source.CurrentData();
+    source.SkipBytes(length);
+    return QString::fromUtf8(str, length);
+}
+
+void WriteAttribute(DataSerializer &dest, char *buffer, const IAttribute &attr)
+{
+    dest.Add<u8>(attr.Index());
+    WriteUtf8(dest, attr.Id());
+    dest.AddVLE<VLE8_16_32>(attr.TypeId());
+    const size_t sizePos = dest.BytesFilled();
+    dest.Add<u32>(0);
+    attr.ToBinary(dest);
+    const u32 size = (u32)(dest.BytesFilled() - sizePos - sizeof(u32));
+    memcpy(buffer + sizePos, &size, sizeof(u32));
+}
+
+void WriteComponentHeader(DataSerializer &dest, const IComponent &comp, u32 numAttributes)
+{
+    WriteUtf8(dest, comp.TypeName());
+    WriteUtf8(dest, comp.Name());
+    dest.Add<u8>(comp.IsReplicated() ? 1 : 0);
+    dest.AddVLE<VLE8_16_32>(numAttributes);
+}
+
+/// Reads a component of a record and applies it to the entity. Returns the component, or null if the entity is null or the component could not be created.
+/** Attributes that the component does not have are skipped, as are values of a different type than the attribute.
+    @param allAttributes True if the record holds all attributes of the component. The dynamic attributes that are not in it are then removed. */
+ComponentPtr ReadComponent(DataDeserializer &source, Entity *entity, bool allAttributes)
+{
+    const QString typeName = ReadUtf8(source);
+    const QString name = ReadUtf8(source);
+    const bool replicated = source.Read<u8>() != 0;
+    ComponentPtr comp = entity ? entity->GetOrCreateComponent(typeName, name, AttributeChange::Default, replicated) : ComponentPtr();
+    if (entity && !comp)
+        LogWarning("SceneJournal: failed to create component \"" + typeName + "\" of entity " + QString::number(entity->Id()) + ".");
+
+    std::set<QString> recordedIds;
+    const u32 numAttributes = source.ReadVLE<VLE8_16_32>();
+    for(u32 i = 0; i < numAttributes; ++i)
+    {
+        const u8 index = source.Read<u8>();
+        const QString id = ReadUtf8(source);
+        const u32 typeId = source.ReadVLE<VLE8_16_32>();
+        const u32 size = source.Read<u32>();
+        const char *valueData = source.CurrentData();
+        source.SkipBytes(size);
+        if (allAttributes)
+            recordedIds.insert(id);
+        if (!comp || typeId == cAttributeNone || typeId >= cNumAttributeTypes)
+            continue;
+
+        IAttribute *attr = comp->AttributeById(id);
+        if (!attr && comp->SupportsDynamicAttributes())
+            attr = comp->CreateAttribute(index, typeId, id, AttributeChange::Default);
+        if (!attr || attr->TypeId() != typeId)
+            continue;
+
+        // Read to a detached attribute first, so that the change is signalled only if the value is read completely.
+        shared_ptr<IAttribute> value(SceneAPI::CreateAttribute(typeId, id));
+        DataDeserializer valueSource(valueData, size);
+        value->FromBinary(valueSource, AttributeChange::Disconnected);
+        if (typeId == cAttributeAssetReferenceList)
+        {
+            // The asset type of the list is set by the component, and not stored in the journal.
+            AssetReferenceList refs = static_cast<Attribute<AssetReferenceList> *>(value.get())->Get();
+            refs.type = static_cast<Attribute<AssetReferenceList> *>(attr)->Get().type;
+            static_cast<Attribute<AssetReferenceList> *>(attr)->Set(refs, AttributeChange::Default);
+        }
+        else
+            attr->CopyValue(value.get(), AttributeChange::Default);
+    }
+
+    // The dynamic attributes that are not in a record of the whole component were removed after it was written.
+    if (comp && allAttributes && comp->SupportsDynamicAttributes())
+    {
+        std::vector<u8> removed;
+        const AttributeVector &attributes = comp->Attributes();
+        for(size_t i = 0; i < attributes.size(); ++i)
+            if (attributes[i] && attributes[i]->IsDynamic() && recordedIds.find(attributes[i]->Id()) == recordedIds.end())
+                removed.push_back(attributes[i]->Index());
+        for(size_t i = 0; i < removed.size(); ++i)
+            comp->RemoveAttribute(removed[i], AttributeChange::Default);
+    }
+    return comp;
+}
+
+/// Appends a batch of records to the journal file.
+class JournalAppendTask : public QRunnable
+{
+public:
+    JournalAppendTask(const QString &filename_, const QByteArray &data_, QAtomicInt *failed_) :
+        filename(filename_), data(data_), failed(failed_)
+    {
+    }
+
+    void run()
+    {
+        QFile file(filename);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(data) != data.size() || !file.flush())
+            failed->fetchAndStoreOrdered(1);
+    }
+
+private:
+    QString filename;
+    QByteArray data;
+    QAtomicInt *failed;
+};
+
+/// Serializes and writes a new snapshot, and starts the journal over.
+class JournalSnapshotTask : public QRunnable
+{
+public:
+    JournalSnapshotTask(const QString &snapshotFilename_, const QString &journalFilename_, const SceneSnapshotPtr &sceneSnapshot_,
+        QAtomicInt *snapshotSize_, QAtomicInt *failed_) :
+        snapshotFilename(snapshotFilename_), journalFilename(journalFilename_), sceneSnapshot(sceneSnapshot_),
+        snapshotSize(snapshotSize_), failed(failed_)
+    {
+    }
+
+    void run()
+    {
+        const QByteArray snapshot = sceneSnapshot->SerializeToBinary();
+        sceneSnapshot.reset();
+        if (snapshot.isEmpty())
+        {
+            failed->fetchAndStoreOrdered(1);
+            return;
+        }
+        snapshotSize->fetchAndStoreOrdered(snapshot.size());
+
+        // Write the snapshot to a temporary file first, so that the previous snapshot stays intact if the write fails.
+        const QString tempFilename = snapshotFilename + ".tmp";
+        QFile file(tempFilename);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(snapshot) != snapshot.size() || !file.flush())
+        {
+            failed->fetchAndStoreOrdered(1);
+            return;
+        }
+        file.close();
+        QFile::remove(snapshotFilename);
+        if (!QFile::rename(tempFilename, snapshotFilename))
+        {
+            failed->fetchAndStoreOrdered(1);
+            return;
+        }
+
+        // Until the journal is started over, its checksum does not match the new snapshot, so it is not replayed over it.
+        char header[cJournalHeaderSize];
+        DataSerializer dest(header, cJournalHeaderSize);
+        dest.Add<u32>(cJournalMagic);
+        dest.Add<u32>(cJournalVersion);
+        dest.Add<u32>((u32)snapshot.size());
+        dest.Add<u32>(qChecksum(snapshot.constData(), snapshot.size()));
+        QFile journal(journalFilename);
+        if (!journal.open(QIODevice::WriteOnly | QIODevice::Truncate) || journal.write(header, cJournalHeaderSize) != cJournalHeaderSize || !journal.flush())
+            failed->fetchAndStoreOrdered(1);
+    }
+
+private:
+    QString snapshotFilename;
+    QString journalFilename;
+    SceneSnapshotPtr sceneSnapshot;
+    QAtomicInt *snapshotSize;
+    QAtomicInt *failed;
+};
+
+}
+
+SceneJournal::SceneJournal(const ScenePtr &scene_, const QString &filename) :
+    scene(scene_),
+    framework(scene_->GetFramework()),
+    snapshotFilename(filename),
+    journalFilename(filename + ".journal"),
+    recording(false),
+    flushInterval(1.f),
+    compactionInterval(600.f),
+    timeSinceFlush(0.f),
+    timeSinceCompaction(0.f),
+    journalSize(0)
+{
+    // A single thread, so that the writes are done in the order they are queued.
+    writer.setMaxThreadCount(1);
+    connect(framework->Frame(), SIGNAL(Updated(float)), this, SLOT(OnUpdated(float)));
+}
+
+SceneJournal::~SceneJournal()
+{
+    if (recording)
+        Flush();
+    writer.waitForDone();
+}
+
+bool SceneJournal::Recover()
+{
+    ScenePtr s = scene.lock();
+    if (!s)
+        return false;
+
+    // The program may have died during compaction, after removing the previous snapshot but before renaming the new one.
+    const QString tempFilename = snapshotFilename + ".tmp";
+    if (!QFile::exists(snapshotFilename) && QFile::exists(tempFilename))
+        QFile::rename(tempFilename, snapshotFilename);
+
+    QFile file(snapshotFilename);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray snapshot = file.readAll();
+    file.close();
+
+    PROFILE(SceneJournal_Recover);
+    s->RemoveAllEntities(true, AttributeChange::Default);
+    QList<Entity *> entities = s->CreateContentFromBinary(snapshot.constData(), snapshot.size(), true, AttributeChange::Default);
+
+    QFile journal(journalFilename);
+    QByteArray data;
+    if (journal.open(QIODevice::ReadOnly))
+        data = journal.readAll();
+
+    int numBatches = 0;
+    if (data.size() >= cJournalHeaderSize)
+    {
+        DataDeserializer header(data.constData(), cJournalHeaderSize);
+        const u32 magic = header.Read<u32>();
+        const u32 version = header.Read<u32>();
+        const u32 size = header.Read<u32>();
+        const u32 checksum = header.Read<u32>();
+        if (magic != cJournalMagic || version != cJournalVersion)
+            LogError("SceneJournal: " + journalFilename + " is not a supported scene journal, ignoring it.");
+        else if (size != (u32)snapshot.size() || checksum != qChecksum(snapshot.constData(), snapshot.size()))
+            LogInfo("SceneJournal: " + journalFilename + " was written before the current snapshot, ignoring it.");
+        else
+        {
+            int pos = cJournalHeaderSize;
+            while(pos + cJournalBatchHeaderSize <= data.size())
+            {
+                DataDeserializer batchHeader(data.constData() + pos, cJournalBatchHeaderSize);
+                const u32 batchSize = batchHeader.Read<u32>();
+                const u32 batchChecksum = batchHeader.Read<u32>();
+                const char *batch = data.constData() + pos + cJournalBatchHeaderSize;
+                if (batchSize > (u32)(data.size() - pos - cJournalBatchHeaderSize) || batchChecksum != qChecksum(batch, batchSize))
+                    break;
+                if (!ReplayBatch(batch, batchSize))
+                    break;
+                pos += cJournalBatchHeaderSize + batchSize;
+                ++numBatches;
+            }
+            if (pos != data.size())
+                LogWarning("SceneJournal: " + journalFilename + " ends in an incomplete write, the changes after it are lost.");
+        }
+    }
+
+    LogInfo("SceneJournal: restored " + QString::number(entities.size()) + " entities from " + snapshotFilename + " and replayed " +
+        QString::number(numBatches) + " batches of changes.");
+    return true;
+}
+
+void SceneJournal::Start()
+{
+    ScenePtr s = scene.lock();
+    if (recording || !s)
+        return;
+
+    Compact();
+    connect(s.get(), SIGNAL(AttributeChanged(IComponent *, IAttribute *, AttributeChange::Type)),
+        SLOT(OnAttributeChanged(IComponent *, IAttribute *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(AttributeAdded(IComponent *, IAttribute *, AttributeChange::Type)),
+        SLOT(OnAttributeAddedOrRemoved(IComponent *, IAttribute *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(AttributeRemoved(IComponent *, IAttribute *, AttributeChange::Type)),
+        SLOT(OnAttributeAddedOrRemoved(IComponent *, IAttribute *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(ComponentAdded(Entity *, IComponent *, AttributeChange::Type)),
+        SLOT(OnComponentAddedOrRemoved(Entity *, IComponent *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(ComponentRemoved(Entity *, IComponent *, AttributeChange::Type)),
+        SLOT(OnComponentAddedOrRemoved(Entity *, IComponent *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(EntityCreated(Entity *, AttributeChange::Type)), SLOT(OnEntityChanged(Entity *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(EntityRemoved(Entity *, AttributeChange::Type)), SLOT(OnEntityChanged(Entity *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(EntityTemporaryStateToggled(Entity *, AttributeChange::Type)), SLOT(OnEntityChanged(Entity *, AttributeChange::Type)));
+    connect(s.get(), SIGNAL(EntityParentChanged(Entity *, Entity *, AttributeChange::Type)),
+        SLOT(OnEntityParentChanged(Entity *, Entity *, AttributeChange::Type)));
+    recording = true;
+}
+
+void SceneJournal::Stop()
+{
+    if (!recording)
+        return;
+
+    Flush();
+    ScenePtr s = scene.lock();
+    if (s)
+        disconnect(s.get(), 0, this, 0);
+    recording = false;
+}
+
+void SceneJournal::Flush()
+{
+    ScenePtr s = scene.lock();
+    if (dirtyOrder.empty() || !s)
+        return;
+
+    PROFILE(SceneJournal_Flush);
+    QByteArray batch(cJournalBatchHeaderSize, 0);
+    for(size_t i = 0; i < dirtyOrder.size(); ++i)
+    {
+        const int size = SerializeRecord(dirtyOrder[i], dirty[dirtyOrder[i]]);
+        if (size > 0)
+            batch.append(&recordBuffer[0], size);
+    }
+    dirty.clear();
+    dirtyOrder.clear();
+    if (batch.size() == cJournalBatchHeaderSize)
+        return;
+
+    DataSerializer header(batch.data(), cJournalBatchHeaderSize);
+    header.Add<u32>((u32)(batch.size() - cJournalBatchHeaderSize));
+    header.Add<u32>(qChecksum(batch.constData() + cJournalBatchHeaderSize, batch.size() - cJournalBatchHeaderSize));
+    writer.start(new JournalAppendTask(journalFilename, batch, &writeFailed));
+    journalSize += batch.size();
+
+    // Once the journal is larger than the snapshot, replaying it costs more than loading a new snapshot would.
+    if (journalSize > std::max((qint64)(int)snapshotSize, cMinCompactionSize))
+        Compact();
+}
+
+void SceneJournal::Compact()
+{
+    ScenePtr s = scene.lock();
+    if (!s)
+        return;
+
+    PROFILE(SceneJournal_Compact);
+    // The snapshot includes the pending changes. It is serialized on the writer thread.
+    dirty.clear();
+    dirtyOrder.clear();
+    writer.start(new JournalSnapshotTask(snapshotFilename, journalFilename, s->CreateSnapshot(false, false), &snapshotSize, &writeFailed));
+    journalSize = cJournalHeaderSize;
+    timeSinceCompaction = 0.f;
+}
+
+void SceneJournal::OnUpdated(float frametime)
+{
+    if (writeFailed.fetchAndStoreOrdered(0))
+        LogError("SceneJournal: failed to write " + journalFilename + " or " + snapshotFilename + ".");
+    if (!recording)
+        return;
+
+    timeSinceFlush += frametime;
+    timeSinceCompaction += frametime;
+    if (timeSinceFlush >= flushInterval)
+    {
+        timeSinceFlush = 0.f;
+        Flush();
+    }
+    if (compactionInterval > 0.f && timeSinceCompaction >= compactionInterval)
+        Compact();
+}
+
+SceneJournal::DirtyEntity *SceneJournal::Dirty(Entity *entity)
+{
+    if (!entity || entity->IsLocal())
+        return 0;
+    std::map<entity_id_t, DirtyEntity>::iterator iter = dirty.find(entity->Id());
+    if (iter == dirty.end())
+    {
+        iter = dirty.insert(std::make_pair(entity->Id(), DirtyEntity())).first;
+        dirtyOrder.push_back(entity->Id());
+    }
+    return &iter->second;
+}
+
+void SceneJournal::OnAttributeChanged(IComponent *comp, IAttribute *attribute, AttributeChange::Type /*change*/)
+{
+    if (comp->IsTemporary())
+        return;
+    DirtyEntity *d = Dirty(comp->ParentEntity());
+    if (d && !d->full)
+        d->attributes.insert(std::make_pair(comp->Id(), attribute->Index()));
+}
+
+void SceneJournal::OnAttributeAddedOrRemoved(IComponent *comp, IAttribute * /*attribute*/, AttributeChange::Type /*change*/)
+{
+    DirtyEntity *d = Dirty(comp->ParentEntity());
+    if (d)
+    {
+        d->full = true;
+        d->attributes.clear();
+    }
+}
+
+void SceneJournal::OnComponentAddedOrRemoved(Entity *entity, IComponent * /*comp*/, AttributeChange::Type change)
+{
+    OnEntityChanged(entity, change);
+}
+
+void SceneJournal::OnEntityChanged(Entity *entity, AttributeChange::Type /*change*/)
+{
+    DirtyEntity *d = Dirty(entity);
+    if (d)
+    {
+        d->full = true;
+        d->attributes.clear();
+    }
+}
+
+void SceneJournal::OnEntityParentChanged(Entity *entity, Entity * /*newParent*/, AttributeChange::Type change)
+{
+    OnEntityChanged(entity, change);
+}
+
+int SceneJournal::SerializeRecord(entity_id_t id, const DirtyEntity &d)
+{
+    ScenePtr s = scene.lock();
+    EntityPtr entity = s ? s->EntityById(id) : EntityPtr();
+    if (recordBuffer.empty())
+        recordBuffer.resize(cRecordInitialSize);
+    for(;;)
+    {
+        try
+        {
+            DataSerializer dest(&recordBuffer[0], recordBuffer.size());
+            if (!entity || entity->IsTemporary())
+            {
+                // Temporary entities are not saved, so one that was made temporary is removed.
+                dest.Add<u8>(cRecordRemoveEntity);
+                dest.Add<u32>(id);
+            }
+            else if (d.full)
+            {
+                dest.Add<u8>(cRecordEntity);
+                dest.Add<u32>(id);
+                EntityPtr parent = entity->Parent();
+                dest.Add<u32>(parent ? parent->Id() : 0);
+
+                const Entity::ComponentMap &components = entity->Components();
+                u32 numComponents = 0;
+                for(Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+                    if (!i->second->IsTemporary())
+                        ++numComponents;
+                dest.AddVLE<VLE8_16_32>(numComponents);
+                for(Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+                {
+                    const IComponent &comp = *i->second;
+                    if (comp.IsTemporary())
+                        continue;
+                    const AttributeVector &attributes = comp.Attributes();
+                    WriteComponentHeader(dest, comp, comp.NumAttributes());
+                    for(size_t j = 0; j < attributes.size(); ++j)
+                        if (attributes[j])
+                            WriteAttribute(dest, &recordBuffer[0], *attributes[j]);
+                }
+            }
+            else
+            {
+                dest.Add<u8>(cRecordAttributes);
+                dest.Add<u32>(id);
+
+                // The changed attributes are ordered by component, so each component is written once.
+                std::vector<std::pair<IComponent *, std::vector<IAttribute *> > > changed;
+                for(std::set<std::pair<component_id_t, u8> >::const_iterator i = d.attributes.begin(); i != d.attributes.end(); ++i)
+                {
+                    IComponent *comp = entity->ComponentById(i->first).get();
+                    if (!comp)
+                        continue;
+                    const AttributeVector &attributes = comp->Attributes();
+                    if (i->second >= attributes.size() || !attributes[i->second])
+                        continue;
+                    if (changed.empty() || changed.back().first != comp)
+                        changed.push_back(std::make_pair(comp, std::vector<IAttribute *>()));
+                    changed.back().second.push_back(attributes[i->second]);
+                }
+
+                dest.AddVLE<VLE8_16_32>((u32)changed.size());
+                for(size_t i = 0; i < changed.size(); ++i)
+                {
+                    WriteComponentHeader(dest, *changed[i].first, (u32)changed[i].second.size());
+                    for(size_t j = 0; j < changed[i].second.size(); ++j)
+                        WriteAttribute(dest, &recordBuffer[0], *changed[i].second[j]);
+                }
+            }
+            return (int)dest.BytesFilled();
+        }
+        catch(...)
+        {
+            // The record did not fit to the buffer. Grow the buffer and start over.
+            if (recordBuffer.size() >= (size_t)cRecordMaxSize)
+            {
+                LogError("SceneJournal: entity " + QString::number(id) + " is too large to record.");
+                return 0;
+            }
+            recordBuffer.resize(recordBuffer.size() * 2);
+        }
+    }
+}
+
+bool SceneJournal::ReplayBatch(const char *data, int size)
+{
+    ScenePtr s = scene.lock();
+    if (!s)
+        return false;
+
+    try
+    {
+        DataDeserializer source(data, size);
+        while(source.BytesLeft() > 0)
+        {
+            const u8 type = source.Read<u8>();
+            const entity_id_t id = source.Read<u32>();
+            if (type == cRecordRemoveEntity)
+            {
+                if (s->HasEntity(id))
+                    s->RemoveEntity(id, AttributeChange::Default);
+            }
+            else if (type == cRecordEntity)
+            {
+                const entity_id_t parentId = source.Read<u32>();
+                EntityPtr parent = parentId ? s->EntityById(parentId) : EntityPtr();
+                if (parentId && !parent)
+                    LogWarning("SceneJournal: parent " + QString::number(parentId) + " of entity " + QString::number(id) + " not found, creating the entity at the root level.");
+                EntityPtr entity = s->EntityById(id);
+                if (!entity)
+                    entity = parent ? parent->CreateChild(id) : s->CreateEntity(id);
+                else if (entity->Parent() != parent)
+                    entity->SetParent(parent, AttributeChange::Default);
+                if (!entity)
+                {
+                    LogError("SceneJournal: failed to create entity " + QString::number(id) + ".");
+                    return false;
+                }
+                entity->SetTemporary(false);
+
+                std::set<IComponent *> recorded;
+                const u32 numComponents = source.ReadVLE<VLE8_16_32>();
+                for(u32 i = 0; i < numComponents; ++i)
+                {
+                    ComponentPtr comp = ReadComponent(source, entity.get(), true);
+                    if (comp)
+                        recorded.insert(comp.get());
+                }
+
+                // The components that are not in the record were removed after it was written.
+                std::vector<ComponentPtr> removed;
+                const Entity::ComponentMap &components = entity->Components();
+                for(Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+                    if (!i->second->IsTemporary() && recorded.find(i->second.get()) == recorded.end())
+                        removed.push_back(i->second);
+                for(size_t i = 0; i < removed.size(); ++i)
+                    entity->RemoveComponent(removed[i], AttributeChange::Default);
+            }
+            else if (type == cRecordAttributes)
+            {
+                EntityPtr entity = s->EntityById(id);
+                const u32 numComponents = source.ReadVLE<VLE8_16_32>();
+                for(u32 i = 0; i < numComponents; ++i)
+                    ReadComponent(source, entity.get(), false);
+            }
+            else
+            {
+                LogError("SceneJournal: unknown record type " + QString::number(type) + " in " + journalFilename + ".");
+                return false;
+            }
+        }
+    }
+    catch(...)
+    {
+        LogError("SceneJournal: damaged record in " + journalFilename + ".");
+        return false;
+    }
+    return true;
+}
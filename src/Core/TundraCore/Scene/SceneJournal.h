@@ -0,0 +1,134 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "CoreTypes.h"
+#include "SceneFwd.h"
+#include "AttributeChangeType.h"
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include <map>
+#include <set>
+#include <vector>
+
+class Framework;
+
+/// Saves a scene persistently by recording its changes to an append-only journal file.
+/** The persistent state consists of a snapshot of the scene in the binary scene format, and a journal of the changes made
+    after the snapshot was written. The journal is written next to the snapshot, with ".journal" appended to its file name.
+
+    The changes are collected from the scene signals and coalesced per entity, so that an entity that changes every frame
+    is written only once per flush. At each flush the current state of the changed entities and attributes is serialized,
+    and the result is appended to the journal on a background thread. The cost of the autosave is thus proportional to
+    the rate of change, not to the size of the scene.
+
+    The journal is compacted by writing a new snapshot once it has grown larger than the snapshot, and at regular intervals.
+    The snapshot is written to a temporary file and renamed over the old one, and the journal records the size and the
+    checksum of the snapshot it applies to, so that the files stay consistent even if the program dies during compaction.
+
+    Like Scene::SaveSceneBinary by default, temporary and local entities and temporary components are not recorded. */
+class TUNDRACORE_API SceneJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    /// @param filename Snapshot file name. The journal is written to the same name with ".journal" appended.
+    SceneJournal(const ScenePtr &scene, const QString &filename);
+    /// Writes the pending changes, and waits until the background thread has written them to disk.
+    ~SceneJournal();
+
+    /// Returns the snapshot file name.
+    const QString &SnapshotFilename() const { return snapshotFilename; }
+
+    /// Returns the journal file name.
+    const QString &JournalFilename() const { return journalFilename; }
+
+    /// Returns whether the changes of the scene are being recorded.
+    bool IsRecording() const { return recording; }
+
+public slots:
+    /// Restores the scene from the snapshot and the journal, replacing the current content of the scene.
+    /** The entities keep the ids they had when they were recorded. If the journal ends in an incomplete write, the changes
+        up to it are restored.
+        @return False if there is no snapshot to restore from. */
+    bool Recover();
+
+    /// Starts recording the changes of the scene.
+    /** Writes the current content of the scene as the snapshot and starts the journal over, so call Recover first to
+        continue from an existing snapshot. */
+    void Start();
+
+    /// Writes the pending changes and stops recording.
+    void Stop();
+
+    /// Serializes the pending changes and queues them to be appended to the journal.
+    void Flush();
+
+    /// Writes a new snapshot of the scene and starts the journal over.
+    void Compact();
+
+    /// Sets how often the pending changes are written, in seconds. The default is 1 second.
+    void SetFlushInterval(float seconds) { flushInterval = seconds; }
+
+    /// Sets how often the journal is compacted even if it stays small, in seconds. The default is 10 minutes. Zero disables.
+    void SetCompactionInterval(float seconds) { compactionInterval = seconds; }
+
+private slots:
+    void OnUpdated(float frametime);
+    void OnAttributeChanged(IComponent *comp, IAttribute *attribute, AttributeChange::Type change);
+    void OnAttributeAddedOrRemoved(IComponent *comp, IAttribute *attribute, AttributeChange::Type change);
+    void OnComponentAddedOrRemoved(Entity *entity, IComponent *comp, AttributeChange::Type change);
+    void OnEntityChanged(Entity *entity, AttributeChange::Type change);
+    void OnEntityParentChanged(Entity *entity, Entity *newParent, AttributeChange::Type change);
+
+private:
+    /// Changes of an entity since the last flush.
+    struct DirtyEntity
+    {
+        DirtyEntity() : full(false) {}
+        /// The entity was created or removed, or its components, parent or temporary state changed: write the whole entity.
+        bool full;
+        /// Changed attributes, by component id and attribute index. Not used if full is set.
+        std::set<std::pair<component_id_t, u8> > attributes;
+    };
+
+    /// Returns the dirty state of an entity, or null if the entity is not recorded.
+    DirtyEntity *Dirty(Entity *entity);
+
+    /// Serializes the current state of an entity to the record buffer. Returns the number of bytes written.
+    int SerializeRecord(entity_id_t id, const DirtyEntity &dirty);
+
+    /// Replays the records of a journal batch to the scene. Returns false if the batch is damaged.
+    bool ReplayBatch(const char *data, int size);
+
+    SceneWeakPtr scene;
+    Framework *framework;
+    QString snapshotFilename;
+    QString journalFilename;
+    bool recording;
+
+    std::map<entity_id_t, DirtyEntity> dirty;
+    /// Ids of the dirty entities in the order they first changed, so that parents are written before their children.
+    std::vector<entity_id_t> dirtyOrder;
+    /// Buffer the records are serialized to. Reused for all records.
+    std::vector<char> recordBuffer;
+
+    float flushInterval;
+    float compactionInterval;
+    float timeSinceFlush;
+    float timeSinceCompaction;
+    /// Bytes written to the journal since the last compaction.
+    qint64 journalSize;
+    /// Size of the last snapshot. Set by the writer thread once the snapshot has been serialized.
+    QAtomicInt snapshotSize;
+
+    /// Runs the file writes in the order they were queued.
+    QThreadPool writer;
+    /// Set by the writer thread if a write fails, so that the failure can be logged on the main thread.
+    QAtomicInt writeFailed;
+};
@@ -0,0 +1,389 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "StableHeaders.h"
+#include "DebugOperatorNew.h"
+
+#include "SceneSnapshot.h"
+#include "BinarySceneFormat.h"
+#include "SceneAPI.h"
+#include "Entity.h"
+#include "IComponent.h"
+#include "IAttribute.h"
+#include "AssetReference.h"
+#include "CoreStringUtils.h"
+
+#include <QDomDocument>
+#include <QFile>
+#include <QBuffer>
+#include <QHash>
+#include <QStringList>
+
+#include <kNet/DataSerializer.h>
+
+#include <cstring>
+#include "MemoryLeakCheck.h"
+
+using namespace kNet;
+
+namespace
+{
+
+/// Initial size of the buffer entity chunks are serialized to.
+const int cBinaryChunkInitialSize = 64 * 1024;
+/// Largest buffer an entity chunk can be serialized to, before giving up.
+const int cBinaryChunkMaxSize = 256 * 1024 * 1024;
+
+/// Writes snapshot entities in the versioned binary scene format to a device.
+/** Serializes one root-level entity chunk at a time to a buffer that grows as needed, and writes each chunk to the device
+    as soon as it is complete. The header is written last, once the chunk offsets are known. */
+class BinarySceneWriter
+{
+public:
+    explicit BinarySceneWriter(bool serializeTemporary_) : serializeTemporary(serializeTemporary_) {}
+
+    /// Writes the given root-level entities and their children to the device.
+    bool Write(QIODevice &device, const std::vector<SceneSnapshot::EntityData> &entities)
+    {
+        try
+        {
+            // The chunk offsets are stored as u32, so the sizes are computed in 64 bits and checked before they are stored.
+            const u64 headerSize = (u64)cBinarySceneHeaderSize + (u64)entities.size() * sizeof(u32);
+            if (headerSize > cBinarySceneMaxSize)
+                return false;
+
+            const qint64 start = device.pos();
+            // Leave room for the header.
+            QByteArray header((int)headerSize, 0);
+            if (device.write(header) != header.size())
+                return false;
+
+            std::vector<u32> chunkOffsets;
+            chunkOffsets.reserve(entities.size());
+            u64 offset = headerSize;
+            for(size_t i = 0; i < entities.size(); ++i)
+            {
+                const int size = Serialize(&entities[i]);
+                if (offset + size > cBinarySceneMaxSize || device.write(buffer.constData(), size) != size)
+                    return false;
+                chunkOffsets.push_back((u32)offset);
+                offset += size;
+            }
+
+            const u32 stringTableOffset = (u32)offset;
+            const int size = Serialize(0);
+            if (offset + size > cBinarySceneMaxSize || device.write(buffer.constData(), size) != size)
+                return false;
+            const qint64 end = device.pos();
+
+            DataSerializer dest(header.data(), header.size());
+            dest.Add<u32>(cBinarySceneMagic);
+            dest.Add<u32>(cBinarySceneVersion);
+            dest.Add<u32>(stringTableOffset);
+            dest.Add<u32>((u32)chunkOffsets.size());
+            for(size_t i = 0; i < chunkOffsets.size(); ++i)
+                dest.Add<u32>(chunkOffsets[i]);
+            if (!device.seek(start) || device.write(header) != header.size())
+                return false;
+            return device.seek(end);
+        }
+        catch(...)
+        {
+            return false;
+        }
+    }
+
+private:
+    /// Serializes the chunk of the given entity, or the string table if the entity is null, to the buffer. Returns the number of bytes written.
+    int Serialize(const SceneSnapshot::EntityData *entity)
+    {
+        if (buffer.isEmpty())
+            buffer.resize(cBinaryChunkInitialSize);
+        for(;;)
+        {
+            try
+            {
+                DataSerializer dest(buffer.data(), buffer.size());
+                if (entity)
+                    WriteEntity(dest, *entity);
+                else
+                    WriteStringTable(dest);
+                return (int)dest.BytesFilled();
+            }
+            catch(...)
+            {
+                // The chunk did not fit to the buffer. Grow the buffer and start over.
+                if (buffer.size() >= cBinaryChunkMaxSize)
+                    throw;
+                buffer.resize(buffer.size() * 2);
+            }
+        }
+    }
+
+    void WriteEntity(DataSerializer &dest, const SceneSnapshot::EntityData &entity)
+    {
+        dest.Add<u32>(entity.id);
+        dest.Add<u8>((entity.replicated ? cBinaryReplicated : 0) | (entity.temporary ? cBinaryTemporary : 0));
+
+        u32 numComponents = 0;
+        for(size_t i = 0; i < entity.components.size(); ++i)
+            if (serializeTemporary || !entity.components[i].temporary)
+                ++numComponents;
+        dest.AddVLE<VLE8_16_32>(numComponents);
+        for(size_t i = 0; i < entity.components.size(); ++i)
+            if (serializeTemporary || !entity.components[i].temporary)
+                WriteComponent(dest, entity.components[i]);
+
+        u32 numChildren = 0;
+        for(size_t i = 0; i < entity.children.size(); ++i)
+            if (serializeTemporary || !entity.children[i].temporary)
+                ++numChildren;
+        dest.AddVLE<VLE8_16_32>(numChildren);
+        for(size_t i = 0; i < entity.children.size(); ++i)
+            if (serializeTemporary || !entity.children[i].temporary)
+                WriteEntity(dest, entity.children[i]);
+    }
+
+    void WriteComponent(DataSerializer &dest, const SceneSnapshot::ComponentData &comp)
+    {
+        dest.AddVLE<VLE8_16_32>(StringIndex(comp.typeName));
+        dest.AddVLE<VLE8_16_32>(comp.typeId);
+        dest.AddVLE<VLE8_16_32>(StringIndex(comp.name));
+        dest.Add<u8>((comp.replicated ? cBinaryReplicated : 0) | (comp.temporary ? cBinaryTemporary : 0));
+
+        const size_t sizePos = BeginSize(dest);
+        dest.AddVLE<VLE8_16_32>((u32)comp.attributes.size());
+        for(size_t i = 0; i < comp.attributes.size(); ++i)
+            WriteAttribute(dest, comp.attributes[i]);
+        EndSize(dest, sizePos);
+    }
+
+    void WriteAttribute(DataSerializer &dest, const SceneSnapshot::AttributeData &data)
+    {
+        const IAttribute &attr = *data.value;
+        dest.Add<u8>(data.index);
+        dest.AddVLE<VLE8_16_32>(StringIndex(attr.Id()));
+        dest.AddVLE<VLE8_16_32>(attr.TypeId());
+
+        const size_t sizePos = BeginSize(dest);
+        if (attr.TypeId() == cAttributeAssetReference)
+            dest.AddVLE<VLE8_16_32>(StringIndex(static_cast<const Attribute<AssetReference> &>(attr).Get().ref));
+        else if (attr.TypeId() == cAttributeAssetReferenceList)
+        {
+            const AssetReferenceList &refs = static_cast<const Attribute<AssetReferenceList> &>(attr).Get();
+            dest.AddVLE<VLE8_16_32>(refs.Size());
+            for(int i = 0; i < refs.Size(); ++i)
+                dest.AddVLE<VLE8_16_32>(StringIndex(refs[i].ref));
+        }
+        else
+            attr.ToBinary(dest);
+        EndSize(dest, sizePos);
+    }
+
+    void WriteStringTable(DataSerializer &dest)
+    {
+        dest.AddVLE<VLE8_16_32>(strings.size());
+        for(int i = 0; i < strings.size(); ++i)
+        {
+            const QByteArray utf8 = strings[i].toUtf8();
+            dest.AddVLE<VLE8_16_32>(utf8.size());
+            if (utf8.size())
+                dest.AddArray<u8>((const u8 *)utf8.constData(), utf8.size());
+        }
+    }
+
+    /// Writes a placeholder for the size of the data that follows. EndSize fills it in.
+    size_t BeginSize(DataSerializer &dest)
+    {
+        const size_t pos = dest.BytesFilled();
+        dest.Add<u32>(0);
+        return pos;
+    }
+
+    void EndSize(DataSerializer &dest, size_t pos)
+    {
+        const u32 size = (u32)(dest.BytesFilled() - pos - sizeof(u32));
+        memcpy(buffer.data() + pos, &size, sizeof(u32));
+    }
+
+    /// Returns the index of the string in the string table, adding it if it's not there yet.
+    u32 StringIndex(const QString &str)
+    {
+        QHash<QString, u32>::const_iterator iter = stringIndices.find(str);
+        if (iter != stringIndices.end())
+            return iter.value();
+        const u32 index = (u32)strings.size();
+        stringIndices[str] = index;
+        strings.append(str);
+        return index;
+    }
+
+    bool serializeTemporary;
+    /// Buffer the chunks are serialized to. Reused for all chunks.
+    QByteArray buffer;
+    QStringList strings;
+    QHash<QString, u32> stringIndices;
+};
+
+/// Copies an entity and its children, including the temporary ones.
+void CopyEntity(const Entity &entity, SceneSnapshot::EntityData &dest)
+{
+    dest.id = entity.Id();
+    dest.replicated = entity.IsReplicated();
+    dest.temporary = entity.IsTemporary();
+
+    const Entity::ComponentMap &components = entity.Components();
+    dest.components.resize(components.size());
+    size_t index = 0;
+    for(Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i, ++index)
+    {
+        const IComponent &comp = *i->second;
+        SceneSnapshot::ComponentData &c = dest.components[index];
+        c.typeName = comp.TypeName();
+        c.typeId = comp.TypeId();
+        c.name = comp.Name();
+        c.replicated = comp.IsReplicated();
+        c.temporary = comp.IsTemporary();
+
+        const AttributeVector &attributes = comp.Attributes();
+        c.attributes.reserve(attributes.size());
+        for(size_t j = 0; j < attributes.size(); ++j)
+        {
+            IAttribute *attr = attributes[j];
+            if (!attr)
+                continue;
+            SceneSnapshot::AttributeData a;
+            a.value = shared_ptr<IAttribute>(SceneAPI::CreateAttribute(attr->TypeId(), attr->Id()));
+            if (!a.value)
+                continue;
+            a.value->CopyValue(attr, AttributeChange::Disconnected);
+            a.name = attr->Name();
+            a.index = attr->Index();
+            c.attributes.push_back(a);
+        }
+    }
+
+    dest.children.resize(entity.NumChildren());
+    index = 0;
+    for(size_t i = 0; i < entity.NumChildren(); ++i)
+    {
+        EntityPtr child = entity.Child(i);
+        if (child)
+            CopyEntity(*child, dest.children[index++]);
+    }
+    dest.children.resize(index);
+}
+
+/// Writes an entity the same way as Entity::SerializeToXML and IComponent::SerializeTo.
+void WriteEntityXml(QDomDocument &doc, QDomElement &parent, const SceneSnapshot::EntityData &entity, bool serializeTemporary)
+{
+    QDomElement entityElem = doc.createElement("entity");
+    entityElem.setAttribute("id", QString::number(entity.id));
+    entityElem.setAttribute("sync", BoolToString(entity.replicated));
+    if (serializeTemporary)
+        entityElem.setAttribute("temporary", BoolToString(entity.temporary));
+
+    for(size_t i = 0; i < entity.components.size(); ++i)
+    {
+        const SceneSnapshot::ComponentData &comp = entity.components[i];
+        QDomElement compElem = doc.createElement("component");
+        compElem.setAttribute("type", IComponent::EnsureTypeNameWithoutPrefix(comp.typeName));
+        compElem.setAttribute("typeId", QString::number(comp.typeId));
+        if (!comp.name.isEmpty())
+            compElem.setAttribute("name", comp.name);
+        compElem.setAttribute("sync", BoolToString(comp.replicated));
+        if (serializeTemporary)
+            compElem.setAttribute("temporary", BoolToString(comp.temporary));
+
+        for(size_t j = 0; j < comp.attributes.size(); ++j)
+        {
+            const SceneSnapshot::AttributeData &attr = comp.attributes[j];
+            QDomElement attrElem = doc.createElement("attribute");
+            attrElem.setAttribute("name", attr.name);
+            attrElem.setAttribute("id", attr.value->Id());
+            attrElem.setAttribute("value", attr.value->ToString());
+            attrElem.setAttribute("type", attr.value->TypeName());
+            compElem.appendChild(attrElem);
+        }
+        entityElem.appendChild(compElem);
+    }
+
+    for(size_t i = 0; i < entity.children.size(); ++i)
+        WriteEntityXml(doc, entityElem, entity.children[i], serializeTemporary);
+
+    parent.appendChild(entityElem);
+}
+
+}
+
+SceneSnapshot::SceneSnapshot(const EntityList &rootLevel, bool serializeTemporary_) :
+    serializeTemporary(serializeTemporary_)
+{
+    entities.resize(rootLevel.size());
+    size_t index = 0;
+    for(EntityList::const_iterator iter = rootLevel.begin(); iter != rootLevel.end(); ++iter, ++index)
+        CopyEntity(**iter, entities[index]);
+}
+
+bool SceneSnapshot::WriteBinary(QIODevice &device) const
+{
+    BinarySceneWriter writer(serializeTemporary);
+    return writer.Write(device, entities);
+}
+
+QByteArray SceneSnapshot::SerializeToBinary() const
+{
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    if (!WriteBinary(buffer))
+        return QByteArray();
+    buffer.close();
+    return bytes;
+}
+
+QByteArray SceneSnapshot::SerializeToXmlString() const
+{
+    QDomDocument sceneDoc("Scene");
+    QDomElement sceneElem = sceneDoc.createElement("scene");
+    for(size_t i = 0; i < entities.size(); ++i)
+        WriteEntityXml(sceneDoc, sceneElem, entities[i], serializeTemporary);
+    sceneDoc.appendChild(sceneElem);
+    return sceneDoc.toByteArray();
+}
+
+bool SceneSnapshot::Save(const QString &filename) const
+{
+    return SaveFile(filename, filename.endsWith(".tbin", Qt::CaseInsensitive));
+}
+
+bool SceneSnapshot::SaveBinary(const QString &filename) const
+{
+    return SaveFile(filename, true);
+}
+
+bool SceneSnapshot::SaveFile(const QString &filename, bool binary) const
+{
+    const QString tempFilename = filename + ".tmp";
+    QFile file(tempFilename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    bool ok;
+    if (binary)
+        ok = WriteBinary(file);
+    else
+    {
+        const QByteArray bytes = SerializeToXmlString();
+        ok = file.write(bytes) == bytes.size();
+    }
+    ok = file.flush() && ok;
+    file.close();
+    if (!ok)
+    {
+        QFile::remove(tempFilename);
+        return false;
+    }
+
+    QFile::remove(filename);
+    return QFile::rename(tempFilename, filename);
+}
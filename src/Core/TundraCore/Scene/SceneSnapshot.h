@@ -0,0 +1,90 @@
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#pragma once
+
+#include "TundraCoreApi.h"
+#include "SceneFwd.h"
+
+#include <QString>
+#include <QByteArray>
+
+#include <vector>
+
+class QIODevice;
+
+/// An immutable copy of scene entities, which can be serialized outside the main thread.
+/** Created with Scene::CreateSnapshot at a frame boundary. The attribute values are copied to attributes that belong to
+    no component, so the snapshot shares no mutable state with the scene, and the simulation can continue while the
+    snapshot is written. Copying is cheap compared to serialization: most values are plain data, and strings and asset
+    references are implicitly shared Qt strings.
+
+    Scene::SerializeToXmlString, Scene::SerializeToBinary and the functions that save a scene use snapshots internally,
+    so a snapshot serializes to the same data as the scene it was created from. */
+class TUNDRACORE_API SceneSnapshot
+{
+public:
+    /// A copied attribute.
+    struct AttributeData
+    {
+        shared_ptr<IAttribute> value; ///< The value, in an attribute that does not belong to any component. Holds also the id and the type.
+        QString name; ///< Human-readable name of the attribute.
+        u8 index; ///< Index of the attribute in its component.
+    };
+
+    /// A copied component.
+    struct ComponentData
+    {
+        QString typeName;
+        u32 typeId;
+        QString name;
+        bool replicated;
+        bool temporary;
+        std::vector<AttributeData> attributes;
+    };
+
+    /// A copied entity and its children.
+    struct EntityData
+    {
+        entity_id_t id;
+        bool replicated;
+        bool temporary;
+        std::vector<ComponentData> components;
+        std::vector<EntityData> children;
+    };
+
+    /// Copies the given entities and their children. Call in the main thread.
+    /** @param serializeTemporary Whether temporary entities and components are serialized. */
+    SceneSnapshot(const EntityList &entities, bool serializeTemporary);
+
+    /// Returns the copied root-level entities.
+    const std::vector<EntityData> &Entities() const { return entities; }
+
+    /// Returns whether temporary entities and components are serialized.
+    bool SerializesTemporary() const { return serializeTemporary; }
+
+    /// Serializes the snapshot in the binary scene format. Returns an empty array if the serialization fails.
+    /** Does not log, so that it can be called outside the main thread. */
+    QByteArray SerializeToBinary() const;
+
+    /// Writes the snapshot in the binary scene format to a device. Does not log.
+    bool WriteBinary(QIODevice &device) const;
+
+    /// Serializes the snapshot to a scene XML document. Does not log.
+    QByteArray SerializeToXmlString() const;
+
+    /// Saves the snapshot to a file, as binary if the file name ends in ".tbin" and as XML otherwise.
+    /** Does not log, so that it can be called outside the main thread. The file is written to a temporary file first, and
+        renamed over the given file when complete, so that a failed save leaves the previous file intact.
+        @return Whether the file was saved successfully. */
+    bool Save(const QString &filename) const;
+
+    /// Saves the snapshot to a file in the binary scene format regardless of the file name. Works like Save otherwise.
+    bool SaveBinary(const QString &filename) const;
+
+private:
+    /// Writes the snapshot to a temporary file and renames it over the given file. See Save.
+    bool SaveFile(const QString &filename, bool binary) const;
+
+    std::vector<EntityData> entities;
+    bool serializeTemporary;
+};
@@ -19,11 +19,14 @@
 #include "Profiler.h"
 #include "EC_Placeable.h"
 #include "EC_RigidBody.h"
+#include "EC_Terrain.h"
 #include "SceneAPI.h"
 #include "UserConnection.h"
 
 #include <kNet.h>
 
+#include <QByteArray>
+
 #include <cstring>
 
 #include "MemoryLeakCheck.h"
@@ -156,6 +159,73 @@ int DetectRotSendType(bool rotChanged, const float3x3 &rot)
         return 0;
 }
 
+/// Maximum number of terrain vertices per side in one terrain heights message.
+const uint cTerrainHeightsBlockSize = 64;
+
+/// Time for which terrain height edits are coalesced before sending them, in seconds.
+const float cTerrainEditCoalescePeriod = 0.1f;
+
+// Helper function for predicting a terrain height value bit pattern from the already coded values: from the left neighbour,
+// or on the first column from the value above.
+u32 PredictTerrainHeightBits(const std::vector<u32> &bits, size_t index, uint width)
+{
+    if (index % width != 0)
+        return bits[index - 1];
+    return index >= width ? bits[index - width] : 0;
+}
+
+// Helper function for compressing a rectangle of terrain height values losslessly for network transfer.
+// The differences of the value bit patterns to their predictions are small for smooth terrain. They are zigzag-coded,
+// and stored byte plane by byte plane, so that zlib sees long runs of similar bytes.
+QByteArray CompressTerrainHeights(const std::vector<float> &heights, uint width)
+{
+    const size_t count = heights.size();
+    std::vector<u32> bits(count);
+    memcpy(&bits[0], &heights[0], count * sizeof(u32));
+
+    QByteArray planes((int)(count * sizeof(u32)), 0);
+    for(size_t i = 0; i < count; ++i)
+    {
+        const s32 residual = (s32)(bits[i] - PredictTerrainHeightBits(bits, i, width));
+        const u32 zigzag = ((u32)residual << 1) ^ (u32)(residual >> 31);
+        for(size_t b = 0; b < sizeof(u32); ++b)
+            planes[(int)(b * count + i)] = (char)(zigzag >> (8 * b));
+    }
+    return qCompress(planes);
+}
+
+// Helper function for decompressing terrain height values compressed with CompressTerrainHeights.
+// The size of heights must be the number of compressed values, which the caller bounds, see cTerrainHeightsBlockSize.
+bool DecompressTerrainHeights(const QByteArray &data, uint width, std::vector<float> &heights)
+{
+    const size_t count = heights.size();
+    // qUncompress allocates the size stored in the big-endian length prefix of the data, so check it against the expected size
+    // first, instead of letting a malformed message make us allocate an arbitrary amount of memory.
+    if (data.size() < 4)
+        return false;
+    const u8 *prefix = (const u8 *)data.constData();
+    const u32 uncompressedSize = ((u32)prefix[0] << 24) | ((u32)prefix[1] << 16) | ((u32)prefix[2] << 8) | (u32)prefix[3];
+    if ((size_t)uncompressedSize != count * sizeof(u32))
+        return false;
+
+    const QByteArray planes = qUncompress(data);
+    if ((size_t)planes.size() != count * sizeof(u32))
+        return false;
+
+    const u8 *bytes = (const u8 *)planes.constData();
+    std::vector<u32> bits(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        u32 zigzag = 0;
+        for(size_t b = 0; b < sizeof(u32); ++b)
+            zigzag |= (u32)bytes[b * count + i] << (8 * b);
+        const u32 residual = (zigzag >> 1) ^ (0 - (zigzag & 1));
+        bits[i] = residual + PredictTerrainHeightBits(bits, i, width);
+    }
+    memcpy(&heights[0], &bits[0], count * sizeof(u32));
+    return true;
+}
+
 } // ~unnamed namespace
 
 namespace TundraLogic
@@ -319,6 +389,12 @@ void SyncManager::RegisterToScene(ScenePtr scene)
         SLOT( OnActionTriggered(Entity *, const QString &, const QStringList &, EntityAction::ExecTypeField)));
     connect(sceneptr, SIGNAL( EntityTemporaryStateToggled(Entity *, AttributeChange::Type) ), SLOT( OnEntityPropertiesChanged(Entity *, AttributeChange::Type) ));
     connect(sceneptr, SIGNAL( EntityParentChanged(Entity *, Entity*, AttributeChange::Type) ), SLOT( OnEntityParentChanged(Entity *, Entity *, AttributeChange::Type) ));
+
+    // Terrain height edits are not attribute changes, so connect to them separately.
+    pendingTerrainEdits_.clear();
+    std::vector<shared_ptr<EC_Terrain> > terrains = scene->Components<EC_Terrain>();
+    for(size_t i = 0; i < terrains.size(); ++i)
+        ConnectTerrainEdits(terrains[i].get());
 }
 
 void SyncManager::HandleNetworkMessage(UserConnection* user, kNet::packet_id_t packetId, kNet::message_id_t messageId, const char* data, size_t numBytes)
@@ -378,6 +454,9 @@ void SyncManager::HandleNetworkMessage(UserConnection* user, kNet::packet_id_t p
         case cRegisterComponentTypeMessage:
             HandleRegisterComponentType(user, data, numBytes);
             break;
+        case cTerrainHeightsMessage:
+            HandleTerrainHeights(user, data, numBytes);
+            break;
         }
     }
     catch (kNet::NetException& e)
@@ -548,6 +627,9 @@ void SyncManager::OnComponentAdded(Entity* entity, IComponent* comp, AttributeCh
     if (!entity || !comp)
         return;
 
+    // Also the terrains received from the network can be edited locally.
+    ConnectTerrainEdits(comp);
+
     if ((change != AttributeChange::Replicate) || (comp->IsLocal()))
         return;
     if (entity->IsLocal())
@@ -967,6 +1049,8 @@ void SyncManager::Update(f64 frametime)
     ScenePtr scene = scene_.lock();
     if (!scene)
         return;
+
+    ReplicateTerrainEdits(updatePeriod_);
     
     if (owner_->IsServer())
     {
@@ -974,6 +1058,8 @@ void SyncManager::Update(f64 frametime)
         // SyncState is not added to the user before it's authenticated, so using UserConnections() instead of
         // AuthenticatedUsers() and checking for SyncState's existence does the same thing in a little more efficient fashion.
         UserConnectionList& users = owner_->GetServer()->UserConnections();
+        if (prioritizer_ && prioUpdateAcc_ >= priorityUpdatePeriod_)
+            UpdateTerrainStreamingObservers(scene.get());
         for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
         {
             SceneSyncState *syncState = (*i)->syncState.get();
@@ -1020,6 +1106,123 @@ void SyncManager::Update(f64 frametime)
     }
 }
 
+void SyncManager::UpdateTerrainStreamingObservers(Scene *scene)
+{
+    std::vector<shared_ptr<EC_Terrain> > terrains = scene->Components<EC_Terrain>();
+    if (terrains.empty())
+        return;
+
+    std::vector<float3> positions;
+    UserConnectionList& users = owner_->GetServer()->UserConnections();
+    for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
+        if ((*i)->syncState && (*i)->syncState->observerPos.IsFinite()) // The position is NaN until the client has sent it.
+            positions.push_back((*i)->syncState->observerPos);
+
+    for(size_t i = 0; i < terrains.size(); ++i)
+        if (terrains[i]->IsStreaming())
+            terrains[i]->SetStreamingObservers(positions);
+}
+
+void SyncManager::ConnectTerrainEdits(IComponent* comp)
+{
+    EC_Terrain *terrain = dynamic_cast<EC_Terrain*>(comp);
+    if (terrain)
+        connect(terrain, SIGNAL(HeightsEdited()), this, SLOT(OnTerrainHeightsEdited()), Qt::UniqueConnection);
+}
+
+void SyncManager::OnTerrainHeightsEdited()
+{
+    EC_Terrain *terrain = dynamic_cast<EC_Terrain*>(sender());
+    if (!terrain || !terrain->ParentEntity() || terrain->ParentEntity()->IsLocal())
+        return;
+
+    // The terrain emits the signal again only after its edits have been taken, so it is never queued twice.
+    PendingTerrainEdit edit;
+    edit.terrain = terrain->shared_from_this();
+    edit.age = 0.f;
+    pendingTerrainEdits_.push_back(edit);
+}
+
+void SyncManager::ReplicateTerrainEdits(float elapsed)
+{
+    PROFILE(SyncManager_ReplicateTerrainEdits);
+
+    for(size_t i = 0; i < pendingTerrainEdits_.size();)
+    {
+        PendingTerrainEdit &edit = pendingTerrainEdits_[i];
+        edit.age += elapsed;
+        EC_Terrain *terrain = dynamic_cast<EC_Terrain*>(edit.terrain.lock().get());
+        Entity *entity = terrain ? terrain->ParentEntity() : 0;
+        // Wait for the server to assign the real ID to an entity created by this client.
+        if (entity && (edit.age < cTerrainEditCoalescePeriod || entity->IsUnacked()))
+        {
+            ++i;
+            continue;
+        }
+
+        uint minX, minY, maxX, maxY;
+        if (entity && terrain->TakeEditedHeights(minX, minY, maxX, maxY))
+            SendTerrainHeights(terrain, minX, minY, maxX, maxY);
+        pendingTerrainEdits_.erase(pendingTerrainEdits_.begin() + i);
+    }
+}
+
+void SyncManager::SendTerrainHeights(EC_Terrain* terrain, uint minX, uint minY, uint maxX, uint maxY, UserConnection* user)
+{
+    std::vector<float> heights;
+    for(uint blockY = minY; blockY <= maxY; blockY += cTerrainHeightsBlockSize)
+        for(uint blockX = minX; blockX <= maxX; blockX += cTerrainHeightsBlockSize)
+        {
+            const uint width = Min(maxX - blockX + 1, cTerrainHeightsBlockSize);
+            const uint height = Min(maxY - blockY + 1, cTerrainHeightsBlockSize);
+            heights.resize(width * height);
+            terrain->GetHeights(blockX, blockY, width, height, &heights[0]);
+            const QByteArray compressed = CompressTerrainHeights(heights, width);
+
+            kNet::DataSerializer ds(compressed.size() + 64);
+            ds.AddVLE<kNet::VLE8_16_32>(0); ///\todo Dummy scene ID. Use proper scene ID when available
+            ds.AddVLE<kNet::VLE8_16_32>(terrain->ParentEntity()->Id());
+            ds.AddVLE<kNet::VLE8_16_32>(terrain->Id());
+            ds.AddVLE<kNet::VLE8_16_32>(blockX);
+            ds.AddVLE<kNet::VLE8_16_32>(blockY);
+            ds.AddVLE<kNet::VLE8_16_32>(width);
+            ds.AddVLE<kNet::VLE8_16_32>(height);
+            ds.AddVLE<kNet::VLE8_16_32>(compressed.size());
+            ds.AddArray<u8>((const u8*)compressed.constData(), (u32)compressed.size());
+            if (user)
+                user->Send(cTerrainHeightsMessage, ds.GetData(), ds.BytesFilled(), true, true);
+            else
+                SendTerrainHeightsMessage(ds.GetData(), ds.BytesFilled());
+        }
+}
+
+void SyncManager::SendEditedTerrainHeights(UserConnection* user, EC_Terrain* terrain)
+{
+    if (user->ProtocolVersion() < ProtocolTerrainHeights)
+    {
+        LogWarning("User " + QString::number(user->ConnectionId()) + " uses an older protocol version that does not support terrain height edits. " +
+            "The terrain of " + terrain->ParentEntity()->ToString() + " will show the original height map for that user.");
+        return;
+    }
+
+    uint minX, minY, maxX, maxY;
+    if (terrain->EditedHeightsSinceLoad(minX, minY, maxX, maxY))
+        SendTerrainHeights(terrain, minX, minY, maxX, maxY, user);
+}
+
+void SyncManager::SendTerrainHeightsMessage(const char* data, size_t numBytes, UserConnection* exclude)
+{
+    if (owner_->IsServer())
+    {
+        UserConnectionList& users = owner_->GetServer()->UserConnections();
+        for(UserConnectionList::iterator i = users.begin(); i != users.end(); ++i)
+            if ((*i).get() != exclude && (*i)->syncState && (*i)->protocolVersion >= ProtocolTerrainHeights)
+                (*i)->Send(cTerrainHeightsMessage, data, numBytes, true, true);
+    }
+    else if (serverConnection_->protocolVersion >= ProtocolTerrainHeights)
+        serverConnection_->Send(cTerrainHeightsMessage, data, numBytes, true, true);
+}
+
 void SyncManager::ReplicateRigidBodyChanges(UserConnection* user)
 {
     PROFILE(SyncManager_ReplicateRigidBodyChanges);
@@ -1472,6 +1675,70 @@ void SyncManager::HandleSetEntityParent(UserConnection* source, const char* data
     state->entities[entityID].hasParentChange = false;
 }
 
+void SyncManager::HandleTerrainHeights(UserConnection* source, const char* data, size_t numBytes)
+{
+    assert(source);
+    ScenePtr scene = GetRegisteredScene();
+    if (!scene || !source->syncState)
+    {
+        LogWarning("Null scene or sync state, disregarding TerrainHeights message");
+        return;
+    }
+
+    kNet::DataDeserializer ds(data, numBytes);
+    unsigned sceneID = ds.ReadVLE<kNet::VLE8_16_32>(); ///\todo Dummy ID. Lookup scene once multiscene is properly supported
+    UNREFERENCED_PARAM(sceneID)
+    entity_id_t entityID = ds.ReadVLE<kNet::VLE8_16_32>();
+    component_id_t compID = ds.ReadVLE<kNet::VLE8_16_32>();
+    uint minX = ds.ReadVLE<kNet::VLE8_16_32>();
+    uint minY = ds.ReadVLE<kNet::VLE8_16_32>();
+    uint width = ds.ReadVLE<kNet::VLE8_16_32>();
+    uint height = ds.ReadVLE<kNet::VLE8_16_32>();
+    uint compressedSize = ds.ReadVLE<kNet::VLE8_16_32>();
+    if (width == 0 || height == 0 || width > cTerrainHeightsBlockSize || height > cTerrainHeightsBlockSize || compressedSize > ds.BytesLeft())
+    {
+        LogWarning("Malformed TerrainHeights message for entity " + QString::number(entityID));
+        return;
+    }
+    QByteArray compressed(compressedSize, 0);
+    ds.ReadArray<u8>((u8*)compressed.data(), compressedSize);
+
+    if (!ValidateAction(source, cTerrainHeightsMessage, entityID))
+        return;
+
+    EntityPtr entity = scene->EntityById(entityID);
+    if (entity && !scene->AllowModifyEntity(source, entity.get())) // check if allowed to modify this entity.
+        return;
+    if (!entity)
+    {
+        LogWarning("Entity " + QString::number(entityID) + " not found for TerrainHeights message");
+        return;
+    }
+    shared_ptr<EC_Terrain> terrain = dynamic_pointer_cast<EC_Terrain>(entity->ComponentById(compID));
+    if (!terrain)
+    {
+        LogWarning("Terrain component id " + QString::number(compID) + " not found in " + entity->ToString() + " for TerrainHeights message");
+        return;
+    }
+
+    std::vector<float> heights(width * height);
+    if (!DecompressTerrainHeights(compressed, width, heights))
+    {
+        LogWarning("Failed to decompress TerrainHeights message for " + entity->ToString());
+        return;
+    }
+
+    // Apply the heights locally, so that they are not sent back. The server forwards the message to the other clients as is.
+    terrain->SetHeights(minX, minY, width, height, &heights[0], AttributeChange::LocalOnly);
+    terrain->RegenerateDirtyTerrainPatches();
+    if (owner_->IsServer())
+    {
+        // Remember the edit for the users that join later.
+        terrain->AddEditedHeightsSinceLoad(minX, minY, minX + width - 1, minY + height - 1);
+        SendTerrainHeightsMessage(data, numBytes, source);
+    }
+}
+
 void SyncManager::HandleRegisterComponentType(UserConnection* source, const char* data, size_t numBytes)
 {
     assert(source);
@@ -1645,6 +1912,15 @@ void SyncManager::ProcessSyncState(UserConnection* user)
             it = state->dirtyQueue.erase(it);
             // The create has been processed fully. Clear dirty flags.
             state->MarkEntityProcessed(entity->Id());
+
+            // The terrain height edits are not part of the attributes, so send them after the entity exists on the client.
+            if (isServer)
+                for (Entity::ComponentMap::const_iterator i = components.begin(); i != components.end(); ++i)
+                {
+                    EC_Terrain *terrain = dynamic_cast<EC_Terrain*>(i->second.get());
+                    if (terrain && terrain->IsReplicated())
+                        SendEditedTerrainHeights(user, terrain);
+                }
         }
         else if (entity)
         {
@@ -1656,6 +1932,7 @@ void SyncManager::ProcessSyncState(UserConnection* user)
                 kNet::DataSerializer createCompsDs(createCompsBuffer_, 64 * 1024);
                 kNet::DataSerializer createAttrsDs(createAttrsBuffer_, 16 * 1024);
                 kNet::DataSerializer editAttrsDs(editAttrsBuffer_, 64 * 1024);
+                std::vector<EC_Terrain*> createdTerrains;
                 
                 while (!entityState.dirtyQueue.empty())
                 {
@@ -1706,6 +1983,8 @@ void SyncManager::ProcessSyncState(UserConnection* user)
                         WriteComponentFullUpdate(createCompsDs, comp);
                         // Mark the component undirty in the receiver's syncstate
                         state->MarkComponentProcessed(entity->Id(), comp->Id());
+                        if (isServer && dynamic_cast<EC_Terrain*>(comp.get()))
+                            createdTerrains.push_back(static_cast<EC_Terrain*>(comp.get()));
                     }
                     // Added/removed/edited attributes
                     else if (comp)
@@ -1881,6 +2160,8 @@ void SyncManager::ProcessSyncState(UserConnection* user)
                     user->Send(cCreateComponentsMessage, true, true, createCompsDs);
                     ++numMessagesSent;
                 }
+                for (size_t i = 0; i < createdTerrains.size(); ++i)
+                    SendEditedTerrainHeights(user, createdTerrains[i]);
                 if (createAttrsDs.BytesFilled())
                 {
                     user->Send(cCreateAttributesMessage, true, true, createAttrsDs);
@@ -2648,9 +2929,7 @@ void SyncManager::HandleEditAttributes(UserConnection* source, const char* data,
                 }
                 else
                 {
-                    IAttribute* endValue = attr->Clone();
-                    endValue->FromBinary(attrDs, AttributeChange::Disconnected);
-                    scene->StartAttributeInterpolation(attr, endValue, updateInterval);
+                    scene->StartAttributeInterpolation(*attr, attrDs, updateInterval);
                 }
             }
         }
@@ -2680,9 +2959,7 @@ void SyncManager::HandleEditAttributes(UserConnection* source, const char* data,
                     }
                     else
                     {
-                        IAttribute* endValue = attr->Clone();
-                        endValue->FromBinary(attrDs, AttributeChange::Disconnected);
-                        scene->StartAttributeInterpolation(attr, endValue, updateInterval);
+                        scene->StartAttributeInterpolation(*attr, attrDs, updateInterval);
                     }
                 }
             }
@@ -16,6 +16,7 @@
 #include <QObject>
 
 class Framework;
+class EC_Terrain;
 
 namespace TundraLogic
 {
@@ -127,6 +128,9 @@ private slots:
     /// Trigger sync of a custom component type
     void OnPlaceholderComponentTypeRegistered(u32 typeId, const QString& typeName, AttributeChange::Type change);
 
+    /// Queue the edited height values of the sender terrain to be sent once the edits have been coalesced
+    void OnTerrainHeightsEdited();
+
 private:
     /// Craft a component full update, with all static and dynamic attributes.
     void WriteComponentFullUpdate(kNet::DataSerializer& ds, ComponentPtr comp);
@@ -156,6 +160,8 @@ private:
     void HandleRegisterComponentType(UserConnection* source, const char* data, size_t numBytes);
     /// Handle entity parent change message.
     void HandleSetEntityParent(UserConnection* source, const char* data, size_t numBytes);
+    /// Handle terrain heights message.
+    void HandleTerrainHeights(UserConnection* source, const char* data, size_t numBytes);
 
     void HandleRigidBodyChanges(UserConnection* source, kNet::packet_id_t packetId, const char* data, size_t numBytes);
     
@@ -163,6 +169,27 @@ private:
 
     void InterpolateRigidBodies(f64 frametime, SceneSyncState* state);
 
+    /// Passes the observer positions of the clients to the streamed terrains of the scene.
+    void UpdateTerrainStreamingObservers(Scene *scene);
+
+    /// Connects to the height edits of the given component, if it is a terrain.
+    void ConnectTerrainEdits(IComponent* comp);
+
+    /// Sends the terrain height edits that have been coalesced for long enough.
+    /** @param elapsed Time since the previous call, in seconds. */
+    void ReplicateTerrainEdits(float elapsed);
+
+    /// Sends the given rectangle of terrain height values, split into blocks that are compressed separately.
+    /** @param user The user to send the height values to, or null to send them like SendTerrainHeightsMessage. */
+    void SendTerrainHeights(EC_Terrain* terrain, uint minX, uint minY, uint maxX, uint maxY, UserConnection* user = 0);
+
+    /// On the server, sends the heights edited since the height map was loaded to a user that has just been sent the terrain.
+    /** Users with an older protocol version can not receive the edits, so they keep the original height map and a warning is logged. */
+    void SendEditedTerrainHeights(UserConnection* user, EC_Terrain* terrain);
+
+    /// Sends a terrain heights message to the server, or on the server to all clients that support it except the given one.
+    void SendTerrainHeightsMessage(const char* data, size_t numBytes, UserConnection* exclude = 0);
+
     void ReplicateComponentType(u32 typeId, UserConnection* connection = 0);
 
     /// Read client extrapolation time parameter from command line and match it to the current sync period.
@@ -218,6 +245,15 @@ private:
     char removeAttrsBuffer_[1024];
     std::vector<u8> changedAttributes_;
 
+    /// A terrain whose edited height values are waiting to be sent.
+    struct PendingTerrainEdit
+    {
+        ComponentWeakPtr terrain;
+        float age; ///< Time since the first of the coalesced edits, in seconds.
+    };
+    /// Terrains whose edited height values are waiting to be sent
+    std::vector<PendingTerrainEdit> pendingTerrainEdits_;
+
     /// The sender of a component type. Used to avoid sending component description back to sender
     UserConnection* componentTypeSender_;
 
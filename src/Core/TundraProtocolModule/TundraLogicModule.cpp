@@ -18,6 +18,7 @@
 #include "ConfigAPI.h"
 #include "IComponentFactory.h"
 #include "Scene/Scene.h"
+#include "SceneJournal.h"
 #include "AssetAPI.h"
 #include "ConsoleAPI.h"
 #include "AssetAPI.h"
@@ -158,6 +159,7 @@ void TundraLogicModule::Initialize()
 void TundraLogicModule::Uninitialize()
 {
     kristalliModule_ = 0;
+    sceneJournal_.reset();
     syncManager_.reset();
     client_.reset();
     server_.reset();
@@ -226,6 +228,26 @@ void TundraLogicModule::LoadStartupScene()
     }
 }
 
+void TundraLogicModule::StartSceneJournal()
+{
+    QStringList files = framework_->CommandLineParameters("--journal");
+    if (files.isEmpty())
+    {
+        LogError("TundraLogicModule: --journal specified without a value.");
+        return;
+    }
+
+    Scene *scene = GetFramework()->Scene()->MainCameraScene();
+    if (!scene)
+        scene = framework_->Scene()->CreateScene("TundraServer", true, true).get();
+
+    // An existing snapshot replaces the startup scene, as it holds the state the scene had when the program last ran.
+    sceneJournal_ = shared_ptr<SceneJournal>(new SceneJournal(scene->shared_from_this(), files.first()));
+    if (!sceneJournal_->Recover())
+        LogInfo("TundraLogicModule: no scene snapshot in " + files.first() + ", starting a new one from the current scene.");
+    sceneJournal_->Start();
+}
+
 void TundraLogicModule::ReadStartupParameters()
 {
     // Check whether server should be auto started.
@@ -280,6 +302,8 @@ void TundraLogicModule::ReadStartupParameters()
         server_->Start(autoStartServerPort); 
     if (framework_->HasCommandLineParameter("--file")) // Load startup scene here (if we have one)
         LoadStartupScene();
+    if (framework_->HasCommandLineParameter("--journal"))
+        StartSceneJournal();
 
     // Web login handling, if we are on a server the request will be ignored down the chain.
     QStringList cmdLineParams = framework_->CommandLineParameters("--login");
@@ -11,6 +11,8 @@
 #include <kNetFwd.h>
 #include <kNet/Types.h>
 
+class SceneJournal;
+
 namespace TundraLogic
 {
 /// Implements the Tundra protocol server and client functionality.
@@ -89,10 +91,14 @@ private:
     /// Loads the startup scene(s) specified by --file command line parameter.
     void LoadStartupScene();
 
+    /// Restores the scene from the journal specified by --journal command line parameter, and starts recording its changes.
+    void StartSceneJournal();
+
     shared_ptr<SyncManager> syncManager_; ///< Sync manager
     shared_ptr<Client> client_; ///< Client
     shared_ptr<Server> server_; ///< Server
     KristalliProtocolModule *kristalliModule_; ///< KristalliProtocolModule pointer
+    shared_ptr<SceneJournal> sceneJournal_; ///< Scene journal, if --journal was given
 };
 
 }
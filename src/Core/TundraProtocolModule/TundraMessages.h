@@ -43,6 +43,9 @@ const unsigned long cRegisterComponentTypeMessage = 123;
 // Entity parenting
 const unsigned long cSetEntityParentMessage = 124;
 
+// Terrain editing
+const unsigned long cTerrainHeightsMessage = 125; // A rectangle of edited EC_Terrain height values
+
 // In case of network message structs are regenerated and descriptions get deleted., saving their descriptions here.
 // MsgAssetDeleted: Network message informing that asset has been deleted from storage.
 // MsgAssetDiscovery: Network message informing that new asset has been discovered in storage.
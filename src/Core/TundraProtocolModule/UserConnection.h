@@ -20,11 +20,12 @@ enum NetworkProtocolVersion
     ProtocolOriginal = 0x1,         // Original
     ProtocolCustomComponents = 0x2, // Adds support for transmitting new static-structured component types without actual C++ implementation, using EC_PlaceholderComponent
     ProtocolHierarchicScene = 0x3,  // Adds support for hierarchic scene, ie. entities having child entities
-    ProtocolWebClientRigidBodyMessage = 0x4 // WebSocket client that supports the rigid body optimization message
+    ProtocolWebClientRigidBodyMessage = 0x4, // WebSocket client that supports the rigid body optimization message
+    ProtocolTerrainHeights = 0x5    // Adds support for replicating edited terrain height values without transferring the height map asset
 };
 
 /// Highest supported protocol version in the build. Update this when a new protocol version is added
-const NetworkProtocolVersion cHighestSupportedProtocolVersion = ProtocolWebClientRigidBodyMessage;
+const NetworkProtocolVersion cHighestSupportedProtocolVersion = ProtocolTerrainHeights;
 
 /// Represents a client connection on the server side. Subclassed by networking implementations.
 class TUNDRAPROTOCOL_MODULE_API UserConnection : public QObject, public enable_shared_from_this<UserConnection>